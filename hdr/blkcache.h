@@ -0,0 +1,99 @@
+#ifndef _BLKCACHE_H_
+#define _BLKCACHE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cpu.h"
+#include "opcodes.h"
+
+/*
+  Decoded block cache.
+
+  A block is a straight-line run of instructions decoded once from memory:
+  for each instruction it keeps the handler resolved through the table of
+  its prefix, the opcode passed to it, its length and its fixed duration.
+  Instructions with a handler in opc_decodedTbl or opc_decodedTblXY also
+  keep their immediate, address or displacement operand, which is then
+  never fetched again. Blocks never cross a page boundary and end at the
+  first instruction that may change the PC. Decoding a block tags its page
+  with PAGE_CODE, the first write to that page bumps the page generation
+  and every block decoded from it becomes stale.
+
+  Built with -DCPU_FUSION (make FUSION=1), blocks decoded from ROM also
+  have the groups of opc_fusionTbl replaced by a single entry that runs
+  the whole group.
+*/
+
+#define BLK_COUNT      1024 // Cached blocks, must be a power of two.
+#define BLK_MAX_INSTR  16   // Instructions per block.
+#define BLK_MAX_LEN    4    // Longest instruction, in bytes.
+
+typedef struct blk_instr_t {
+    // Handler taking the decoded entry, NULL if the instruction runs through
+    // handler.op with the opcode.
+    opc_decoded_t execute;
+    // Handler in the opcode table of the prefix.
+    union {
+        void (*op) (cpu_t *cpu, uint8_t opcode);
+        void (*xy) (cpu_t *cpu, uint16_t *idx, uint8_t opcode);
+        void (*xycb) (cpu_t *cpu, uint16_t addr, uint8_t opcode);
+    } handler;
+    uint16_t operand; // n, nn, e or d, then n for LD (IX+d),n.
+    uint8_t prefix;   // 0xCB, 0xED, 0xDD or 0xFD, 0 if none.
+    uint8_t opcode;   // Opcode after the prefix, passed to the handler.
+    uint8_t len;
+    uint8_t fetched;  // Bytes the PC moves past before execute runs.
+    uint8_t TStates;
+} blk_instr_t;
+
+typedef struct blk_t {
+    uint16_t start;   // Address of the first instruction.
+    uint8_t count;    // Decoded instructions, 0 if the entry is empty.
+    uint32_t gen;     // Page generation at decode time.
+    blk_instr_t instr[BLK_MAX_INSTR];
+} blk_t;
+
+typedef struct blk_cache_t {
+    // Block being executed, position and address of its next instruction.
+    blk_t *cur;
+    uint8_t pos;
+    uint16_t next_pc;
+    // Blocks, direct mapped by start address.
+    blk_t blocks[BLK_COUNT];
+#ifdef CPU_FUSION
+    // Times each fused group has been run, and instructions it has run.
+    uint64_t fusion_hits[OPC_FUSION_COUNT];
+    uint64_t fusion_instr[OPC_FUSION_COUNT];
+#endif
+} blk_cache_t;
+
+
+blk_cache_t *blk_create(void);
+void blk_destroy(blk_cache_t *cache);
+void blk_flush(blk_cache_t *cache);
+int32_t blk_decode(cpu_t *cpu, blk_t *blk, uint16_t pc);
+const blk_instr_t *blk_lookup(cpu_t *cpu);
+#ifdef CPU_FUSION
+void blk_fusionReport(cpu_t *cpu, FILE *stream);
+#endif
+
+
+// Returns the decoded instruction at the current PC. Straight-line code
+// just moves to the next instruction of the current block, anything else
+// goes through blk_lookup. Returns NULL if the PC cannot be decoded, in
+// which case the instruction has to be fetched from memory.
+static inline const blk_instr_t *blk_fetch(cpu_t *cpu) {
+    blk_cache_t *cache = cpu->blocks;
+    blk_t *blk = cache->cur;
+
+    if (blk == NULL || cpu->PC != cache->next_pc || cache->pos == blk->count ||
+        blk->gen != cpu->pages[blk->start >> MEM_PAGE_SHIFT].gen)
+        return blk_lookup(cpu);
+
+    const blk_instr_t *instr = &blk->instr[cache->pos++];
+    cache->next_pc += instr->len;
+    return instr;
+}
+
+#endif // _BLKCACHE_H_
@@ -2,9 +2,17 @@
 #define _BOARD_H_
 
 #include <stdint.h>
+#include <signal.h>
 
 #include "cpu.h"
 #include "mc6850.h"
+#include "rom.h"
+#ifndef Z80_LIBRARY
+#include "input.h"
+#include "output.h"
+#endif
+
+#define BOARD_ROM_SIZE 0x8000 // 32KB.
 
 
 // This is used to fix the circular dependency between board and cpu.
@@ -15,11 +23,23 @@ typedef struct cpu_t cpu_t;
 typedef struct board_t {
     cpu_t *cpu;
     mc6850_t *acia;
+#ifndef Z80_LIBRARY
+    // Set from a signal handler, the trace is dumped between two slices.
+    volatile sig_atomic_t is_traceRequested;
+#endif
 } board_t;
 
 
-int32_t board_init(board_t *board, char *rom_file);
-void board_emulate(board_t *board, int32_t instr_limit, bool is_terminal);
+int32_t board_init(board_t *board, const char *rom_file);
+int32_t board_initShared(board_t *board, rom_t *rom);
+int32_t board_fork(board_t *board, board_t *parent);
+int32_t board_loadRom(board_t *board, const char *rom_file);
+void board_updateIrq(board_t *board);
+uint32_t board_sliceCycles(board_t *board, uint32_t max);
+#ifndef Z80_LIBRARY
+void board_emulate(board_t *board, int32_t instr_limit, input_t *input,
+    output_t *output, uint32_t idle_timeout);
+#endif
 int32_t board_destroy(board_t *board);
 
 #endif // _BOARD_H_
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <signal.h>
 
 #include "board.h"
 
@@ -26,32 +27,64 @@ typedef struct board_t board_t;
 // Carry flag indicates a carry from the high-order bit of the accumulator (B7).
 #define FLAG_CARRY_BIT  0
 
-#define GET_FLAG_SIGN(cpu) 	   ((cpu->F >> FLAG_SIGN_BIT) & 0x1)   // S
-#define GET_FLAG_ZERO(cpu) 	   ((cpu->F >> FLAG_ZERO_BIT) & 0x1)   // Z
-#define GET_FLAG_HCARRY(cpu)   ((cpu->F >> FLAG_HCARRY_BIT) & 0x1) // H
-#define GET_FLAG_PARITY(cpu)   ((cpu->F >> FLAG_PARITY_BIT) & 0x1) // P/V
-#define GET_FLAG_ADDSUB(cpu)   ((cpu->F >> FLAG_ADDSUB_BIT) & 0x1) // N
-#define GET_FLAG_CARRY(cpu)    ((cpu->F >> FLAG_CARRY_BIT) & 0x1)  // C
-
-#define SET_FLAG_SIGN(cpu) 	   (cpu->F |= (1 << FLAG_SIGN_BIT))    // S
-#define SET_FLAG_ZERO(cpu) 	   (cpu->F |= (1 << FLAG_ZERO_BIT))    // Z
-#define SET_FLAG_HCARRY(cpu)   (cpu->F |= (1 << FLAG_HCARRY_BIT))  // H
-#define SET_FLAG_PARITY(cpu)   (cpu->F |= (1 << FLAG_PARITY_BIT))  // P/V
-#define SET_FLAG_ADDSUB(cpu)   (cpu->F |= (1 << FLAG_ADDSUB_BIT))  // N
-#define SET_FLAG_CARRY(cpu)    (cpu->F |= (1 << FLAG_CARRY_BIT))   // C
-
-#define RESET_FLAG_SIGN(cpu)   (cpu->F &= ~(1 << FLAG_SIGN_BIT))   // S
-#define RESET_FLAG_ZERO(cpu)   (cpu->F &= ~(1 << FLAG_ZERO_BIT))   // Z
-#define RESET_FLAG_HCARRY(cpu) (cpu->F &= ~(1 << FLAG_HCARRY_BIT)) // H
-#define RESET_FLAG_PARITY(cpu) (cpu->F &= ~(1 << FLAG_PARITY_BIT)) // P/V
-#define RESET_FLAG_ADDSUB(cpu) (cpu->F &= ~(1 << FLAG_ADDSUB_BIT)) // N
-#define RESET_FLAG_CARRY(cpu)  (cpu->F &= ~(1 << FLAG_CARRY_BIT))  // C
+#define FLAG_SIGN       (1 << FLAG_SIGN_BIT)
+#define FLAG_ZERO       (1 << FLAG_ZERO_BIT)
+#define FLAG_HCARRY     (1 << FLAG_HCARRY_BIT)
+#define FLAG_PARITY     (1 << FLAG_PARITY_BIT)
+#define FLAG_ADDSUB     (1 << FLAG_ADDSUB_BIT)
+#define FLAG_CARRY      (1 << FLAG_CARRY_BIT)
+// Bits 3 and 5 are not computed and keep their previous value.
+#define FLAG_UNDOC_MASK 0x28
+
+// Flag accessors. They go through cpu_getF so that lazy flags are
+// materialized first.
+#define GET_FLAG_SIGN(cpu) 	   ((cpu_getF(cpu) >> FLAG_SIGN_BIT) & 0x1)   // S
+#define GET_FLAG_ZERO(cpu) 	   ((cpu_getF(cpu) >> FLAG_ZERO_BIT) & 0x1)   // Z
+#define GET_FLAG_HCARRY(cpu)   ((cpu_getF(cpu) >> FLAG_HCARRY_BIT) & 0x1) // H
+#define GET_FLAG_PARITY(cpu)   ((cpu_getF(cpu) >> FLAG_PARITY_BIT) & 0x1) // P/V
+#define GET_FLAG_ADDSUB(cpu)   ((cpu_getF(cpu) >> FLAG_ADDSUB_BIT) & 0x1) // N
+#define GET_FLAG_CARRY(cpu)    ((cpu_getF(cpu) >> FLAG_CARRY_BIT) & 0x1)  // C
+
+#define SET_FLAG_SIGN(cpu) 	   (cpu_getF(cpu), cpu->F |= (1 << FLAG_SIGN_BIT))    // S
+#define SET_FLAG_ZERO(cpu) 	   (cpu_getF(cpu), cpu->F |= (1 << FLAG_ZERO_BIT))    // Z
+#define SET_FLAG_HCARRY(cpu)   (cpu_getF(cpu), cpu->F |= (1 << FLAG_HCARRY_BIT))  // H
+#define SET_FLAG_PARITY(cpu)   (cpu_getF(cpu), cpu->F |= (1 << FLAG_PARITY_BIT))  // P/V
+#define SET_FLAG_ADDSUB(cpu)   (cpu_getF(cpu), cpu->F |= (1 << FLAG_ADDSUB_BIT))  // N
+#define SET_FLAG_CARRY(cpu)    (cpu_getF(cpu), cpu->F |= (1 << FLAG_CARRY_BIT))   // C
+
+#define RESET_FLAG_SIGN(cpu)   (cpu_getF(cpu), cpu->F &= ~(1 << FLAG_SIGN_BIT))   // S
+#define RESET_FLAG_ZERO(cpu)   (cpu_getF(cpu), cpu->F &= ~(1 << FLAG_ZERO_BIT))   // Z
+#define RESET_FLAG_HCARRY(cpu) (cpu_getF(cpu), cpu->F &= ~(1 << FLAG_HCARRY_BIT)) // H
+#define RESET_FLAG_PARITY(cpu) (cpu_getF(cpu), cpu->F &= ~(1 << FLAG_PARITY_BIT)) // P/V
+#define RESET_FLAG_ADDSUB(cpu) (cpu_getF(cpu), cpu->F &= ~(1 << FLAG_ADDSUB_BIT)) // N
+#define RESET_FLAG_CARRY(cpu)  (cpu_getF(cpu), cpu->F &= ~(1 << FLAG_CARRY_BIT))  // C
+
+#ifdef CPU_LAZYFLAGS
+// Pending flag computations. The last 8-bit ALU operation only records its
+// kind and operands, F is computed from them when it is read.
+#define FLAGS_NONE      0 // F is up to date.
+#define FLAGS_ADD       1 // ADD/ADC of flags_op1, flags_op2 and flags_c.
+#define FLAGS_SUB       2 // SUB/SBC/CP of flags_op1, flags_op2 and flags_c.
+#define FLAGS_INC       3 // INC of flags_op1, C is kept.
+#define FLAGS_DEC       4 // DEC of flags_op1, C is kept.
+#define FLAGS_SZP       5 // S, Z, P of flags_op1, H and C from flags_op2.
+#endif
 
 // Interrupt mode codes.
 #define INT_MODE_0      0
 #define INT_MODE_1      1
 #define INT_MODE_2      2
 
+// Reasons for cpu_run() to return.
+typedef enum {
+    CPU_RUN_BUDGET,     // The cycle budget has been used.
+    CPU_RUN_IO,         // An IO port has been accessed.
+    CPU_RUN_INTERRUPT,  // An interrupt has been accepted.
+    CPU_RUN_HALT,       // A HALT instruction has been executed.
+    CPU_RUN_BREAKPOINT, // The PC has reached a breakpoint.
+    CPU_RUN_FAULT       // A fatal error stopped the cpu (see cpu_fault).
+} cpu_run_t;
+
 // Chunk types.
 #define CHUNK_UNUSED    0
 #define CHUNK_READONLY  1
@@ -59,6 +92,19 @@ typedef struct board_t board_t;
 
 #define WHITIN(x, y, z) ((x >= y) && (x <= z))
 
+// Page table geometry. The 64KB address space is split into 256-byte pages.
+#define MEM_PAGE_SHIFT  8
+#define MEM_PAGE_SIZE   (1 << MEM_PAGE_SHIFT)
+#define MEM_PAGE_MASK   (MEM_PAGE_SIZE - 1)
+#define MEM_PAGE_COUNT  (0x10000 >> MEM_PAGE_SHIFT)
+
+// Page flags. A page with no flags set is plain RAM.
+#define PAGE_UNUSED     (1 << 0) // No chunk maps this page.
+#define PAGE_READONLY   (1 << 1) // Writes are rejected.
+#define PAGE_MMIO       (1 << 2) // Not directly mapped, uses the slow path.
+#define PAGE_CODE       (1 << 3) // Holds decoded blocks, see blkcache.h.
+#define PAGE_COW        (1 << 4) // Shared RAM, copied on the first write.
+
 
 // Memory bank description.
 typedef struct mem_chunk_t {
@@ -68,9 +114,42 @@ typedef struct mem_chunk_t {
     uint16_t size;
     uint8_t *buff;
     struct mem_chunk_t *next;
+    // Shared image. A read-only chunk uses it as its buffer. A read-write
+    // chunk reads its PAGE_COW pages from it, buff then holds the pages
+    // written since and may be NULL until the first one.
+    struct rom_t *image;
 } mem_chunk_t;
 
 
+// Page table entry. The host pointer refers to the first byte of the page.
+typedef struct mem_page_t {
+    uint8_t *host;
+    uint8_t flags;
+    uint32_t gen; // Bumped when a write hits a PAGE_CODE page.
+} mem_page_t;
+
+
+// Maximum length in bytes of a loop detected by cpu_isIdle.
+#define CPU_IDLE_LOOP_LEN 16
+
+
+// Instruction trace. Built with -DCPU_TRACE (make TRACE=1), every executed
+// instruction stores a binary record in a per-cpu ring buffer which is only
+// formatted when dumped (cpu_dumpTrace), on demand or on a fatal error.
+#define TRACE_SIZE 1024 // Must be a power of two.
+
+typedef struct trace_rec_t {
+    uint16_t PC;
+    uint8_t  opcode[4]; // Bytes at PC, not all belong to the instruction.
+    uint16_t AF;
+    uint16_t BC;
+    uint16_t DE;
+    uint16_t HL;
+    uint16_t SP;
+    uint32_t cycles;
+} trace_rec_t;
+
+
 // Defines the cpu state.
 typedef struct cpu_t {
     uint32_t cycles;
@@ -79,6 +158,8 @@ typedef struct cpu_t {
     // executing NOPs until a non maskable interrupt is received or a maskable
     // interrupt is received and interrupts are globally enabled.
     uint8_t  halt;
+    // Set by cpu_fault() in library builds, the cpu does not run anymore.
+    bool is_faulted;
 
     // Main register set.
     union {
@@ -130,8 +211,26 @@ typedef struct cpu_t {
         uint16_t SP;
     };
 
+#ifdef CPU_LAZYFLAGS
+    // Pending flag computation (FLAGS_*), F is only valid after cpu_getF.
+    // cpu_run, thr_emulate and jit_emulate leave F materialized.
+    uint8_t flags_op;
+    uint8_t flags_op1;
+    uint8_t flags_op2;
+    uint8_t flags_c;
+#endif
+
     // Attached memory banks.
     mem_chunk_t *memory;
+    // Flat memory map built from the memory banks.
+    mem_page_t pages[MEM_PAGE_COUNT];
+    // Decoded block cache, NULL if not built with CPU_BLOCKCACHE.
+    struct blk_cache_t *blocks;
+    // Dynamic translator, created by the first jit_emulate() call.
+    struct jit_t *jit;
+    // Guest profiler, only fed by the reference engine built with
+    // CPU_PROFILE. NULL if profiling is off.
+    struct prof_t *prof;
 
     // Interrupt enable flag. IFF1 disables interrupts from being accepted.
     // IFF2 is a temporary storage location for IFF1.
@@ -158,14 +257,32 @@ typedef struct cpu_t {
     // Byte from the interrupting device (see mode 0 and 2).
     uint8_t int_data;
 
+    // Breakpoint bitmap indexed by address, NULL if none was ever set.
+    uint8_t *breakpoints;
+    // Set by cpu_portIn and cpu_portOut, cleared by cpu_run.
+    bool is_ioAccess;
+    // T-states left in the current cpu_run slice. Block repeat instructions
+    // (LDIR, LDDR, CPIR, CPDR) run as many iterations as fit in one step,
+    // 0 runs one iteration per step.
+    uint32_t repeat_cycles;
+
     // IO.
     board_t *board;
     uint8_t (*portIO_in) (board_t *board, uint8_t port);
     void (*portIO_out) (board_t *board, uint8_t port, uint8_t data);
+    // True if reading port has no side effects, see cpu_isIdle.
+    bool (*portIO_isPure) (board_t *board, uint8_t port);
+
+#ifdef CPU_TRACE
+    // Last executed instructions, trace_count counts all the records.
+    trace_rec_t trace[TRACE_SIZE];
+    uint32_t trace_count;
+#endif
 } cpu_t;
 
 
 int32_t cpu_init(cpu_t *cpu, mem_chunk_t *mem_list, board_t *board);
+int32_t cpu_fork(cpu_t *cpu, cpu_t *parent, board_t *board);
 int32_t cpu_destroy(cpu_t *cpu);
 void cpu_reset(cpu_t *cpu);
 uint8_t cpu_read(cpu_t *cpu, const uint16_t addr);
@@ -173,10 +290,75 @@ void cpu_write(cpu_t *cpu, const uint8_t data, const uint16_t addr);
 void cpu_stackPush(cpu_t *cpu, uint16_t data);
 uint16_t cpu_stackPop(cpu_t *cpu);
 void cpu_emulate(cpu_t *cpu);
+cpu_run_t cpu_run(cpu_t *cpu, uint32_t cycle_budget);
+uint32_t cpu_skipHalt(cpu_t *cpu, uint32_t count);
+bool cpu_isIdle(cpu_t *cpu);
+int32_t cpu_setBreakpoint(cpu_t *cpu, uint16_t addr);
+void cpu_clearBreakpoint(cpu_t *cpu, uint16_t addr);
+uint8_t cpu_portIn(cpu_t *cpu, uint8_t port);
+void cpu_portOut(cpu_t *cpu, uint8_t port, uint8_t data);
 void cpu_setIOcallbacks(cpu_t *cpu, uint8_t (*portIO_in)(board_t *, uint8_t),
-    void (*portIO_out)(board_t *, uint8_t, uint8_t));
+    void (*portIO_out)(board_t *, uint8_t, uint8_t),
+    bool (*portIO_isPure)(board_t *, uint8_t));
+
+#ifdef CPU_LAZYFLAGS
+void cpu_computeFlags(cpu_t *cpu);
+#endif
 
 void cpu_printChunk(mem_chunk_t *chunk);
 void cpu_dumpRegisters(cpu_t *cpu);
+void cpu_dumpTrace(cpu_t *cpu);
+
+
+// Returns true if an interrupt will be accepted after the current
+// instruction.
+static inline bool cpu_hasInterrupt(cpu_t *cpu) {
+    return cpu->is_pendingNMI || (cpu->is_pendingMI && cpu->IFF1);
+}
+
+
+// Stops the emulation after a fatal error. The program raises SIGINT so
+// that its exit handler runs. Built as a library (Z80_LIBRARY), the cpu
+// is only marked as faulted and cpu_run() returns CPU_RUN_FAULT, so that
+// the other instances in the process keep running.
+static inline void cpu_fault(cpu_t *cpu) {
+#ifdef Z80_LIBRARY
+    cpu->is_faulted = true;
+#else
+    raise(SIGINT);
+#endif
+    return;
+}
+
+
+// Returns the F register, computing any pending flags first.
+static inline uint8_t cpu_getF(cpu_t *cpu) {
+#ifdef CPU_LAZYFLAGS
+    if (cpu->flags_op != FLAGS_NONE)
+        cpu_computeFlags(cpu);
+#endif
+    return cpu->F;
+}
+
+
+#ifdef CPU_TRACE
+// Appends a record to the instruction trace. Opcode bytes are read from
+// the cpu memory at the given PC.
+static inline void cpu_traceRecord(cpu_t *cpu, uint16_t pc, uint16_t af,
+    uint16_t bc, uint16_t de, uint16_t hl, uint16_t sp, uint32_t cycles) {
+
+    trace_rec_t *rec = &cpu->trace[cpu->trace_count++ & (TRACE_SIZE - 1)];
+    rec->PC = pc;
+    for (int32_t i = 0; i < 4; i++)
+        rec->opcode[i] = cpu_read(cpu, pc + i);
+    rec->AF = af;
+    rec->BC = bc;
+    rec->DE = de;
+    rec->HL = hl;
+    rec->SP = sp;
+    rec->cycles = cycles;
+    return;
+}
+#endif
 
 #endif // _CPU_H_
@@ -0,0 +1,66 @@
+#ifndef _INPUT_H_
+#define _INPUT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/*
+  Host input.
+
+  A thread of its own blocks on reads from the input file descriptor and
+  pushes the bytes into a single-producer, single-consumer ring. The
+  emulation loop takes them out with input_pop(), which only loads the
+  head and tail indexes: no system call is made while the guest runs.
+
+  The lock and condition are only used by input_wait(), for the emulation
+  loop to sleep while the guest has nothing to do but wait for input.
+
+  Paced input is fed one line at a time: after the end of a line, the
+  rest waits for the guest to be idle. Scripts can then be sent at full
+  speed without overflowing the receive buffer of the guest.
+*/
+
+#define INPUT_RING_SIZE 4096 // Power of two.
+
+typedef struct input_t {
+    uint8_t ring[INPUT_RING_SIZE];
+    // Free-running indexes, head only moved by the reader thread and tail
+    // only by the emulation loop. Each sits on its own cache line.
+    uint32_t head __attribute__((aligned(64)));
+    uint32_t tail __attribute__((aligned(64)));
+    bool is_closed;     // The reader got to the end of the input.
+    bool is_paced;      // Lines wait for the guest to be idle.
+    int32_t fd;
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+} input_t;
+
+
+input_t *input_start(int32_t fd, bool is_paced);
+void input_stop(input_t *input);
+bool input_wait(input_t *input, uint32_t timeout);
+
+
+// Takes the oldest input byte into byte.
+// Returns false if there is none.
+static inline bool input_pop(input_t *input, uint8_t *byte) {
+    uint32_t tail = input->tail;
+
+    if (__atomic_load_n(&input->head, __ATOMIC_ACQUIRE) == tail)
+        return false;
+
+    *byte = input->ring[tail % INPUT_RING_SIZE];
+    __atomic_store_n(&input->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+
+// Returns true if no more input can come.
+static inline bool input_isOver(input_t *input) {
+    return __atomic_load_n(&input->is_closed, __ATOMIC_ACQUIRE) &&
+        __atomic_load_n(&input->head, __ATOMIC_ACQUIRE) == input->tail;
+}
+
+#endif // _INPUT_H_
@@ -0,0 +1,55 @@
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+/*
+  x86-64 dynamic translator.
+
+  Blocks found by blk_decode() are translated once they have been entered
+  JIT_HOT times. Loads between registers and immediate loads, INC and DEC
+  of registers and register pairs, the 8-bit ALU operations on registers
+  and immediates, JR, DJNZ and JP are translated into x86-64 instructions
+  working on the cpu_t fields, with F taken from the same flag tables as
+  the interpreter. Every other instruction, including those that access
+  memory, becomes a call to its decoded handler. With CPU_LAZYFLAGS, the
+  instructions that read or write F are calls too. A block chains to the
+  next translated block through a PC indexed map without going back to C.
+  Translated blocks never contain IO instructions and stop after EI, so
+  interrupts and peripherals are left to the interpreter. Writes to a
+  page holding translated code make its blocks stale (see PAGE_CODE).
+
+  The arena is never writable and executable at once: its pages are
+  switched to read-write while a block is emitted, then back to
+  read-execute. If the host refuses either mapping, only the interpreter
+  runs.
+
+  Built with JIT_SELFCHECK, every block is also run by cpu_emulate() on a
+  shadow cpu and the two states are compared.
+*/
+
+#define JIT_HOT         32                // Entries before translation.
+#define JIT_ARENA_SIZE  (4 * 1024 * 1024) // Executable memory, in bytes.
+#define JIT_BLOCK_SIZE  4096              // Upper bound of one block's code.
+
+typedef struct jit_t {
+    uint8_t *arena;  // NULL if the translator is not available.
+    uint32_t used;
+    // Shared entry and exit code at the start of the arena.
+    int32_t (*enter) (cpu_t *cpu, uint32_t budget, uint8_t *code, void *map);
+    uint8_t *leave;
+    // Translated code and entry counters, indexed by PC.
+    uint8_t *map[0x10000];
+    uint16_t hits[0x10000];
+    // State of the lockstep interpreter in self-check mode.
+    cpu_t *shadow;
+} jit_t;
+
+
+jit_t *jit_create(cpu_t *cpu);
+void jit_destroy(jit_t *jit);
+uint32_t jit_emulate(cpu_t *cpu, uint32_t instr_limit);
+
+#endif // _JIT_H_
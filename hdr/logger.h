@@ -12,26 +12,36 @@
 #define LOGGER_INFO_LEVEL    4
 #define LOGGER_DEBUG_LEVEL   10
 
+// Highest verbosity level compiled into the program. Messages above it are
+// removed at build time, arguments included. Debug builds raise it with
+// -DLOGGER_MAX_LEVEL=LOGGER_DEBUG_LEVEL (make DEBUG=1).
+#ifndef LOGGER_MAX_LEVEL
+#define LOGGER_MAX_LEVEL LOGGER_INFO_LEVEL
+#endif
+
+#define LOGGER_WRITE(level, args...) \
+    ((level) <= LOGGER_MAX_LEVEL ? logger_write(level, args) : (void)0)
+
 #define LOG_FATAL(args...) \
-    logger_write(LOGGER_FATAL_LEVEL, "[FATAL] " args)
+    LOGGER_WRITE(LOGGER_FATAL_LEVEL, "[FATAL] " args)
 
 #define LOG_ERROR(args...) \
-    logger_write(LOGGER_ERROR_LEVEL, "[ERROR] " args)
+    LOGGER_WRITE(LOGGER_ERROR_LEVEL, "[ERROR] " args)
 
 #define LOG_WARNING(args...) \
-    logger_write(LOGGER_WARNING_LEVEL, "[WARNING] " args)
+    LOGGER_WRITE(LOGGER_WARNING_LEVEL, "[WARNING] " args)
 
 #define LOG_INFO(args...) \
-    logger_write(LOGGER_INFO_LEVEL, "[INFO] " args)
+    LOGGER_WRITE(LOGGER_INFO_LEVEL, "[INFO] " args)
 
 // Debug messages can be fully customized. No prefix is given.
 #define LOG_DEBUG(args...) \
-    logger_write(LOGGER_DEBUG_LEVEL, "[DEBUG] " args)
-
+    LOGGER_WRITE(LOGGER_DEBUG_LEVEL, "[DEBUG] " args)
 
 void logger_open(const char *logfile, bool is_terminal);
 void logger_close(void);
-void logger_write(const int32_t level, const char *format, ...);
+void logger_write(const int32_t level, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
 void logger_set_verbosity(int32_t level);
 
 #endif // _LOGGER_H_
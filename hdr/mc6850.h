@@ -2,32 +2,73 @@
 #define _MC6850_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
-#define RX_FULL   (1 << 0)
-#define TX_EMPTY  (1 << 1)
+// Status register.
+#define RX_FULL    (1 << 0) // Receive data register full.
+#define TX_EMPTY   (1 << 1) // Transmit data register empty.
+#define RX_OVERRUN (1 << 5) // A character was lost, RDR was still full.
+#define IRQ        (1 << 7) // The ACIA asks for an interrupt.
+
+// Control register.
+#define CR_DIVIDE       0x03 // Counter divide select, CR1-CR0.
+#define CR_MASTER_RESET 0x03
+#define CR_WORD         0x1C // Word select, CR4-CR2.
+#define CR_WORD_8BIT    0x10 // 8 data bits, 7 otherwise.
+#define CR_TX           0x60 // Transmitter control, CR6-CR5.
+#define CR_TX_IRQ       0x20 // RTS low, transmit interrupt enabled.
+#define CR_RTS_HIGH     0x40 // RTS high, transmit interrupt disabled.
+#define CR_RX_IRQ       0x80 // Receive interrupt enabled.
 
 /*
   IO ports to communicate with the 6850 are 0x80 and 0x81.
   In particular, the higher nibble activates the ACIA while
   the lower nibble drives the register select pin.
-  0x80: R/W control/status registers
-  0x81: R/W TX/RX data registers
+  0x80: W control register, R status register
+  0x81: W TX data register, R RX data register
+
+  Characters take the time set by the control register to go through the
+  serial lines: start bit, data bits, parity and stop bits, each of them
+  as many clock cycles as the divide ratio. The ACIA clock is the cpu
+  clock, so times are counted in T-states of the cpu. In turbo mode, they
+  take no time at all: the host sends characters as fast as the guest
+  reads them.
 
-  Transmitting interrupt is disabled. Reception interrupt is enabled.
+  The IRQ line is a level: it stays active while RX_FULL or RX_OVERRUN
+  are set with receive interrupts enabled, or TX_EMPTY is set with the
+  transmit interrupt enabled. The host only sends characters while RTS is
+  low, the guest raises it when it cannot take more.
 */
 
 typedef struct mc6850_t {
-    uint8_t TDR;    // Transmit Data Register.
-    uint8_t RDR;    // Receive Data Register.
-    uint8_t status; // Status Register.
+    uint8_t TDR;      // Transmit Data Register.
+    uint8_t RDR;      // Receive Data Register.
+    uint8_t status;   // Status Register.
+    uint8_t control;  // Control Register.
+    uint8_t TSR;      // Transmit Shift Register.
+    uint8_t RSR;      // Receive Shift Register.
+    bool is_txBusy;   // TSR holds a character, sent at tx_end.
+    bool is_rxBusy;   // RSR holds a character, received at rx_end.
+    uint32_t tx_end;
+    uint32_t rx_end;
+    bool is_turbo;
 } mc6850_t;
 
 
 int32_t mc6850_init(mc6850_t *mc6850);
-uint8_t mc6850_getStatus(mc6850_t *mc6850);
-void mc6850_setStatus(mc6850_t *mc6850, uint8_t data);
-uint8_t mc6850_getTDR(mc6850_t *mc6850);
-void mc6850_setRDR(mc6850_t *mc6850, uint8_t data);
+uint8_t mc6850_readStatus(mc6850_t *mc6850);
+uint8_t mc6850_readData(mc6850_t *mc6850);
+void mc6850_writeControl(mc6850_t *mc6850, uint8_t data);
+void mc6850_writeData(mc6850_t *mc6850, uint8_t data, uint32_t now);
+bool mc6850_hasIrq(mc6850_t *mc6850);
+
+void mc6850_update(mc6850_t *mc6850, uint32_t now);
+uint32_t mc6850_nextEvent(mc6850_t *mc6850, uint32_t now);
+bool mc6850_isBusy(mc6850_t *mc6850, uint32_t now);
+bool mc6850_canReceive(mc6850_t *mc6850);
+void mc6850_receive(mc6850_t *mc6850, uint8_t data, uint32_t now);
+bool mc6850_isSent(mc6850_t *mc6850, uint32_t now);
+uint8_t mc6850_transmit(mc6850_t *mc6850, uint32_t now);
 
 void mc6850_dumpStatus(mc6850_t *mc6850);
 
@@ -5,13 +5,70 @@
 #include "cpu.h"
 
 
+// TStates is the fixed duration of the instruction. Instructions whose
+// duration depends on operands or conditions have TStates set to 0 and
+// their handler adds the consumed cycles to cpu->cycles directly, so the
+// table is never written at runtime.
 typedef struct {
     void (*execute) (cpu_t *cpu, uint8_t opcode);
     int32_t TStates;
 } opc_t;
 
+// Second-level table of the 0xDD and 0xFD prefixes, shared by both: the
+// handler gets the index register (IX or IY) to work on.
+typedef struct {
+    void (*execute) (cpu_t *cpu, uint16_t *idx, uint8_t opcode);
+    int32_t TStates;
+} opc_xy_t;
+
+// Table of the 0xDDCB and 0xFDCB prefixes. The handler gets the IX+d or IY+d
+// address, already computed from the displacement byte.
+typedef struct {
+    void (*execute) (cpu_t *cpu, uint16_t addr, uint8_t opcode);
+    int32_t TStates;
+} opc_xycb_t;
+
+
+// Prefixed opcodes are dispatched through a second table indexed by the
+// next byte; their opc_tbl entries only fetch it and dispatch.
+extern const opc_t opc_tbl[0x100];
+extern const opc_t opc_tblCB[0x100];
+extern const opc_t opc_tblED[0x100];
+extern const opc_xy_t opc_tblXY[0x100];
+extern const opc_xycb_t opc_tblXYCB[0x100];
+
+// Handlers of instructions decoded by blk_decode, which take their operands
+// from the block cache entry instead of fetching them. NULL for the
+// instructions that run through the tables above.
+struct blk_instr_t;
+typedef void (*opc_decoded_t) (cpu_t *cpu, const struct blk_instr_t *instr);
+
+extern const opc_decoded_t opc_decodedTbl[0x100];
+extern const opc_decoded_t opc_decodedTblXY[0x100];
+
+#ifdef CPU_FUSION
+// Groups of adjacent unprefixed instructions run by a single handler, see
+// blk_fuse. The handler gets the group index as its opcode argument.
+#define OPC_FUSION_COUNT 8
+#define OPC_FUSION_MAX   3
+
+typedef struct {
+    const char *name;
+    uint8_t count; // Instructions in the group.
+    uint8_t opcode[OPC_FUSION_MAX];
+    void (*execute) (cpu_t *cpu, uint8_t id);
+} opc_fusion_t;
+
+extern const opc_fusion_t opc_fusionTbl[OPC_FUSION_COUNT];
+#endif
+
+// Flag lookup tables, filled once at program start-up. The ADD/SUB tables
+// hold S, Z, H, P/V, N and C and are indexed by FLAG_TBL_IDX.
+#define FLAG_TBL_IDX(c, op1, op2) (((c) << 16) | ((op1) << 8) | (op2))
 
-extern opc_t opc_tbl[0x100];
+extern uint8_t opc_szpTbl[0x100];
+extern uint8_t opc_szhvcAddTbl[2 * 0x100 * 0x100];
+extern uint8_t opc_szhvcSubTbl[2 * 0x100 * 0x100];
 
 
 uint8_t opc_fetch8(cpu_t *cpu);
@@ -0,0 +1,38 @@
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+  Guest output.
+
+  Bytes sent by the guest through the ACIA are kept as they are in a
+  buffer. output_update() writes them out at most once per
+  OUTPUT_FRAME_MS, or as soon as the guest goes idle: line endings and
+  form feeds are translated for the whole buffer at once, followed by a
+  single refresh() of the curses screen, or a single fflush() of the
+  output stream in headless mode.
+
+  Built with Z80_HEADLESS (make HEADLESS=1), only streams are supported.
+*/
+
+#define OUTPUT_BUFFER_SIZE 4096
+#define OUTPUT_FRAME_MS    20 // Time between two refreshes, at least.
+
+typedef struct output_t {
+    char buff[OUTPUT_BUFFER_SIZE];
+    uint32_t size;
+    FILE *stream;        // NULL for the curses screen.
+    uint64_t last_flush; // Time of the last refresh, in milliseconds.
+} output_t;
+
+
+output_t *output_create(FILE *stream);
+void output_destroy(output_t *output);
+void output_put(output_t *output, uint8_t byte);
+void output_flush(output_t *output);
+void output_update(output_t *output, bool is_idle);
+
+#endif // _OUTPUT_H_
@@ -0,0 +1,73 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cpu.h"
+
+/*
+  Guest profiler.
+
+  Built with -DCPU_PROFILE (make PROFILE=1), the reference engine counts
+  the instructions and T-states run at each PC in two flat 64K arrays.
+  It also follows CALL, RST and accepted interrupts on a shadow stack and
+  charges the T-states to the path of calls that led there. A frame is
+  left as soon as SP moves above the return address it pushed, so RET and
+  code that drops its return address are both handled. Calls nested
+  deeper than PROF_MAX_DEPTH are charged to the last tracked one.
+
+  An optional symbol map names the ROM routines: one "<hex address>
+  <name>" pair per line, lines starting with '#' or ';' are ignored. Each
+  PC belongs to the closest symbol at or below it.
+*/
+
+#define PROF_MAX_DEPTH   64     // Tracked nested calls.
+#define PROF_MAX_NODES   0x8000 // Distinct call paths.
+#define PROF_HASH_SIZE   0x10000
+#define PROF_MAX_NAME    32
+
+typedef struct prof_node_t {
+    uint16_t addr;   // Called address, 0 for the root.
+    int32_t parent;  // -1 for the root.
+    uint64_t cycles; // T-states spent in the function itself.
+} prof_node_t;
+
+typedef struct prof_frame_t {
+    int32_t node;
+    uint16_t sp;     // Address of the pushed return address.
+} prof_frame_t;
+
+typedef struct prof_sym_t {
+    uint16_t addr;
+    char name[PROF_MAX_NAME];
+} prof_sym_t;
+
+typedef struct prof_t {
+    // Instructions and T-states, indexed by PC.
+    uint64_t instr[0x10000];
+    uint64_t cycles[0x10000];
+    // Call tree, nodes are found by (parent, addr) through the hash table.
+    prof_node_t nodes[PROF_MAX_NODES];
+    int32_t node_count;
+    int32_t hash[PROF_HASH_SIZE];
+    // Shadow call stack, stack[0] is the root.
+    prof_frame_t stack[PROF_MAX_DEPTH];
+    int32_t depth;
+    // Symbols sorted by address.
+    prof_sym_t *syms;
+    int32_t sym_count;
+} prof_t;
+
+
+prof_t *prof_create(void);
+void prof_destroy(prof_t *prof);
+int32_t prof_loadSymbols(prof_t *prof, const char *path);
+void prof_record(prof_t *prof, cpu_t *cpu, uint16_t pc, uint16_t sp,
+    uint32_t cycles);
+void prof_skipHalt(prof_t *prof, cpu_t *cpu, uint32_t count);
+void prof_interrupt(prof_t *prof, cpu_t *cpu, uint32_t cycles);
+void prof_writeReport(prof_t *prof, FILE *stream);
+void prof_writeFolded(prof_t *prof, FILE *stream);
+
+#endif // _PROFILER_H_
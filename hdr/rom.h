@@ -0,0 +1,47 @@
+#ifndef _ROM_H_
+#define _ROM_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+  Shared ROM images.
+
+  A ROM image is a hex file parsed once into its own page aligned memory,
+  made read-only with mprotect(). Any number of boards can map it as their
+  CHUNK_READONLY chunk (see mem_chunk_t.image). Images are reference
+  counted: each board holds a reference and the last rom_release() frees
+  the memory.
+
+  A registry finds images by file path, so every file is parsed only once.
+  It holds its own reference to each image until rom_destroyRegistry(), and
+  its functions can be called from several threads.
+
+  rom_create() makes the same kind of image from memory. board_fork() uses
+  it to freeze the memory of a board before sharing it with its copies.
+*/
+
+typedef struct rom_t {
+    char *path;         // NULL if not loaded from a file.
+    uint8_t *data;      // Page aligned, read-only.
+    uint32_t size;      // Bytes of ROM, the mapping is rounded up to pages.
+    uint32_t refs;
+    struct rom_t *next; // Next image in the registry.
+} rom_t;
+
+typedef struct rom_registry_t {
+    pthread_mutex_t lock;
+    rom_t *images;
+} rom_registry_t;
+
+
+rom_t *rom_load(const char *path, uint32_t size);
+rom_t *rom_create(const uint8_t *data, uint32_t size);
+rom_t *rom_acquire(rom_t *rom);
+void rom_release(rom_t *rom);
+
+rom_registry_t *rom_createRegistry(void);
+void rom_destroyRegistry(rom_registry_t *registry);
+rom_t *rom_open(rom_registry_t *registry, const char *path, uint32_t size);
+
+#endif // _ROM_H_
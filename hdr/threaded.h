@@ -0,0 +1,11 @@
+#ifndef _THREADED_H_
+#define _THREADED_H_
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+
+uint32_t thr_emulate(cpu_t *cpu, uint32_t instr_limit);
+
+#endif // _THREADED_H_
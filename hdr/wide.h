@@ -0,0 +1,68 @@
+#ifndef _WIDE_H_
+#define _WIDE_H_
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+/*
+  Lockstep engine.
+
+  Runs up to WIDE_MAX_LANES cpus together, one per lane, with their main
+  registers held in structure-of-arrays form. At every step, the lanes at
+  the PC of the lane furthest behind run its instruction at once: kernels
+  loop over all the lanes under a mask, without branches, so that the
+  compiler turns them into SSE2 code, or AVX2 with make AVX2=1. Flags
+  still come from the opcodes.c lookup tables, one lane at a time.
+
+  Kernels cover the frequent unprefixed instructions: loads, 8-bit
+  arithmetic and rotations of A, 16-bit additions, jumps, calls and stack
+  operations. Their memory reads and writes still go through each cpu,
+  straight to the page when it is plain RAM. Anything else, IO and
+  interrupts included, runs lane by lane through cpu_emulate(). When
+  lanes have been split up for WIDE_DIVERGE_STEPS steps in a row, the
+  rest of the run is scalar: each cpu goes through cpu_run() on its own.
+
+  Built with WIDE_SELFCHECK (make WIDECHECK=1), every lane of every kernel
+  is checked against cpu_emulate() on a copy of its cpu.
+*/
+
+#define WIDE_MAX_LANES     32
+#define WIDE_DIVERGE_STEPS 64 // Steps run by less than half of the lanes.
+
+// Index of F in the register arrays. It takes the place of (HL), which
+// kernels never work on.
+#define WIDE_F 6
+
+typedef struct wide_t {
+    uint32_t count;
+    cpu_t *cpus[WIDE_MAX_LANES];
+    // Main registers, indexed as in opcodes: B, C, D, E, H, L, F, A.
+    uint8_t reg[8][WIDE_MAX_LANES];
+    uint16_t PC[WIDE_MAX_LANES];
+    uint16_t SP[WIDE_MAX_LANES];
+    uint32_t cycles[WIDE_MAX_LANES];
+    uint32_t instr[WIDE_MAX_LANES];
+    // Copies of cpu->halt and cpu_hasInterrupt(), which only change when
+    // a lane runs through cpu_emulate().
+    uint8_t halt[WIDE_MAX_LANES];
+    uint8_t is_interrupted[WIDE_MAX_LANES];
+    // Operand bytes of the current instruction, read by each lane.
+    uint8_t data[2][WIDE_MAX_LANES];
+    // Memory operand of the current instruction: the byte at (HL), (BC),
+    // (DE) or (nn), or the two bytes at (SP). Reads have no side effects,
+    // so they are done before the kernel runs.
+    uint8_t mem[2][WIDE_MAX_LANES];
+    // Lanes whose page maps the same read-only memory as in lane 0, one
+    // bit per lane. Their code there is the same for the whole run.
+    uint32_t rom_lanes[MEM_PAGE_COUNT];
+    // Consecutive steps run by less than half of the running lanes.
+    uint32_t diverged;
+} wide_t;
+
+
+wide_t *wide_create(cpu_t **cpus, uint32_t count);
+void wide_destroy(wide_t *wide);
+void wide_run(wide_t *wide, const uint32_t *budget, cpu_run_t *status);
+
+#endif // _WIDE_H_
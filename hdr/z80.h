@@ -0,0 +1,65 @@
+#ifndef _Z80_H_
+#define _Z80_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+  Emulator library (make lib builds libz80.a and libz80.so).
+
+  Each z80_t handle owns a whole board: cpu, memory, ACIA and the host
+  side input and output buffers. The library keeps no global state, so
+  any number of instances can live in one process and run on different
+  threads, as long as each handle is used by one thread at a time.
+
+  Logging is compiled out of the library. Errors are reported by return
+  values, and a fatal guest error only stops its own instance.
+
+  Boards made with z80_createShared() map a ROM image shared through a
+  z80_roms_t registry: each hex file is parsed once, into read-only
+  memory, whatever the number of boards running it.
+
+  z80_fork() copies an instance in its current state, for instance a
+  booted interpreter, at the cost of the RAM pages each copy writes later.
+
+  z80_runLockstep() runs many instances at once. While their guests run
+  the same code, as boards forked from one another do, they go through
+  the lockstep engine (see wide.h), which decodes each instruction once
+  for all of them.
+
+  Bytes are exchanged with the ACIA as they are: lines typed to BASIC end
+  with '\r' and its output lines end with "\r\n". They take the time set by
+  the guest in the ACIA control register to go through the serial lines,
+  115200 baud on the stock ROM, unless z80_setTurbo() is on.
+*/
+
+#define Z80_BUFFER_SIZE 4096 // Input and output bytes kept per instance.
+
+// Reasons for z80_run() to return.
+typedef enum {
+    Z80_RUN_BUDGET, // The cycle budget has been used.
+    Z80_RUN_IDLE,   // The guest waits for input and none is queued.
+    Z80_RUN_OUTPUT, // The output buffer is full, z80_read() has to drain it.
+    Z80_RUN_FAULT   // A fatal error stopped the guest for good.
+} z80_run_t;
+
+typedef struct z80_t z80_t;
+typedef struct rom_registry_t z80_roms_t;
+
+
+z80_roms_t *z80_createRoms(void);
+void z80_destroyRoms(z80_roms_t *roms);
+z80_t *z80_create(void);
+z80_t *z80_createShared(z80_roms_t *roms, const char *rom_file);
+z80_t *z80_fork(z80_t *z80);
+int32_t z80_loadRom(z80_t *z80, const char *rom_file);
+z80_run_t z80_run(z80_t *z80, uint32_t cycles);
+int32_t z80_runLockstep(z80_t **z80, uint32_t count, uint32_t cycles,
+    z80_run_t *status);
+void z80_setTurbo(z80_t *z80, bool is_turbo);
+uint32_t z80_write(z80_t *z80, const uint8_t *data, uint32_t size);
+uint32_t z80_read(z80_t *z80, uint8_t *data, uint32_t size);
+uint64_t z80_cycles(const z80_t *z80);
+void z80_destroy(z80_t *z80);
+
+#endif // _Z80_H_
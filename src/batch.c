@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "z80.h"
+
+/*
+  Batch runner.
+
+  Runs the jobs listed in a manifest on a pool of worker threads, each job
+  on its own board. Every worker owns a queue of jobs: it runs the job at
+  the front for one quantum of T-states and, if it is not done, puts it
+  back at the end. A worker with an empty queue steals from the end of the
+  others, so long jobs are spread out while short ones still get their
+  turn.
+
+  The input script is typed one line at a time, whenever the guest waits
+  for input. A job is done once the script is over and the guest is idle.
+*/
+
+// T-states a job runs before going back to its queue.
+#define BATCH_QUANTUM 20000000
+
+typedef enum {
+    JOB_QUEUED,
+    JOB_DONE,    // Script over, guest idle.
+    JOB_TIMEOUT, // The cycle limit has been reached.
+    JOB_FAULT,   // The guest stopped on a fatal error.
+    JOB_ERROR    // A file could not be opened.
+} job_status_t;
+
+typedef struct job_t {
+    char *rom;
+    char *input;
+    char *output;
+    uint64_t max_cycles; // 0 for no limit.
+    z80_t *z80;          // NULL until the job first runs.
+    FILE *in;
+    FILE *out;
+    job_status_t status;
+    uint64_t cycles;
+} job_t;
+
+// Job indexes in a circular buffer, owned by one worker.
+typedef struct queue_t {
+    pthread_mutex_t lock;
+    int32_t *jobs;
+    int32_t head;
+    int32_t count;
+} queue_t;
+
+typedef struct pool_t {
+    job_t *jobs;
+    int32_t job_count;
+    queue_t *queues;
+    int32_t worker_count;
+    uint32_t quantum;
+    bool is_turbo;       // Characters take no time on the serial lines.
+    // Every ROM file is loaded once and shared by its jobs.
+    z80_roms_t *roms;
+    // Workers with nothing to run or steal sleep on wakeup.
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    int32_t queued;
+    int32_t left;
+} pool_t;
+
+typedef struct worker_t {
+    pool_t *pool;
+    int32_t id;
+} worker_t;
+
+
+// Adds a job at the end of queue.
+static void pushJob(queue_t *queue, int32_t job_count, int32_t job) {
+    pthread_mutex_lock(&queue->lock);
+    queue->jobs[(queue->head + queue->count++) % job_count] = job;
+    pthread_mutex_unlock(&queue->lock);
+    return;
+}
+
+
+// Removes a job from the front of queue, or from its end if is_steal is
+// set. Returns -1 if the queue is empty.
+static int32_t popJob(queue_t *queue, int32_t job_count, bool is_steal) {
+    int32_t job = -1;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count > 0) {
+        queue->count--;
+        if (is_steal)
+            job = queue->jobs[(queue->head + queue->count) % job_count];
+        else {
+            job = queue->jobs[queue->head];
+            queue->head = (queue->head + 1) % job_count;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return job;
+}
+
+
+// Returns the next job for worker id, from its own queue first and then
+// from the others. Waits while jobs are running elsewhere and may come
+// back. Returns -1 once every job is over.
+static int32_t nextJob(pool_t *pool, int32_t id) {
+    for (;;) {
+        int32_t job = popJob(&pool->queues[id], pool->job_count, false);
+        for (int32_t i = 1; job == -1 && i < pool->worker_count; i++) {
+            job = popJob(&pool->queues[(id + i) % pool->worker_count],
+                pool->job_count, true);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (job != -1) {
+            pool->queued--;
+            pthread_mutex_unlock(&pool->lock);
+            return job;
+        }
+        // The queues were found empty, but a job may have been put back
+        // since then.
+        while (pool->queued <= 0 && pool->left > 0)
+            pthread_cond_wait(&pool->wakeup, &pool->lock);
+        bool is_over = (pool->left == 0);
+        pthread_mutex_unlock(&pool->lock);
+
+        if (is_over)
+            return -1;
+    }
+}
+
+
+// Writes the guest output to the job output file. Line ends are handled
+// as on the terminal.
+static void drainOutput(job_t *job) {
+    uint8_t buff[Z80_BUFFER_SIZE];
+    uint32_t n;
+
+    while ((n = z80_read(job->z80, buff, sizeof(buff))) > 0) {
+        for (uint32_t i = 0; i < n; i++) {
+            if (buff[i] == 0x0D)      // Carriage return.
+                fputc('\n', job->out);
+            else if (buff[i] != 0x0A && buff[i] != 0x0C)
+                fputc(buff[i], job->out);
+        }
+    }
+    return;
+}
+
+
+// Creates the board of a job and opens its files.
+// Returns 0 if no errors occur.
+static int32_t startJob(job_t *job, const pool_t *pool) {
+    job->in = fopen(job->input, "r");
+    if (job->in == NULL) {
+        fprintf(stderr, "Cannot open the input script %s.\n", job->input);
+        return 1;
+    }
+
+    job->out = fopen(job->output, "w");
+    if (job->out == NULL) {
+        fprintf(stderr, "Cannot open the output file %s.\n", job->output);
+        return 1;
+    }
+
+    job->z80 = z80_createShared(pool->roms, job->rom);
+    if (job->z80 == NULL) {
+        fprintf(stderr, "Cannot load the ROM %s.\n", job->rom);
+        return 1;
+    }
+    z80_setTurbo(job->z80, pool->is_turbo);
+    return 0;
+}
+
+
+// Releases the board and the files of a job.
+static void stopJob(job_t *job) {
+    if (job->z80 != NULL)
+        z80_destroy(job->z80);
+    if (job->in != NULL)
+        fclose(job->in);
+    if (job->out != NULL)
+        fclose(job->out);
+    job->z80 = NULL;
+    job->in = NULL;
+    job->out = NULL;
+    return;
+}
+
+
+// Runs a job for up to quantum T-states.
+// Returns true if the job is over.
+static bool runJob(job_t *job, const pool_t *pool) {
+    uint32_t quantum = pool->quantum;
+
+    if (job->z80 == NULL && startJob(job, pool)) {
+        job->status = JOB_ERROR;
+        return true;
+    }
+
+    uint64_t start = z80_cycles(job->z80);
+    while (z80_cycles(job->z80) - start < quantum) {
+        uint32_t budget = quantum - (z80_cycles(job->z80) - start);
+        if (job->max_cycles != 0 &&
+            job->max_cycles - job->cycles < budget)
+            budget = job->max_cycles - job->cycles;
+
+        z80_run_t status = z80_run(job->z80, budget);
+        job->cycles = z80_cycles(job->z80);
+        drainOutput(job);
+
+        if (status == Z80_RUN_FAULT) {
+            job->status = JOB_FAULT;
+            return true;
+        }
+
+        if (status == Z80_RUN_IDLE) {
+            // Types the next line of the script, with the ENTER key.
+            char line[256];
+            if (fgets(line, sizeof(line), job->in) == NULL) {
+                job->status = JOB_DONE;
+                return true;
+            }
+            for (char *c = line; *c != '\0'; c++)
+                if (*c == '\n')
+                    *c = 0x0D;
+            z80_write(job->z80, (uint8_t *)line, strlen(line));
+        }
+
+        if (job->max_cycles != 0 && job->cycles >= job->max_cycles) {
+            job->status = JOB_TIMEOUT;
+            return true;
+        }
+    }
+    fflush(job->out);
+    return false;
+}
+
+
+// Worker thread body.
+static void *workerMain(void *arg) {
+    worker_t *worker = (worker_t *)arg;
+    pool_t *pool = worker->pool;
+    int32_t id;
+
+    while ((id = nextJob(pool, worker->id)) != -1) {
+        job_t *job = &pool->jobs[id];
+        bool is_over = runJob(job, pool);
+
+        if (is_over)
+            stopJob(job);
+        else
+            pushJob(&pool->queues[worker->id], pool->job_count, id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (is_over)
+            pool->left--;
+        else
+            pool->queued++;
+        pthread_cond_broadcast(&pool->wakeup);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+
+// Reads the manifest at path. Each line holds a job: ROM hex file, input
+// script, output file and an optional limit of T-states. Empty lines and
+// lines starting with '#' are skipped.
+// Returns the number of jobs, -1 in case of errors.
+static int32_t readManifest(const char *path, job_t **jobs) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open the manifest %s.\n", path);
+        return -1;
+    }
+
+    int32_t count = 0;
+    int32_t size = 0;
+    char line[3 * 1024];
+    int32_t line_num = 0;
+    *jobs = NULL;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line_num++;
+
+        char rom[1024], input[1024], output[1024];
+        unsigned long long max_cycles = 0;
+        char *str = line + strspn(line, " \t");
+        if (*str == '#' || *str == '\n' || *str == '\0')
+            continue;
+
+        int32_t fields = sscanf(str, "%1023s %1023s %1023s %llu", rom, input,
+            output, &max_cycles);
+        if (fields < 3) {
+            fprintf(stderr, "Invalid job at %s:%d.\n", path, line_num);
+            fclose(fp);
+            return -1;
+        }
+
+        if (count == size) {
+            size = size ? 2 * size : 64;
+            job_t *tmp = (job_t *)realloc(*jobs, size * sizeof(job_t));
+            if (tmp == NULL) {
+                fprintf(stderr, "Cannot allocate the jobs.\n");
+                fclose(fp);
+                return -1;
+            }
+            *jobs = tmp;
+        }
+        (*jobs)[count++] = (job_t){strdup(rom), strdup(input), strdup(output),
+            max_cycles, NULL, NULL, NULL, JOB_QUEUED, 0};
+    }
+    fclose(fp);
+    return count;
+}
+
+
+// Prints usage information for this program and exits.
+static void print_usage(FILE *stream, const char *this_program, int32_t exit_code) {
+    fprintf(stream, "Usage: %s [OPTIONS...] MANIFEST\n", this_program);
+    fprintf(stream, " -h --help        Display this help information.\n"
+                    " -j --jobs        Number of worker threads.\n"
+                    " -q --quantum     T-states a job runs before yielding.\n"
+                    " -u --turbo       Serial characters take no time.\n");
+    exit(exit_code);
+}
+
+
+///////////////////////////////////////////////////////////
+// MAIN
+///////////////////////////////////////////////////////////
+int main(int argc, char **argv) {
+    // Parses command line options.
+    const char *this_program = argv[0];
+    int32_t next_option;
+    const char * const short_options = "hj:q:u";
+    const struct option long_options[] = {
+        {"help",       0, NULL, 'h'},
+        {"jobs",       1, NULL, 'j'},
+        {"quantum",    1, NULL, 'q'},
+        {"turbo",      0, NULL, 'u'},
+        { NULL,        0, NULL,  0 }
+    };
+
+    // Default values for the program options.
+    int32_t worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t quantum = BATCH_QUANTUM;
+    bool is_turbo = false;
+
+    do {
+        next_option = getopt_long(argc, argv, short_options, long_options, NULL);
+        switch (next_option) {
+            case 'h': // Help.
+                print_usage(stdout, this_program, 0);
+
+            case 'j': // Worker threads.
+                worker_count = atoi(optarg);
+                break;
+
+            case 'q': // Scheduling quantum.
+                quantum = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'u': // Turbo serial lines.
+                is_turbo = true;
+                break;
+
+            case '?': // Invalid option.
+                print_usage(stderr, this_program, 1);
+
+            case -1:  // Done with options.
+                break;
+
+            default:  // Something unexpected.
+                exit(1);
+        }
+    } while(next_option != -1);
+
+    if (optind != argc - 1 || worker_count < 1 || quantum == 0)
+        print_usage(stderr, this_program, 1);
+
+    pool_t pool = {0};
+    pool.job_count = readManifest(argv[optind], &pool.jobs);
+    if (pool.job_count <= 0)
+        return pool.job_count == 0 ? 0 : 1;
+    if (worker_count > pool.job_count)
+        worker_count = pool.job_count;
+
+    // Jobs are dealt to the workers in turn.
+    pool.worker_count = worker_count;
+    pool.quantum = quantum;
+    pool.is_turbo = is_turbo;
+    pool.queued = pool.job_count;
+    pool.left = pool.job_count;
+    pool.roms = z80_createRoms();
+    pool.queues = (queue_t *)calloc(worker_count, sizeof(queue_t));
+    worker_t *workers = (worker_t *)calloc(worker_count, sizeof(worker_t));
+    pthread_t *threads = (pthread_t *)calloc(worker_count, sizeof(pthread_t));
+    if (pool.roms == NULL || pool.queues == NULL || workers == NULL ||
+        threads == NULL) {
+        fprintf(stderr, "Cannot allocate the workers.\n");
+        return 1;
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.wakeup, NULL);
+    for (int32_t w = 0; w < worker_count; w++) {
+        pthread_mutex_init(&pool.queues[w].lock, NULL);
+        pool.queues[w].jobs = (int32_t *)malloc(pool.job_count * sizeof(int32_t));
+        if (pool.queues[w].jobs == NULL) {
+            fprintf(stderr, "Cannot allocate the job queues.\n");
+            return 1;
+        }
+    }
+    for (int32_t j = 0; j < pool.job_count; j++)
+        pushJob(&pool.queues[j % worker_count], pool.job_count, j);
+
+    for (int32_t w = 0; w < worker_count; w++) {
+        workers[w] = (worker_t){&pool, w};
+        if (pthread_create(&threads[w], NULL, workerMain, &workers[w])) {
+            fprintf(stderr, "Cannot start the worker threads.\n");
+            return 1;
+        }
+    }
+    for (int32_t w = 0; w < worker_count; w++)
+        pthread_join(threads[w], NULL);
+
+    // Summary, one line per job.
+    static const char * const status_str[] = {
+        "QUEUED", "DONE", "TIMEOUT", "FAULT", "ERROR"};
+    int32_t failed = 0;
+
+    for (int32_t j = 0; j < pool.job_count; j++) {
+        job_t *job = &pool.jobs[j];
+        printf("%-8s %14llu  %s\n", status_str[job->status],
+            (unsigned long long)job->cycles, job->output);
+        if (job->status != JOB_DONE)
+            failed++;
+        free(job->rom);
+        free(job->input);
+        free(job->output);
+    }
+
+    for (int32_t w = 0; w < worker_count; w++)
+        free(pool.queues[w].jobs);
+    free(pool.queues);
+    free(pool.jobs);
+    z80_destroyRoms(pool.roms);
+    free(workers);
+    free(threads);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,359 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "blkcache.h"
+#include "opcodes.h"
+#include "logger.h"
+
+
+// Returns the length in bytes of the instruction starting with code.
+static uint8_t blk_length(const uint8_t *code) {
+    uint8_t op = code[0];
+
+    switch (op) {
+        case 0xCB:
+            return 2;
+
+        case 0xED:
+            // LD (nn),dd and LD dd,(nn).
+            return ((code[1] & 0xC7) == 0x43) ? 4 : 2;
+
+        case 0xDD:
+        case 0xFD:
+            switch (code[1]) {
+                case 0x21: case 0x22: case 0x2A: case 0x36: case 0xCB:
+                    return 4;
+                case 0x34: case 0x35:
+                    return 3;
+                default:
+                    // Instructions with an (IX+d) or (IY+d) operand.
+                    if ((code[1] & 0xC7) == 0x46 || (code[1] & 0xF8) == 0x70 ||
+                        (code[1] & 0xC7) == 0x86)
+                        return 3;
+                    return 2;
+            }
+
+        default:
+            if ((op & 0xCF) == 0x01 || (op & 0xE7) == 0x22 ||
+                (op & 0xC7) == 0xC2 || (op & 0xC7) == 0xC4 ||
+                op == 0xC3 || op == 0xCD)
+                return 3;
+            if ((op & 0xC7) == 0x06 || (op & 0xC7) == 0xC6 ||
+                (op & 0xE7) == 0x20 || op == 0x10 || op == 0x18 ||
+                op == 0xD3 || op == 0xDB)
+                return 2;
+            return 1;
+    }
+}
+
+
+// Tests if the instruction starting with code may change the PC other
+// than by moving to the next instruction. Such instructions end a block.
+static bool blk_isBranch(const uint8_t *code) {
+    uint8_t op = code[0];
+
+    switch (op) {
+        case 0xED:
+            // RETN, RETI and the repeating block instructions.
+            return (code[1] & 0xC7) == 0x45 || (code[1] & 0xF4) == 0xB0;
+
+        case 0xDD:
+        case 0xFD:
+            return code[1] == 0xE9;
+
+        default:
+            return op == 0x10 || op == 0x18 || (op & 0xE7) == 0x20 ||
+                op == 0x76 || op == 0xC3 || op == 0xC9 || op == 0xCD ||
+                op == 0xE9 || (op & 0xC7) == 0xC0 || (op & 0xC7) == 0xC2 ||
+                (op & 0xC7) == 0xC4 || (op & 0xC7) == 0xC7;
+    }
+}
+
+
+// Runs a 0xDD prefixed instruction through its handler in opc_tblXY.
+static void blk_runIX(cpu_t *cpu, const blk_instr_t *instr) {
+    instr->handler.xy(cpu, &cpu->IX, instr->opcode);
+    return;
+}
+
+
+// Runs a 0xFD prefixed instruction through its handler in opc_tblXY.
+static void blk_runIY(cpu_t *cpu, const blk_instr_t *instr) {
+    instr->handler.xy(cpu, &cpu->IY, instr->opcode);
+    return;
+}
+
+
+// Runs a 0xDD 0xCB instruction on (IX+d), d being its decoded operand.
+static void blk_runIXCB(cpu_t *cpu, const blk_instr_t *instr) {
+    instr->handler.xycb(cpu, cpu->IX + (int8_t)instr->operand, instr->opcode);
+    return;
+}
+
+
+// Runs a 0xFD 0xCB instruction on (IY+d), d being its decoded operand.
+static void blk_runIYCB(cpu_t *cpu, const blk_instr_t *instr) {
+    instr->handler.xycb(cpu, cpu->IY + (int8_t)instr->operand, instr->opcode);
+    return;
+}
+
+
+// Sets the handler of the instruction starting with code, taken from the
+// table of its prefix, and decodes its operands when it has a handler in
+// opc_decodedTbl or opc_decodedTblXY. instr->len must be set.
+static void blk_resolve(blk_instr_t *instr, const uint8_t *code) {
+    uint8_t op = code[0];
+    const opc_t *tbl;
+
+    instr->prefix = 0;
+    instr->opcode = op;
+    instr->operand = 0;
+    instr->fetched = 1;
+
+    switch (op) {
+        case 0xCB:
+        case 0xED:
+            tbl = (op == 0xCB) ? opc_tblCB : opc_tblED;
+            instr->prefix = op;
+            instr->opcode = code[1];
+            instr->fetched = 2;
+            instr->execute = NULL;
+            instr->handler.op = tbl[code[1]].execute;
+            instr->TStates = tbl[code[1]].TStates;
+            return;
+
+        case 0xDD:
+        case 0xFD:
+            instr->prefix = op;
+            if (code[1] == 0xCB) {
+                // The displacement comes before the opcode.
+                instr->opcode = code[3];
+                instr->operand = code[2];
+                instr->fetched = 4;
+                instr->execute = (op == 0xDD) ? blk_runIXCB : blk_runIYCB;
+                instr->handler.xycb = opc_tblXYCB[code[3]].execute;
+                instr->TStates = opc_tblXYCB[code[3]].TStates;
+                return;
+            }
+
+            instr->opcode = code[1];
+            instr->TStates = opc_tblXY[code[1]].TStates;
+            if (opc_decodedTblXY[code[1]] != NULL) {
+                instr->execute = opc_decodedTblXY[code[1]];
+                instr->fetched = instr->len;
+                for (uint8_t k = 2; k < instr->len; k++)
+                    instr->operand |= code[k] << ((k - 2) * 8);
+                return;
+            }
+            instr->fetched = 2;
+            instr->execute = (op == 0xDD) ? blk_runIX : blk_runIY;
+            instr->handler.xy = opc_tblXY[code[1]].execute;
+            return;
+
+        default:
+            instr->TStates = opc_tbl[op].TStates;
+            if (opc_decodedTbl[op] != NULL) {
+                instr->execute = opc_decodedTbl[op];
+                instr->fetched = instr->len;
+                for (uint8_t k = 1; k < instr->len; k++)
+                    instr->operand |= code[k] << ((k - 1) * 8);
+                return;
+            }
+            instr->execute = NULL;
+            instr->handler.op = opc_tbl[op].execute;
+            return;
+    }
+}
+
+
+// Decodes the block starting at pc into blk and tags its page.
+// Returns 0 if at least one instruction could be decoded.
+int32_t blk_decode(cpu_t *cpu, blk_t *blk, uint16_t pc) {
+    mem_page_t *pg = &cpu->pages[pc >> MEM_PAGE_SHIFT];
+
+    // Only directly mapped memory is decoded.
+    if (pg->flags & (PAGE_UNUSED | PAGE_MMIO))
+        return 1;
+
+    blk->start = pc;
+    blk->count = 0;
+    blk->gen = pg->gen;
+
+    while (blk->count < BLK_MAX_INSTR) {
+        uint16_t offset = pc & MEM_PAGE_MASK;
+
+        // The whole instruction must lie in the page.
+        if (offset > MEM_PAGE_SIZE - BLK_MAX_LEN)
+            break;
+
+        const uint8_t *code = pg->host + offset;
+        blk_instr_t *instr = &blk->instr[blk->count++];
+
+        instr->len = blk_length(code);
+        blk_resolve(instr, code);
+        pc += instr->len;
+
+        if (blk_isBranch(code))
+            break;
+    }
+
+    if (blk->count == 0)
+        return 1;
+
+    pg->flags |= PAGE_CODE;
+    return 0;
+}
+
+
+#ifdef CPU_FUSION
+// Returns the index of the fused group starting with instruction i of blk,
+// at address pc, or -1 if none matches. A group with a breakpoint past its
+// first instruction does not match.
+static int32_t blk_matchFusion(cpu_t *cpu, const blk_t *blk, uint8_t i,
+    uint16_t pc) {
+
+    for (int32_t f = 0; f < OPC_FUSION_COUNT; f++) {
+        const opc_fusion_t *fusion = &opc_fusionTbl[f];
+        if (i + fusion->count > blk->count)
+            continue;
+
+        bool is_match = true;
+        uint16_t addr = pc;
+        for (uint8_t k = 0; k < fusion->count && is_match; k++) {
+            const blk_instr_t *instr = &blk->instr[i + k];
+            is_match = instr->prefix == 0 &&
+                instr->opcode == fusion->opcode[k] &&
+                (k == 0 || cpu->breakpoints == NULL ||
+                !(cpu->breakpoints[addr >> 3] & (1 << (addr & 7))));
+            addr += instr->len;
+        }
+
+        if (is_match)
+            return f;
+    }
+    return -1;
+}
+
+
+// Replaces the fused groups found in a block decoded from ROM by single
+// entries. A fused entry spans the whole group, gets the group index as its
+// opcode and adds its own T-states.
+static void blk_fuse(cpu_t *cpu, blk_t *blk) {
+#if defined(CPU_TRACE) || defined(CPU_PROFILE)
+    // Every instruction needs its own trace record and profile counters.
+    return;
+#endif
+    if (!(cpu->pages[blk->start >> MEM_PAGE_SHIFT].flags & PAGE_READONLY))
+        return;
+
+    uint8_t count = 0;
+    uint16_t pc = blk->start;
+    for (uint8_t i = 0; i < blk->count; count++) {
+        blk_instr_t instr = blk->instr[i];
+        int32_t f = blk_matchFusion(cpu, blk, i, pc);
+
+        if (f >= 0) {
+            // The group handlers fetch their own operands.
+            instr.execute = NULL;
+            instr.handler.op = opc_fusionTbl[f].execute;
+            instr.opcode = f;
+            instr.fetched = 1;
+            instr.TStates = 0;
+            for (uint8_t k = 1; k < opc_fusionTbl[f].count; k++)
+                instr.len += blk->instr[i + k].len;
+            i += opc_fusionTbl[f].count;
+        }
+        else
+            i++;
+
+        pc += instr.len;
+        blk->instr[count] = instr;
+    }
+
+    blk->count = count;
+    return;
+}
+
+
+// Writes how many times each fused group has been run and how many
+// instructions it covered. A group cut short by an interrupt only counts
+// the instructions it ran.
+void blk_fusionReport(cpu_t *cpu, FILE *stream) {
+    const blk_cache_t *cache = cpu->blocks;
+    uint64_t covered = 0;
+
+    fprintf(stream, "%14s %14s  %s\n", "Runs", "Instructions", "Fused group");
+    for (int32_t f = 0; f < OPC_FUSION_COUNT; f++) {
+        uint64_t runs = cache->fusion_hits[f];
+        uint64_t instr = cache->fusion_instr[f];
+        covered += instr;
+        fprintf(stream, "%14llu %14llu  %s\n", (unsigned long long)runs,
+            (unsigned long long)instr, opc_fusionTbl[f].name);
+    }
+    fprintf(stream, "%14s %14llu  Total\n", "", (unsigned long long)covered);
+    return;
+}
+#endif
+
+
+// Allocates an empty block cache.
+// Returns NULL in case of errors.
+blk_cache_t *blk_create(void) {
+    blk_cache_t *cache = (blk_cache_t *)malloc(sizeof(blk_cache_t));
+
+    if (cache == NULL) {
+        LOG_ERROR("Cannot allocate the block cache.\n");
+        return NULL;
+    }
+
+    blk_flush(cache);
+#ifdef CPU_FUSION
+    memset(cache->fusion_hits, 0, sizeof(cache->fusion_hits));
+    memset(cache->fusion_instr, 0, sizeof(cache->fusion_instr));
+#endif
+    return cache;
+}
+
+
+// Releases the block cache.
+void blk_destroy(blk_cache_t *cache) {
+    free(cache);
+    return;
+}
+
+
+// Drops all the cached blocks. Needed when the memory map changes.
+void blk_flush(blk_cache_t *cache) {
+    cache->cur = NULL;
+    for (int32_t i = 0; i < BLK_COUNT; i++)
+        cache->blocks[i].count = 0;
+    return;
+}
+
+
+// Looks up the block starting at the current PC, decoding it if needed,
+// and makes it the current block. Returns its first instruction, or NULL
+// if the PC cannot be decoded.
+const blk_instr_t *blk_lookup(cpu_t *cpu) {
+    blk_cache_t *cache = cpu->blocks;
+    uint16_t pc = cpu->PC;
+    blk_t *blk = &cache->blocks[pc & (BLK_COUNT - 1)];
+
+    if (blk->count == 0 || blk->start != pc ||
+        blk->gen != cpu->pages[pc >> MEM_PAGE_SHIFT].gen) {
+
+        if (blk_decode(cpu, blk, pc)) {
+            blk->count = 0;
+            cache->cur = NULL;
+            return NULL;
+        }
+#ifdef CPU_FUSION
+        blk_fuse(cpu, blk);
+#endif
+    }
+
+    cache->cur = blk;
+    cache->pos = 1;
+    cache->next_pc = pc + blk->instr[0].len;
+    return &blk->instr[0];
+}
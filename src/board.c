@@ -1,25 +1,48 @@
-#include <ncurses.h>
 #include <stdlib.h>
 
 #include "board.h"
+#include "blkcache.h"
 #include "logger.h"
 #include "hex2array.h"
+#if defined(CPU_JIT)
+#include "jit.h"
+#elif defined(CPU_THREADED)
+#include "threaded.h"
+#endif
 
 #define ROM_START 0x0
 #define RAM_START 0x8000
 
-#define ROM_SIZE 0x8000 // 32KB.
+#define ROM_SIZE BOARD_ROM_SIZE
 #define RAM_SIZE 0x8000 // 32KB.
 
+// Maximum number of instructions run by the threaded engine or the JIT
+// between two peripheral checks.
+#define BOARD_SLICE 10000
+// T-states of the longest instruction.
+#define BOARD_MAX_TSTATES 23
+// T-states run by cpu_run() between two peripheral checks.
+#define BOARD_SLICE_CYCLES 40000
+// Slices the cpu must end idle, with no ACIA activity, before the host
+// waits for input. Engines return after each IO access, so polling loops on
+// a port need more than one slice to act on the latest value.
+#define BOARD_IDLE_SLICES 3
+// Milliseconds between two checks for a trace request while the host
+// waits for input.
+#define BOARD_WAIT_STEP 100
+
 
 // Sends data from peripherals to the cpu.
 static uint8_t board_cpuIOin(board_t *board, uint8_t port) {
+    uint8_t data;
+
     switch(port) {
         case 0x80: // CPU wants to read the acia status register.
-            return board->acia->status;
+            return mc6850_readStatus(board->acia);
         case 0x81: // CPU wants to read received data by the acia.
-            board->acia->status &= ~(RX_FULL);
-            return board->acia->RDR;
+            data = mc6850_readData(board->acia);
+            board_updateIrq(board);
+            return data;
         default:
             LOG_WARNING("CPU IO IN: invalid port (%d).\n", port);
     }
@@ -28,149 +51,354 @@ static uint8_t board_cpuIOin(board_t *board, uint8_t port) {
 }
 
 
+// Returns true if the cpu can read port without side effects: reading
+// the acia data register clears RX_FULL and changes the IRQ line.
+static bool board_cpuIOisPure(board_t *board, uint8_t port) {
+    return port == 0x80;
+}
+
+
 // Receives data from the cpu and dispatches it to the proper peripheral.
 static void board_cpuIOout(board_t *board, uint8_t port, uint8_t data) {
     switch(port) {
-        case 0x80: // CPU wants to write the acia status register (not used).
+        case 0x80: // CPU wants to write the acia control register.
+            mc6850_writeControl(board->acia, data);
             break;
         case 0x81: // CPU places in acia TDR data to be transmitted.
-            board->acia->TDR = data;
-            board->acia->status &= ~(TX_EMPTY); // Clears TX empty bit.
+            mc6850_writeData(board->acia, data, board->cpu->cycles);
             break;
         default:
             LOG_WARNING("CPU IO OUT: invalid port.\n");
+            return;
     }
+    board_updateIrq(board);
     return;
 }
 
 
-// Detects if any key is pressed.
-static int32_t kbhit(void) {
-    int32_t ch = getch(); // Read the character.
+// Frees what board_build() allocated before failing, NULL pointers
+// included, and drops its reference to image, if any.
+static void board_unbuild(board_t *board, rom_t *image, uint8_t *rom_buff,
+    uint8_t *ram_buff, mem_chunk_t *rom, mem_chunk_t *ram) {
 
-    // If key is pressed...
-    if (ch != ERR) {
-        ungetch(ch); // Restore the character in the buffer.
-        return 1;
-    } else {
-        return 0;
-    }
+    if (image != NULL)
+        rom_release(image);
+    else
+        free(rom_buff);
+    free(ram_buff);
+    free(rom);
+    free(ram);
+
+    free(board->cpu);
+    free(board->acia);
+    board->cpu = NULL;
+    board->acia = NULL;
+    return;
 }
 
 
-// Initializes the given board. A board is a minimal Z80-based
-// system made of the cpu itself, an uart, 32KB of ROM and 32KB of RAM,
-// respectively mapped at 0x0 and at 0x8000 locations.
-// Returns 0 if initialization is successful.
-int32_t board_init(board_t *board, char *rom_file) {
+// Builds a board whose ROM is either the shared image, if not NULL, or a
+// buffer of its own filled from rom_file. The board takes over the
+// reference to image, released if the build fails.
+// Returns 0 if initialization is successful. Otherwise nothing is left
+// allocated.
+static int32_t board_build(board_t *board, const char *rom_file,
+    rom_t *image) {
 
     board->cpu = (cpu_t *)malloc(sizeof(cpu_t));
     board->acia = (mc6850_t *)malloc(sizeof(mc6850_t));
+#ifndef Z80_LIBRARY
+    board->is_traceRequested = 0;
+#endif
 
     ///////////////////////////////////////////////////////
     // MEMORY CONFIGURATION
-    uint8_t *rom_buff = (uint8_t *)calloc(ROM_SIZE, sizeof(uint8_t));
+    uint8_t *rom_buff = (image != NULL) ? image->data :
+        (uint8_t *)calloc(ROM_SIZE, sizeof(uint8_t));
     uint8_t *ram_buff = (uint8_t *)calloc(RAM_SIZE, sizeof(uint8_t));
+    mem_chunk_t *ram = (mem_chunk_t *)malloc(sizeof(mem_chunk_t));
+    mem_chunk_t *rom = (mem_chunk_t *)malloc(sizeof(mem_chunk_t));
 
-    if (rom_buff != NULL && ram_buff != NULL) {
-        // Loads the hex file into rom memory.
-        if (hex2array(rom_file, rom_buff, ROM_SIZE)) {
-            LOG_FATAL("Unable to load the hex file (%s).\n", rom_file);
-            return 1;
-        }
-    } else {
+    if (board->cpu == NULL || board->acia == NULL || rom_buff == NULL ||
+        ram_buff == NULL || rom == NULL || ram == NULL) {
         LOG_FATAL("Cannot allocate memory.\n");
+        board_unbuild(board, image, rom_buff, ram_buff, rom, ram);
         return 1;
     }
 
-    // Creates ROM and RAM chunks.
-    mem_chunk_t *ram = (mem_chunk_t *)malloc(sizeof(mem_chunk_t));
-    mem_chunk_t *rom = (mem_chunk_t *)malloc(sizeof(mem_chunk_t));
-
-    if (rom == NULL || ram == NULL) {
-        LOG_FATAL("Cannot create memory chunks.\n");
+    // Loads the hex file into rom memory.
+    if (image == NULL && rom_file != NULL &&
+        hex2array(rom_file, rom_buff, ROM_SIZE)) {
+        LOG_FATAL("Unable to load the hex file (%s).\n", rom_file);
+        board_unbuild(board, image, rom_buff, ram_buff, rom, ram);
         return 1;
     }
 
-    *ram = (mem_chunk_t){"RAM", CHUNK_READWRITE, RAM_START, RAM_SIZE, ram_buff, NULL};
-    *rom = (mem_chunk_t){"ROM", CHUNK_READONLY, ROM_START, ROM_SIZE, rom_buff, ram};
+    // Creates ROM and RAM chunks.
+    *ram = (mem_chunk_t){"RAM", CHUNK_READWRITE, RAM_START, RAM_SIZE, ram_buff,
+        NULL, NULL};
+    *rom = (mem_chunk_t){"ROM", CHUNK_READONLY, ROM_START, ROM_SIZE, rom_buff,
+        ram, image};
 
     ///////////////////////////////////////////////////////
     // CPU INITIALIZATION
     if (cpu_init(board->cpu, rom, board)) {
         LOG_FATAL("Cannot initialize the cpu.\n");
+        board_unbuild(board, image, rom_buff, ram_buff, rom, ram);
         return 1;
     }
 
     ///////////////////////////////////////////////////////
     // PERIPHERALS INITIALIZATION
     mc6850_init(board->acia);
-    cpu_setIOcallbacks(board->cpu, board_cpuIOin, board_cpuIOout);
+    cpu_setIOcallbacks(board->cpu, board_cpuIOin, board_cpuIOout,
+        board_cpuIOisPure);
 
     LOG_INFO("Board initialized.\n");
     return 0;
 }
 
 
-// Starts emulation.
-void board_emulate(board_t *board, int32_t instr_limit, bool is_terminal) {
+// Initializes the given board. A board is a minimal Z80-based
+// system made of the cpu itself, an uart, 32KB of ROM and 32KB of RAM,
+// respectively mapped at 0x0 and at 0x8000 locations. The ROM is loaded
+// from rom_file, or left blank for board_loadRom() if it is NULL.
+// Returns 0 if initialization is successful.
+int32_t board_init(board_t *board, const char *rom_file) {
+    return board_build(board, rom_file, NULL);
+}
+
+
+// Initializes the given board like board_init(), with the shared ROM image
+// mapped in place of a ROM of its own. The board takes a reference to it.
+// Returns 0 if initialization is successful.
+int32_t board_initShared(board_t *board, rom_t *rom) {
+    if (rom->size != ROM_SIZE) {
+        LOG_ERROR("The ROM image does not fit the board.\n");
+        board->cpu = NULL;
+        board->acia = NULL;
+        return 1;
+    }
+    return board_build(board, NULL, rom_acquire(rom));
+}
+
+
+// Initializes board as a copy of parent, running from the same state.
+// Memory is shared copy-on-write (see cpu_fork), so a copy only allocates
+// the RAM pages it writes. The ROM of both boards is shared from then on
+// and cannot be reloaded.
+// Returns 0 if initialization is successful.
+int32_t board_fork(board_t *board, board_t *parent) {
+    board->cpu = (cpu_t *)malloc(sizeof(cpu_t));
+    board->acia = (mc6850_t *)malloc(sizeof(mc6850_t));
+
+    if (board->cpu == NULL || board->acia == NULL) {
+        LOG_ERROR("Cannot allocate memory.\n");
+        board_unbuild(board, NULL, NULL, NULL, NULL, NULL);
+        return 1;
+    }
+
+    if (cpu_fork(board->cpu, parent->cpu, board)) {
+        LOG_ERROR("Cannot fork the cpu.\n");
+        board_unbuild(board, NULL, NULL, NULL, NULL, NULL);
+        return 1;
+    }
+
+    *board->acia = *parent->acia;
+    return 0;
+}
+
+
+// Replaces the ROM contents with the hex file at rom_file and resets the
+// cpu. Returns 0 if no errors occur.
+int32_t board_loadRom(board_t *board, const char *rom_file) {
+    mem_chunk_t *rom = board->cpu->memory;
+
+    while (rom != NULL && rom->type != CHUNK_READONLY)
+        rom = rom->next;
+
+    if (rom != NULL && rom->image != NULL) {
+        LOG_ERROR("Cannot overwrite a shared ROM image.\n");
+        return 1;
+    }
+
+    if (rom == NULL || hex2array(rom_file, rom->buff, rom->size)) {
+        LOG_ERROR("Unable to load the hex file (%s).\n", rom_file);
+        return 1;
+    }
+
+    // Blocks decoded from the previous ROM are gone.
+    if (board->cpu->blocks != NULL)
+        blk_flush(board->cpu->blocks);
+    cpu_reset(board->cpu);
+    return 0;
+}
+
+
+// Sets the maskable interrupt line of the cpu to the ACIA IRQ output.
+// Called whenever the ACIA state changes.
+void board_updateIrq(board_t *board) {
+    board->cpu->is_pendingMI = mc6850_hasIrq(board->acia);
+    return;
+}
+
+
+// Returns the T-states the cpu can run, at most max, before the ACIA has
+// a character to move through its lines.
+uint32_t board_sliceCycles(board_t *board, uint32_t max) {
+    uint32_t next = mc6850_nextEvent(board->acia, board->cpu->cycles);
+    return (next < max) ? next : max;
+}
+
+
+#ifndef Z80_LIBRARY
+// Dumps the instruction trace if a signal handler asked for it.
+static void board_serviceTrace(board_t *board) {
+    if (board->is_traceRequested) {
+        board->is_traceRequested = 0;
+        cpu_dumpTrace(board->cpu);
+    }
+    return;
+}
+
+
+// Waits for input as input_wait() does, in steps of BOARD_WAIT_STEP so
+// that a trace asked for meanwhile is dumped in time.
+// Returns false if the time is up.
+static bool board_waitInput(board_t *board, input_t *input,
+    uint32_t timeout) {
+
+    uint32_t waited = 0;
+    while (timeout == 0 || waited < timeout) {
+        uint32_t step = (timeout == 0 || timeout - waited > BOARD_WAIT_STEP) ?
+            BOARD_WAIT_STEP : timeout - waited;
+        if (input_wait(input, step))
+            return true;
+        waited += step;
+        board_serviceTrace(board);
+    }
+    return false;
+}
+
+
+// Starts emulation. The ACIA receives the bytes of input and sends its
+// own to output, or drops them if output is NULL. Emulation ends once the
+// guest waits for input after the end of it, or for more than
+// idle_timeout milliseconds if it is not 0.
+void board_emulate(board_t *board, int32_t instr_limit, input_t *input,
+    output_t *output, uint32_t idle_timeout) {
+
     LOG_INFO("Emulation started.\n");
     bool inf_loop = (instr_limit < 0);
+    uint32_t idle_slices = 0;
+    bool is_held = false; // Paced input, a line has been sent.
 
     while (inf_loop || instr_limit > 0) {
         // CPU MANAGEMENT
-        // Executes one instruction.
-        cpu_emulate(board->cpu);
-        instr_limit--;
+#if defined(CPU_JIT) || defined(CPU_THREADED)
+        // Executes a slice of instructions. The engine returns early after
+        // IO accesses, so peripherals are still serviced in time.
+        uint32_t slice = (inf_loop || instr_limit > BOARD_SLICE) ?
+            BOARD_SLICE : instr_limit;
+        // No instruction takes more than BOARD_MAX_TSTATES: the slice ends
+        // before the next ACIA event.
+        slice = board_sliceCycles(board, slice * BOARD_MAX_TSTATES) /
+            BOARD_MAX_TSTATES;
+        slice = (slice > 0) ? slice : 1;
+#if defined(CPU_JIT)
+        instr_limit -= jit_emulate(board->cpu, slice);
+#else
+        instr_limit -= thr_emulate(board->cpu, slice);
+#endif
+#else
+        // Executes a slice of cycles, up to the next ACIA event. cpu_run()
+        // returns early after IO accesses, so peripherals are still serviced
+        // in time. As every instruction takes at least 4 T-states, a budget
+        // of 4 T-states per remaining instruction never overshoots
+        // instr_limit.
+        uint32_t budget = (inf_loop || instr_limit > BOARD_SLICE_CYCLES / 4) ?
+            BOARD_SLICE_CYCLES : instr_limit * 4;
+        budget = board_sliceCycles(board, budget);
+        uint32_t instr = board->cpu->instr;
+        cpu_run(board->cpu, budget);
+        instr_limit -= board->cpu->instr - instr;
+#endif
+
+        board_serviceTrace(board);
 
         // ACIA MANAGEMENT
 
-        // After the execution of the current instruction, checks for
-        // key pressed with kbhit(). If one key was pressed, then puts it
-        // into RDR, set RX_FULL and is_pendingInterrupt.
-
-        if (kbhit() && !(mc6850_getStatus(board->acia) & RX_FULL)) {
-            char ch = getch();
-            if (ch == 0x0A) {
-                mc6850_setRDR(board->acia, 0x0D); // Carriage return.
-            } else
-                mc6850_setRDR(board->acia, ch);
-
-            mc6850_setStatus(board->acia, mc6850_getStatus(board->acia) | RX_FULL);
-
-            // Signals pending interrupt.
-            board->cpu->is_pendingMI = 1;
+        // After the execution of the slice, the characters which went
+        // through the lines reach RDR, or the host output.
+        uint32_t now = board->cpu->cycles;
+        bool is_active = false;
+        uint8_t ch;
+
+        mc6850_update(board->acia, now);
+        while (mc6850_isSent(board->acia, now)) {
+            is_active = true;
+            ch = mc6850_transmit(board->acia, now);
+            if (output != NULL)
+                output_put(output, ch);
         }
 
-        // After checking incoming characters, checks the ACIA status register
-        // and determines if a byte is ready to be transmitted.
-
-        if (!(mc6850_getStatus(board->acia) & TX_EMPTY)) {
-            char charToPrint = mc6850_getTDR(board->acia);
-            if (is_terminal) {
-                if (charToPrint == 0x0D) { // Carriage return.
-                    printw("\n");
-                } else if (charToPrint == 0x0C) { // New page - Form Feed.
-                    clear();
-                } else if (charToPrint == 0x0A) {
-                    // Do nothing
-                } else {
-                    printw("%c", charToPrint);
+        // Then the next key of the input ring starts its way to RDR, if the
+        // guest lets the host send it.
+        if (!is_held && mc6850_canReceive(board->acia) &&
+            input_pop(input, &ch)) {
+            is_active = true;
+            is_held = input->is_paced && (ch == 0x0A || ch == 0x0D);
+            if (ch == 0x0A)
+                ch = 0x0D; // Carriage return.
+            mc6850_receive(board->acia, ch, now);
+        }
+        board_updateIrq(board);
+
+        // A halted cpu, or one polling memory or the ACIA in an idle loop,
+        // can only go on after an interrupt or a change of the ACIA status.
+        // With no character on the lines, both only come from the keyboard:
+        // there is nothing to run until a key is pressed.
+        bool is_idle = !mc6850_isBusy(board->acia, now) &&
+            !cpu_hasInterrupt(board->cpu) &&
+            (board->cpu->halt || cpu_isIdle(board->cpu));
+        idle_slices = (is_idle && !is_active) ? idle_slices + 1 : 0;
+
+        // The screen is refreshed once per frame, or before waiting for
+        // input. Waiting for TX_EMPTY looks idle for a slice, so a single
+        // idle slice is not enough to tell that the guest is done printing.
+        if (output != NULL)
+            output_update(output, idle_slices >= BOARD_IDLE_SLICES);
+
+        // The guest waits for input: the next line can be sent, if there
+        // is any.
+        if (idle_slices >= BOARD_IDLE_SLICES) {
+            is_held = false;
+            if (input_isOver(input)) {
+                LOG_INFO("End of input.\n");
+                break;
+            }
+            if (inf_loop) {
+                if (!board_waitInput(board, input, idle_timeout)) {
+                    LOG_INFO("No input for %u ms.\n", idle_timeout);
+                    break;
                 }
-                refresh();
+                idle_slices = 0;
             }
-
-            mc6850_setStatus(board->acia,
-                mc6850_getStatus(board->acia) | TX_EMPTY);
         }
     }
+
+    if (output != NULL)
+        output_flush(output);
     return;
 }
+#endif
 
 
 // Destroys board deallocating memory.
 int32_t board_destroy(board_t *board) {
-    cpu_destroy(board->cpu);
+    // Left NULL by a failed initialization.
+    if (board->cpu != NULL)
+        cpu_destroy(board->cpu);
     free(board->cpu);
     free(board->acia);
 
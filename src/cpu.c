@@ -1,13 +1,62 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include <signal.h>
 
 #include "cpu.h"
 #include "opcodes.h"
+#include "blkcache.h"
+#include "jit.h"
+#include "profiler.h"
+#include "rom.h"
 #include "logger.h"
 
 
+// Fills the page table from the registered memory chunks. Pages fully
+// covered by a single chunk are mapped directly; pages only partially
+// covered are routed to the slow path.
+static void cpu_mapPages(cpu_t *cpu) {
+    for (int32_t page = 0; page < MEM_PAGE_COUNT; page++) {
+        uint32_t pg_start = page << MEM_PAGE_SHIFT;
+        uint32_t pg_end = pg_start + MEM_PAGE_SIZE;
+
+        cpu->pages[page] = (mem_page_t){NULL, PAGE_UNUSED, 0};
+
+        for (mem_chunk_t *mc = cpu->memory; mc != NULL; mc = mc->next) {
+            uint32_t mc_end = (uint32_t)mc->start + mc->size;
+
+            if (mc->start >= pg_end || mc_end <= pg_start)
+                continue;
+
+            if (mc->start > pg_start || mc_end < pg_end) {
+                cpu->pages[page] = (mem_page_t){NULL, PAGE_MMIO, 0};
+                break;
+            }
+
+            switch (mc->type) {
+                case CHUNK_READONLY:
+                    cpu->pages[page] = (mem_page_t){
+                        mc->buff + (pg_start - mc->start), PAGE_READONLY, 0};
+                    break;
+                case CHUNK_READWRITE:
+                    // Memory shared with forked boards is only read until
+                    // the first write.
+                    if (mc->image != NULL)
+                        cpu->pages[page] = (mem_page_t){mc->image->data +
+                            (pg_start - mc->start), PAGE_COW, 0};
+                    else
+                        cpu->pages[page] = (mem_page_t){
+                            mc->buff + (pg_start - mc->start), 0, 0};
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+    }
+    return;
+}
+
+
 // Initializes the CPU data structure.
 // Returns 0 if no errors occur.
 int32_t cpu_init(cpu_t *cpu, mem_chunk_t *mem_list, board_t *board) {
@@ -87,21 +136,223 @@ int32_t cpu_init(cpu_t *cpu, mem_chunk_t *mem_list, board_t *board) {
 
     // Memory chunks registration.
     cpu->memory = mem_list;
+    cpu_mapPages(cpu);
+
+#ifdef CPU_BLOCKCACHE
+    cpu->blocks = blk_create();
+    if (cpu->blocks == NULL)
+        return 1;
+#else
+    cpu->blocks = NULL;
+#endif
+    cpu->jit = NULL;
+    cpu->prof = NULL;
+    cpu->breakpoints = NULL;
+    cpu->is_ioAccess = false;
+    cpu->portIO_isPure = NULL;
+    cpu->repeat_cycles = 0;
+
     cpu_reset(cpu);
     return 0;
 }
 
 
-// Cleans up dynamically allocated memory.
-// Returns 0 in case of success.
-int32_t cpu_destroy(cpu_t *cpu) {
+// Copies a PAGE_COW page into the buffer of its chunk, allocated on the
+// first copy, and maps it there.
+static void cpu_unsharePage(cpu_t *cpu, uint32_t page) {
+    uint32_t pg_start = page << MEM_PAGE_SHIFT;
+    mem_page_t *pg = &cpu->pages[page];
+
+    for (mem_chunk_t *mc = cpu->memory; mc != NULL; mc = mc->next) {
+        if (mc->type != CHUNK_READWRITE ||
+            !WHITIN(pg_start, mc->start, mc->start + mc->size - 1))
+            continue;
+
+        if (mc->buff == NULL) {
+            mc->buff = (uint8_t *)malloc(mc->size);
+            if (mc->buff == NULL) {
+                LOG_FATAL("Cannot allocate the %s chunk.\n", mc->label);
+                cpu_fault(cpu);
+                return;
+            }
+        }
+
+        uint8_t *host = mc->buff + (pg_start - mc->start);
+        memcpy(host, pg->host, MEM_PAGE_SIZE);
+        pg->host = host;
+        pg->flags &= ~PAGE_COW;
+        return;
+    }
+    return;
+}
+
+
+// Frees a list of memory chunks.
+static void cpu_freeChunks(mem_chunk_t *mem_list) {
+    mem_chunk_t *next;
+    for (mem_chunk_t *mc = mem_list; mc != NULL; mc = next) {
+        next = mc->next;
+        LOG_INFO("Deallocation of %s chunk.\n", mc->label);
+        // The buffer of a shared ROM belongs to its image.
+        if (mc->image == NULL || mc->buff != mc->image->data)
+            free(mc->buff);
+        if (mc->image != NULL)
+            rom_release(mc->image);
+        free(mc);
+    }
+    return;
+}
+
+
+// Freezes the memory of the cpu into shared images, so that it can be
+// mapped by forked cpus. ROM chunks become images of their own. RAM
+// chunks get a snapshot of their contents, unless they are all still
+// shared, and their pages turn PAGE_COW. RAM chunks not aligned to pages
+// are left alone.
+// Returns 0 if no errors occur.
+static int32_t cpu_shareMemory(cpu_t *cpu) {
     for (mem_chunk_t *mc = cpu->memory; mc != NULL; mc = mc->next) {
-        if (mc != NULL) {
-            LOG_INFO("Deallocation of %s chunk.\n", mc->label);
+        if (mc->type == CHUNK_READONLY && mc->image == NULL) {
+            rom_t *image = rom_create(mc->buff, mc->size);
+            if (image == NULL)
+                return 1;
             free(mc->buff);
-            free(mc);
+            mc->buff = image->data;
+            mc->image = image;
+            continue;
+        }
+
+        if (mc->type != CHUNK_READWRITE ||
+            ((mc->start | mc->size) & (MEM_PAGE_SIZE - 1)))
+            continue;
+
+        uint32_t first = mc->start >> MEM_PAGE_SHIFT;
+        uint32_t last = first + (mc->size >> MEM_PAGE_SHIFT);
+        bool is_dirty = (mc->image == NULL);
+        for (uint32_t page = first; page < last && !is_dirty; page++)
+            is_dirty = !(cpu->pages[page].flags & PAGE_COW);
+        if (!is_dirty)
+            continue;
+
+        // Gathers the current contents in buff.
+        if (mc->buff == NULL) {
+            mc->buff = (uint8_t *)malloc(mc->size);
+            if (mc->buff == NULL) {
+                LOG_ERROR("Cannot allocate the %s chunk.\n", mc->label);
+                return 1;
+            }
+        }
+        for (uint32_t page = first; page < last; page++) {
+            if (cpu->pages[page].flags & PAGE_COW)
+                cpu_unsharePage(cpu, page);
+        }
+
+        rom_t *image = rom_create(mc->buff, mc->size);
+        if (image == NULL)
+            return 1;
+        if (mc->image != NULL)
+            rom_release(mc->image);
+        mc->image = image;
+    }
+
+    // Decoded blocks stay valid, the contents did not change. Generations
+    // are kept so that stale blocks stay stale.
+    mem_page_t old[MEM_PAGE_COUNT];
+    memcpy(old, cpu->pages, sizeof(old));
+    cpu_mapPages(cpu);
+    for (int32_t page = 0; page < MEM_PAGE_COUNT; page++) {
+        cpu->pages[page].flags |= old[page].flags & PAGE_CODE;
+        cpu->pages[page].gen = old[page].gen;
+    }
+    return 0;
+}
+
+
+// Initializes cpu as a copy of parent, attached to board. Registers and
+// interrupt state are copied, memory is shared: RAM pages are copied by
+// either cpu on their first write only. The decoded blocks, the JIT and
+// the profiler of parent are not inherited.
+// Returns 0 if no errors occur.
+int32_t cpu_fork(cpu_t *cpu, cpu_t *parent, board_t *board) {
+    if (cpu_shareMemory(parent)) {
+        LOG_ERROR("Cannot share the cpu memory.\n");
+        return 1;
+    }
+
+    mem_chunk_t *mem_list = NULL;
+    mem_chunk_t **tail = &mem_list;
+
+    for (mem_chunk_t *mc = parent->memory; mc != NULL; mc = mc->next) {
+        mem_chunk_t *copy = (mem_chunk_t *)malloc(sizeof(mem_chunk_t));
+        if (copy == NULL) {
+            LOG_ERROR("Cannot create memory chunks.\n");
+            cpu_freeChunks(mem_list);
+            return 1;
+        }
+
+        *copy = *mc;
+        copy->next = NULL;
+        *tail = copy;
+        tail = &copy->next;
+
+        if (mc->image != NULL) {
+            rom_acquire(mc->image);
+            if (mc->type == CHUNK_READWRITE)
+                copy->buff = NULL;
+        } else if (mc->buff != NULL) {
+            copy->buff = (uint8_t *)malloc(mc->size);
+            if (copy->buff == NULL) {
+                LOG_ERROR("Cannot allocate the %s chunk.\n", mc->label);
+                cpu_freeChunks(mem_list);
+                return 1;
+            }
+            memcpy(copy->buff, mc->buff, mc->size);
+        }
+    }
+
+    *cpu = *parent;
+    cpu->memory = mem_list;
+    cpu->board = board;
+    cpu_mapPages(cpu);
+
+#ifdef CPU_BLOCKCACHE
+    cpu->blocks = blk_create();
+    if (cpu->blocks == NULL) {
+        cpu_freeChunks(mem_list);
+        return 1;
+    }
+#else
+    cpu->blocks = NULL;
+#endif
+    cpu->jit = NULL;
+    cpu->prof = NULL;
+    cpu->breakpoints = NULL;
+
+    if (parent->breakpoints != NULL) {
+        cpu->breakpoints = (uint8_t *)malloc(0x10000 / 8);
+        if (cpu->breakpoints == NULL) {
+            LOG_ERROR("Cannot allocate the breakpoint map.\n");
+            cpu_destroy(cpu);
+            return 1;
         }
+        memcpy(cpu->breakpoints, parent->breakpoints, 0x10000 / 8);
     }
+    return 0;
+}
+
+
+// Cleans up dynamically allocated memory.
+// Returns 0 in case of success.
+int32_t cpu_destroy(cpu_t *cpu) {
+    cpu_freeChunks(cpu->memory);
+
+    if (cpu->blocks != NULL)
+        blk_destroy(cpu->blocks);
+    if (cpu->jit != NULL)
+        jit_destroy(cpu->jit);
+    if (cpu->prof != NULL)
+        prof_destroy(cpu->prof);
+    free(cpu->breakpoints);
 
     LOG_INFO("Deallocated cpu memory.\n");
     return 0;
@@ -115,6 +366,7 @@ void cpu_reset(cpu_t *cpu) {
     cpu->cycles = 0;
     cpu->instr = 0;
     cpu->halt = 0;
+    cpu->is_faulted = false;
     cpu->I = 0;
     cpu->R = 0;
     cpu->PC = 0;
@@ -123,14 +375,20 @@ void cpu_reset(cpu_t *cpu) {
     cpu->IM = INT_MODE_0;
     cpu->is_pendingMI = 0;
     cpu->is_pendingNMI = 0;
+#ifdef CPU_LAZYFLAGS
+    cpu->flags_op = FLAGS_NONE;
+#endif
+#ifdef CPU_TRACE
+    cpu->trace_count = 0;
+#endif
 
     return;
 }
 
 
-// Reads one byte at the given memory location. The CPU has 64KB of
-// addressable memory.
-uint8_t cpu_read(cpu_t *cpu, const uint16_t addr) {
+// Reads one byte walking the memory chunks. Used for pages that are
+// not directly mapped.
+static uint8_t cpu_readChunk(cpu_t *cpu, const uint16_t addr) {
     for (mem_chunk_t *mc = cpu->memory; mc != NULL; mc = mc->next) {
         if (WHITIN(addr, mc->start, mc->start + mc->size - 1) &&
             mc->type != CHUNK_UNUSED) {
@@ -140,20 +398,21 @@ uint8_t cpu_read(cpu_t *cpu, const uint16_t addr) {
     }
 
     LOG_FATAL("Memory read error at address 0x%04X.\n", addr);
-    raise(SIGINT);
+    cpu_fault(cpu);
     return 0;
 }
 
 
-// Writes one byte at the given memory location. The CPU has 64KB of
-// addressable memory.
-void cpu_write(cpu_t *cpu, const uint8_t data, const uint16_t addr) {
+// Writes one byte walking the memory chunks. Used for pages that are
+// not directly mapped or read-only.
+static void cpu_writeChunk(cpu_t *cpu, const uint8_t data, const uint16_t addr) {
     for (mem_chunk_t *mc = cpu->memory; mc != NULL; mc = mc->next) {
         if (WHITIN(addr, mc->start, mc->start + mc->size - 1)) {
             if (mc->type == CHUNK_READONLY) {
                 LOG_FATAL("Cannot write to read-only memory at address 0x%04X.\n",
                     addr);
-                raise(SIGINT);
+                cpu_fault(cpu);
+                return;
             }
 
             if (mc->type == CHUNK_READWRITE) {
@@ -164,7 +423,49 @@ void cpu_write(cpu_t *cpu, const uint8_t data, const uint16_t addr) {
     }
 
     LOG_FATAL("Memory write error at address 0x%04X.\n", addr);
-    raise(SIGINT);
+    cpu_fault(cpu);
+}
+
+
+// Reads one byte at the given memory location. The CPU has 64KB of
+// addressable memory.
+uint8_t cpu_read(cpu_t *cpu, const uint16_t addr) {
+    const mem_page_t *pg = &cpu->pages[addr >> MEM_PAGE_SHIFT];
+
+    if (!(pg->flags & (PAGE_UNUSED | PAGE_MMIO)))
+        return pg->host[addr & MEM_PAGE_MASK];
+
+    return cpu_readChunk(cpu, addr);
+}
+
+
+// Writes one byte at the given memory location. The CPU has 64KB of
+// addressable memory.
+void cpu_write(cpu_t *cpu, const uint8_t data, const uint16_t addr) {
+    mem_page_t *pg = &cpu->pages[addr >> MEM_PAGE_SHIFT];
+
+    if (!pg->flags) {
+        pg->host[addr & MEM_PAGE_MASK] = data;
+        return;
+    }
+
+    // RAM still shared with a forked board: gets a copy of its own first.
+    if (pg->flags & PAGE_COW) {
+        cpu_unsharePage(cpu, addr >> MEM_PAGE_SHIFT);
+        cpu_write(cpu, data, addr);
+        return;
+    }
+
+    // RAM holding decoded blocks: they become stale and the page goes
+    // back to the fast path until it is decoded again.
+    if (pg->flags == PAGE_CODE) {
+        pg->flags = 0;
+        pg->gen++;
+        pg->host[addr & MEM_PAGE_MASK] = data;
+        return;
+    }
+
+    cpu_writeChunk(cpu, data, addr);
 }
 
 
@@ -184,6 +485,42 @@ uint16_t cpu_stackPop(cpu_t *cpu) {
 }
 
 
+#ifdef CPU_LAZYFLAGS
+// Computes F from the pending flag operation. Undocumented bits 3 and 5 are
+// kept, INC and DEC also keep C.
+void cpu_computeFlags(cpu_t *cpu) {
+    uint8_t op1 = cpu->flags_op1;
+    uint8_t op2 = cpu->flags_op2;
+
+    switch (cpu->flags_op) {
+        case FLAGS_ADD:
+            cpu->F = (cpu->F & FLAG_UNDOC_MASK) |
+                opc_szhvcAddTbl[FLAG_TBL_IDX(cpu->flags_c, op1, op2)];
+            break;
+        case FLAGS_SUB:
+            cpu->F = (cpu->F & FLAG_UNDOC_MASK) |
+                opc_szhvcSubTbl[FLAG_TBL_IDX(cpu->flags_c, op1, op2)];
+            break;
+        case FLAGS_INC:
+            cpu->F = (cpu->F & (FLAG_UNDOC_MASK | FLAG_CARRY)) |
+                (opc_szhvcAddTbl[FLAG_TBL_IDX(0, op1, 1)] & ~FLAG_CARRY);
+            break;
+        case FLAGS_DEC:
+            cpu->F = (cpu->F & (FLAG_UNDOC_MASK | FLAG_CARRY)) |
+                (opc_szhvcSubTbl[FLAG_TBL_IDX(0, op1, 1)] & ~FLAG_CARRY);
+            break;
+        case FLAGS_SZP:
+            cpu->F = (cpu->F & FLAG_UNDOC_MASK) | opc_szpTbl[op1] | op2;
+            break;
+        default:
+            break;
+    }
+    cpu->flags_op = FLAGS_NONE;
+    return;
+}
+#endif
+
+
 // Executes non-maskable interrupts. Restarts from 0x66;
 static void cpu_doNonMaskableINT(cpu_t *cpu) {
     cpu->IFF1 = 0;
@@ -197,7 +534,8 @@ static void cpu_doNonMaskableINT(cpu_t *cpu) {
 
 
 // Executes maskable interrupts.
-static void cpu_doMaskableINT(cpu_t *cpu) {
+// Returns true if the interrupt is accepted.
+static bool cpu_doMaskableINT(cpu_t *cpu) {
     // If the previous instruction is EI (0xFB), does not execute INT.
     if (cpu_read(cpu, cpu->PC - 1) != 0xFB) {
         // Checks IFF1 status.
@@ -214,7 +552,7 @@ static void cpu_doMaskableINT(cpu_t *cpu) {
                 /* TODO: instruction execution. */
                 cpu->cycles += 2;
                 LOG_FATAL("Interrupt mode 0 not supported yet.\n");
-                raise(SIGINT);
+                cpu_fault(cpu);
             }
 
             // Interrupt mode 1.
@@ -240,45 +578,338 @@ static void cpu_doMaskableINT(cpu_t *cpu) {
 
             else {
                 LOG_FATAL("Unknown interrupt mode.\n");
-                raise(SIGINT);
+                cpu_fault(cpu);
             }
+            return true;
         }
     }
-    return;
+    return false;
 }
 
 
-// Executes one instruction.
-void cpu_emulate(cpu_t *cpu) {
+// Fetches and executes one instruction.
+static inline void cpu_step(cpu_t *cpu) {
     uint8_t opcode = 0; // NOP, default for HALT;
 
-    if (!cpu->halt) {
-        // Fetches instruction and increases the PC.
-        opcode = opc_fetch8(cpu);
+#ifdef CPU_TRACE
+    cpu_getF(cpu);
+    cpu_traceRecord(cpu, cpu->PC, cpu->AF, cpu->BC, cpu->DE, cpu->HL,
+        cpu->SP, cpu->cycles);
+#endif
+#ifdef CPU_PROFILE
+    // A halted cpu is charged to its HALT instruction.
+    uint16_t pc = cpu->halt ? cpu->PC - 1 : cpu->PC;
+    uint16_t sp = cpu->SP;
+    uint32_t cycles = cpu->cycles;
+#endif
+
+    const blk_instr_t *instr = NULL;
+    if (!cpu->halt && cpu->blocks != NULL)
+        instr = blk_fetch(cpu);
+
+    if (instr != NULL) {
+        // Executes the decoded instruction, skipping the bytes it has
+        // already been decoded from.
+        cpu->PC += instr->fetched;
+        if (instr->execute != NULL)
+            instr->execute(cpu, instr);
+        else
+            instr->handler.op(cpu, instr->opcode);
+        cpu->cycles += instr->TStates;
     }
+    else {
+        if (!cpu->halt) {
+            // Fetches instruction and increases the PC.
+            opcode = opc_fetch8(cpu);
+        }
 
-    // Executes instruction.
-    opc_tbl[opcode].execute(cpu, opcode);
-    cpu->cycles += opc_tbl[opcode].TStates;
+        // Executes instruction.
+        opc_tbl[opcode].execute(cpu, opcode);
+        cpu->cycles += opc_tbl[opcode].TStates;
+    }
     cpu->instr++;
+#ifdef CPU_PROFILE
+    if (cpu->prof != NULL)
+        prof_record(cpu->prof, cpu, pc, sp, cycles);
+#endif
+    return;
+}
+
 
-    // Detects interrupts at the end of instruction's execution.
-    // NMIs have priority over MI.
-    if (cpu->is_pendingNMI)
+// Detects interrupts at the end of instruction's execution.
+// NMIs have priority over MI.
+// Returns true if an interrupt is accepted.
+static inline bool cpu_doInterrupts(cpu_t *cpu) {
+#ifdef CPU_PROFILE
+    uint32_t cycles = cpu->cycles;
+#endif
+    bool is_accepted = false;
+
+    if (cpu->is_pendingNMI) {
         cpu_doNonMaskableINT(cpu);
+        is_accepted = true;
+    }
     else if (cpu->is_pendingMI)
-        cpu_doMaskableINT(cpu);
+        is_accepted = cpu_doMaskableINT(cpu);
+
+#ifdef CPU_PROFILE
+    if (is_accepted && cpu->prof != NULL)
+        prof_interrupt(cpu->prof, cpu, cpu->cycles - cycles);
+#endif
+    return is_accepted;
+}
+
 
+// Executes one instruction.
+void cpu_emulate(cpu_t *cpu) {
+    cpu_step(cpu);
+    cpu_doInterrupts(cpu);
+    return;
+}
+
+
+// Executes instructions until cycle_budget T-states have been used or one
+// of the events in cpu_run_t occurs. A breakpoint on the first instruction
+// does not stop the run, so that execution can resume from it.
+// Returns the reason for stopping.
+cpu_run_t cpu_run(cpu_t *cpu, uint32_t cycle_budget) {
+    uint32_t start = cpu->cycles;
+    bool is_first = true;
+    cpu_run_t status = CPU_RUN_BUDGET;
+
+    cpu->is_ioAccess = false;
+
+    while (cpu->cycles - start < cycle_budget) {
+        if (cpu->is_faulted) {
+            status = CPU_RUN_FAULT;
+            break;
+        }
+
+        // A halted cpu that cannot take an interrupt only runs NOPs, the
+        // rest of the budget is skipped at once.
+        if (cpu->halt && !cpu_hasInterrupt(cpu)) {
+            uint32_t left = cycle_budget - (cpu->cycles - start);
+            cpu_skipHalt(cpu, left / 4 + (left % 4 != 0));
+            break;
+        }
+
+        if (cpu->breakpoints != NULL && !is_first && !cpu->halt &&
+            (cpu->breakpoints[cpu->PC >> 3] & (1 << (cpu->PC & 7)))) {
+            status = CPU_RUN_BREAKPOINT;
+            break;
+        }
+        is_first = false;
+
+        // Block repeats may run several iterations in one step, unless a
+        // breakpoint is set on them.
+        bool was_halted = cpu->halt;
+        if (cpu->breakpoints == NULL ||
+            !(cpu->breakpoints[cpu->PC >> 3] & (1 << (cpu->PC & 7))))
+            cpu->repeat_cycles = cycle_budget - (cpu->cycles - start);
+        cpu_step(cpu);
+        cpu->repeat_cycles = 0;
+        bool is_interrupted = cpu_doInterrupts(cpu);
+
+        if (cpu->is_ioAccess)
+            status = CPU_RUN_IO;
+        else if (is_interrupted)
+            status = CPU_RUN_INTERRUPT;
+        else if (cpu->halt && !was_halted)
+            status = CPU_RUN_HALT;
+        else
+            continue;
+        break;
+    }
+
+    cpu_getF(cpu);
+    return status;
+}
+
+
+
+// Runs count NOPs at once on a halted cpu that cannot take an interrupt.
+// Only the T-states and the instruction count change.
+// Returns count.
+uint32_t cpu_skipHalt(cpu_t *cpu, uint32_t count) {
+#ifdef CPU_PROFILE
+    if (cpu->prof != NULL)
+        prof_skipHalt(cpu->prof, cpu, count);
+#endif
+    cpu->cycles += 4 * count;
+    cpu->instr += count;
+    return count;
+}
+
+
+// Returns true if addr can be read without side effects and can only be
+// changed by the cpu itself.
+static bool cpu_isPlainRead(cpu_t *cpu, uint16_t addr) {
+    return !(cpu->pages[addr >> MEM_PAGE_SHIFT].flags &
+        (PAGE_UNUSED | PAGE_MMIO));
+}
+
+
+// Returns the length of the instruction at addr if it can be part of an
+// idle loop, 0 otherwise. Allowed instructions only read memory or a port
+// without side effects into A and compute A and F from it. is_load is set
+// for the ones that load A.
+static uint32_t cpu_idleInstrLen(cpu_t *cpu, uint16_t addr, bool *is_load) {
+    uint8_t opcode = cpu_read(cpu, addr);
+    uint8_t next = cpu_read(cpu, addr + 1);
+
+    *is_load = true;
+    switch (opcode) {
+        case 0x3A: // LD A,(nn)
+            return cpu_isPlainRead(cpu, next | (cpu_read(cpu, addr + 2) << 8))
+                ? 3 : 0;
+        case 0x0A: // LD A,(BC)
+            return cpu_isPlainRead(cpu, cpu->BC) ? 1 : 0;
+        case 0x1A: // LD A,(DE)
+            return cpu_isPlainRead(cpu, cpu->DE) ? 1 : 0;
+        case 0x7E: // LD A,(HL)
+            return cpu_isPlainRead(cpu, cpu->HL) ? 1 : 0;
+        case 0xDB: // IN A,(n)
+            return (cpu->portIO_isPure != NULL &&
+                cpu->portIO_isPure(cpu->board, next)) ? 2 : 0;
+    }
+
+    *is_load = false;
+    switch (opcode) {
+        case 0xC6: // ADD A,n
+        case 0xD6: // SUB n
+        case 0xE6: // AND n
+        case 0xEE: // XOR n
+        case 0xF6: // OR n
+        case 0xFE: // CP n
+            return 2;
+        case 0xCB: // BIT b,r
+            if ((next & 0xC0) != 0x40)
+                return 0;
+            return ((next & 0x07) != 0x06 || cpu_isPlainRead(cpu, cpu->HL))
+                ? 2 : 0;
+    }
+
+    // ADD, SUB, AND, XOR, OR and CP with a register or (HL). ADC and SBC
+    // depend on the carry of the previous iteration.
+    if ((opcode & 0xC0) == 0x80 && (opcode & 0x38) != 0x08 &&
+        (opcode & 0x38) != 0x18)
+        return ((opcode & 0x07) != 0x06 || cpu_isPlainRead(cpu, cpu->HL))
+            ? 1 : 0;
+
+    return 0;
+}
+
+
+// Returns true if the instruction at addr is a jump, and sets target.
+static bool cpu_idleBranch(cpu_t *cpu, uint16_t addr, uint16_t *target) {
+    uint8_t opcode = cpu_read(cpu, addr);
+
+    // JR e and JR cc,e.
+    if (opcode == 0x18 || (opcode & 0xE7) == 0x20) {
+        *target = addr + 2 + (int8_t)cpu_read(cpu, addr + 1);
+        return true;
+    }
+    // JP nn and JP cc,nn.
+    if (opcode == 0xC3 || (opcode & 0xC7) == 0xC2) {
+        *target = cpu_read(cpu, addr + 1) | (cpu_read(cpu, addr + 2) << 8);
+        return true;
+    }
+    return false;
+}
+
+
+// Returns true if the cpu is spinning in a short loop that reloads A from
+// memory or from a port the board reads without side effects (a status
+// register), tests it and jumps back, or in a jump to itself. Such a loop
+// has no side effects: it keeps running until an interrupt handler or a
+// peripheral changes the value it reads.
+bool cpu_isIdle(cpu_t *cpu) {
+    uint16_t addr = cpu->PC;
+    uint16_t start = 0;
+    bool is_load;
+
+    if (cpu->halt)
+        return false;
+
+    // Walks forward to the jump closing the loop.
+    while (!cpu_idleBranch(cpu, addr, &start)) {
+        uint32_t len = cpu_idleInstrLen(cpu, addr, &is_load);
+        if (len == 0 || (uint16_t)(addr - cpu->PC) >= CPU_IDLE_LOOP_LEN)
+            return false;
+        addr += len;
+    }
+
+    // The loop must contain PC and start by loading A.
+    uint16_t end = addr;
+    if ((uint16_t)(end - start) >= CPU_IDLE_LOOP_LEN ||
+        (uint16_t)(cpu->PC - start) > (uint16_t)(end - start))
+        return false;
+
+    for (addr = start; addr != end; ) {
+        uint32_t len = cpu_idleInstrLen(cpu, addr, &is_load);
+        if (len == 0 || (addr == start && !is_load))
+            return false;
+        addr += len;
+        if ((uint16_t)(addr - start) > (uint16_t)(end - start))
+            return false;
+    }
+    return true;
+}
+
+
+// Sets a breakpoint at the given address, see cpu_run.
+// Returns 0 in case of success.
+int32_t cpu_setBreakpoint(cpu_t *cpu, uint16_t addr) {
+    if (cpu->breakpoints == NULL) {
+        cpu->breakpoints = (uint8_t *)calloc(0x10000 / 8, sizeof(uint8_t));
+        if (cpu->breakpoints == NULL) {
+            LOG_ERROR("Cannot allocate the breakpoint map.\n");
+            return 1;
+        }
+    }
+
+    cpu->breakpoints[addr >> 3] |= (1 << (addr & 7));
+#ifdef CPU_FUSION
+    // The instruction may be part of a fused group in a decoded block.
+    if (cpu->blocks != NULL)
+        blk_flush(cpu->blocks);
+#endif
+    return 0;
+}
+
+
+// Removes the breakpoint at the given address, if any.
+void cpu_clearBreakpoint(cpu_t *cpu, uint16_t addr) {
+    if (cpu->breakpoints != NULL)
+        cpu->breakpoints[addr >> 3] &= ~(1 << (addr & 7));
+    return;
+}
+
+
+// Reads from an IO port through the board callback.
+uint8_t cpu_portIn(cpu_t *cpu, uint8_t port) {
+    cpu->is_ioAccess = true;
+    return cpu->portIO_in(cpu->board, port);
+}
+
+
+// Writes to an IO port through the board callback.
+void cpu_portOut(cpu_t *cpu, uint8_t port, uint8_t data) {
+    cpu->is_ioAccess = true;
+    cpu->portIO_out(cpu->board, port, data);
     return;
 }
 
 
 // Sets callbacks for IO operations. Callbacks are defined at board level.
+// portIO_isPure may be NULL if no port can be read without side effects.
 void cpu_setIOcallbacks(cpu_t *cpu, uint8_t (*portIO_in)(board_t *, uint8_t),
-    void (*portIO_out)(board_t *, uint8_t, uint8_t)) {
+    void (*portIO_out)(board_t *, uint8_t, uint8_t),
+    bool (*portIO_isPure)(board_t *, uint8_t)) {
 
     cpu->portIO_in = portIO_in;
     cpu->portIO_out = portIO_out;
+    cpu->portIO_isPure = portIO_isPure;
     return;
 }
 
@@ -306,6 +937,7 @@ void cpu_printChunk(mem_chunk_t *chunk) {
 
 // Dumps cpu registers.
 void cpu_dumpRegisters(cpu_t *cpu) {
+    cpu_getF(cpu);
     LOG_DEBUG("CPU registers:\n");
     LOG_DEBUG("A: %02X  F: %02X    A': %02X  F': %02X\n"
               "B: %02X  C: %02X    B': %02X  C': %02X\n"
@@ -324,3 +956,30 @@ void cpu_dumpRegisters(cpu_t *cpu) {
 
     return;
 }
+
+
+// Dumps the instruction trace, oldest record first. Records are written
+// with the fatal level so that they reach the log whatever the verbosity,
+// and are left out with the logger (LOGGER_MAX_LEVEL=0).
+void cpu_dumpTrace(cpu_t *cpu) {
+#ifdef CPU_TRACE
+    uint32_t count = cpu->trace_count < TRACE_SIZE ?
+        cpu->trace_count : TRACE_SIZE;
+
+    LOGGER_WRITE(LOGGER_FATAL_LEVEL, "[TRACE] Last %u instructions:\n", count);
+    LOGGER_WRITE(LOGGER_FATAL_LEVEL,
+        "PC    OPCODE       AF   BC   DE   HL   SP   CYCLES\n");
+
+    for (uint32_t i = cpu->trace_count - count; i != cpu->trace_count; i++) {
+        const trace_rec_t *rec = &cpu->trace[i & (TRACE_SIZE - 1)];
+        LOGGER_WRITE(LOGGER_FATAL_LEVEL,
+            "%04X  %02X %02X %02X %02X  %04X %04X %04X %04X %04X %u\n",
+            rec->PC, rec->opcode[0], rec->opcode[1], rec->opcode[2],
+            rec->opcode[3], rec->AF, rec->BC, rec->DE, rec->HL, rec->SP,
+            rec->cycles);
+    }
+#else
+    LOG_WARNING("Instruction trace not available, build with TRACE=1.\n");
+#endif
+    return;
+}
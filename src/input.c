@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "input.h"
+#include "logger.h"
+
+// Microseconds the reader sleeps while the ring is full.
+#define INPUT_FULL_SLEEP 1000
+
+
+// Wakes up the emulation loop if it sleeps in input_wait().
+static void input_signal(input_t *input) {
+    pthread_mutex_lock(&input->lock);
+    pthread_cond_broadcast(&input->wakeup);
+    pthread_mutex_unlock(&input->lock);
+    return;
+}
+
+
+// Reader thread: moves the input bytes into the ring until the end of the
+// input or input_stop().
+static void *input_read(void *arg) {
+    input_t *input = (input_t *)arg;
+    uint8_t buff[256];
+
+    while (true) {
+        ssize_t size = read(input->fd, buff, sizeof(buff));
+        if (size < 0 && errno == EINTR)
+            continue;
+        if (size <= 0)
+            break;
+
+        uint32_t head = input->head;
+        for (ssize_t i = 0; i < size; i++) {
+            // Waits for the emulation loop to make room, as a pasted text
+            // can be longer than the ring.
+            while (head - __atomic_load_n(&input->tail, __ATOMIC_ACQUIRE) ==
+                INPUT_RING_SIZE) {
+                __atomic_store_n(&input->head, head, __ATOMIC_RELEASE);
+                input_signal(input);
+                usleep(INPUT_FULL_SLEEP);
+            }
+            input->ring[head++ % INPUT_RING_SIZE] = buff[i];
+        }
+        __atomic_store_n(&input->head, head, __ATOMIC_RELEASE);
+        input_signal(input);
+    }
+
+    __atomic_store_n(&input->is_closed, true, __ATOMIC_RELEASE);
+    input_signal(input);
+    return NULL;
+}
+
+
+// Starts a reader thread on fd, paced or not. Signals are blocked in the
+// thread, so that their handlers run in the emulation loop.
+// Returns NULL in case of errors.
+input_t *input_start(int32_t fd, bool is_paced) {
+    input_t *input = (input_t *)calloc(1, sizeof(input_t));
+    if (input == NULL) {
+        LOG_ERROR("Cannot allocate the input ring.\n");
+        return NULL;
+    }
+
+    input->fd = fd;
+    input->is_paced = is_paced;
+
+    // Timed waits are not affected by changes of the system clock.
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&input->lock, NULL);
+    pthread_cond_init(&input->wakeup, &attr);
+    pthread_condattr_destroy(&attr);
+
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int32_t error = pthread_create(&input->reader, NULL, input_read, input);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (error) {
+        LOG_ERROR("Cannot start the input thread.\n");
+        pthread_mutex_destroy(&input->lock);
+        pthread_cond_destroy(&input->wakeup);
+        free(input);
+        return NULL;
+    }
+    return input;
+}
+
+
+// Stops the reader thread and frees input. Bytes not taken are lost.
+void input_stop(input_t *input) {
+    pthread_cancel(input->reader);
+    pthread_join(input->reader, NULL);
+    pthread_mutex_destroy(&input->lock);
+    pthread_cond_destroy(&input->wakeup);
+    free(input);
+    return;
+}
+
+
+// Blocks until there is input to take, or none can come any more, for at
+// most timeout milliseconds, or with no limit if timeout is 0.
+// Returns false if the time is up.
+bool input_wait(input_t *input, uint32_t timeout) {
+    struct timespec deadline;
+    int32_t error = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (timeout % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&input->lock);
+    while (error == 0 &&
+        __atomic_load_n(&input->head, __ATOMIC_ACQUIRE) == input->tail &&
+        !__atomic_load_n(&input->is_closed, __ATOMIC_ACQUIRE)) {
+        if (timeout == 0)
+            pthread_cond_wait(&input->wakeup, &input->lock);
+        else
+            error = pthread_cond_timedwait(&input->wakeup, &input->lock,
+                &deadline);
+    }
+    pthread_mutex_unlock(&input->lock);
+    return error == 0;
+}
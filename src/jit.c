@@ -0,0 +1,835 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "jit.h"
+#include "blkcache.h"
+#include "opcodes.h"
+#include "rom.h"
+#include "logger.h"
+
+// Reasons for leaving the translated code.
+#define JIT_EXIT    0 // Back to the interpreter at cpu->PC.
+#define JIT_STALE   1 // The block at cpu->PC has been overwritten.
+#define JIT_BUDGET  2 // The block at cpu->PC does not fit the budget.
+
+// Offsets of the cpu_t fields used by the translated code.
+#define CPU_OFF(field) ((uint32_t)offsetof(cpu_t, field))
+#define GEN_OFF(addr) ((uint32_t)(offsetof(cpu_t, pages) + \
+    ((addr) >> MEM_PAGE_SHIFT) * sizeof(mem_page_t) + offsetof(mem_page_t, gen)))
+
+
+// Tests if the instruction at addr accesses IO ports.
+static bool jit_isIO(cpu_t *cpu, uint16_t addr) {
+    uint8_t op = cpu_read(cpu, addr);
+
+    if (op == 0xD3 || op == 0xDB)
+        return true;
+    if (op != 0xED)
+        return false;
+
+    // IN r,(C), OUT (C),r and the IO block instructions.
+    uint8_t next_opc = cpu_read(cpu, addr + 1);
+    return (next_opc & 0xC6) == 0x40 || (next_opc & 0xE6) == 0xA2;
+}
+
+
+#ifdef JIT_SELFCHECK
+// Allocates a cpu with a private copy of the given cpu memory.
+static cpu_t *jit_createShadow(cpu_t *cpu) {
+    mem_chunk_t *mem_list = NULL;
+    mem_chunk_t **tail = &mem_list;
+
+    for (mem_chunk_t *mc = cpu->memory; mc != NULL; mc = mc->next) {
+        mem_chunk_t *copy = (mem_chunk_t *)malloc(sizeof(mem_chunk_t));
+        *copy = *mc;
+        copy->buff = (uint8_t *)malloc(mc->size);
+        copy->next = NULL;
+        copy->image = NULL;
+        *tail = copy;
+        tail = &copy->next;
+    }
+
+    cpu_t *shadow = (cpu_t *)malloc(sizeof(cpu_t));
+    if (cpu_init(shadow, mem_list, cpu->board)) {
+        LOG_FATAL("Cannot initialize the self-check cpu.\n");
+        cpu_fault(cpu);
+    }
+    return shadow;
+}
+
+
+// Returns true if the chunk mc of the cpu is entirely held in its buffer.
+// Chunks shared copy-on-write (see cpu_fork) are read through the page
+// table instead.
+static bool jit_isPrivate(mem_chunk_t *mc) {
+    return mc->type == CHUNK_UNUSED || mc->image == NULL ||
+        mc->buff == mc->image->data;
+}
+
+
+// Copies registers and RAM of the cpu into its shadow.
+static void jit_syncShadow(cpu_t *cpu, cpu_t *shadow) {
+    memcpy(shadow, cpu, offsetof(cpu_t, memory));
+    shadow->IFF1 = cpu->IFF1;
+    shadow->IFF2 = cpu->IFF2;
+    shadow->IM = cpu->IM;
+    shadow->is_pendingMI = cpu->is_pendingMI;
+    shadow->is_pendingNMI = cpu->is_pendingNMI;
+    shadow->int_data = cpu->int_data;
+
+    mem_chunk_t *ms = shadow->memory;
+    for (mem_chunk_t *mc = cpu->memory; mc != NULL; mc = mc->next) {
+        if (jit_isPrivate(mc))
+            memcpy(ms->buff, mc->buff, mc->size);
+        else
+            for (uint32_t i = 0; i < mc->size; i++)
+                ms->buff[i] = cpu_read(cpu, mc->start + i);
+        ms = ms->next;
+    }
+
+    if (shadow->blocks != NULL)
+        blk_flush(shadow->blocks);
+    return;
+}
+
+
+// Compares the cpu with its shadow after a translated block starting
+// at pc. Stops the emulation on the first mismatch.
+static void jit_checkShadow(cpu_t *cpu, cpu_t *shadow, uint16_t pc) {
+    cpu_getF(shadow);
+    bool is_equal = memcmp(shadow, cpu, offsetof(cpu_t, memory)) == 0 &&
+        shadow->IFF1 == cpu->IFF1 && shadow->IFF2 == cpu->IFF2 &&
+        shadow->IM == cpu->IM;
+
+    mem_chunk_t *ms = shadow->memory;
+    for (mem_chunk_t *mc = cpu->memory; mc != NULL; mc = mc->next) {
+        bool is_diff = false;
+        if (jit_isPrivate(mc))
+            is_diff = memcmp(ms->buff, mc->buff, mc->size) != 0;
+        else
+            for (uint32_t i = 0; i < mc->size && !is_diff; i++)
+                is_diff = ms->buff[i] != cpu_read(cpu, mc->start + i);
+        if (is_diff) {
+            LOG_ERROR("JIT self-check: %s differs.\n", mc->label);
+            is_equal = false;
+        }
+        ms = ms->next;
+    }
+
+    if (!is_equal) {
+        LOG_FATAL("JIT self-check failed for the block at 0x%04X.\n"
+            "        PC   AF   BC   DE   HL   IX   IY   SP   CYCLES\n"
+            "jit     %04X %04X %04X %04X %04X %04X %04X %04X %u\n"
+            "interp  %04X %04X %04X %04X %04X %04X %04X %04X %u\n", pc,
+            cpu->PC, cpu->AF, cpu->BC, cpu->DE, cpu->HL, cpu->IX, cpu->IY,
+            cpu->SP, cpu->cycles, shadow->PC, shadow->AF, shadow->BC,
+            shadow->DE, shadow->HL, shadow->IX, shadow->IY, shadow->SP,
+            shadow->cycles);
+        cpu_fault(cpu);
+    }
+    return;
+}
+#endif
+
+
+#if defined(__x86_64__)
+
+///////////////////////////////////////////////////////////
+// X86-64 CODE EMISSION
+///////////////////////////////////////////////////////////
+
+// Register usage in the translated code:
+//  rbx  cpu_t pointer.
+//  r12d instructions that can still be run before going back to C.
+//  r13  map of translated blocks, indexed by PC.
+// All three are callee-saved, so the opc_tbl handlers leave them alone.
+// The native instructions use eax, ecx, edx, esi and edi as scratch.
+#define JIT_EAX 0
+#define JIT_ECX 1
+#define JIT_EDX 2
+#define JIT_ESI 6
+#define JIT_EDI 7
+
+static void jit_emit8(jit_t *jit, uint8_t val) {
+    jit->arena[jit->used++] = val;
+    return;
+}
+
+
+static void jit_emit16(jit_t *jit, uint16_t val) {
+    memcpy(jit->arena + jit->used, &val, sizeof(val));
+    jit->used += sizeof(val);
+    return;
+}
+
+
+static void jit_emit32(jit_t *jit, uint32_t val) {
+    memcpy(jit->arena + jit->used, &val, sizeof(val));
+    jit->used += sizeof(val);
+    return;
+}
+
+
+static void jit_emit64(jit_t *jit, uint64_t val) {
+    memcpy(jit->arena + jit->used, &val, sizeof(val));
+    jit->used += sizeof(val);
+    return;
+}
+
+
+// cmp dword [rbx+off], imm32
+static void jit_emitCmp32(jit_t *jit, uint32_t off, uint32_t imm) {
+    jit_emit8(jit, 0x81); jit_emit8(jit, 0xBB);
+    jit_emit32(jit, off); jit_emit32(jit, imm);
+    return;
+}
+
+
+// cmp byte [rbx+off], imm8
+static void jit_emitCmp8(jit_t *jit, uint32_t off, uint8_t imm) {
+    jit_emit8(jit, 0x80); jit_emit8(jit, 0xBB);
+    jit_emit32(jit, off); jit_emit8(jit, imm);
+    return;
+}
+
+
+// mov word [rbx+off], imm16
+static void jit_emitMov16(jit_t *jit, uint32_t off, uint16_t imm) {
+    jit_emit8(jit, 0x66); jit_emit8(jit, 0xC7); jit_emit8(jit, 0x83);
+    jit_emit32(jit, off); jit_emit16(jit, imm);
+    return;
+}
+
+
+// add dword [rbx+off], imm32
+static void jit_emitAdd32(jit_t *jit, uint32_t off, uint32_t imm) {
+    jit_emit8(jit, 0x81); jit_emit8(jit, 0x83);
+    jit_emit32(jit, off); jit_emit32(jit, imm);
+    return;
+}
+
+
+// movzx reg32, byte [rbx+off]
+static void jit_emitLoad8(jit_t *jit, uint8_t reg, uint32_t off) {
+    jit_emit8(jit, 0x0F); jit_emit8(jit, 0xB6); jit_emit8(jit, 0x83 | (reg << 3));
+    jit_emit32(jit, off);
+    return;
+}
+
+
+// mov byte [rbx+off], reg8
+static void jit_emitStore8(jit_t *jit, uint8_t reg, uint32_t off) {
+    // A REX prefix selects sil and dil instead of dh and bh.
+    if (reg >= JIT_ESI)
+        jit_emit8(jit, 0x40);
+    jit_emit8(jit, 0x88); jit_emit8(jit, 0x83 | (reg << 3));
+    jit_emit32(jit, off);
+    return;
+}
+
+
+// mov byte [rbx+off], imm8
+static void jit_emitMov8(jit_t *jit, uint32_t off, uint8_t imm) {
+    jit_emit8(jit, 0xC6); jit_emit8(jit, 0x83);
+    jit_emit32(jit, off); jit_emit8(jit, imm);
+    return;
+}
+
+
+// mov rdi, rbx; mov rsi, arg; mov rax, fn; call rax
+static void jit_emitCall(jit_t *jit, void *fn, uint64_t arg) {
+    jit_emit8(jit, 0x48); jit_emit8(jit, 0x89); jit_emit8(jit, 0xDF);
+    jit_emit8(jit, 0x48); jit_emit8(jit, 0xBE); jit_emit64(jit, arg);
+    jit_emit8(jit, 0x48); jit_emit8(jit, 0xB8); jit_emit64(jit, (uint64_t)fn);
+    jit_emit8(jit, 0xFF); jit_emit8(jit, 0xD0);
+    return;
+}
+
+
+// Emits a conditional near jump with the given condition code.
+// Returns the position of the displacement, see jit_patch.
+static uint32_t jit_emitJcc(jit_t *jit, uint8_t cc) {
+    jit_emit8(jit, 0x0F); jit_emit8(jit, 0x80 | cc);
+    jit_emit32(jit, 0);
+    return jit->used - 4;
+}
+
+
+// Points the jump whose displacement is at pos to the current position.
+static void jit_patch(jit_t *jit, uint32_t pos) {
+    uint32_t rel = jit->used - (pos + 4);
+    memcpy(jit->arena + pos, &rel, sizeof(rel));
+    return;
+}
+
+
+// mov eax, status; jmp leave
+static void jit_emitLeave(jit_t *jit, int32_t status) {
+    jit_emit8(jit, 0xB8); jit_emit32(jit, status);
+    jit_emit8(jit, 0xE9);
+    jit_emit32(jit, (uint32_t)(jit->leave - (jit->arena + jit->used + 4)));
+    return;
+}
+
+
+#define CC_B  0x2
+#define CC_E  0x4
+#define CC_NE 0x5
+
+
+// Emits the code to enter and leave translated blocks at the start of
+// the arena.
+static void jit_emitTrampoline(jit_t *jit) {
+    // enter(cpu, budget, code, map)
+    jit->enter = (void *)jit->arena;
+    jit_emit8(jit, 0x53);                                        // push rbx
+    jit_emit8(jit, 0x41); jit_emit8(jit, 0x54);                  // push r12
+    jit_emit8(jit, 0x41); jit_emit8(jit, 0x55);                  // push r13
+    jit_emit8(jit, 0x48); jit_emit8(jit, 0x89); jit_emit8(jit, 0xFB); // mov rbx, rdi
+    jit_emit8(jit, 0x41); jit_emit8(jit, 0x89); jit_emit8(jit, 0xF4); // mov r12d, esi
+    jit_emit8(jit, 0x49); jit_emit8(jit, 0x89); jit_emit8(jit, 0xCD); // mov r13, rcx
+    jit_emit8(jit, 0xFF); jit_emit8(jit, 0xE2);                  // jmp rdx
+
+    // The status is in eax.
+    jit->leave = jit->arena + jit->used;
+    jit_emit8(jit, 0x41); jit_emit8(jit, 0x5D);                  // pop r13
+    jit_emit8(jit, 0x41); jit_emit8(jit, 0x5C);                  // pop r12
+    jit_emit8(jit, 0x5B);                                        // pop rbx
+    jit_emit8(jit, 0xC3);                                        // ret
+    return;
+}
+
+
+#ifdef CPU_TRACE
+// Records the instruction at cpu->PC in the trace.
+static void jit_trace(cpu_t *cpu) {
+    cpu_getF(cpu);
+    cpu_traceRecord(cpu, cpu->PC, cpu->AF, cpu->BC, cpu->DE, cpu->HL,
+        cpu->SP, cpu->cycles);
+    return;
+}
+#endif
+
+
+// Sets the protection of the arena pages holding [start, start + size).
+// Returns 0 on success.
+static int32_t jit_protect(jit_t *jit, uint32_t start, uint32_t size,
+    int32_t prot) {
+
+    uint32_t page = (uint32_t)sysconf(_SC_PAGESIZE);
+    uint32_t from = start & ~(page - 1);
+    uint32_t to = start + size;
+
+    if (to > JIT_ARENA_SIZE)
+        to = JIT_ARENA_SIZE;
+    return mprotect(jit->arena + from, to - from, prot);
+}
+
+
+// Releases the arena after its protection could not be changed. The
+// emulation goes on in the interpreter.
+static void jit_disable(jit_t *jit) {
+    LOG_WARNING("Cannot change the JIT arena protection, interpreting only.\n");
+    munmap(jit->arena, JIT_ARENA_SIZE);
+    jit->arena = NULL;
+    memset(jit->map, 0, sizeof(jit->map));
+    return;
+}
+
+
+// Drops all the translated code.
+// Returns 0 on success.
+static int32_t jit_flush(jit_t *jit) {
+    memset(jit->map, 0, sizeof(jit->map));
+    jit->used = 0;
+
+    if (jit_protect(jit, 0, JIT_BLOCK_SIZE, PROT_READ | PROT_WRITE))
+        return 1;
+    jit_emitTrampoline(jit);
+    if (jit_protect(jit, 0, JIT_BLOCK_SIZE, PROT_READ | PROT_EXEC))
+        return 1;
+
+    LOG_INFO("JIT arena flushed.\n");
+    return 0;
+}
+
+
+// Offsets of the registers selected by the r and dd fields. 6 stands for
+// (HL), which is left to the handlers.
+static const uint32_t jit_reg8Off[8] = {
+    CPU_OFF(B), CPU_OFF(C), CPU_OFF(D), CPU_OFF(E),
+    CPU_OFF(H), CPU_OFF(L), 0, CPU_OFF(A)
+};
+
+static const uint32_t jit_reg16Off[4] = {
+    CPU_OFF(BC), CPU_OFF(DE), CPU_OFF(HL), CPU_OFF(SP)
+};
+
+
+#ifndef CPU_LAZYFLAGS
+// Sets F to (F & keep) | (tbl[esi] & mask), as opc_setFlagsAdd8 and the
+// other flag helpers do. Clobbers esi and edi.
+static void jit_emitSetF(jit_t *jit, const uint8_t *tbl, uint8_t keep,
+    uint8_t mask) {
+
+    jit_emit8(jit, 0x48); jit_emit8(jit, 0xBF); jit_emit64(jit, (uint64_t)tbl); // mov rdi, tbl
+    jit_emit8(jit, 0x0F); jit_emit8(jit, 0xB6);                      // movzx esi, byte [rdi+rsi]
+    jit_emit8(jit, 0x34); jit_emit8(jit, 0x37);
+    if (mask != 0xFF) {
+        jit_emit8(jit, 0x81); jit_emit8(jit, 0xE6); jit_emit32(jit, mask); // and esi, mask
+    }
+    jit_emitLoad8(jit, JIT_EDI, CPU_OFF(F));
+    jit_emit8(jit, 0x81); jit_emit8(jit, 0xE7); jit_emit32(jit, keep); // and edi, keep
+    jit_emit8(jit, 0x09); jit_emit8(jit, 0xF7);                      // or edi, esi
+    jit_emitStore8(jit, JIT_EDI, CPU_OFF(F));
+    return;
+}
+
+
+// Emits the 8-bit operation selected by bits 3-5 of opcode on A and ecx,
+// with the flags of opc_decodedALU.
+static void jit_emitALU(jit_t *jit, uint8_t opcode) {
+    uint8_t op = (opcode >> 3) & 0x07;
+
+    jit_emitLoad8(jit, JIT_EAX, CPU_OFF(A));
+    switch (op) {
+        case 0x04: // AND
+        case 0x05: // XOR
+        case 0x06: // OR
+            jit_emit8(jit, (op == 0x04) ? 0x21 : (op == 0x05) ? 0x31 : 0x09);
+            jit_emit8(jit, 0xC8);                                    // op eax, ecx
+            jit_emitStore8(jit, JIT_EAX, CPU_OFF(A));
+            jit_emit8(jit, 0x89); jit_emit8(jit, 0xC6);              // mov esi, eax
+            jit_emitSetF(jit, opc_szpTbl, FLAG_UNDOC_MASK, 0xFF);
+            if (op == 0x04) {
+                jit_emit8(jit, 0x80); jit_emit8(jit, 0x8B);          // or byte [rbx+F], H
+                jit_emit32(jit, CPU_OFF(F)); jit_emit8(jit, FLAG_HCARRY);
+            }
+            return;
+    }
+
+    // ADD, ADC, SUB, SBC and CP index the flag tables with the carry in
+    // edx, A and the operand, see FLAG_TBL_IDX.
+    if (op == 0x01 || op == 0x03) {
+        jit_emitLoad8(jit, JIT_EDX, CPU_OFF(F));
+        jit_emit8(jit, 0x83); jit_emit8(jit, 0xE2); jit_emit8(jit, FLAG_CARRY); // and edx, C
+    }
+    else {
+        jit_emit8(jit, 0x31); jit_emit8(jit, 0xD2);                  // xor edx, edx
+    }
+    jit_emit8(jit, 0x89); jit_emit8(jit, 0xD6);                      // mov esi, edx
+    jit_emit8(jit, 0xC1); jit_emit8(jit, 0xE6); jit_emit8(jit, 16);  // shl esi, 16
+    jit_emit8(jit, 0x89); jit_emit8(jit, 0xC7);                      // mov edi, eax
+    jit_emit8(jit, 0xC1); jit_emit8(jit, 0xE7); jit_emit8(jit, 8);   // shl edi, 8
+    jit_emit8(jit, 0x09); jit_emit8(jit, 0xFE);                      // or esi, edi
+    jit_emit8(jit, 0x09); jit_emit8(jit, 0xCE);                      // or esi, ecx
+    jit_emitSetF(jit, (op < 0x02) ? opc_szhvcAddTbl : opc_szhvcSubTbl,
+        FLAG_UNDOC_MASK, 0xFF);
+
+    if (op == 0x07) // CP only sets the flags.
+        return;
+    jit_emit8(jit, (op < 0x02) ? 0x01 : 0x29); jit_emit8(jit, 0xC8); // add/sub eax, ecx
+    jit_emit8(jit, (op < 0x02) ? 0x01 : 0x29); jit_emit8(jit, 0xD0); // add/sub eax, edx
+    jit_emitStore8(jit, JIT_EAX, CPU_OFF(A));
+    return;
+}
+
+
+// Emits INC r or DEC r, with the flags of opc_setFlagsInc8 and
+// opc_setFlagsDec8.
+static void jit_emitIncDec8(jit_t *jit, uint32_t off, bool is_dec) {
+    jit_emitLoad8(jit, JIT_EAX, off);
+    jit_emit8(jit, 0x89); jit_emit8(jit, 0xC6);                      // mov esi, eax
+    jit_emit8(jit, 0xC1); jit_emit8(jit, 0xE6); jit_emit8(jit, 8);   // shl esi, 8
+    jit_emit8(jit, 0x83); jit_emit8(jit, 0xCE); jit_emit8(jit, 1);   // or esi, 1
+    jit_emitSetF(jit, is_dec ? opc_szhvcSubTbl : opc_szhvcAddTbl,
+        FLAG_UNDOC_MASK | FLAG_CARRY, (uint8_t)~FLAG_CARRY);
+    jit_emit8(jit, 0xFF); jit_emit8(jit, is_dec ? 0xC8 : 0xC0);      // dec/inc eax
+    jit_emitStore8(jit, JIT_EAX, off);
+    return;
+}
+
+
+// Emits a jump to the condition-not-met path of JR cc or JP cc, cc being
+// NZ, Z, NC, C, PO, PE, P or M.
+// Returns the position of the displacement, see jit_patch.
+static uint32_t jit_emitSkipUnless(jit_t *jit, uint8_t cc) {
+    static const uint8_t flag[4] = {
+        FLAG_ZERO, FLAG_CARRY, FLAG_PARITY, FLAG_SIGN
+    };
+
+    jit_emit8(jit, 0xF6); jit_emit8(jit, 0x83);                      // test byte [rbx+F], flag
+    jit_emit32(jit, CPU_OFF(F)); jit_emit8(jit, flag[cc >> 1]);
+    return jit_emitJcc(jit, (cc & 0x1) ? CC_E : CC_NE);
+}
+#endif
+
+
+// Emits native code for the instruction if it only works on registers or
+// is a jump, next being the address of the following instruction. Fixed
+// T-states are added to *cycles, the PC is left to the caller unless a
+// jump is taken. With lazy flags, only the instructions that neither read
+// nor write F are translated.
+// Returns false, without emitting anything, if the handler has to run.
+static bool jit_emitNative(jit_t *jit, const blk_instr_t *instr, uint16_t next,
+    uint32_t *cycles) {
+
+    uint8_t op = instr->opcode;
+    uint8_t dst = (op >> 3) & 0x07;
+    uint8_t src = op & 0x07;
+
+    if (instr->prefix != 0)
+        return false;
+
+    if ((op & 0xC0) == 0x40 && dst != 6 && src != 6) { // LD r,r'
+        jit_emitLoad8(jit, JIT_EAX, jit_reg8Off[src]);
+        jit_emitStore8(jit, JIT_EAX, jit_reg8Off[dst]);
+    }
+    else if ((op & 0xC7) == 0x06 && dst != 6) // LD r,n
+        jit_emitMov8(jit, jit_reg8Off[dst], instr->operand);
+    else if ((op & 0xCF) == 0x01) // LD dd,nn
+        jit_emitMov16(jit, jit_reg16Off[op >> 4], instr->operand);
+    else if ((op & 0xC7) == 0x03) { // INC ss and DEC ss
+        jit_emit8(jit, 0x66); jit_emit8(jit, 0xFF);
+        jit_emit8(jit, (op & 0x08) ? 0x8B : 0x83);                   // dec/inc word [rbx+off]
+        jit_emit32(jit, jit_reg16Off[op >> 4]);
+    }
+    else if (op == 0x18) // JR e
+        jit_emitMov16(jit, CPU_OFF(PC), next + (int8_t)instr->operand);
+    else if (op == 0xC3) // JP nn
+        jit_emitMov16(jit, CPU_OFF(PC), instr->operand);
+    else if (op == 0x10) { // DJNZ e
+        // The T-states are added first, add changes the host flags.
+        jit_emitAdd32(jit, CPU_OFF(cycles), 8);
+        jit_emit8(jit, 0xFE); jit_emit8(jit, 0x8B);                  // dec byte [rbx+B]
+        jit_emit32(jit, CPU_OFF(B));
+        uint32_t skip = jit_emitJcc(jit, CC_E);
+        jit_emitMov16(jit, CPU_OFF(PC), next + (int8_t)instr->operand);
+        jit_emitAdd32(jit, CPU_OFF(cycles), 5);
+        jit_patch(jit, skip);
+    }
+#ifndef CPU_LAZYFLAGS
+    else if ((op & 0xC7) == 0x04 && dst != 6) // INC r
+        jit_emitIncDec8(jit, jit_reg8Off[dst], false);
+    else if ((op & 0xC7) == 0x05 && dst != 6) // DEC r
+        jit_emitIncDec8(jit, jit_reg8Off[dst], true);
+    else if ((op & 0xC0) == 0x80 && src != 6) { // ALU r
+        jit_emitLoad8(jit, JIT_ECX, jit_reg8Off[src]);
+        jit_emitALU(jit, op);
+    }
+    else if ((op & 0xC7) == 0xC6) { // ALU n
+        jit_emit8(jit, 0xB9); jit_emit32(jit, instr->operand & 0xFF); // mov ecx, n
+        jit_emitALU(jit, op);
+    }
+    else if ((op & 0xE7) == 0x20) { // JR cc,e
+        jit_emitAdd32(jit, CPU_OFF(cycles), 7);
+        uint32_t skip = jit_emitSkipUnless(jit, dst & 0x03);
+        jit_emitMov16(jit, CPU_OFF(PC), next + (int8_t)instr->operand);
+        jit_emitAdd32(jit, CPU_OFF(cycles), 5);
+        jit_patch(jit, skip);
+    }
+    else if ((op & 0xC7) == 0xC2) { // JP cc,nn
+        uint32_t skip = jit_emitSkipUnless(jit, dst);
+        jit_emitMov16(jit, CPU_OFF(PC), instr->operand);
+        jit_patch(jit, skip);
+    }
+#endif
+    else
+        return false;
+
+    *cycles += instr->TStates;
+    return true;
+}
+
+
+// Adds the T-states and instructions run since the last call to the cpu
+// counters, and clears them.
+static void jit_emitCount(jit_t *jit, uint32_t *cycles, uint32_t *count) {
+    if (*cycles)
+        jit_emitAdd32(jit, CPU_OFF(cycles), *cycles);
+    if (*count)
+        jit_emitAdd32(jit, CPU_OFF(instr), *count);
+    *cycles = 0;
+    *count = 0;
+    return;
+}
+
+
+// Translates the block starting at pc.
+// Returns its native code, or NULL if it cannot be translated.
+static uint8_t *jit_translate(cpu_t *cpu, jit_t *jit, uint16_t pc) {
+    blk_t blk;
+
+    if (blk_decode(cpu, &blk, pc))
+        return NULL;
+
+    // IO is left to the interpreter, and after EI a pending interrupt
+    // must be taken after exactly one more instruction.
+    uint8_t count = 0;
+    for (uint16_t addr = pc; count < blk.count && !jit_isIO(cpu, addr); ) {
+        uint8_t opcode = cpu_read(cpu, addr);
+        addr += blk.instr[count++].len;
+        if (opcode == 0xFB)
+            break;
+    }
+
+    if (count == 0)
+        return NULL;
+
+    if (jit->used + JIT_BLOCK_SIZE > JIT_ARENA_SIZE && jit_flush(jit)) {
+        jit_disable(jit);
+        return NULL;
+    }
+
+    uint32_t start = jit->used;
+    if (jit_protect(jit, start, JIT_BLOCK_SIZE, PROT_READ | PROT_WRITE)) {
+        jit_disable(jit);
+        return NULL;
+    }
+
+    // The decoded instructions are kept before the code, which passes them
+    // to their handlers.
+    jit->used = (jit->used + 7) & ~7;
+    blk_instr_t *decoded = (blk_instr_t *)(jit->arena + jit->used);
+    memcpy(decoded, blk.instr, count * sizeof(blk_instr_t));
+    jit->used += count * sizeof(blk_instr_t);
+
+    uint8_t *code = jit->arena + jit->used;
+    uint32_t exits[BLK_MAX_INSTR + 4];
+    int32_t exit_count = 0;
+
+    // The block is still valid and fits the budget.
+    jit_emitCmp32(jit, GEN_OFF(pc), blk.gen);
+    uint32_t stale = jit_emitJcc(jit, CC_NE);
+    jit_emit8(jit, 0x41); jit_emit8(jit, 0x81); jit_emit8(jit, 0xFC); // cmp r12d, count
+    jit_emit32(jit, count);
+    uint32_t budget = jit_emitJcc(jit, CC_B);
+    jit_emit8(jit, 0x41); jit_emit8(jit, 0x81); jit_emit8(jit, 0xEC); // sub r12d, count
+    jit_emit32(jit, count);
+
+    // T-states and instructions not yet added to the cpu counters.
+    uint32_t cycles = 0;
+    uint32_t done = 0;
+
+    uint16_t addr = pc;
+    for (int32_t i = 0; i < count; i++) {
+        const blk_instr_t *instr = &decoded[i];
+        uint16_t next = addr + instr->len;
+
+#ifdef CPU_TRACE
+        jit_emitCount(jit, &cycles, &done);
+        jit_emitMov16(jit, CPU_OFF(PC), addr);
+        jit_emitCall(jit, (void *)jit_trace, 0);
+#endif
+        // Native instructions do not touch memory, only the PC after the
+        // last one matters. Jumps end the block and overwrite it if taken.
+        uint32_t mark = jit->used;
+        if (i + 1 == count)
+            jit_emitMov16(jit, CPU_OFF(PC), next);
+        if (jit_emitNative(jit, instr, next, &cycles)) {
+            done++;
+            addr = next;
+            continue;
+        }
+        jit->used = mark;
+
+        // The handler finds the PC past the bytes it does not fetch itself.
+        jit_emitCount(jit, &cycles, &done);
+        jit_emitMov16(jit, CPU_OFF(PC), addr + instr->fetched);
+        if (instr->execute != NULL)
+            jit_emitCall(jit, (void *)instr->execute, (uint64_t)instr);
+        else
+            jit_emitCall(jit, (void *)instr->handler.op, instr->opcode);
+        cycles += instr->TStates;
+        done++;
+
+        // Leaves if the instruction wrote into the block's page.
+        if (i + 1 < count) {
+            jit_emitCount(jit, &cycles, &done);
+            jit_emitCmp32(jit, GEN_OFF(pc), blk.gen);
+            exits[exit_count++] = jit_emitJcc(jit, CC_NE);
+        }
+        addr = next;
+    }
+    jit_emitCount(jit, &cycles, &done);
+
+    // Interrupts and HALT are handled by the interpreter.
+    jit_emitCmp8(jit, CPU_OFF(is_pendingNMI), 0);
+    exits[exit_count++] = jit_emitJcc(jit, CC_NE);
+    jit_emitCmp8(jit, CPU_OFF(is_pendingMI), 0);
+    uint32_t no_mi = jit_emitJcc(jit, CC_E);
+    jit_emitCmp8(jit, CPU_OFF(IFF1), 0);
+    exits[exit_count++] = jit_emitJcc(jit, CC_NE);
+    jit_patch(jit, no_mi);
+    jit_emitCmp8(jit, CPU_OFF(halt), 0);
+    exits[exit_count++] = jit_emitJcc(jit, CC_NE);
+
+#ifndef JIT_SELFCHECK
+    // Chains to the block at the new PC, if translated.
+    jit_emit8(jit, 0x0F); jit_emit8(jit, 0xB7); jit_emit8(jit, 0x83); // movzx eax, word [rbx+PC]
+    jit_emit32(jit, CPU_OFF(PC));
+    jit_emit8(jit, 0x49); jit_emit8(jit, 0x8B); jit_emit8(jit, 0x44); // mov rax, [r13+rax*8]
+    jit_emit8(jit, 0xC5); jit_emit8(jit, 0x00);
+    jit_emit8(jit, 0x48); jit_emit8(jit, 0x85); jit_emit8(jit, 0xC0); // test rax, rax
+    exits[exit_count++] = jit_emitJcc(jit, CC_E);
+    jit_emit8(jit, 0xFF); jit_emit8(jit, 0xE0);                       // jmp rax
+#endif
+
+    for (int32_t i = 0; i < exit_count; i++)
+        jit_patch(jit, exits[i]);
+    jit_emitLeave(jit, JIT_EXIT);
+    jit_patch(jit, stale);
+    jit_emitLeave(jit, JIT_STALE);
+    jit_patch(jit, budget);
+    jit_emitLeave(jit, JIT_BUDGET);
+
+    if (jit_protect(jit, start, JIT_BLOCK_SIZE, PROT_READ | PROT_EXEC)) {
+        jit_disable(jit);
+        return NULL;
+    }
+
+    jit->map[pc] = code;
+    return code;
+}
+
+#endif // __x86_64__
+
+
+///////////////////////////////////////////////////////////
+// JIT DRIVER
+///////////////////////////////////////////////////////////
+
+// Allocates the translator of the given cpu. Without an executable arena
+// jit_emulate() only interprets.
+// Returns NULL in case of errors.
+jit_t *jit_create(cpu_t *cpu) {
+    jit_t *jit = (jit_t *)calloc(1, sizeof(jit_t));
+
+    if (jit == NULL) {
+        LOG_ERROR("Cannot allocate the JIT.\n");
+        return NULL;
+    }
+
+#if defined(__x86_64__)
+    jit->arena = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->arena == MAP_FAILED) {
+        LOG_WARNING("Cannot map the JIT arena, interpreting only.\n");
+        jit->arena = NULL;
+    }
+    else {
+        jit_emitTrampoline(jit);
+        if (jit_protect(jit, 0, JIT_ARENA_SIZE, PROT_READ | PROT_EXEC))
+            jit_disable(jit);
+    }
+#else
+    LOG_WARNING("JIT not supported on this host, interpreting only.\n");
+#endif
+
+#ifdef JIT_SELFCHECK
+    jit->shadow = jit_createShadow(cpu);
+#endif
+    return jit;
+}
+
+
+// Releases the translator.
+void jit_destroy(jit_t *jit) {
+    if (jit->arena != NULL)
+        munmap(jit->arena, JIT_ARENA_SIZE);
+
+    if (jit->shadow != NULL) {
+        cpu_destroy(jit->shadow);
+        free(jit->shadow);
+    }
+
+    free(jit);
+    return;
+}
+
+
+// Runs translated code starting at cpu->PC for at most budget instructions.
+// Returns the reason for leaving it.
+static int32_t jit_run(cpu_t *cpu, jit_t *jit, uint32_t budget, uint8_t *code) {
+#ifdef JIT_SELFCHECK
+    uint16_t pc = cpu->PC;
+    uint32_t instr = cpu->instr;
+    jit_syncShadow(cpu, jit->shadow);
+#endif
+
+    int32_t status = jit->enter(cpu, budget, code, jit->map);
+    cpu_getF(cpu);
+
+#ifdef JIT_SELFCHECK
+    for (; instr != cpu->instr; instr++)
+        cpu_emulate(jit->shadow);
+    jit_checkShadow(cpu, jit->shadow, pc);
+#endif
+    return status;
+}
+
+
+// Executes up to instr_limit instructions, running translated blocks when
+// possible and cpu_emulate() otherwise. Like thr_emulate(), it returns
+// after any IO instruction and on HALT.
+// Returns the number of executed instructions.
+uint32_t jit_emulate(cpu_t *cpu, uint32_t instr_limit) {
+    if (cpu->jit == NULL) {
+        cpu->jit = jit_create(cpu);
+        if (cpu->jit == NULL) {
+            LOG_FATAL("Cannot initialize the JIT.\n");
+            cpu_fault(cpu);
+            return 0;
+        }
+    }
+
+    // A halted cpu that cannot take an interrupt only runs NOPs.
+    if (cpu->halt && !cpu_hasInterrupt(cpu))
+        return cpu_skipHalt(cpu, instr_limit);
+
+    jit_t *jit = cpu->jit;
+    uint32_t start = cpu->instr;
+
+    while (cpu->instr - start < instr_limit) {
+        uint16_t pc = cpu->PC;
+
+#if defined(__x86_64__)
+        bool can_enter = jit->arena != NULL && !cpu->halt &&
+            !cpu_hasInterrupt(cpu);
+
+        if (can_enter) {
+            uint8_t *code = jit->map[pc];
+
+            if (code == NULL && ++jit->hits[pc] >= JIT_HOT) {
+                jit->hits[pc] = 0;
+                code = jit_translate(cpu, jit, pc);
+            }
+
+            if (code != NULL) {
+                uint32_t instr = cpu->instr;
+                uint32_t budget = instr_limit - (instr - start);
+                int32_t status = jit_run(cpu, jit, budget, code);
+
+                if (status == JIT_STALE)
+                    jit->map[cpu->PC] = NULL;
+                if (cpu->halt)
+                    break;
+                // The first block did not fit: it is interpreted instead.
+                if (status != JIT_BUDGET || cpu->instr != instr)
+                    continue;
+            }
+        }
+#endif
+
+        bool is_io = !cpu->halt && jit_isIO(cpu, pc);
+        cpu_emulate(cpu);
+        if (is_io || cpu->halt)
+            break;
+    }
+
+    cpu_getF(cpu);
+    return cpu->instr - start;
+}
@@ -1,13 +1,19 @@
+#ifndef Z80_HEADLESS
 #include <ncurses.h>
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <signal.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "logger.h"
 #include "board.h"
+#include "blkcache.h"
+#include "profiler.h"
 
 ///////////////////////////////////////////////////////////
 // Z80 CPU Emulator VERSION.
@@ -19,25 +25,111 @@
 
 static bool is_terminal = false;
 static board_t z80_sys;
+static input_t *input = NULL;
+static output_t *output = NULL;
+static const char *fusion_report = NULL;
+static const char *profile_report = NULL;
 
 
-// Exit handler in case SIGINT is received.
+// Writes the fused instruction groups report, if requested.
+static void writeFusionReport(void) {
+#ifdef CPU_FUSION
+    if (fusion_report == NULL || z80_sys.cpu == NULL)
+        return;
+
+    FILE *stream = fopen(fusion_report, "w");
+    if (stream == NULL) {
+        LOG_ERROR("Cannot open the fusion report file %s.\n", fusion_report);
+        return;
+    }
+    blk_fusionReport(z80_sys.cpu, stream);
+    fclose(stream);
+#endif
+    return;
+}
+
+
+// Writes the profiler report and, next to it with the .folded suffix, the
+// call paths for flame graph tools, if requested.
+static void writeProfile(void) {
+#ifdef CPU_PROFILE
+    if (profile_report == NULL || z80_sys.cpu == NULL ||
+        z80_sys.cpu->prof == NULL)
+        return;
+
+    FILE *stream = fopen(profile_report, "w");
+    if (stream == NULL) {
+        LOG_ERROR("Cannot open the profile file %s.\n", profile_report);
+        return;
+    }
+    prof_writeReport(z80_sys.cpu->prof, stream);
+    fclose(stream);
+
+    char *folded = (char *)malloc(strlen(profile_report) + sizeof(".folded"));
+    if (folded == NULL) {
+        LOG_ERROR("Cannot allocate the folded stacks file name.\n");
+        return;
+    }
+    strcpy(folded, profile_report);
+    strcat(folded, ".folded");
+
+    stream = fopen(folded, "w");
+    if (stream == NULL)
+        LOG_ERROR("Cannot open the folded stacks file %s.\n", folded);
+    else {
+        prof_writeFolded(z80_sys.cpu->prof, stream);
+        fclose(stream);
+    }
+    free(folded);
+#endif
+    return;
+}
+
+
+// Exit handler in case SIGINT is received. Fatal errors raise SIGINT too,
+// the instruction trace is dumped to show how the cpu got there.
 static void exitHandler(int sigNumber) {
+#ifdef CPU_TRACE
+    if (z80_sys.cpu != NULL)
+        cpu_dumpTrace(z80_sys.cpu);
+#endif
+    writeFusionReport();
+    writeProfile();
+    if (output != NULL)
+        output_flush(output);
     logger_close();
     board_destroy(&z80_sys);
+#ifndef Z80_HEADLESS
     if (is_terminal)
         endwin();
+#endif
     exit(1);
 }
 
 
+// Asks for the instruction trace when SIGUSR1 is received. Dumping it
+// is not async-signal-safe: board_emulate() does it after the slice.
+static void traceHandler(int sigNumber) {
+    z80_sys.is_traceRequested = 1;
+    return;
+}
+
+
 // Prints usage information for this program and exits.
 static void print_usage(FILE *stream, const char *this_program, int32_t exit_code) {
     fprintf(stream, "Usage: %s [OPTIONS...]\n", this_program);
     fprintf(stream, " -h --help        Display this help information.\n"
                     " -l --logfile     Output file path for logging messages.\n"
                     " -d --verb-level  Debug verbosity level.\n"
+                    " -f --fusion-report Output file path for the fusion report.\n"
+                    " -p --profile     Output file path for the profiler report.\n"
+                    " -s --symbols     Symbol map of the ROM for the profiler.\n"
                     " -t --terminal    Enables serial terminal.\n"
+                    " -i --input       Serial input file, stdin by default.\n"
+                    " -o --output      Serial output file, stdout by default.\n"
+                    " -w --idle-timeout Exits after the guest waits for input\n"
+                    "                  that long, in milliseconds.\n"
+                    " -u --turbo       Serial characters take no time.\n"
                     " -v --version     Print current version.\n");
     exit(exit_code);
 }
@@ -62,11 +154,18 @@ int main(int argc, char **argv) {
     // Parses command line options.
     const char *this_program = argv[0];
     int32_t next_option;
-    const char * const short_options = "hl:d:tv";
+    const char * const short_options = "hi:o:w:ul:d:f:p:s:tv";
     const struct option long_options[] = {
         {"help",       0, NULL, 'h'},
+        {"input",      1, NULL, 'i'},
+        {"output",     1, NULL, 'o'},
+        {"idle-timeout", 1, NULL, 'w'},
+        {"turbo",      0, NULL, 'u'},
         {"logfile",    1, NULL, 'l'},
         {"verb-level", 1, NULL, 'd'},
+        {"fusion-report", 1, NULL, 'f'},
+        {"profile",    1, NULL, 'p'},
+        {"symbols",    1, NULL, 's'},
         {"terminal",   0, NULL, 't'},
         {"version",    0, NULL, 'v'},
         { NULL,        0, NULL,  0 }
@@ -75,6 +174,11 @@ int main(int argc, char **argv) {
     // Default values for the program options.
     const char *logfile = NULL;
     int32_t debug_level = LOGGER_ERROR_LEVEL;
+    const char *symbols = NULL;
+    const char *input_file = NULL;
+    const char *output_file = NULL;
+    uint32_t idle_timeout = 0;
+    bool is_turbo = false;
 
     do {
         next_option = getopt_long(argc, argv, short_options, long_options, NULL);
@@ -82,6 +186,22 @@ int main(int argc, char **argv) {
             case 'h': // Help.
                 print_usage(stdout, this_program, 0);
 
+            case 'i': // Serial input.
+                input_file = optarg;
+                break;
+
+            case 'o': // Serial output.
+                output_file = optarg;
+                break;
+
+            case 'w': // Idle timeout.
+                idle_timeout = atoi(optarg);
+                break;
+
+            case 'u': // Turbo serial lines.
+                is_turbo = true;
+                break;
+
             case 'l': // Logging file.
                 logfile = optarg;
                 break;
@@ -90,6 +210,18 @@ int main(int argc, char **argv) {
                 debug_level = atoi(optarg);
                 break;
 
+            case 'f': // Fused instruction groups report.
+                fusion_report = optarg;
+                break;
+
+            case 'p': // Profiler report.
+                profile_report = optarg;
+                break;
+
+            case 's': // Symbol map for the profiler.
+                symbols = optarg;
+                break;
+
             case 't': // Serial terminal.
                 is_terminal = true;
                 break;
@@ -109,17 +241,40 @@ int main(int argc, char **argv) {
     } while(next_option != -1);
 
     // NCURSES initialization.
+#ifdef Z80_HEADLESS
+    bool is_terminalAsked = is_terminal;
+    is_terminal = false;
+#else
     if (is_terminal) {
         initscr();              // Initialize terminal
         cbreak();               // Set per-character buffer
         noecho();               // Do not echo characters
-        nodelay(stdscr, TRUE);  // No delay for getch function
+        typeahead(-1);          // Keys are read by the input thread
         scrollok(stdscr, TRUE); // Set auto scrolling
     }
+#endif
 
     // Initializes the logger and the verbosity level.
     logger_set_verbosity(debug_level);
     logger_open(logfile, is_terminal);
+    if (debug_level > LOGGER_MAX_LEVEL)
+        LOG_WARNING("Messages above level %d are not compiled in, "
+                    "build with DEBUG=1.\n", LOGGER_MAX_LEVEL);
+#ifdef Z80_HEADLESS
+    if (is_terminalAsked)
+        LOG_WARNING("The terminal is not compiled in, "
+                    "build without HEADLESS=1.\n");
+#endif
+#ifndef CPU_FUSION
+    if (fusion_report != NULL)
+        LOG_WARNING("Instruction fusion is not compiled in, "
+                    "build with FUSION=1.\n");
+#endif
+#ifndef CPU_PROFILE
+    if (profile_report != NULL || symbols != NULL)
+        LOG_WARNING("The profiler is not compiled in, "
+                    "build with PROFILE=1.\n");
+#endif
 
     // The user can use CTRL+C at any time to abort emulator execution.
     // The exitHandler takes care of gracefully close the program.
@@ -127,6 +282,8 @@ int main(int argc, char **argv) {
     memset(&sa, 0, sizeof(sa));
     sa.sa_handler = &exitHandler;
     sigaction(SIGINT, &sa, NULL);
+    sa.sa_handler = &traceHandler;
+    sigaction(SIGUSR1, &sa, NULL);
 
     // Board initialization.
     if (board_init(&z80_sys, ROM_PATH)) {
@@ -134,15 +291,67 @@ int main(int argc, char **argv) {
         raise(SIGINT);
     }
 
+#ifdef CPU_PROFILE
+    if (profile_report != NULL) {
+        z80_sys.cpu->prof = prof_create();
+        if (z80_sys.cpu->prof == NULL ||
+            (symbols != NULL && prof_loadSymbols(z80_sys.cpu->prof, symbols))) {
+            LOG_FATAL("Cannot initialize the profiler.\n");
+            raise(SIGINT);
+        }
+    }
+#endif
+
+    z80_sys.acia->is_turbo = is_turbo;
+
+    // Serial port: the keyboard and the curses screen with -t, otherwise
+    // the input and output files. Input that is not typed on a terminal
+    // is sent one line at a time.
+    int32_t input_fd = STDIN_FILENO;
+    FILE *output_stream = stdout;
+
+    if (input_file != NULL &&
+        (input_fd = open(input_file, O_RDONLY)) < 0) {
+        LOG_FATAL("Cannot open the input file %s.\n", input_file);
+        raise(SIGINT);
+    }
+    if (is_terminal) {
+        output_stream = NULL;
+        if (output_file != NULL)
+            LOG_WARNING("The output file is not used with -t.\n");
+    }
+    else if (output_file != NULL &&
+        (output_stream = fopen(output_file, "w")) == NULL) {
+        LOG_FATAL("Cannot open the output file %s.\n", output_file);
+        raise(SIGINT);
+    }
+
+    input = input_start(input_fd, !isatty(input_fd));
+    output = output_create(output_stream);
+    if (input == NULL || output == NULL) {
+        LOG_FATAL("Cannot start the serial port.\n");
+        raise(SIGINT);
+    }
+
     // System emulation.
-    board_emulate(&z80_sys, -1, is_terminal);
+    board_emulate(&z80_sys, -1, input, output, idle_timeout);
 
     // Board destruction.
+    writeFusionReport();
+    writeProfile();
     board_destroy(&z80_sys);
+    input_stop(input);
+    output_destroy(output);
+    if (output_stream != NULL && output_stream != stdout)
+        fclose(output_stream);
+    if (input_fd != STDIN_FILENO)
+        close(input_fd);
 
     logger_close();
+#ifndef Z80_HEADLESS
     if (is_terminal)
         endwin();
+#endif
 
     return 0;
 }
@@ -3,6 +3,33 @@
 #include "mc6850.h"
 #include "logger.h"
 
+// Bits per character for each word select value: start bit, data bits,
+// parity bit and stop bits.
+static const uint8_t mc6850_wordBits[8] = {11, 11, 10, 10, 11, 10, 11, 11};
+// Clock cycles per bit for each counter divide select value.
+static const uint8_t mc6850_divide[4] = {1, 16, 64, 1};
+
+
+// Returns true if now has reached cycle at.
+static inline bool mc6850_isDue(uint32_t at, uint32_t now) {
+    return (int32_t)(now - at) >= 0;
+}
+
+
+// Returns the T-states a character takes on the lines.
+static uint32_t mc6850_charCycles(mc6850_t *mc6850) {
+    if (mc6850->is_turbo)
+        return 0;
+    return mc6850_wordBits[(mc6850->control & CR_WORD) >> 2] *
+        mc6850_divide[mc6850->control & CR_DIVIDE];
+}
+
+
+// Returns data without the bits the word select does not carry.
+static uint8_t mc6850_mask(mc6850_t *mc6850, uint8_t data) {
+    return (mc6850->control & CR_WORD_8BIT) ? data : data & 0x7F;
+}
+
 
 // Initializes the given MC6850 ACIA.
 // Returns 0 if operation is successful.
@@ -16,34 +43,142 @@ int32_t mc6850_init(mc6850_t *mc6850) {
 
 
 // Returns the status register.
-uint8_t mc6850_getStatus(mc6850_t *mc6850) {
-    return mc6850->status;
+uint8_t mc6850_readStatus(mc6850_t *mc6850) {
+    return mc6850->status | (mc6850_hasIrq(mc6850) ? IRQ : 0);
 }
 
 
-// Sets the status register.
-void mc6850_setStatus(mc6850_t *mc6850, uint8_t data) {
-    mc6850->status = data;
+// Returns the RDR register. Reading it clears RX_FULL and RX_OVERRUN.
+uint8_t mc6850_readData(mc6850_t *mc6850) {
+    mc6850->status &= ~(RX_FULL | RX_OVERRUN);
+    return mc6850->RDR;
+}
+
+
+// Sets the control register. A master reset drops the characters on the
+// lines and clears the status register.
+void mc6850_writeControl(mc6850_t *mc6850, uint8_t data) {
+    mc6850->control = data;
+    if ((data & CR_DIVIDE) == CR_MASTER_RESET) {
+        mc6850->status = TX_EMPTY;
+        mc6850->is_txBusy = false;
+        mc6850->is_rxBusy = false;
+    }
+    return;
+}
+
+
+// Sets the TDR register. The character moves on to TSR at once if the
+// transmitter is free.
+void mc6850_writeData(mc6850_t *mc6850, uint8_t data, uint32_t now) {
+    mc6850->TDR = data;
+    mc6850->status &= ~(TX_EMPTY);
+    if (!mc6850->is_txBusy) {
+        mc6850->TSR = mc6850_mask(mc6850, data);
+        mc6850->tx_end = now + mc6850_charCycles(mc6850);
+        mc6850->is_txBusy = true;
+        mc6850->status |= TX_EMPTY;
+    }
     return;
 }
 
 
-// Returns the TDR register.
-uint8_t mc6850_getTDR(mc6850_t *mc6850) {
-    return mc6850->TDR;
+// Returns true if the IRQ line is active.
+bool mc6850_hasIrq(mc6850_t *mc6850) {
+    uint8_t control = mc6850->control;
+
+    if ((control & CR_DIVIDE) == CR_MASTER_RESET)
+        return false;
+    return ((control & CR_RX_IRQ) &&
+            (mc6850->status & (RX_FULL | RX_OVERRUN))) ||
+        ((control & CR_TX) == CR_TX_IRQ && (mc6850->status & TX_EMPTY));
 }
 
 
-// Sets the RDR register.
-void mc6850_setRDR(mc6850_t *mc6850, uint8_t data) {
-    mc6850->RDR = data;
+// Moves the character received by now, if any, to RDR. It is lost if RDR
+// is still full.
+void mc6850_update(mc6850_t *mc6850, uint32_t now) {
+    if (!mc6850->is_rxBusy || !mc6850_isDue(mc6850->rx_end, now))
+        return;
+
+    mc6850->is_rxBusy = false;
+    if (mc6850->status & RX_FULL)
+        mc6850->status |= RX_OVERRUN;
+    else {
+        mc6850->RDR = mc6850->RSR;
+        mc6850->status |= RX_FULL;
+    }
     return;
 }
 
 
+// Returns the T-states from now to the end of the next character on the
+// lines, or UINT32_MAX if there is none.
+uint32_t mc6850_nextEvent(mc6850_t *mc6850, uint32_t now) {
+    uint32_t next = UINT32_MAX;
+
+    if (mc6850->is_txBusy && !mc6850_isDue(mc6850->tx_end, now))
+        next = mc6850->tx_end - now;
+    if (mc6850->is_rxBusy && !mc6850_isDue(mc6850->rx_end, now) &&
+        mc6850->rx_end - now < next)
+        next = mc6850->rx_end - now;
+    return next;
+}
+
+
+// Returns true if a character is still on its way through the lines.
+bool mc6850_isBusy(mc6850_t *mc6850, uint32_t now) {
+    return mc6850_nextEvent(mc6850, now) != UINT32_MAX;
+}
+
+
+// Returns true if the host can start sending a character: RTS is low and
+// the receive line is free. In turbo mode, RDR must be empty as well.
+bool mc6850_canReceive(mc6850_t *mc6850) {
+    uint8_t control = mc6850->control;
+
+    if ((control & CR_DIVIDE) == CR_MASTER_RESET ||
+        (control & CR_TX) == CR_RTS_HIGH || mc6850->is_rxBusy)
+        return false;
+    return !mc6850->is_turbo || !(mc6850->status & RX_FULL);
+}
+
+
+// Starts the reception of a character sent by the host. See
+// mc6850_canReceive().
+void mc6850_receive(mc6850_t *mc6850, uint8_t data, uint32_t now) {
+    mc6850->RSR = mc6850_mask(mc6850, data);
+    mc6850->rx_end = now + mc6850_charCycles(mc6850);
+    mc6850->is_rxBusy = true;
+    mc6850_update(mc6850, now);
+    return;
+}
+
+
+// Returns true if the character in TSR has been sent and waits for the
+// host to take it with mc6850_transmit().
+bool mc6850_isSent(mc6850_t *mc6850, uint32_t now) {
+    return mc6850->is_txBusy && mc6850_isDue(mc6850->tx_end, now);
+}
+
+
+// Hands the character sent to the host, see mc6850_isSent(). The next one
+// moves from TDR to TSR, if any.
+// Returns the character.
+uint8_t mc6850_transmit(mc6850_t *mc6850, uint32_t now) {
+    uint8_t data = mc6850->TSR;
+
+    mc6850->is_txBusy = false;
+    if (!(mc6850->status & TX_EMPTY))
+        mc6850_writeData(mc6850, mc6850->TDR, now);
+    return data;
+}
+
+
 // Logs the MC6850 ACIA current status.
 void mc6850_dumpStatus(mc6850_t *mc6850) {
-    LOG_DEBUG("MC6850 RDR: 0x%02hhX, TDR: 0x%02hhX, status: 0x%02hhX\n",
-        mc6850->RDR, mc6850->TDR, mc6850->status);
+    LOG_DEBUG("MC6850 RDR: 0x%02hhX, TDR: 0x%02hhX, status: 0x%02hhX, "
+        "control: 0x%02hhX\n", mc6850->RDR, mc6850->TDR, mc6850->status,
+        mc6850->control);
     return;
 }
@@ -1,7 +1,10 @@
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <signal.h>
 
 #include "opcodes.h"
+#include "blkcache.h"
 #include "logger.h"
 
 #define FASTSWAP(X1,X2) X1 ^= X2; X2 ^= X1; X1 ^= X2
@@ -20,6 +23,13 @@ typedef enum {
 } op_t;
 
 
+// S, Z and P flags of a result.
+uint8_t opc_szpTbl[0x100];
+// Flags of ADD/ADC and SUB/SBC/CP, indexed by carry and both operands.
+uint8_t opc_szhvcAddTbl[2 * 0x100 * 0x100];
+uint8_t opc_szhvcSubTbl[2 * 0x100 * 0x100];
+
+
 // TODO: DAA is missing, pag. 173.
 // TODO: Complete IN and OUT: INIR, INDR, OTIR, OTDR.
 
@@ -108,7 +118,7 @@ static void opc_testHFlag8(cpu_t *cpu, uint8_t op1, uint8_t op2,
             break;
         default:
             LOG_FATAL("Invalid operation type.\n");
-            raise(SIGINT);
+            cpu_fault(cpu);
     }
 
     if (hc)
@@ -136,7 +146,7 @@ static void opc_testHFlag16(cpu_t *cpu, uint16_t op1, uint16_t op2,
             break;
         default:
             LOG_FATAL("Invalid operation type.\n");
-            raise(SIGINT);
+            cpu_fault(cpu);
     }
 
     if (hc)
@@ -163,7 +173,7 @@ static void opc_testVFlag8(cpu_t *cpu, uint8_t op1, uint8_t op2,
             break;
         default:
             LOG_FATAL("Invalid operation type.\n");
-            raise(SIGINT);
+            cpu_fault(cpu);
     }
 
     if (tot < -128 || tot > 127)
@@ -190,7 +200,7 @@ static void opc_testVFlag16(cpu_t *cpu, uint16_t op1, uint16_t op2,
             break;
         default:
             LOG_FATAL("Invalid operation type.\n");
-            raise(SIGINT);
+            cpu_fault(cpu);
     }
 
     if (tot < -32768 || tot > 32767)
@@ -243,7 +253,7 @@ static void opc_testCFlag8(cpu_t *cpu, uint8_t op1, uint8_t op2,
             break;
         default:
             LOG_FATAL("Invalid operation type.\n");
-            raise(SIGINT);
+            cpu_fault(cpu);
     }
     return;
 }
@@ -273,22 +283,23 @@ static void opc_testCFlag16(cpu_t *cpu, uint16_t op1, uint16_t op2,
             break;
         default:
             LOG_FATAL("Invalid operation type.\n");
-            raise(SIGINT);
+            cpu_fault(cpu);
     }
     return;
 }
 
 
 // General purpose update flags function that works for 8-bit ADDs and ADCs.
-static void opc_setFlagsAdd8(cpu_t *cpu, uint8_t op1, uint8_t op2,
-    uint8_t c, uint8_t res) {
-
-    opc_testSFlag8(cpu, res);                 /* sign flag.       */
-    opc_testZFlag8(cpu, res);                 /* zero flag.       */
-    opc_testHFlag8(cpu, op1, op2, c, IS_ADD); /* half carry flag. */
-    opc_testVFlag8(cpu, op1, op2, c, IS_ADD); /* overflow flag.   */
-    RESET_FLAG_ADDSUB(cpu);
-    opc_testCFlag8(cpu, op1, op2, c, IS_ADD); /* carry flag.      */
+static void opc_setFlagsAdd8(cpu_t *cpu, uint8_t op1, uint8_t op2, uint8_t c) {
+#ifdef CPU_LAZYFLAGS
+    cpu->flags_op = FLAGS_ADD;
+    cpu->flags_op1 = op1;
+    cpu->flags_op2 = op2;
+    cpu->flags_c = c;
+#else
+    cpu->F = (cpu->F & FLAG_UNDOC_MASK) |
+        opc_szhvcAddTbl[FLAG_TBL_IDX(c, op1, op2)];
+#endif
     return;
 }
 
@@ -308,15 +319,100 @@ static void opc_setFlagsAdd16(cpu_t *cpu, uint16_t op1, uint16_t op2,
 
 
 // General purpose update flags function that works for 8-bit SUBs and SBCs.
-static void opc_setFlagsSub8(cpu_t *cpu, uint8_t op1, uint8_t op2,
-    uint8_t c, uint8_t res) {
+static void opc_setFlagsSub8(cpu_t *cpu, uint8_t op1, uint8_t op2, uint8_t c) {
+#ifdef CPU_LAZYFLAGS
+    cpu->flags_op = FLAGS_SUB;
+    cpu->flags_op1 = op1;
+    cpu->flags_op2 = op2;
+    cpu->flags_c = c;
+#else
+    cpu->F = (cpu->F & FLAG_UNDOC_MASK) |
+        opc_szhvcSubTbl[FLAG_TBL_IDX(c, op1, op2)];
+#endif
+    return;
+}
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    opc_testHFlag8(cpu, op1, op2, c, IS_SUB);
-    opc_testVFlag8(cpu, op1, op2, c, IS_SUB);
-    SET_FLAG_ADDSUB(cpu);
-    opc_testCFlag8(cpu, op1, op2, c, IS_SUB);
+
+// Updates flags after an 8-bit increment of the given value. C is kept.
+static void opc_setFlagsInc8(cpu_t *cpu, uint8_t val) {
+#ifdef CPU_LAZYFLAGS
+    cpu_getF(cpu);
+    cpu->flags_op = FLAGS_INC;
+    cpu->flags_op1 = val;
+#else
+    cpu->F = (cpu->F & (FLAG_UNDOC_MASK | FLAG_CARRY)) |
+        (opc_szhvcAddTbl[FLAG_TBL_IDX(0, val, 1)] & ~FLAG_CARRY);
+#endif
+    return;
+}
+
+
+// Updates flags after an 8-bit decrement of the given value. C is kept.
+static void opc_setFlagsDec8(cpu_t *cpu, uint8_t val) {
+#ifdef CPU_LAZYFLAGS
+    cpu_getF(cpu);
+    cpu->flags_op = FLAGS_DEC;
+    cpu->flags_op1 = val;
+#else
+    cpu->F = (cpu->F & (FLAG_UNDOC_MASK | FLAG_CARRY)) |
+        (opc_szhvcSubTbl[FLAG_TBL_IDX(0, val, 1)] & ~FLAG_CARRY);
+#endif
+    return;
+}
+
+
+// Sets S, Z and P flags of the given result, resets N and sets H and C
+// as given. Used by logical, rotate and shift instructions.
+static void opc_setFlagsSZP8(cpu_t *cpu, uint8_t res, uint8_t flags) {
+#ifdef CPU_LAZYFLAGS
+    cpu->flags_op = FLAGS_SZP;
+    cpu->flags_op1 = res;
+    cpu->flags_op2 = flags;
+#else
+    cpu->F = (cpu->F & FLAG_UNDOC_MASK) | opc_szpTbl[res] | flags;
+#endif
+    return;
+}
+
+
+// Builds the flag lookup tables from the reference flag functions.
+// Runs once when the program or the library is loaded, before any cpu is
+// created. The tables are only read afterwards.
+static void __attribute__((constructor)) opc_initFlagTables(void) {
+    cpu_t tmp = {0};
+
+    for (int32_t val = 0; val < 0x100; val++) {
+        tmp.F = 0;
+        opc_testSFlag8(&tmp, val);
+        opc_testZFlag8(&tmp, val);
+        opc_testPFlag8(&tmp, val);
+        opc_szpTbl[val] = tmp.F;
+    }
+
+    for (int32_t c = 0; c < 2; c++) {
+        for (int32_t op1 = 0; op1 < 0x100; op1++) {
+            for (int32_t op2 = 0; op2 < 0x100; op2++) {
+                uint8_t res = op1 + op2 + c;
+                tmp.F = 0;
+                opc_testSFlag8(&tmp, res);
+                opc_testZFlag8(&tmp, res);
+                opc_testHFlag8(&tmp, op1, op2, c, IS_ADD);
+                opc_testVFlag8(&tmp, op1, op2, c, IS_ADD);
+                opc_testCFlag8(&tmp, op1, op2, c, IS_ADD);
+                opc_szhvcAddTbl[FLAG_TBL_IDX(c, op1, op2)] = tmp.F;
+
+                res = op1 - op2 - c;
+                tmp.F = 0;
+                opc_testSFlag8(&tmp, res);
+                opc_testZFlag8(&tmp, res);
+                opc_testHFlag8(&tmp, op1, op2, c, IS_SUB);
+                opc_testVFlag8(&tmp, op1, op2, c, IS_SUB);
+                SET_FLAG_ADDSUB((&tmp));
+                opc_testCFlag8(&tmp, op1, op2, c, IS_SUB);
+                opc_szhvcSubTbl[FLAG_TBL_IDX(c, op1, op2)] = tmp.F;
+            }
+        }
+    }
     return;
 }
 
@@ -325,103 +421,70 @@ static void opc_setFlagsSub8(cpu_t *cpu, uint8_t op1, uint8_t op2,
 // REGISTER ACCESS FUNCTIONS AND HELPERS
 ///////////////////////////////////////////////////////////
 
+// Offsets of the registers selected by the 3-bit r field. Register operands
+// decode into a single indexed access. 6 stands for (HL), which is decoded
+// by separate handlers, so its slot is never used.
+static const uint16_t opc_reg8Off[8] = {
+    offsetof(cpu_t, B), offsetof(cpu_t, C), offsetof(cpu_t, D),
+    offsetof(cpu_t, E), offsetof(cpu_t, H), offsetof(cpu_t, L),
+    offsetof(cpu_t, F), offsetof(cpu_t, A)
+};
+
+
+// Offsets of the registers selected by the 2-bit dd, qq, pp and rr fields,
+// indexed by reg16_t first. pp and rr are the 0xDD and 0xFD forms, where IX
+// and IY take the place of HL.
+static const uint16_t opc_reg16Off[4][4] = {
+    [REG16_QQ] = {offsetof(cpu_t, BC), offsetof(cpu_t, DE),
+        offsetof(cpu_t, HL), offsetof(cpu_t, AF)},
+    [REG16_DD] = {offsetof(cpu_t, BC), offsetof(cpu_t, DE),
+        offsetof(cpu_t, HL), offsetof(cpu_t, SP)},
+    [REG16_PP] = {offsetof(cpu_t, BC), offsetof(cpu_t, DE),
+        offsetof(cpu_t, IX), offsetof(cpu_t, SP)},
+    [REG16_RR] = {offsetof(cpu_t, BC), offsetof(cpu_t, DE),
+        offsetof(cpu_t, IY), offsetof(cpu_t, SP)}
+};
+
+
+// Returns the 8-bit register selected by the given r field.
+static inline uint8_t * opc_reg8(cpu_t *cpu, uint8_t reg) {
+    return (uint8_t *)cpu + opc_reg8Off[reg];
+}
+
+
+// Returns the 16-bit register selected by the given 2-bit field.
+static inline uint16_t * opc_reg16(cpu_t *cpu, uint8_t reg, reg16_t type) {
+    return (uint16_t *)((uint8_t *)cpu + opc_reg16Off[type][reg]);
+}
+
+
 // Writes data into a register.
-static void opc_writeReg(cpu_t *cpu, uint8_t reg, uint8_t value) {
-    switch(reg) {
-        case 0x00:
-            cpu->B = value; break;
-        case 0x01:
-            cpu->C = value; break;
-        case 0x02:
-            cpu->D = value; break;
-        case 0x03:
-            cpu->E = value; break;
-        case 0x04:
-            cpu->H = value; break;
-        case 0x05:
-            cpu->L = value; break;
-        case 0x07:
-            cpu->A = value; break;
-        default:
-            LOG_FATAL("Cannot write to unknown register (0x%02X).\n", reg);
-            raise(SIGINT);
-    }
+static inline void opc_writeReg(cpu_t *cpu, uint8_t reg, uint8_t value) {
+    *opc_reg8(cpu, reg) = value;
     return;
 }
 
 
 // Reads data from a register.
-static uint8_t opc_readReg(cpu_t *cpu, uint8_t reg) {
-    switch(reg) {
-        case 0x00:
-            return cpu->B;
-        case 0x01:
-            return cpu->C;
-        case 0x02:
-            return cpu->D;
-        case 0x03:
-            return cpu->E;
-        case 0x04:
-            return cpu->H;
-        case 0x05:
-            return cpu->L;
-        case 0x07:
-            return cpu->A;
-        default:
-            LOG_FATAL("Cannot read unknown register (0x%02X).\n", reg);
-            raise(SIGINT);
-    }
-    return 0; // Never reached.
+static inline uint8_t opc_readReg(cpu_t *cpu, uint8_t reg) {
+    return *opc_reg8(cpu, reg);
 }
 
 
-// Writes data into a 16-bit register.
-static void opc_writeReg16(cpu_t *cpu, uint8_t reg, uint16_t value, reg16_t type) {
-    switch(reg) {
-        case 0x00:
-            cpu->BC = value; break;
-        case 0x01:
-            cpu->DE = value; break;
-        case 0x02:
-            if (type == REG16_DD) {cpu->HL = value; break;}
-            if (type == REG16_QQ) {cpu->HL = value; break;}
-            if (type == REG16_PP) {cpu->IX = value; break;}
-            if (type == REG16_RR) {cpu->IY = value; break;}
-        case 0x03:
-            if (type == REG16_DD) {cpu->SP = value; break;}
-            if (type == REG16_QQ) {cpu->AF = value; break;}
-            if (type == REG16_PP) {cpu->SP = value; break;}
-            if (type == REG16_RR) {cpu->SP = value; break;}
-        default:
-            LOG_FATAL("Cannot write to unknown register (0x%02X).\n", reg);
-            raise(SIGINT);
-    }
+// Writes data into a 16-bit register. Writing AF is up to the caller, see
+// opc_POPqq.
+static inline void opc_writeReg16(cpu_t *cpu, uint8_t reg, uint16_t value,
+    reg16_t type) {
+
+    *opc_reg16(cpu, reg, type) = value;
     return;
 }
 
 
-// Reads data from a 16-bit register.
-static uint16_t opc_readReg16(cpu_t *cpu, uint8_t reg, reg16_t type) {
-    switch(reg) {
-        case 0x00:
-            return cpu->BC;
-        case 0x01:
-            return cpu->DE;
-        case 0x02:
-            if (type == REG16_DD) return cpu->HL;
-            if (type == REG16_QQ) return cpu->HL;
-            if (type == REG16_PP) return cpu->IX;
-            if (type == REG16_RR) return cpu->IY;
-        case 0x03:
-            if (type == REG16_DD) return cpu->SP;
-            if (type == REG16_QQ) return cpu->AF;
-            if (type == REG16_PP) return cpu->SP;
-            if (type == REG16_RR) return cpu->SP;
-        default:
-            LOG_FATAL("Cannot read unknown register (0x%02X).\n", reg);
-            raise(SIGINT);
-    }
-    return 0; // Never reached.
+// Reads data from a 16-bit register. Reading AF is up to the caller, see
+// opc_PUSHqq.
+static inline uint16_t opc_readReg16(cpu_t *cpu, uint8_t reg, reg16_t type) {
+    return *opc_reg16(cpu, reg, type);
 }
 
 
@@ -483,8 +546,7 @@ static char * opc_regName16(uint8_t reg, reg16_t type) {
 static void opc_LDrr(cpu_t *cpu, uint8_t opcode) {
     uint8_t dst = ((opcode >> 3) & 0x07);
     uint8_t src = (opcode & 0x07);
-    uint8_t data = opc_readReg(cpu, src);
-    opc_writeReg(cpu, dst, data);
+    *opc_reg8(cpu, dst) = *opc_reg8(cpu, src);
     LOG_DEBUG("Executed LD %s,%s\n", opc_regName8(dst), opc_regName8(src));
     return;
 }
@@ -510,1587 +572,1175 @@ static void opc_LDrHL(cpu_t *cpu, uint8_t opcode) {
 }
 
 
-static void opc_LDIX(cpu_t *cpu, uint8_t opcode) {
-    opc_tbl[0xDD].TStates = 19;
-    uint8_t next_opc = opc_fetch8(cpu);
+// Returns the name of the given index register.
+static char * opc_idxName(cpu_t *cpu, uint16_t *idx) {
+    return (idx == &cpu->IX) ? "IX" : "IY";
+}
 
-    // LD r,(IX+d) instruction.
-    if ((next_opc & 0xC7) == 0x46) {
-        uint8_t dst = ((next_opc >> 3) & 0x07);
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        opc_writeReg(cpu, dst, data);
-        LOG_DEBUG("Executed LD %s,(IX+d) IX+d=0x%04X\n", opc_regName8(dst), addr);
-    }
 
-    // LD (IX+d),r instruction.
-    else if ((next_opc & 0xF8) == 0x70) {
-        uint8_t src = (next_opc & 0x07);
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = opc_readReg(cpu, src);
-        cpu_write(cpu, data, addr);
-        LOG_DEBUG("Executed LD (IX+d),%s IX+d=0x%04X\n", addr, opc_regName8(src));
-    }
+// Fetches the displacement of an (IX+d) or (IY+d) operand and returns the
+// addressed location.
+static uint16_t opc_fetchIdxAddr(cpu_t *cpu, uint16_t *idx) {
+    int8_t d = (int8_t)opc_fetch8(cpu);
+    return *idx + d;
+}
 
-    // LD (IX+d),n instruction.
-    else if (next_opc == 0x36) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint8_t n = opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        cpu_write(cpu, n, addr);
-        LOG_DEBUG("Executed LD (IX+d),0x%02X IX+d=0x%04X\n", n, addr);
-    }
 
-    // LD IX,nn instruction.
-    else if (next_opc == 0x21) {
-        opc_tbl[0xDD].TStates = 14;
-        uint16_t nn = opc_fetch16(cpu);
-        cpu->IX = nn;
-        LOG_DEBUG("Executed LD IX,0x%04X\n", nn);
-    }
+// LD r,(IX+d) instruction.
+static void opc_LDrIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint8_t dst = ((opcode >> 3) & 0x07);
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
+    opc_writeReg(cpu, dst, data);
+    LOG_DEBUG("Executed LD %s,(%s+d) addr=0x%04X\n", opc_regName8(dst),
+        opc_idxName(cpu, idx), addr);
+    return;
+}
 
-    // LD IX,(nn) instruction.
-    else if (next_opc == 0x2A) {
-        opc_tbl[0xDD].TStates = 20;
-        uint16_t addr = opc_fetch16(cpu);
-        cpu->IX = (cpu_read(cpu, addr) | (cpu_read(cpu, addr + 1) << 8));
-        LOG_DEBUG("Executed LD IX,(0x%04X)\n", addr);
-    }
 
-    // LD (nn),IX instruction.
-    else if (next_opc == 0x22) {
-        opc_tbl[0xDD].TStates = 20;
-        uint16_t addr = opc_fetch16(cpu);
-        cpu_write(cpu, (cpu->IX & 0xFF), addr);
-        cpu_write(cpu, ((cpu->IX >> 8) & 0xFF), addr + 1);
-        LOG_DEBUG("Executed LD (0x%04X),IX\n", addr);
-    }
+// LD (IX+d),r instruction.
+static void opc_LDIdxr(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint8_t src = (opcode & 0x07);
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = opc_readReg(cpu, src);
+    cpu_write(cpu, data, addr);
+    LOG_DEBUG("Executed LD (%s+d),%s addr=0x%04X\n", opc_idxName(cpu, idx),
+        opc_regName8(src), addr);
+    return;
+}
 
-    // LD SP,IX instruction.
-    else if (next_opc == 0xF9) {
-        opc_tbl[0xDD].TStates = 10;
-        cpu->SP = cpu->IX;
-        LOG_DEBUG("Executed LD SP,IX\n");
-    }
 
-    // PUSH IX instruction.
-    else if (next_opc == 0xE5) {
-        opc_tbl[0xDD].TStates = 15;
-        cpu_stackPush(cpu, cpu->IX);
-        LOG_DEBUG("Executed PUSH IX\n");
-    }
+// LD (IX+d),n instruction.
+static void opc_LDIdxn(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t n = opc_fetch8(cpu);
+    cpu_write(cpu, n, addr);
+    LOG_DEBUG("Executed LD (%s+d),0x%02X addr=0x%04X\n", opc_idxName(cpu, idx),
+        n, addr);
+    return;
+}
 
-    // POP IX instruction.
-    else if (next_opc == 0xE1) {
-        opc_tbl[0xDD].TStates = 14;
-        cpu->IX = cpu_stackPop(cpu);
-        LOG_DEBUG("POP IX\n");
-    }
 
-    // EX (SP),IX instruction.
-    else if (next_opc == 0xE3) {
-        opc_tbl[0xDD].TStates = 23;
-        uint8_t valSPL = cpu_read(cpu, cpu->SP);
-        uint8_t valSPH = cpu_read(cpu, cpu->SP + 1);
-        cpu_write(cpu, (cpu->IX & 0xFF), cpu->SP);
-        cpu_write(cpu, ((cpu->IX >> 8) & 0xFF), cpu->SP + 1);
-        cpu->IX = (valSPL | (valSPH << 8));
-        LOG_DEBUG("Executed EX (SP),IX SP=0x%04X\n", cpu->SP);
-    }
+// LD IX,nn instruction.
+static void opc_LDXYnn(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t nn = opc_fetch16(cpu);
+    *idx = nn;
+    LOG_DEBUG("Executed LD %s,0x%04X\n", opc_idxName(cpu, idx), nn);
+    return;
+}
 
-    // ADD A,(IX+d) instruction.
-    else if (next_opc == 0x86) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A + data;
 
-        opc_setFlagsAdd8(cpu, cpu->A, data, 0, res);
+// LD IX,(nn) instruction.
+static void opc_LDXYMnn(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetch16(cpu);
+    *idx = (cpu_read(cpu, addr) | (cpu_read(cpu, addr + 1) << 8));
+    LOG_DEBUG("Executed LD %s,(0x%04X)\n", opc_idxName(cpu, idx), addr);
+    return;
+}
+
 
-        cpu->A = res;
-        LOG_DEBUG("Executed ADD A,(IX+d) IX+d=0x%04X\n", addr);
-    }
+// LD (nn),IX instruction.
+static void opc_LDMnnXY(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetch16(cpu);
+    cpu_write(cpu, (*idx & 0xFF), addr);
+    cpu_write(cpu, ((*idx >> 8) & 0xFF), addr + 1);
+    LOG_DEBUG("Executed LD (0x%04X),%s\n", addr, opc_idxName(cpu, idx));
+    return;
+}
 
-    // ADC A,(IX+d) instruction.
-    else if (next_opc == 0x8E) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t c = GET_FLAG_CARRY(cpu);
-        uint8_t res = cpu->A + data + c;
 
-        opc_setFlagsAdd8(cpu, cpu->A, data, c, res);
+// LD SP,IX instruction.
+static void opc_LDSPXY(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    cpu->SP = *idx;
+    LOG_DEBUG("Executed LD SP,%s\n", opc_idxName(cpu, idx));
+    return;
+}
 
-        cpu->A = res;
-        LOG_DEBUG("Executed ADC A,(IX+d) IX+d=0x%04X\n", addr);
-    }
 
-    // SUB A,(IX+d) instruction.
-    else if (next_opc == 0x96) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A - data;
+// PUSH IX instruction.
+static void opc_PUSHXY(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    cpu_stackPush(cpu, *idx);
+    LOG_DEBUG("Executed PUSH %s\n", opc_idxName(cpu, idx));
+    return;
+}
 
-        opc_setFlagsSub8(cpu, cpu->A, data, 0, res);
 
-        cpu->A = res;
-        LOG_DEBUG("Executed SUB A,(IX+d) IX+d=0x%04X\n", addr);
-    }
+// POP IX instruction.
+static void opc_POPXY(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    *idx = cpu_stackPop(cpu);
+    LOG_DEBUG("Executed POP %s\n", opc_idxName(cpu, idx));
+    return;
+}
 
-    // SBC A,(IX+d) instruction.
-    else if (next_opc == 0x9E) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t c = GET_FLAG_CARRY(cpu);
-        uint8_t res = cpu->A - data - c;
 
-        opc_setFlagsSub8(cpu, cpu->A, data, c, res);
+// EX (SP),IX instruction.
+static void opc_EXSPXY(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint8_t valSPL = cpu_read(cpu, cpu->SP);
+    uint8_t valSPH = cpu_read(cpu, cpu->SP + 1);
+    cpu_write(cpu, (*idx & 0xFF), cpu->SP);
+    cpu_write(cpu, ((*idx >> 8) & 0xFF), cpu->SP + 1);
+    *idx = (valSPL | (valSPH << 8));
+    LOG_DEBUG("Executed EX (SP),%s SP=0x%04X\n", opc_idxName(cpu, idx), cpu->SP);
+    return;
+}
 
-        cpu->A = res;
-        LOG_DEBUG("Executed SBC A,(IX+d) IX+d=0x%04X\n", addr);
-    }
 
-    // AND (IX+d) instruction.
-    else if (next_opc == 0xA6) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A & data;
+// ADD A,(IX+d) instruction.
+static void opc_ADDAIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t res = cpu->A + data;
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        SET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
-        RESET_FLAG_CARRY(cpu);
+    opc_setFlagsAdd8(cpu, cpu->A, data, 0);
 
-        cpu->A = res;
-        LOG_DEBUG("Executed AND (IX+d) IX+d=0x%04X\n", addr);
-    }
+    cpu->A = res;
+    LOG_DEBUG("Executed ADD A,(%s+d) addr=0x%04X\n", opc_idxName(cpu, idx), addr);
+    return;
+}
 
-    // OR (IX+d) instruction.
-    else if (next_opc == 0xB6) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A | data;
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
-        RESET_FLAG_CARRY(cpu);
+// ADC A,(IX+d) instruction.
+static void opc_ADCAIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t c = GET_FLAG_CARRY(cpu);
+    uint8_t res = cpu->A + data + c;
 
-        cpu->A = res;
-        LOG_DEBUG("Executed OR (IX+d) IX+d=0x%04X\n", addr);
-    }
+    opc_setFlagsAdd8(cpu, cpu->A, data, c);
 
-    // XOR (IX+d) instruction.
-    else if (next_opc == 0xAE) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A ^ data;
+    cpu->A = res;
+    LOG_DEBUG("Executed ADC A,(%s+d) addr=0x%04X\n", opc_idxName(cpu, idx), addr);
+    return;
+}
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
-        RESET_FLAG_CARRY(cpu);
 
-        cpu->A = res;
-        LOG_DEBUG("Executed XOR (IX+d) IX+d=0x%04X\n", addr);
-    }
+// SUB A,(IX+d) instruction.
+static void opc_SUBAIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t res = cpu->A - data;
 
-    // CP (IX+d) instruction.
-    else if (next_opc == 0xBE) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A - data;
+    opc_setFlagsSub8(cpu, cpu->A, data, 0);
 
-        opc_setFlagsSub8(cpu, cpu->A, data, 0, res);
+    cpu->A = res;
+    LOG_DEBUG("Executed SUB A,(%s+d) addr=0x%04X\n", opc_idxName(cpu, idx), addr);
+    return;
+}
 
-        LOG_DEBUG("Executed CP (IX+d) IX+d=0x%04X\n", addr);
-    }
 
-    // INC (IX+d) instruction.
-    else if (next_opc == 0x34) {
-        opc_tbl[0xDD].TStates = 23;
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = data + 1;
-
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        opc_testHFlag8(cpu, data, 1, 0, IS_ADD);
-        RESET_FLAG_ADDSUB(cpu);
-
-        if (data == 0x7F)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
-
-        cpu_write(cpu, res, addr);
-        LOG_DEBUG("Executed INC (IX+d) IX+d=0x%04X\n", addr);
-    }
+// SBC A,(IX+d) instruction.
+static void opc_SBCAIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t c = GET_FLAG_CARRY(cpu);
+    uint8_t res = cpu->A - data - c;
 
-    // DEC (IX+d) instruction.
-    else if (next_opc == 0x35) {
-        opc_tbl[0xDD].TStates = 23;
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IX + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = data - 1;
-
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        opc_testHFlag8(cpu, data, 1, 0, IS_SUB);
-        SET_FLAG_ADDSUB(cpu);
-
-        if (data == 0x80)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
-
-        cpu_write(cpu, res, addr);
-        LOG_DEBUG("Executed DEC (IX+d) IX+d=0x%04X\n", addr);
-    }
+    opc_setFlagsSub8(cpu, cpu->A, data, c);
 
-    // ADD IX,pp instruction.
-    else if ((next_opc & 0xCF) == 0x09) {
-        opc_tbl[0xDD].TStates = 15;
-        uint8_t src = ((next_opc >> 4) & 0x03);
-        uint16_t data = opc_readReg16(cpu, src, REG16_PP);
-        uint16_t res = cpu->IX + data;
+    cpu->A = res;
+    LOG_DEBUG("Executed SBC A,(%s+d) addr=0x%04X\n", opc_idxName(cpu, idx), addr);
+    return;
+}
 
-        opc_testHFlag16(cpu, cpu->IX, data, 0, IS_ADD);
-        RESET_FLAG_ADDSUB(cpu);
-        opc_testCFlag16(cpu, cpu->IX, data, 0, IS_ADD);
 
-        cpu->IX = res;
-        LOG_DEBUG("Executed ADD IX,%s\n", opc_regName16(src, REG16_PP));
-    }
+// AND (IX+d) instruction.
+static void opc_ANDIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t res = cpu->A & data;
 
-    // INC IX instruction.
-    else if (next_opc == 0x23) {
-        opc_tbl[0xDD].TStates = 10;
-        cpu->IX++;
-        LOG_DEBUG("Executed INC IX\n");
-    }
+    opc_setFlagsSZP8(cpu, res, FLAG_HCARRY);
 
-    // DEC IX instruction.
-    else if (next_opc == 0x2B) {
-        opc_tbl[0xDD].TStates = 10;
-        cpu->IX--;
-        LOG_DEBUG("Executed DEC IX\n");
-    }
+    cpu->A = res;
+    LOG_DEBUG("Executed AND (%s+d) addr=0x%04X\n", opc_idxName(cpu, idx), addr);
+    return;
+}
 
-    // JP (IX) instruction.
-    else if (next_opc == 0xE9) {
-        opc_tbl[0xDD].TStates = 8;
-        cpu->PC = cpu->IX;
-        LOG_DEBUG("Executed JP (IX) IX=0x%04X\n", cpu->IX);
-    }
 
-    else if (next_opc == 0xCB) {
-        int8_t d = (int8_t)opc_fetch8(cpu); // 3rd instruction byte.
-        uint16_t addr = cpu->IX + d;
-        uint8_t controlByte = opc_fetch8(cpu); // 4th instruction byte.
+// OR (IX+d) instruction.
+static void opc_ORIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t res = cpu->A | data;
 
-        // RLC (IX+d) instruction.
-        if (controlByte == 0x06) {
-            opc_tbl[0xDD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t msb = (data & 0x80) >> 7;
-            uint8_t res = ((data << 1) | msb);
+    opc_setFlagsSZP8(cpu, res, 0);
 
-            if (msb)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+    cpu->A = res;
+    LOG_DEBUG("Executed OR (%s+d) addr=0x%04X\n", opc_idxName(cpu, idx), addr);
+    return;
+}
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed RLC (IX+d) IX+d=0x%04X\n", addr);
-        }
+// XOR (IX+d) instruction.
+static void opc_XORIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t res = cpu->A ^ data;
 
-        // BIT b,(IX+d) instruction.
-        else if ((controlByte & 0xC7) == 0x46) {
-            opc_tbl[0xDD].TStates = 20;
-            uint8_t bit = ((controlByte >> 3) & 0x07);
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t res = ((data >> bit) & 0x1);
+    opc_setFlagsSZP8(cpu, res, 0);
 
-            opc_testZFlag8(cpu, res);
-            SET_FLAG_HCARRY(cpu);
-            RESET_FLAG_ADDSUB(cpu);
+    cpu->A = res;
+    LOG_DEBUG("Executed XOR (%s+d) addr=0x%04X\n", opc_idxName(cpu, idx), addr);
+    return;
+}
 
-            LOG_DEBUG("Executed BIT %d,(IX+d) IX+d=0x%04X\n", bit, addr);
-        }
 
-        // SET b,(IX+d) instruction.
-        else if ((controlByte & 0xC7) == 0xC6) {
-            opc_tbl[0xDD].TStates = 23;
-            uint8_t bit = ((controlByte >> 3) & 0x07);
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t res = data | (1 << bit);
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed SET %d,(IX+d) IX+d=0x%04X\n", bit, addr);
-        }
+// CP (IX+d) instruction.
+static void opc_CPIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
 
-        // RES b,(IX+d) instruction.
-        else if ((controlByte & 0xC7) == 0x86) {
-            opc_tbl[0xDD].TStates = 23;
-            uint8_t bit = ((controlByte >> 3) & 0x07);
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t res = data & ~(1 << bit);
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed RES %d,(IX+d) IX+d=0x%04X\n", bit, addr);
-        }
+    opc_setFlagsSub8(cpu, cpu->A, data, 0);
 
-        // RL (IX+d) instruction.
-        else if (controlByte == 0x16) {
-            opc_tbl[0xDD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t c = GET_FLAG_CARRY(cpu);
+    LOG_DEBUG("Executed CP (%s+d) addr=0x%04X\n", opc_idxName(cpu, idx), addr);
+    return;
+}
 
-            // MSB in carry flag.
-            if (data & 0x80)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
 
-            uint8_t res = ((data << 1) | c);
+// INC (IX+d) instruction.
+static void opc_INCIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t res = data + 1;
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
+    opc_setFlagsInc8(cpu, data);
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed RL (IX+d) IX+d=0x%04X\n", addr);
-        }
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed INC (%s+d) addr=0x%04X\n", opc_idxName(cpu, idx), addr);
+    return;
+}
 
-        // RRC (IX+d) instruction.
-        else if (controlByte == 0x0E) {
-            opc_tbl[0xDD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t lsb = (data & 0x1);
 
-            // LSB in carry flag.
-            if (lsb)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+// DEC (IX+d) instruction.
+static void opc_DECIdx(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t res = data - 1;
 
-            uint8_t res = ((data >> 1) | (lsb << 7));
+    opc_setFlagsDec8(cpu, data);
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed DEC (%s+d) addr=0x%04X\n", opc_idxName(cpu, idx), addr);
+    return;
+}
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed RRC (IX+d) IX+d=0x%04X\n", addr);
-        }
 
-        // RR (IX+d) instruction.
-        else if (controlByte == 0x1E) {
-            opc_tbl[0xDD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t c = GET_FLAG_CARRY(cpu);
+// ADD IX,pp and ADD IY,rr instructions.
+static void opc_ADDXYpp(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    reg16_t type = (idx == &cpu->IX) ? REG16_PP : REG16_RR;
+    uint8_t src = ((opcode >> 4) & 0x03);
+    uint16_t data = opc_readReg16(cpu, src, type);
+    uint16_t res = *idx + data;
 
-            // LSB in carry flag.
-            if (data & 0x1)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+    opc_testHFlag16(cpu, *idx, data, 0, IS_ADD);
+    RESET_FLAG_ADDSUB(cpu);
+    opc_testCFlag16(cpu, *idx, data, 0, IS_ADD);
 
-            uint8_t res = ((data >> 1) | (c << 7));
+    *idx = res;
+    LOG_DEBUG("Executed ADD %s,%s\n", opc_idxName(cpu, idx),
+        opc_regName16(src, type));
+    return;
+}
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed RR (IX+d) IX+d=0x%04X\n", addr);
-        }
+// INC IX instruction.
+static void opc_INCXY(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    (*idx)++;
+    LOG_DEBUG("Executed INC %s\n", opc_idxName(cpu, idx));
+    return;
+}
 
-        // SLA (IX+d) instruction.
-        else if (controlByte == 0x26) {
-            opc_tbl[0xDD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
 
-            // MSB in carry bit
-            if (data & 0x80)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+// DEC IX instruction.
+static void opc_DECXY(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    (*idx)--;
+    LOG_DEBUG("Executed DEC %s\n", opc_idxName(cpu, idx));
+    return;
+}
 
-            uint8_t res = (data << 1);
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
+// JP (IX) instruction.
+static void opc_JPXY(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    cpu->PC = *idx;
+    LOG_DEBUG("Executed JP (%s) %s=0x%04X\n", opc_idxName(cpu, idx),
+        opc_idxName(cpu, idx), *idx);
+    return;
+}
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed SLA (IX+d) IX+d=0x%04X\n", addr);
-        }
 
-        // SRA (IX+d) instruction.
-        else if (controlByte == 0x2E) {
-            opc_tbl[0xDD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t msb = (data & 0x80);
-            uint8_t lsb = (data & 0x1);
+// Undefined instruction in the 0xDD/0xFD instruction groups.
+static void opc_invalidXY(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    LOG_FATAL("Invalid operation in 0x%s instruction group.\n",
+        (idx == &cpu->IX) ? "DD" : "FD");
+    cpu_fault(cpu);
+    return;
+}
 
-            // LSB in carry flag.
-            if (lsb)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
 
-            uint8_t res = ((data >> 1) | msb);
+// DDCB and FDCB prefixes: the displacement comes before the opcode, which
+// selects the instruction in opc_tblXYCB.
+static void opc_XYCB(cpu_t *cpu, uint16_t *idx, uint8_t opcode) {
+    uint16_t addr = opc_fetchIdxAddr(cpu, idx); // 3rd instruction byte.
+    uint8_t controlByte = opc_fetch8(cpu); // 4th instruction byte.
+    opc_tblXYCB[controlByte].execute(cpu, addr, controlByte);
+    cpu->cycles += opc_tblXYCB[controlByte].TStates;
+    return;
+}
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed SRA (IX+d) IX+d=0x%04X\n", addr);
-        }
+// RLC (IX+d) instruction.
+static void opc_RLCIdx(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t msb = (data & 0x80) >> 7;
+    uint8_t res = ((data << 1) | msb);
 
-        // SRL (IX+d) instruction.
-        else if (controlByte == 0x3E) {
-            opc_tbl[0xDD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
+    opc_setFlagsSZP8(cpu, res, msb);
 
-            // LSB in carry flag.
-            if (data & 0x1)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed RLC (IX/IY+d) addr=0x%04X\n", addr);
+    return;
+}
 
-            uint8_t res = (data >> 1);
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
+// RRC (IX+d) instruction.
+static void opc_RRCIdx(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t lsb = (data & 0x1);
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed SRL (IX+d) IX+d=0x%04X\n", addr);
-        }
+    uint8_t res = ((data >> 1) | (lsb << 7));
 
-        else {
-            LOG_FATAL("Invalid instruction in IX BIT, SET, RESET group or "
-                "in Rotate and Shift group.\n");
-            raise(SIGINT);
-        }
-    }
+    opc_setFlagsSZP8(cpu, res, lsb);
 
-    else {
-        LOG_FATAL("Invalid operation in 0xDD instruction group.\n");
-        raise(SIGINT);
-    }
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed RRC (IX/IY+d) addr=0x%04X\n", addr);
+    return;
 }
 
 
-static void opc_LDIY(cpu_t *cpu, uint8_t opcode) {
-    opc_tbl[0xFD].TStates = 19;
-    uint8_t next_opc = opc_fetch8(cpu);
-
-    // LD r,(IY+d) instruction.
-    if ((next_opc & 0xC7) == 0x46) {
-        uint8_t dst = ((next_opc >> 3) & 0x07);
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        opc_writeReg(cpu, dst, data);
-        LOG_DEBUG("Executed LD %s,(IY+d) IY+d=0x%04X\n", opc_regName8(dst), addr);
-    }
+// RL (IX+d) instruction.
+static void opc_RLIdx(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t c = GET_FLAG_CARRY(cpu);
 
-    // LD (IY+d),r instruction.
-    else if ((next_opc & 0xF8) == 0x70) {
-        uint8_t src = (next_opc & 0x07);
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = opc_readReg(cpu, src);
-        cpu_write(cpu, data, addr);
-        LOG_DEBUG("Executed LD (IY+d),%s IY+d=0x%04X\n", addr, opc_regName8(src));
-    }
+    uint8_t res = ((data << 1) | c);
 
-    // LD (IY+d),n instruction.
-    else if (next_opc == 0x36) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint8_t n = opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        cpu_write(cpu, n, addr);
-        LOG_DEBUG("Executed LD (IY+d),0x%02X IY+d=0x%04X\n", n, addr);
-    }
+    opc_setFlagsSZP8(cpu, res, (data >> 7));
 
-    // LD IY,nn instruction.
-    else if (next_opc == 0x21) {
-        opc_tbl[0xFD].TStates = 14;
-        uint16_t nn = opc_fetch16(cpu);
-        cpu->IY = nn;
-        LOG_DEBUG("Executed LD IY,0x%04X\n", nn);
-    }
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed RL (IX/IY+d) addr=0x%04X\n", addr);
+    return;
+}
 
-    // LD IY,(nn) instruction.
-    else if (next_opc == 0x2A) {
-        opc_tbl[0xFD].TStates = 20;
-        uint16_t addr = opc_fetch16(cpu);
-        cpu->IY = (cpu_read(cpu, addr) | (cpu_read(cpu, addr + 1) << 8));
-        LOG_DEBUG("Executed LD IY,(0x%04X)\n", addr);
-    }
 
-    // LD (nn),IY instruction.
-    else if (next_opc == 0x22) {
-        opc_tbl[0xFD].TStates = 20;
-        uint16_t addr = opc_fetch16(cpu);
-        cpu_write(cpu, (cpu->IY & 0xFF), addr);
-        cpu_write(cpu, ((cpu->IY >> 8) & 0xFF), addr + 1);
-        LOG_DEBUG("Executed LD (0x%04X),IY\n", addr);
-    }
+// RR (IX+d) instruction.
+static void opc_RRIdx(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t c = GET_FLAG_CARRY(cpu);
 
-    // LD SP,IY instruction.
-    else if (next_opc == 0xF9) {
-        opc_tbl[0xFD].TStates = 10;
-        cpu->SP = cpu->IY;
-        LOG_DEBUG("Executed LD SP,IY\n");
-    }
+    uint8_t res = ((data >> 1) | (c << 7));
 
-    // PUSH IY instruction.
-    else if (next_opc == 0xE5) {
-        opc_tbl[0xFD].TStates = 15;
-        cpu_stackPush(cpu, cpu->IY);
-        LOG_DEBUG("Executed PUSH IY\n");
-    }
+    opc_setFlagsSZP8(cpu, res, (data & 0x1));
 
-    // POP IY instruction.
-    else if (next_opc == 0xE1) {
-        opc_tbl[0xFD].TStates = 14;
-        cpu->IY = cpu_stackPop(cpu);
-        LOG_DEBUG("POP IY\n");
-    }
-
-    // EX (SP),IY instruction.
-    else if (next_opc == 0xE3) {
-        opc_tbl[0xFD].TStates = 23;
-        uint8_t valSPL = cpu_read(cpu, cpu->SP);
-        uint8_t valSPH = cpu_read(cpu, cpu->SP + 1);
-        cpu_write(cpu, (cpu->IY & 0xFF), cpu->SP);
-        cpu_write(cpu, ((cpu->IY >> 8) & 0xFF), cpu->SP + 1);
-        cpu->IY = (valSPL | (valSPH << 8));
-        LOG_DEBUG("Executed EX (SP),IY SP=0x%04X\n", cpu->SP);
-    }
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed RR (IX/IY+d) addr=0x%04X\n", addr);
+    return;
+}
 
-    // ADD A,(IY+d) instruction.
-    else if (next_opc == 0x86){
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A + data;
 
-        opc_setFlagsAdd8(cpu, cpu->A, data, 0, res);
+// SLA (IX+d) instruction.
+static void opc_SLAIdx(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, addr);
 
-        cpu->A = res;
-        LOG_DEBUG("Executed ADD A,(IY+d) IY+d=0x%04X\n", addr);
-    }
+    uint8_t res = (data << 1);
 
-    // ADC A,(IY+d) instruction.
-    else if (next_opc == 0x8E){
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t c = GET_FLAG_CARRY(cpu);
-        uint8_t res = cpu->A + data + c;
+    opc_setFlagsSZP8(cpu, res, (data >> 7));
 
-        opc_setFlagsAdd8(cpu, cpu->A, data, c, res);
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed SLA (IX/IY+d) addr=0x%04X\n", addr);
+    return;
+}
 
-        cpu->A = res;
-        LOG_DEBUG("Executed ADC A,(IY+d) IY+d=0x%04X\n", addr);
-    }
 
-    // SUB A,(IY+d) instruction.
-    else if (next_opc == 0x96) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A - data;
+// SRA (IX+d) instruction.
+static void opc_SRAIdx(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t msb = (data & 0x80);
+    uint8_t lsb = (data & 0x1);
 
-        opc_setFlagsSub8(cpu, cpu->A, data, 0, res);
+    uint8_t res = ((data >> 1) | msb);
 
-        cpu->A = res;
-        LOG_DEBUG("Executed SUB A,(IY+d) IY+d=0x%04X\n", addr);
-    }
+    opc_setFlagsSZP8(cpu, res, lsb);
 
-    // SBC A,(IY+d) instruction.
-    else if (next_opc == 0x9E) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t c = GET_FLAG_CARRY(cpu);
-        uint8_t res = cpu->A - data - c;
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed SRA (IX/IY+d) addr=0x%04X\n", addr);
+    return;
+}
 
-        opc_setFlagsSub8(cpu, cpu->A, data, c, res);
 
-        cpu->A = res;
-        LOG_DEBUG("Executed SBC A,(IY+d) IY+d=0x%04X\n", addr);
-    }
+// SRL (IX+d) instruction.
+static void opc_SRLIdx(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, addr);
 
-    // AND (IY+d) instruction.
-    else if (next_opc == 0xA6) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A & data;
+    uint8_t res = (data >> 1);
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        SET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
-        RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, (data & 0x1));
 
-        cpu->A = res;
-        LOG_DEBUG("Executed AND (IY+d) IY+d=0x%04X\n", addr);
-    }
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed SRL (IX/IY+d) addr=0x%04X\n", addr);
+    return;
+}
 
-    // OR (IY+d) instruction.
-    else if (next_opc == 0xB6) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A | data;
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
-        RESET_FLAG_CARRY(cpu);
+// BIT b,(IX+d) instruction.
+static void opc_BITbIdx(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    uint8_t bit = ((opcode >> 3) & 0x07);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t res = ((data >> bit) & 0x1);
 
-        cpu->A = res;
-        LOG_DEBUG("Executed OR (IY+d) IY+d=0x%04X\n", addr);
-    }
+    opc_testZFlag8(cpu, res);
+    SET_FLAG_HCARRY(cpu);
+    RESET_FLAG_ADDSUB(cpu);
 
-    // XOR (IY+d) instruction.
-    else if (next_opc == 0xAE) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A ^ data;
+    LOG_DEBUG("Executed BIT %d,(IX/IY+d) addr=0x%04X\n", bit, addr);
+    return;
+}
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
-        RESET_FLAG_CARRY(cpu);
 
-        cpu->A = res;
-        LOG_DEBUG("Executed XOR (IY+d) IY+d=0x%04X\n", addr);
-    }
+// SET b,(IX+d) instruction.
+static void opc_SETbIdx(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    uint8_t bit = ((opcode >> 3) & 0x07);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t res = data | (1 << bit);
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed SET %d,(IX/IY+d) addr=0x%04X\n", bit, addr);
+    return;
+}
 
-    // CP (IY+d) instruction.
-    else if (next_opc == 0xBE) {
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = cpu->A - data;
 
-        opc_setFlagsSub8(cpu, cpu->A, data, 0, res);
+// RES b,(IX+d) instruction.
+static void opc_RESbIdx(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    uint8_t bit = ((opcode >> 3) & 0x07);
+    uint8_t data = cpu_read(cpu, addr);
+    uint8_t res = data & ~(1 << bit);
+    cpu_write(cpu, res, addr);
+    LOG_DEBUG("Executed RES %d,(IX/IY+d) addr=0x%04X\n", bit, addr);
+    return;
+}
 
-        LOG_DEBUG("Executed CP (IY+d) IY+d=0x%04X\n", addr);
-    }
 
-    // INC (IY+d) instruction.
-    else if (next_opc == 0x34) {
-        opc_tbl[0xFD].TStates = 23;
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = data + 1;
-
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        opc_testHFlag8(cpu, data, 1, 0, IS_ADD);
-        RESET_FLAG_ADDSUB(cpu);
-
-        if (data == 0x7F)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
-
-        cpu_write(cpu, res, addr);
-        LOG_DEBUG("Executed INC (IY+d) IY+d=0x%04X\n", addr);
-    }
+// Undefined instruction in the 0xDDCB/0xFDCB instruction groups.
+static void opc_invalidXYCB(cpu_t *cpu, uint16_t addr, uint8_t opcode) {
+    LOG_FATAL("Invalid instruction in IX/IY BIT, SET, RESET group or "
+        "in Rotate and Shift group.\n");
+    cpu_fault(cpu);
+    return;
+}
 
-    // DEC (IY+d) instruction.
-    else if (next_opc == 0x35) {
-        opc_tbl[0xFD].TStates = 23;
-        int8_t d = (int8_t)opc_fetch8(cpu);
-        uint16_t addr = cpu->IY + d;
-        uint8_t data = cpu_read(cpu, addr);
-        uint8_t res = data - 1;
-
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        opc_testHFlag8(cpu, data, 1, 0, IS_SUB);
-        SET_FLAG_ADDSUB(cpu);
-
-        if (data == 0x80)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
-
-        cpu_write(cpu, res, addr);
-        LOG_DEBUG("Executed DEC (IY+d) IY+d=0x%04X\n", addr);
-    }
 
-    // ADD IY,rr instruction.
-    else if ((next_opc & 0xCF) == 0x09) {
-        opc_tbl[0xFD].TStates = 15;
-        uint8_t src = ((next_opc >> 4) & 0x03);
-        uint16_t data = opc_readReg16(cpu, src, REG16_RR);
-        uint16_t res = cpu->IY + data;
+// LD (HL),r instruction.
+static void opc_LDHLr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
+    cpu_write(cpu, data, cpu->HL);
+    LOG_DEBUG("Executed LD (HL),%s HL=0x%04X\n", opc_regName8(src), cpu->HL);
+    return;
+}
 
-        opc_testHFlag16(cpu, cpu->IY, data, 0, IS_ADD);
-        RESET_FLAG_ADDSUB(cpu);
-        opc_testCFlag16(cpu, cpu->IY, data, 0, IS_ADD);
 
-        cpu->IY = res;
-        LOG_DEBUG("Executed ADD IY,%s\n", opc_regName16(src, REG16_RR));
-    }
+// LD (HL),n instruction.
+static void opc_LDHLn(cpu_t *cpu, uint8_t opcode) {
+    uint8_t n = opc_fetch8(cpu);
+    cpu_write(cpu, n, cpu->HL);
+    LOG_DEBUG("Executed LD (HL),0x%02X HL=0x%04X\n", n, cpu->HL);
+    return;
+}
 
-    // INC IY instruction.
-    else if (next_opc == 0x23) {
-        opc_tbl[0xFD].TStates = 10;
-        cpu->IY++;
-        LOG_DEBUG("Executed INC IY\n");
-    }
 
-    // DEC IY instruction.
-    else if (next_opc == 0x2B) {
-        opc_tbl[0xFD].TStates = 10;
-        cpu->IY--;
-        LOG_DEBUG("Executed DEC IY\n");
-    }
+// LD A,(BC) instruction.
+static void opc_LDABC(cpu_t *cpu, uint8_t opcode) {
+    cpu->A = cpu_read(cpu, cpu->BC);
+    LOG_DEBUG("Executed LD A,(BC) BC=0x%04X\n", cpu->BC);
+    return;
+}
 
-    // JP (IY) instruction.
-    else if (next_opc == 0xE9) {
-        opc_tbl[0xFD].TStates = 8;
-        cpu->PC = cpu->IY;
-        LOG_DEBUG("Executed JP (IY) IY=0x%04X\n", cpu->IY);
-    }
 
-    else if (next_opc == 0xCB) {
-        int8_t d = (int8_t)opc_fetch8(cpu); // 3rd instruction byte.
-        uint16_t addr = cpu->IY + d;
-        uint8_t controlByte = opc_fetch8(cpu); // 4th instruction byte.
+// LD A,(DE) instruction.
+static void opc_LDADE(cpu_t *cpu, uint8_t opcode) {
+    cpu->A = cpu_read(cpu, cpu->DE);
+    LOG_DEBUG("Executed LD A,(DE) DE=0x%04X\n", cpu->DE);
+    return;
+}
 
-        // RLC (IY+d) instruction.
-        if (controlByte == 0x06) {
-            opc_tbl[0xFD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t msb = (data & 0x80) >> 7;
-            uint8_t res = ((data << 1) | msb);
 
-            if (msb)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+// LD A,(nn) instruction.
+static void opc_LDAnn(cpu_t *cpu, uint8_t opcode) {
+    uint16_t addr = opc_fetch16(cpu);
+    cpu->A = cpu_read(cpu, addr);
+    LOG_DEBUG("Executed LD A,(0x%04X)\n", addr);
+    return;
+}
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed RLC (IY+d) IY+d=0x%04X\n", addr);
-        }
+// LD (BC),A instruction.
+static void opc_LDBCA(cpu_t *cpu, uint8_t opcode) {
+    cpu_write(cpu, cpu->A, cpu->BC);
+    LOG_DEBUG("Executed LD (BC),A BC=0x%04X\n", cpu->BC);
+    return;
+}
 
-        // BIT b,(IY+d) instruction.
-        else if ((controlByte & 0xC7) == 0x46) {
-            opc_tbl[0xFD].TStates = 20;
-            uint8_t bit = ((controlByte >> 3) & 0x07);
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t res = ((data >> bit) & 0x1);
 
-            opc_testZFlag8(cpu, res);
-            SET_FLAG_HCARRY(cpu);
-            RESET_FLAG_ADDSUB(cpu);
+// LD (DE),A instruction.
+static void opc_LDDEA(cpu_t *cpu, uint8_t opcode) {
+    cpu_write(cpu, cpu->A, cpu->DE);
+    LOG_DEBUG("Executed LD (DE),A DE=0x%04X\n", cpu->DE);
+    return;
+}
 
-            LOG_DEBUG("Executed BIT %d,(IY+d) IY+d=0x%04X\n", bit, addr);
-        }
 
-        // SET b,(IY+d) instruction.
-        else if ((controlByte & 0xC7) == 0xC6) {
-            opc_tbl[0xFD].TStates = 23;
-            uint8_t bit = ((controlByte >> 3) & 0x07);
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t res = data | (1 << bit);
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed SET %d,(IY+d) IY+d=0x%04X\n", bit, addr);
-        }
+// LD (nn),A instruction.
+static void opc_LDnnA(cpu_t *cpu, uint8_t opcode) {
+    uint16_t addr = opc_fetch16(cpu);
+    cpu_write(cpu, cpu->A, addr);
+    LOG_DEBUG("Executed LD (0x%04X),A\n", addr);
+    return;
+}
 
-        // RES b,(IY+d) instruction.
-        else if ((controlByte & 0xC7) == 0x86) {
-            opc_tbl[0xFD].TStates = 23;
-            uint8_t bit = ((controlByte >> 3) & 0x07);
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t res = data & ~(1 << bit);
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed RES %d,(IY+d) IY+d=0x%04X\n", bit, addr);
-        }
 
-        // RL (IY+d) instruction.
-        else if (controlByte == 0x16) {
-            opc_tbl[0xFD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t c = GET_FLAG_CARRY(cpu);
+// Returns how many iterations of a block repeat instruction can run in this
+// step: one, or as many as fit in the T-states left by cpu_run. A pending
+// interrupt is taken after the first iteration.
+static uint32_t opc_repeatLimit(cpu_t *cpu) {
+    if (cpu_hasInterrupt(cpu))
+        return 1;
 
-            // MSB in carry flag.
-            if (data & 0x80)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+    // Iteration i starts if 21 * i T-states are still below the budget.
+    uint32_t limit = cpu->repeat_cycles / 21 + (cpu->repeat_cycles % 21 != 0);
+    return limit > 0 ? limit : 1;
+}
 
-            uint8_t res = ((data << 1) | c);
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
+// Returns how many bytes can be walked from addr in the given direction
+// without leaving its page.
+static inline uint32_t opc_pageRoom(uint16_t addr, int32_t step) {
+    if (step > 0)
+        return MEM_PAGE_SIZE - (addr & MEM_PAGE_MASK);
+    return (addr & MEM_PAGE_MASK) + 1;
+}
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed RL (IY+d) IY+d=0x%04X\n", addr);
-        }
 
-        // RRC (IY+d) instruction.
-        else if (controlByte == 0x0E) {
-            opc_tbl[0xFD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t lsb = (data & 0x1);
+// Runs iterations of LDIR (step 1) or LDDR (step -1). Runs between plain RAM
+// pages are copied in bulk, anything else goes through cpu_read and
+// cpu_write one byte at a time, stopping on a fault like a single step.
+// Iterations past the first are counted in cpu->instr.
+// Returns the number of executed iterations.
+static uint32_t opc_repeatLD(cpu_t *cpu, int32_t step) {
+    uint32_t limit = opc_repeatLimit(cpu);
+    uint32_t count = 0;
+
+    // Stops after the iteration that overwrites the instruction itself, the
+    // next one has to be fetched again.
+    for (uint16_t addr = cpu->PC - 2; addr != cpu->PC; addr++) {
+        uint32_t dist = (uint16_t)(step > 0 ? addr - cpu->DE : cpu->DE - addr);
+        if (dist < limit)
+            limit = dist + 1;
+    }
 
-            // LSB in carry flag.
-            if (lsb)
-                SET_FLAG_CARRY(cpu);
+    do {
+        const mem_page_t *src = &cpu->pages[cpu->HL >> MEM_PAGE_SHIFT];
+        const mem_page_t *dst = &cpu->pages[cpu->DE >> MEM_PAGE_SHIFT];
+        uint32_t n = limit - count;
+        uint32_t left = cpu->BC ? cpu->BC : 0x10000;
+        uint32_t room = opc_pageRoom(cpu->HL, step);
+        if (n > left)
+            n = left;
+        if (n > room)
+            n = room;
+        room = opc_pageRoom(cpu->DE, step);
+        if (n > room)
+            n = room;
+
+        if (!(src->flags & (PAGE_UNUSED | PAGE_MMIO)) && dst->flags == 0) {
+            uint8_t *s = &src->host[cpu->HL & MEM_PAGE_MASK];
+            uint8_t *d = &dst->host[cpu->DE & MEM_PAGE_MASK];
+
+            // A destination just ahead of the source repeats the copied
+            // bytes (the usual LDIR fill), which memmove would not do.
+            if (step > 0 && d > s && d < s + n)
+                for (uint32_t i = 0; i < n; i++)
+                    d[i] = s[i];
+            else if (step < 0 && d < s && d + n > s)
+                for (uint32_t i = 0; i < n; i++)
+                    *(d - i) = *(s - i);
+            else if (step > 0)
+                memmove(d, s, n);
             else
-                RESET_FLAG_CARRY(cpu);
-
-            uint8_t res = ((data >> 1) | (lsb << 7));
-
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
-
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed RRC (IY+d) IY+d=0x%04X\n", addr);
+                memmove(d - n + 1, s - n + 1, n);
+        }
+        else {
+            n = 1;
+            cpu_write(cpu, cpu_read(cpu, cpu->HL), cpu->DE);
         }
 
-        // RR (IY+d) instruction.
-        else if (controlByte == 0x1E) {
-            opc_tbl[0xFD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t c = GET_FLAG_CARRY(cpu);
+        cpu->HL += step * (int32_t)n;
+        cpu->DE += step * (int32_t)n;
+        cpu->BC -= n;
+        count += n;
+    } while (cpu->BC && count < limit && !cpu->is_faulted);
 
-            // LSB in carry flag.
-            if (data & 0x1)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+    cpu->instr += count - 1;
+    return count;
+}
 
-            uint8_t res = ((data >> 1) | (c << 7));
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
+// Runs iterations of CPIR (step 1) or CPDR (step -1) until A is found.
+// Plain pages are scanned in bulk. Iterations past the first are counted in
+// cpu->instr.
+// Returns the number of executed iterations and the last compared byte.
+static uint32_t opc_repeatCP(cpu_t *cpu, int32_t step, uint8_t *data) {
+    uint32_t limit = opc_repeatLimit(cpu);
+    uint32_t count = 0;
+    bool is_found = false;
+
+    do {
+        const mem_page_t *src = &cpu->pages[cpu->HL >> MEM_PAGE_SHIFT];
+        uint32_t n = limit - count;
+        uint32_t left = cpu->BC ? cpu->BC : 0x10000;
+        uint32_t room = opc_pageRoom(cpu->HL, step);
+        if (n > left)
+            n = left;
+        if (n > room)
+            n = room;
+
+        if (!(src->flags & (PAGE_UNUSED | PAGE_MMIO))) {
+            const uint8_t *s = &src->host[cpu->HL & MEM_PAGE_MASK];
+            uint32_t i = 0;
+
+            if (step > 0) {
+                const uint8_t *hit = memchr(s, cpu->A, n);
+                i = (hit != NULL) ? (uint32_t)(hit - s) : n;
+            }
+            else {
+                while (i < n && *(s - i) != cpu->A)
+                    i++;
+            }
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed RR (IY+d) IY+d=0x%04X\n", addr);
+            is_found = (i < n);
+            if (is_found)
+                n = i + 1;
+            *data = *(s + step * (int32_t)(n - 1));
+        }
+        else {
+            n = 1;
+            *data = cpu_read(cpu, cpu->HL);
+            is_found = (*data == cpu->A);
         }
 
-        // SLA (IY+d) instruction.
-        else if (controlByte == 0x26) {
-            opc_tbl[0xFD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
+        cpu->HL += step * (int32_t)n;
+        cpu->BC -= n;
+        count += n;
+    } while (!is_found && cpu->BC && count < limit && !cpu->is_faulted);
 
-            // MSB in carry bit
-            if (data & 0x80)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+    cpu->instr += count - 1;
+    return count;
+}
 
-            uint8_t res = (data << 1);
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
+// LD A,I instruction.
+static void opc_LDAI(cpu_t *cpu, uint8_t opcode) {
+    cpu->A = cpu->I;
+    // Condition bits are affected.
+    if (opc_isNegative8(cpu->I))
+        SET_FLAG_SIGN(cpu);
+    else
+        RESET_FLAG_SIGN(cpu);
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed SLA (IY+d) IY+d=0x%04X\n", addr);
-        }
+    if (cpu->I == 0)
+        SET_FLAG_ZERO(cpu);
+    else
+        RESET_FLAG_ZERO(cpu);
 
-        // SRA (IY+d) instruction.
-        else if (controlByte == 0x2E) {
-            opc_tbl[0xFD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
-            uint8_t msb = (data & 0x80);
-            uint8_t lsb = (data & 0x1);
+    RESET_FLAG_HCARRY(cpu);
+    RESET_FLAG_ADDSUB(cpu);
 
-            // LSB in carry flag.
-            if (lsb)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+    if (cpu->IFF2)
+        SET_FLAG_PARITY(cpu);
+    else
+        RESET_FLAG_PARITY(cpu);
 
-            uint8_t res = ((data >> 1) | msb);
+    LOG_DEBUG("Executed LD A,I\n");
+    return;
+}
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed SRA (IY+d) IY+d=0x%04X\n", addr);
-        }
+// LD A,R instruction.
+static void opc_LDAR(cpu_t *cpu, uint8_t opcode) {
+    cpu->A = cpu->R;
+    // Condition bits are affected.
+    if (opc_isNegative8(cpu->R))
+        SET_FLAG_SIGN(cpu);
+    else
+        RESET_FLAG_SIGN(cpu);
 
-        // SRL (IY+d) instruction.
-        else if (controlByte == 0x3E) {
-            opc_tbl[0xFD].TStates = 23;
-            uint8_t data = cpu_read(cpu, addr);
+    if (cpu->R == 0)
+        SET_FLAG_ZERO(cpu);
+    else
+        RESET_FLAG_ZERO(cpu);
 
-            // LSB in carry flag.
-            if (data & 0x1)
-                SET_FLAG_CARRY(cpu);
-            else
-                RESET_FLAG_CARRY(cpu);
+    RESET_FLAG_HCARRY(cpu);
+    RESET_FLAG_ADDSUB(cpu);
 
-            uint8_t res = (data >> 1);
+    if (cpu->IFF2)
+        SET_FLAG_PARITY(cpu);
+    else
+        RESET_FLAG_PARITY(cpu);
 
-            opc_testSFlag8(cpu, res);
-            opc_testZFlag8(cpu, res);
-            RESET_FLAG_HCARRY(cpu);
-            opc_testPFlag8(cpu, res);
-            RESET_FLAG_ADDSUB(cpu);
+    LOG_DEBUG("Executed LD A,R\n");
+    return;
+}
 
-            cpu_write(cpu, res, addr);
-            LOG_DEBUG("Executed SRL (IY+d) IY+d=0x%04X\n", addr);
-        }
 
-        else {
-            LOG_FATAL("Invalid instruction in IY BIT, SET, RESET group or "
-                "in Rotate and Shift group.\n");
-            raise(SIGINT);
-        }
-    }
+// LD I,A instruction.
+static void opc_LDIA(cpu_t *cpu, uint8_t opcode) {
+    cpu->I = cpu->A;
+    LOG_DEBUG("Executed LD I,A\n");
+    return;
+}
 
-    else {
-        LOG_FATAL("Invalid operation in 0xFD instruction group.\n");
-        raise(SIGINT);
-    }
+
+// LD R,A instruction.
+static void opc_LDRA(cpu_t *cpu, uint8_t opcode) {
+    cpu->R = cpu->A;
+    LOG_DEBUG("Executed LD R,A\n");
+    return;
 }
 
 
-// LD (HL),r instruction.
-static void opc_LDHLr(cpu_t *cpu, uint8_t opcode) {
-    uint8_t src = (opcode & 0x07);
-    uint8_t data = opc_readReg(cpu, src);
-    cpu_write(cpu, data, cpu->HL);
-    LOG_DEBUG("Executed LD (HL),%s HL=0x%04X\n", opc_regName8(src), cpu->HL);
+// LD dd,(nn) instruction.
+static void opc_LDddMnn(cpu_t *cpu, uint8_t opcode) {
+    uint8_t dst = ((opcode >> 4) & 0x03);
+    uint16_t addr = opc_fetch16(cpu);
+    uint16_t data = (cpu_read(cpu, addr) | (cpu_read(cpu, addr + 1) << 8));
+    opc_writeReg16(cpu, dst, data, REG16_DD);
+    LOG_DEBUG("Executed LD %s,(0x%04X)\n", opc_regName16(dst, REG16_DD), addr);
     return;
 }
 
 
-// LD (HL),n instruction.
-static void opc_LDHLn(cpu_t *cpu, uint8_t opcode) {
-    uint8_t n = opc_fetch8(cpu);
-    cpu_write(cpu, n, cpu->HL);
-    LOG_DEBUG("Executed LD (HL),0x%02X HL=0x%04X\n", n, cpu->HL);
+// LD (nn),dd instruction.
+static void opc_LDMnndd(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = ((opcode >> 4) & 0x03);
+    uint16_t addr = opc_fetch16(cpu);
+    uint16_t data = opc_readReg16(cpu, src, REG16_DD);
+    cpu_write(cpu, (data & 0xFF), addr);
+    cpu_write(cpu, ((data >> 8) & 0xFF), addr + 1);
+    LOG_DEBUG("Executed LD (0x%04X),%s\n", addr, opc_regName16(src, REG16_DD));
     return;
 }
 
 
-// LD A,(BC) instruction.
-static void opc_LDABC(cpu_t *cpu, uint8_t opcode) {
-    cpu->A = cpu_read(cpu, cpu->BC);
-    LOG_DEBUG("Executed LD A,(BC) BC=0x%04X\n", cpu->BC);
+// LDI instruction.
+static void opc_LDI(cpu_t *cpu, uint8_t opcode) {
+    uint8_t mem_HL = cpu_read(cpu, cpu->HL);
+    cpu_write(cpu, mem_HL, cpu->DE);
+    cpu->DE++;
+    cpu->HL++;
+    cpu->BC--;
+
+    RESET_FLAG_HCARRY(cpu);
+    RESET_FLAG_ADDSUB(cpu);
+    if (cpu->BC)
+        SET_FLAG_PARITY(cpu);
+    else
+        RESET_FLAG_PARITY(cpu);
+    LOG_DEBUG("Executed LDI\n");
     return;
 }
 
 
-// LD A,(DE) instruction.
-static void opc_LDADE(cpu_t *cpu, uint8_t opcode) {
-    cpu->A = cpu_read(cpu, cpu->DE);
-    LOG_DEBUG("Executed LD A,(DE) DE=0x%04X\n", cpu->DE);
+// LDIR instruction.
+static void opc_LDIR(cpu_t *cpu, uint8_t opcode) {
+    uint32_t count = opc_repeatLD(cpu, 1);
+
+    RESET_FLAG_HCARRY(cpu);
+    RESET_FLAG_ADDSUB(cpu);
+    RESET_FLAG_PARITY(cpu);
+
+    if (cpu->BC) {
+        cpu->PC -= 2;
+        cpu->cycles += 21 * count;
+    } else
+        cpu->cycles += 21 * count - 5;
+
+    LOG_DEBUG("Executed LDIR\n");
     return;
 }
 
 
-// LD A,(nn) instruction.
-static void opc_LDAnn(cpu_t *cpu, uint8_t opcode) {
-    uint16_t addr = opc_fetch16(cpu);
-    cpu->A = cpu_read(cpu, addr);
-    LOG_DEBUG("Executed LD A,(0x%04X)\n", addr);
+// LDD instruction.
+static void opc_LDD(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, cpu->HL);
+    cpu_write(cpu, data, cpu->DE);
+    cpu->DE--;
+    cpu->HL--;
+    cpu->BC--;
+
+    RESET_FLAG_HCARRY(cpu);
+    RESET_FLAG_ADDSUB(cpu);
+    if (cpu->BC)
+        SET_FLAG_PARITY(cpu);
+    else
+        RESET_FLAG_PARITY(cpu);
+
+    LOG_DEBUG("Executed LDD\n");
     return;
 }
 
 
-// LD (BC),A instruction.
-static void opc_LDBCA(cpu_t *cpu, uint8_t opcode) {
-    cpu_write(cpu, cpu->A, cpu->BC);
-    LOG_DEBUG("Executed LD (BC),A BC=0x%04X\n", cpu->BC);
+// LDDR instruction.
+static void opc_LDDR(cpu_t *cpu, uint8_t opcode) {
+    uint32_t count = opc_repeatLD(cpu, -1);
+
+    RESET_FLAG_HCARRY(cpu);
+    RESET_FLAG_ADDSUB(cpu);
+    RESET_FLAG_PARITY(cpu);
+
+    if (cpu->BC) {
+        cpu->PC -= 2;
+        cpu->cycles += 21 * count;
+    } else
+        cpu->cycles += 21 * count - 5;
+
+    LOG_DEBUG("Executed LDDR\n");
     return;
 }
 
 
-// LD (DE),A instruction.
-static void opc_LDDEA(cpu_t *cpu, uint8_t opcode) {
-    cpu_write(cpu, cpu->A, cpu->DE);
-    LOG_DEBUG("Executed LD (DE),A DE=0x%04X\n", cpu->DE);
+// CPI instruction.
+static void opc_CPI(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data_HL = cpu_read(cpu, cpu->HL);
+    uint8_t res = cpu->A - data_HL;
+    cpu->HL++;
+    cpu->BC--;
+
+    opc_testSFlag8(cpu, res);
+    opc_testZFlag8(cpu, res);
+    opc_testHFlag8(cpu, cpu->A, data_HL, 0, IS_SUB);
+
+    SET_FLAG_ADDSUB(cpu);
+    if (cpu->BC)
+        SET_FLAG_PARITY(cpu);
+    else
+        RESET_FLAG_PARITY(cpu);
+
+    LOG_DEBUG("Executed CPI\n");
     return;
 }
 
 
-// LD (nn),A instruction.
-static void opc_LDnnA(cpu_t *cpu, uint8_t opcode) {
-    uint16_t addr = opc_fetch16(cpu);
-    cpu_write(cpu, cpu->A, addr);
-    LOG_DEBUG("Executed LD (0x%04X),A\n", addr);
+// CPIR instruction.
+static void opc_CPIR(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data_HL;
+    uint32_t count = opc_repeatCP(cpu, 1, &data_HL);
+    uint8_t res = cpu->A - data_HL;
+
+    opc_testSFlag8(cpu, res);
+    opc_testZFlag8(cpu, res);
+    opc_testHFlag8(cpu, cpu->A, data_HL, 0, IS_SUB);
+
+    SET_FLAG_ADDSUB(cpu);
+    if (cpu->BC)
+        SET_FLAG_PARITY(cpu);
+    else
+        RESET_FLAG_PARITY(cpu);
+
+    // If decrementing causes BC to go to 0 or if A = (HL),
+    // the instruction is terminated.
+    if (cpu->BC && res) {
+        cpu->cycles += 21 * count;
+        cpu->PC -= 2;
+    } else
+        cpu->cycles += 21 * count - 5;
+
+    LOG_DEBUG("Executed CPIR\n");
     return;
 }
 
 
-static void opc_LDRIddnn(cpu_t *cpu, uint8_t opcode) {
-    opc_tbl[0xED].TStates = 9;
-    uint8_t next_opc = opc_fetch8(cpu);
+// CPD instruction.
+static void opc_CPD(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data_HL = cpu_read(cpu, cpu->HL);
+    uint8_t res = cpu->A - data_HL;
+    cpu->HL--;
+    cpu->BC--;
 
-    // LD A,I instruction.
-    if (next_opc == 0x57) {
-        cpu->A = cpu->I;
-        // Condition bits are affected.
-        if (opc_isNegative8(cpu->I))
-            SET_FLAG_SIGN(cpu);
-        else
-            RESET_FLAG_SIGN(cpu);
+    opc_testSFlag8(cpu, res);
+    opc_testZFlag8(cpu, res);
+    opc_testHFlag8(cpu, cpu->A, data_HL, 0, IS_SUB);
 
-        if (cpu->I == 0)
-            SET_FLAG_ZERO(cpu);
-        else
-            RESET_FLAG_ZERO(cpu);
+    SET_FLAG_ADDSUB(cpu);
+    if (cpu->BC)
+        SET_FLAG_PARITY(cpu);
+    else
+        RESET_FLAG_PARITY(cpu);
 
-        RESET_FLAG_HCARRY(cpu);
-        RESET_FLAG_ADDSUB(cpu);
+    LOG_DEBUG("Executed CPD\n");
+    return;
+}
 
-        if (cpu->IFF2)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
 
-        LOG_DEBUG("Executed LD A,I\n");
-    }
+// CPDR instruction.
+static void opc_CPDR(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data_HL;
+    uint32_t count = opc_repeatCP(cpu, -1, &data_HL);
+    uint8_t res = cpu->A - data_HL;
 
-    // LD A,R instruction.
-    else if (next_opc == 0x5F) {
-        cpu->A = cpu->R;
-        // Condition bits are affected.
-        if (opc_isNegative8(cpu->R))
-            SET_FLAG_SIGN(cpu);
-        else
-            RESET_FLAG_SIGN(cpu);
+    opc_testSFlag8(cpu, res);
+    opc_testZFlag8(cpu, res);
+    opc_testHFlag8(cpu, cpu->A, data_HL, 0, IS_SUB);
 
-        if (cpu->R == 0)
-            SET_FLAG_ZERO(cpu);
-        else
-            RESET_FLAG_ZERO(cpu);
+    SET_FLAG_ADDSUB(cpu);
+    if (cpu->BC)
+        SET_FLAG_PARITY(cpu);
+    else
+        RESET_FLAG_PARITY(cpu);
 
-        RESET_FLAG_HCARRY(cpu);
-        RESET_FLAG_ADDSUB(cpu);
+    // If decrementing causes BC to go to 0 or if A = (HL),
+    // the instruction is terminated.
+    if (cpu->BC && res) {
+        cpu->cycles += 21 * count;
+        cpu->PC -= 2;
+    } else
+        cpu->cycles += 21 * count - 5;
 
-        if (cpu->IFF2)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
+    LOG_DEBUG("Executed CPDR\n");
+    return;
+}
 
-        LOG_DEBUG("Executed LD A,R\n");
-    }
 
-    // LD I,A instruction.
-    else if (next_opc == 0x47) {
-        cpu->I = cpu->A;
-        LOG_DEBUG("Executed LD I,A\n");
-    }
+// NEG instruction.
+static void opc_NEG(cpu_t *cpu, uint8_t opcode) {
+    uint8_t res = 0 - cpu->A;
 
-    // LD R,A instruction.
-    else if (next_opc == 0x4F) {
-        cpu->R = cpu->A;
-        LOG_DEBUG("Executed LD R,A\n");
-    }
+    opc_setFlagsSub8(cpu, 0, cpu->A, 0);
 
-    // LD dd, (nn) instruction.
-    else if ((next_opc & 0xCF) == 0x4B) {
-        opc_tbl[0xED].TStates = 20;
-        uint8_t dst = ((next_opc >> 4) & 0x03);
-        uint16_t addr = opc_fetch16(cpu);
-        uint16_t data = (cpu_read(cpu, addr) | (cpu_read(cpu, addr + 1) << 8));
-        opc_writeReg16(cpu, dst, data, REG16_DD);
-        LOG_DEBUG("Executed LD %s,(0x%04X)\n", opc_regName16(dst, REG16_DD), addr);
-    }
+    cpu->A = res;
+    LOG_DEBUG("Executed NEG\n");
+    return;
+}
 
-    // LD (nn),dd instruction.
-    else if ((next_opc & 0xCF) == 0x43) {
-        opc_tbl[0xED].TStates = 20;
-        uint8_t src = ((next_opc >> 4) & 0x03);
-        uint16_t addr = opc_fetch16(cpu);
-        uint16_t data = opc_readReg16(cpu, src, REG16_DD);
-        cpu_write(cpu, (data & 0xFF), addr);
-        cpu_write(cpu, ((data >> 8) & 0xFF), addr + 1);
-        LOG_DEBUG("Executed LD (0x%04X),%s\n", addr, opc_regName16(src, REG16_DD));
-    }
 
-    // LDI instruction.
-    else if (next_opc == 0xA0) {
-        opc_tbl[0xED].TStates = 16;
-        uint8_t mem_HL = cpu_read(cpu, cpu->HL);
-        cpu_write(cpu, mem_HL, cpu->DE);
-        cpu->DE++;
-        cpu->HL++;
-        cpu->BC--;
+// IM 0 instruction.
+static void opc_IM0(cpu_t *cpu, uint8_t opcode) {
+    cpu->IM = 0;
+    LOG_DEBUG("Executed IM 0\n");
+    return;
+}
 
-        RESET_FLAG_HCARRY(cpu);
-        RESET_FLAG_ADDSUB(cpu);
-        if (cpu->BC)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
-        LOG_DEBUG("Executed LDI\n");
-    }
 
-    // LDIR instruction.
-    else if (next_opc == 0xB0) {
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        cpu_write(cpu, data, cpu->DE);
-        cpu->DE++;
-        cpu->HL++;
-        cpu->BC--;
+// IM 1 instruction.
+static void opc_IM1(cpu_t *cpu, uint8_t opcode) {
+    cpu->IM = 1;
+    LOG_DEBUG("Executed IM 1\n");
+    return;
+}
 
-        RESET_FLAG_HCARRY(cpu);
-        RESET_FLAG_ADDSUB(cpu);
-        RESET_FLAG_PARITY(cpu);
 
-        if (cpu->BC) {
-            cpu->PC -= 2;
-            opc_tbl[0xED].TStates = 21;
-        } else
-            opc_tbl[0xED].TStates = 16;
+// IM 2 instruction.
+static void opc_IM2(cpu_t *cpu, uint8_t opcode) {
+    cpu->IM = 2;
+    LOG_DEBUG("Executed IM 2\n");
+    return;
+}
 
-        LOG_DEBUG("Executed LDIR\n");
-    }
 
-    // LDD instruction.
-    else if (next_opc == 0xA8) {
-        opc_tbl[0xED].TStates = 16;
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        cpu_write(cpu, data, cpu->DE);
-        cpu->DE--;
-        cpu->HL--;
-        cpu->BC--;
+// ADC HL,ss instruction.
+static void opc_ADCHLss(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = ((opcode >> 4) & 0x03);
+    uint16_t data = opc_readReg16(cpu, src, REG16_DD);
+    uint8_t c = GET_FLAG_CARRY(cpu);
+    uint16_t res = cpu->HL + data + c;
 
-        RESET_FLAG_HCARRY(cpu);
-        RESET_FLAG_ADDSUB(cpu);
-        if (cpu->BC)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
+    opc_setFlagsAdd16(cpu, cpu->HL, data, c, res);
 
-        LOG_DEBUG("Executed LDD\n");
-    }
+    cpu->HL = res;
+    LOG_DEBUG("Executed ADC HL,%s\n", opc_regName16(src, REG16_DD));
+    return;
+}
 
-    // LDDR instruction.
-    else if (next_opc == 0xB8) {
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        cpu_write(cpu, data, cpu->DE);
-        cpu->DE--;
-        cpu->HL--;
-        cpu->BC--;
 
-        RESET_FLAG_HCARRY(cpu);
-        RESET_FLAG_ADDSUB(cpu);
-        RESET_FLAG_PARITY(cpu);
+// SBC HL,ss instruction.
+static void opc_SBCHLss(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = ((opcode >> 4) & 0x03);
+    uint16_t data = opc_readReg16(cpu, src, REG16_DD);
+    uint8_t c = GET_FLAG_CARRY(cpu);
+    uint16_t res = cpu->HL - data - c;
 
-        if (cpu->BC) {
-            cpu->PC -= 2;
-            opc_tbl[0xED].TStates = 21;
-        } else
-            opc_tbl[0xED].TStates = 16;
+    opc_testSFlag16(cpu, res);
+    opc_testZFlag16(cpu, res);
+    opc_testHFlag16(cpu, cpu->HL, data, c, IS_SUB);
+    opc_testVFlag16(cpu, cpu->HL, data, c, IS_SUB);
+    SET_FLAG_ADDSUB(cpu);
+    opc_testCFlag16(cpu, cpu->HL, data, c, IS_SUB);
 
-        LOG_DEBUG("Executed LDDR\n");
-    }
+    cpu->HL = res;
+    LOG_DEBUG("Executed SBC HL,%s\n", opc_regName16(src, REG16_DD));
+    return;
+}
 
-    // CPI instruction.
-    else if (next_opc == 0xA1) {
-        opc_tbl[0xED].TStates = 16;
-        uint8_t data_HL = cpu_read(cpu, cpu->HL);
-        uint8_t res = cpu->A - data_HL;
-        cpu->HL++;
-        cpu->BC--;
-
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        opc_testHFlag8(cpu, cpu->A, data_HL, 0, IS_SUB);
-
-        SET_FLAG_ADDSUB(cpu);
-        if (cpu->BC)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
-
-        LOG_DEBUG("Executed CPI\n");
-    }
 
-    // CPIR instruction.
-    else if (next_opc == 0xB1) {
-        uint8_t data_HL = cpu_read(cpu, cpu->HL);
-        uint8_t res = cpu->A - data_HL;
-        cpu->HL++;
-        cpu->BC--;
-
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        opc_testHFlag8(cpu, cpu->A, data_HL, 0, IS_SUB);
-
-        SET_FLAG_ADDSUB(cpu);
-        if (cpu->BC)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
-
-        // If decrementing causes BC to go to 0 or if A = (HL),
-        // the instruction is terminated.
-        if (cpu->BC && res) {
-            opc_tbl[0xED].TStates = 21;
-            cpu->PC -= 2;
-        } else
-            opc_tbl[0xED].TStates = 16;
-
-        LOG_DEBUG("Executed CPIR\n");
-    }
+// RETI instruction.
+static void opc_RETI(cpu_t *cpu, uint8_t opcode) {
+    cpu->PC = cpu_stackPop(cpu);
+    LOG_DEBUG("Executed RETI\n");
+    return;
+}
+
+
+// RETN instruction.
+static void opc_RETN(cpu_t *cpu, uint8_t opcode) {
+    cpu->IFF1 = cpu->IFF2;
+    cpu->PC = cpu_stackPop(cpu);
+    LOG_DEBUG("Executed RETN\n");
+    return;
+}
+
 
-    // This is CPD instruction
-    else if (next_opc == 0xA9) {
-        opc_tbl[0xED].TStates = 16;
-        uint8_t data_HL = cpu_read(cpu, cpu->HL);
-        uint8_t res = cpu->A - data_HL;
-        cpu->HL--;
-        cpu->BC--;
-
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        opc_testHFlag8(cpu, cpu->A, data_HL, 0, IS_SUB);
-
-        SET_FLAG_ADDSUB(cpu);
-        if (cpu->BC)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
-
-        LOG_DEBUG("Executed CPD\n");
-    }
+// RLD instruction.
+static void opc_RLD(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data_HL = cpu_read(cpu, cpu->HL);
+    uint8_t data_HLH = (data_HL >> 4) & 0xF;
+    uint8_t data_HLL = (data_HL & 0xF);
+    uint8_t data_AL = (cpu->A & 0xF);
 
-    // CPDR instruction.
-    else if (next_opc == 0xB9) {
-        uint8_t data_HL = cpu_read(cpu, cpu->HL);
-        uint8_t res = cpu->A - data_HL;
-        cpu->HL--;
-        cpu->BC--;
-
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        opc_testHFlag8(cpu, cpu->A, data_HL, 0, IS_SUB);
-
-        SET_FLAG_ADDSUB(cpu);
-        if (cpu->BC)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
-
-        // If decrementing causes BC to go to 0 or if A = (HL),
-        // the instruction is terminated.
-        if (cpu->BC && res) {
-            opc_tbl[0xED].TStates = 21;
-            cpu->PC -= 2;
-        } else
-            opc_tbl[0xED].TStates = 16;
-
-        LOG_DEBUG("Executed CPDR\n");
-    }
+    cpu->A = ((cpu->A & 0xF0) | data_HLH);
+    uint8_t res = ((data_HLL << 4) | data_AL);
 
-    // NEG instruction.
-    else if (next_opc == 0x44) {
-        opc_tbl[0xED].TStates = 8;
-        uint8_t res = 0 - cpu->A;
+    opc_setFlagsSZP8(cpu, cpu->A, cpu_getF(cpu) & FLAG_CARRY);
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        opc_testHFlag8(cpu, 0, cpu->A, 0, IS_SUB);
-        SET_FLAG_ADDSUB(cpu);
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed RLD\n");
+    return;
+}
 
-        if (cpu->A == 0x80)
-            SET_FLAG_PARITY(cpu);
-        else
-            RESET_FLAG_PARITY(cpu);
 
-        if (cpu->A)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+// RRD instruction.
+static void opc_RRD(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data_HL = cpu_read(cpu, cpu->HL);
+    uint8_t data_HLH = (data_HL >> 4) & 0xF;
+    uint8_t data_HLL = (data_HL & 0xF);
+    uint8_t data_AL = (cpu->A & 0xF);
 
-        cpu->A = res;
-        LOG_DEBUG("Executed NEG\n");
-    }
+    cpu->A = ((cpu->A & 0xF0) | data_HLL);
+    uint8_t res = ((data_AL << 4) | data_HLH);
 
-    // IM 0 instruction.
-    else if (next_opc == 0x46) {
-        opc_tbl[0xED].TStates = 8;
-        cpu->IM = 0;
-        LOG_DEBUG("Executed IM 0\n");
-    }
+    opc_setFlagsSZP8(cpu, cpu->A, cpu_getF(cpu) & FLAG_CARRY);
 
-    // IM 1 instruction.
-    else if (next_opc == 0x56) {
-        opc_tbl[0xED].TStates = 8;
-        cpu->IM = 1;
-        LOG_DEBUG("Executed IM 1\n");
-    }
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed RRD\n");
+    return;
+}
 
-    // IM 2 instruction.
-    else if (next_opc == 0x5E) {
-        opc_tbl[0xED].TStates = 8;
-        cpu->IM = 2;
-        LOG_DEBUG("Executed IM 2\n");
-    }
 
-    // ADC HL,ss instruction.
-    else if ((next_opc & 0xCF) == 0x4A) {
-        opc_tbl[0xED].TStates = 15;
-        uint8_t src = ((next_opc >> 4) & 0x03);
-        uint16_t data = opc_readReg16(cpu, src, REG16_DD);
-        uint8_t c = GET_FLAG_CARRY(cpu);
-        uint16_t res = cpu->HL + data + c;
+// IN r,(C) instruction.
+static void opc_INrC(cpu_t *cpu, uint8_t opcode) {
+    uint8_t dst = ((opcode >> 3) & 0x07);
+    uint8_t res = cpu_portIn(cpu, cpu->C);
+    opc_writeReg(cpu, dst, res);
 
-        opc_setFlagsAdd16(cpu, cpu->HL, data, c, res);
+    opc_setFlagsSZP8(cpu, res, cpu_getF(cpu) & FLAG_CARRY);
 
-        cpu->HL = res;
-        LOG_DEBUG("Executed ADC HL,%s\n", opc_regName16(src, REG16_DD));
-    }
+    LOG_DEBUG("Executed IN %s,(C)\n", opc_regName8(dst));
+    return;
+}
 
-    // SBC HL,ss instruction.
-    else if ((next_opc & 0xCF) == 0x42) {
-        opc_tbl[0xED].TStates = 15;
-        uint8_t src = ((next_opc >> 4) & 0x03);
-        uint16_t data = opc_readReg16(cpu, src, REG16_DD);
-        uint8_t c = GET_FLAG_CARRY(cpu);
-        uint16_t res = cpu->HL - data - c;
-
-        opc_testSFlag16(cpu, res);
-        opc_testZFlag16(cpu, res);
-        opc_testHFlag16(cpu, cpu->HL, data, c, IS_SUB);
-        opc_testVFlag16(cpu, cpu->HL, data, c, IS_SUB);
-        SET_FLAG_ADDSUB(cpu);
-        opc_testCFlag16(cpu, cpu->HL, data, c, IS_SUB);
-
-        cpu->HL = res;
-        LOG_DEBUG("Executed SBC HL,%s\n", opc_regName16(src, REG16_DD));
-    }
 
-    // RETI instruction.
-    else if (next_opc == 0x4D) {
-        opc_tbl[0xED].TStates = 14;
-        cpu->PC = cpu_stackPop(cpu);
-        LOG_DEBUG("Executed RETI\n");
-    }
+// OUT (C),r instruction.
+static void opc_OUTCr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = ((opcode >> 3) & 0x07);
+    cpu_portOut(cpu, cpu->C, opc_readReg(cpu, src));
 
-    // RETN instruction.
-    else if (next_opc == 0x45) {
-        opc_tbl[0xED].TStates = 14;
-        cpu->IFF1 = cpu->IFF2;
-        cpu->PC = cpu_stackPop(cpu);
-        LOG_DEBUG("Executed RETN\n");
-    }
+    LOG_DEBUG("Executed OUT (C),%s\n", opc_regName8(src));
+    return;
+}
 
-    // RLD instruction.
-    else if (next_opc == 0x6F) {
-        opc_tbl[0xED].TStates = 18;
-        uint8_t data_HL = cpu_read(cpu, cpu->HL);
-        uint8_t data_HLH = (data_HL >> 4) & 0xF;
-        uint8_t data_HLL = (data_HL & 0xF);
-        uint8_t data_AL = (cpu->A & 0xF);
 
-        cpu->A = ((cpu->A & 0xF0) | data_HLH);
-        uint8_t res = ((data_HLL << 4) | data_AL);
+// INI instruction.
+static void opc_INI(cpu_t *cpu, uint8_t opcode) {
+    uint8_t res = cpu_portIn(cpu, cpu->C);
+    cpu_write(cpu, res, cpu->HL);
+    cpu->B--;
+    cpu->HL++;
 
-        opc_testSFlag8(cpu, cpu->A);
-        opc_testZFlag8(cpu, cpu->A);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, cpu->A);
-        RESET_FLAG_ADDSUB(cpu);
+    SET_FLAG_ADDSUB(cpu);
+    if (cpu->B)
+        RESET_FLAG_ZERO(cpu);
+    else
+        SET_FLAG_ZERO(cpu);
 
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed RLD\n");
-    }
+    LOG_DEBUG("Executed INI\n");
+    return;
+}
 
-    // RRD instruction.
-    else if (next_opc == 0x67) {
-        opc_tbl[0xED].TStates = 18;
-        uint8_t data_HL = cpu_read(cpu, cpu->HL);
-        uint8_t data_HLH = (data_HL >> 4) & 0xF;
-        uint8_t data_HLL = (data_HL & 0xF);
-        uint8_t data_AL = (cpu->A & 0xF);
 
-        cpu->A = ((cpu->A & 0xF0) | data_HLL);
-        uint8_t res = ((data_AL << 4) | data_HLH);
+// OUTI instruction.
+static void opc_OUTI(cpu_t *cpu, uint8_t opcode) {
+    uint8_t res = cpu_read(cpu, cpu->HL);
+    cpu_portOut(cpu, cpu->C, res);
+    cpu->B--;
+    cpu->HL++;
 
-        opc_testSFlag8(cpu, cpu->A);
-        opc_testZFlag8(cpu, cpu->A);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, cpu->A);
-        RESET_FLAG_ADDSUB(cpu);
+    SET_FLAG_ADDSUB(cpu);
+    if (cpu->B)
+        RESET_FLAG_ZERO(cpu);
+    else
+        SET_FLAG_ZERO(cpu);
 
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed RRD\n");
-    }
+    LOG_DEBUG("Executed OUTI\n");
+    return;
+}
 
-    // IN r,(C) instruction.
-    else if ((next_opc & 0xC7) == 0x40) {
-        opc_tbl[0xED].TStates = 12;
-        uint8_t dst = ((next_opc >> 3) & 0x07);
-        uint8_t res = cpu->portIO_in(cpu->board, cpu->C);
-        opc_writeReg(cpu, dst, res);
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// IND instruction.
+static void opc_IND(cpu_t *cpu, uint8_t opcode) {
+    uint8_t res = cpu_portIn(cpu, cpu->C);
+    cpu_write(cpu, res, cpu->HL);
+    cpu->B--;
+    cpu->HL--;
 
-        LOG_DEBUG("Executed IN %s,(C)\n", opc_regName8(dst));
-    }
+    SET_FLAG_ADDSUB(cpu);
+    if (cpu->B)
+        RESET_FLAG_ZERO(cpu);
+    else
+        SET_FLAG_ZERO(cpu);
 
-    // OUT (C),r instruction.
-    else if ((next_opc & 0xC7) == 0x41) {
-        opc_tbl[0xED].TStates = 12;
-        uint8_t src = ((next_opc >> 3) & 0x07);
-        cpu->portIO_out(cpu->board, cpu->C, opc_readReg(cpu, src));
+    LOG_DEBUG("Executed IND\n");
+    return;
+}
 
-        LOG_DEBUG("Executed OUT (C),%s\n", opc_regName8(src));
-    }
 
-    // INI instruction.
-    else if (next_opc == 0xA2) {
-        opc_tbl[0xED].TStates = 16;
-        uint8_t res = cpu->portIO_in(cpu->board, cpu->C);
-        cpu_write(cpu, res, cpu->HL);
-        cpu->B--;
-        cpu->HL++;
-
-        SET_FLAG_ADDSUB(cpu);
-        if (cpu->B)
-            RESET_FLAG_ZERO(cpu);
-        else
-            SET_FLAG_ZERO(cpu);
-
-        LOG_DEBUG("Executed INI\n");
-    }
+// OUTD instruction.
+static void opc_OUTD(cpu_t *cpu, uint8_t opcode) {
+    uint8_t res = cpu_read(cpu, cpu->HL);
+    cpu_portOut(cpu, cpu->C, res);
+    cpu->B--;
+    cpu->HL--;
 
-    // OUTI instruction.
-    else if (next_opc == 0xA3) {
-        opc_tbl[0xED].TStates = 16;
-        uint8_t res = cpu_read(cpu, cpu->HL);
-        cpu->portIO_out(cpu->board, cpu->C, res);
-        cpu->B--;
-        cpu->HL++;
-
-        SET_FLAG_ADDSUB(cpu);
-        if (cpu->B)
-            RESET_FLAG_ZERO(cpu);
-        else
-            SET_FLAG_ZERO(cpu);
-
-        LOG_DEBUG("Executed OUTI\n");
-    }
+    SET_FLAG_ADDSUB(cpu);
+    if (cpu->B)
+        RESET_FLAG_ZERO(cpu);
+    else
+        SET_FLAG_ZERO(cpu);
 
-    // IND instruction.
-    else if (next_opc == 0xAA) {
-        opc_tbl[0xED].TStates = 16;
-        uint8_t res = cpu->portIO_in(cpu->board, cpu->C);
-        cpu_write(cpu, res, cpu->HL);
-        cpu->B--;
-        cpu->HL--;
-
-        SET_FLAG_ADDSUB(cpu);
-        if (cpu->B)
-            RESET_FLAG_ZERO(cpu);
-        else
-            SET_FLAG_ZERO(cpu);
-
-        LOG_DEBUG("Executed IND\n");
-    }
+    LOG_DEBUG("Executed OUTD\n");
+    return;
+}
 
-    // OUTD instruction.
-    else if (next_opc == 0xAB) {
-        opc_tbl[0xED].TStates = 16;
-        uint8_t res = cpu_read(cpu, cpu->HL);
-        cpu->portIO_out(cpu->board, cpu->C, res);
-        cpu->B--;
-        cpu->HL--;
-
-        SET_FLAG_ADDSUB(cpu);
-        if (cpu->B)
-            RESET_FLAG_ZERO(cpu);
-        else
-            SET_FLAG_ZERO(cpu);
-
-        LOG_DEBUG("Executed OUTD\n");
-    }
 
-    else {
-        LOG_FATAL("Invalid operation in 0xED instruction group.\n");
-        raise(SIGINT);
-    }
+// Undefined instruction in the 0xED instruction group.
+static void opc_invalidED(cpu_t *cpu, uint8_t opcode) {
+    LOG_FATAL("Invalid operation in 0xED instruction group.\n");
+    cpu_fault(cpu);
+    return;
 }
 
 
@@ -2135,6 +1785,8 @@ static void opc_LDSPHL(cpu_t *cpu, uint8_t opcode) {
 // PUSH qq instruction.
 static void opc_PUSHqq(cpu_t *cpu, uint8_t opcode) {
     uint8_t src = ((opcode >> 4) & 0x03);
+    if (src == 0x03)
+        cpu_getF(cpu);
     cpu_stackPush(cpu, opc_readReg16(cpu, src, REG16_QQ));
     LOG_DEBUG("Executed PUSH %s\n", opc_regName16(src, REG16_QQ));
     return;
@@ -2145,6 +1797,10 @@ static void opc_PUSHqq(cpu_t *cpu, uint8_t opcode) {
 static void opc_POPqq(cpu_t *cpu, uint8_t opcode) {
     uint8_t dst = ((opcode >> 4) & 0x03);
     opc_writeReg16(cpu, dst, cpu_stackPop(cpu), REG16_QQ);
+#ifdef CPU_LAZYFLAGS
+    if (dst == 0x03)
+        cpu->flags_op = FLAGS_NONE;
+#endif
     LOG_DEBUG("Executed POP %s\n", opc_regName16(dst, REG16_QQ));
     return;
 }
@@ -2160,6 +1816,7 @@ static void opc_EXDEHL(cpu_t *cpu, uint8_t opcode) {
 
 // EX AF,AF' instruction.
 static void opc_EXAFAFr(cpu_t *cpu, uint8_t opcode) {
+    cpu_getF(cpu);
     FASTSWAP(cpu->AF, cpu->ArFr);
     LOG_DEBUG("Executed EX AF,AF'\n");
     return;
@@ -2195,7 +1852,7 @@ static void opc_ADDAr(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = opc_readReg(cpu, src);
     uint8_t res = cpu->A + data;
 
-    opc_setFlagsAdd8(cpu, cpu->A, data, 0, res);
+    opc_setFlagsAdd8(cpu, cpu->A, data, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed ADD A,%s\n", opc_regName8(src));
@@ -2209,7 +1866,7 @@ static void opc_SUBAr(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = opc_readReg(cpu, src);
     uint8_t res = cpu->A - data;
 
-    opc_setFlagsSub8(cpu, cpu->A, data, 0, res);
+    opc_setFlagsSub8(cpu, cpu->A, data, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed SUB A,%s\n", opc_regName8(src));
@@ -2222,7 +1879,7 @@ static void opc_ADDAn(cpu_t *cpu, uint8_t opcode) {
     uint8_t n = opc_fetch8(cpu);
     uint8_t res = cpu->A + n;
 
-    opc_setFlagsAdd8(cpu, cpu->A, n, 0, res);
+    opc_setFlagsAdd8(cpu, cpu->A, n, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed ADD A,0x%02hhX\n", n);
@@ -2235,7 +1892,7 @@ static void opc_SUBAn(cpu_t *cpu, uint8_t opcode) {
     uint8_t n = opc_fetch8(cpu);
     uint8_t res = cpu->A - n;
 
-    opc_setFlagsSub8(cpu, cpu->A, n, 0, res);
+    opc_setFlagsSub8(cpu, cpu->A, n, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed SUB A,0x%02hhX\n", n);
@@ -2248,7 +1905,7 @@ static void opc_ADDAHL(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = cpu_read(cpu, cpu->HL);
     uint8_t res = cpu->A + data;
 
-    opc_setFlagsAdd8(cpu, cpu->A, data, 0, res);
+    opc_setFlagsAdd8(cpu, cpu->A, data, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed ADD A,(HL) HL=0x%04X\n", cpu->HL);
@@ -2261,7 +1918,7 @@ static void opc_SUBAHL(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = cpu_read(cpu, cpu->HL);
     uint8_t res = cpu->A - data;
 
-    opc_setFlagsSub8(cpu, cpu->A, data, 0, res);
+    opc_setFlagsSub8(cpu, cpu->A, data, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed SUB A,(HL) HL=0x%04X\n", cpu->HL);
@@ -2276,7 +1933,7 @@ static void opc_ADCAr(cpu_t *cpu, uint8_t opcode) {
     uint8_t c = GET_FLAG_CARRY(cpu);
     uint8_t res = cpu->A + data + c;
 
-    opc_setFlagsAdd8(cpu, cpu->A, data, c, res);
+    opc_setFlagsAdd8(cpu, cpu->A, data, c);
 
     cpu->A = res;
     LOG_DEBUG("Executed ADC A,%s\n", opc_regName8(src));
@@ -2291,7 +1948,7 @@ static void opc_SBCAr(cpu_t *cpu, uint8_t opcode) {
     uint8_t c = GET_FLAG_CARRY(cpu);
     uint8_t res = cpu->A - data - c;
 
-    opc_setFlagsSub8(cpu, cpu->A, data, c, res);
+    opc_setFlagsSub8(cpu, cpu->A, data, c);
 
     cpu->A = res;
     LOG_DEBUG("Executed SBC A,%s\n", opc_regName8(src));
@@ -2305,7 +1962,7 @@ static void opc_ADCAn(cpu_t *cpu, uint8_t opcode) {
     uint8_t c = GET_FLAG_CARRY(cpu);
     uint8_t res = cpu->A + n + c;
 
-    opc_setFlagsAdd8(cpu, cpu->A, n, c, res);
+    opc_setFlagsAdd8(cpu, cpu->A, n, c);
 
     cpu->A = res;
     LOG_DEBUG("Executed ADC A,0x%02hhX\n", n);
@@ -2319,7 +1976,7 @@ static void opc_SBCAn(cpu_t *cpu, uint8_t opcode) {
     uint8_t c = GET_FLAG_CARRY(cpu);
     uint8_t res = cpu->A - n - c;
 
-    opc_setFlagsSub8(cpu, cpu->A, n, c, res);
+    opc_setFlagsSub8(cpu, cpu->A, n, c);
 
     cpu->A = res;
     LOG_DEBUG("Executed SBC A,0x%02hhX\n", n);
@@ -2333,7 +1990,7 @@ static void opc_ADCAHL(cpu_t *cpu, uint8_t opcode) {
     uint8_t c = GET_FLAG_CARRY(cpu);
     uint8_t res = cpu->A + data + c;
 
-    opc_setFlagsAdd8(cpu, cpu->A, data, c, res);
+    opc_setFlagsAdd8(cpu, cpu->A, data, c);
 
     cpu->A = res;
     LOG_DEBUG("Executed ADC A,(HL) HL=0x%04X\n", cpu->HL);
@@ -2347,7 +2004,7 @@ static void opc_SBCAHL(cpu_t *cpu, uint8_t opcode) {
     uint8_t c = GET_FLAG_CARRY(cpu);
     uint8_t res = cpu->A - data - c;
 
-    opc_setFlagsSub8(cpu, cpu->A, data, c, res);
+    opc_setFlagsSub8(cpu, cpu->A, data, c);
 
     cpu->A = res;
     LOG_DEBUG("Executed SBC A,(HL) HL=0x%04X\n", cpu->HL);
@@ -2361,12 +2018,7 @@ static void opc_ANDr(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = opc_readReg(cpu, src);
     uint8_t res = cpu->A & data;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    SET_FLAG_HCARRY(cpu);
-    opc_testPFlag8(cpu, res);
-    RESET_FLAG_ADDSUB(cpu);
-    RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, FLAG_HCARRY);
 
     cpu->A = res;
     LOG_DEBUG("Executed AND %s\n", opc_regName8(src));
@@ -2379,12 +2031,7 @@ static void opc_ANDn(cpu_t *cpu, uint8_t opcode) {
     uint8_t n = opc_fetch8(cpu);
     uint8_t res = cpu->A & n;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    SET_FLAG_HCARRY(cpu);
-    opc_testPFlag8(cpu, res);
-    RESET_FLAG_ADDSUB(cpu);
-    RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, FLAG_HCARRY);
 
     cpu->A = res;
     LOG_DEBUG("Executed AND 0x%02hhX\n", n);
@@ -2397,12 +2044,7 @@ static void opc_ANDHL(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = cpu_read(cpu, cpu->HL);
     uint8_t res = cpu->A & data;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    SET_FLAG_HCARRY(cpu);
-    opc_testPFlag8(cpu, res);
-    RESET_FLAG_ADDSUB(cpu);
-    RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, FLAG_HCARRY);
 
     cpu->A = res;
     LOG_DEBUG("Executed AND (HL) HL=0x%04X\n", cpu->HL);
@@ -2416,12 +2058,7 @@ static void opc_ORr(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = opc_readReg(cpu, src);
     uint8_t res = cpu->A | data;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    RESET_FLAG_HCARRY(cpu);
-    opc_testPFlag8(cpu, res);
-    RESET_FLAG_ADDSUB(cpu);
-    RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed OR %s\n", opc_regName8(src));
@@ -2434,12 +2071,7 @@ static void opc_ORn(cpu_t *cpu, uint8_t opcode) {
     uint8_t n = opc_fetch8(cpu);
     uint8_t res = cpu->A | n;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    RESET_FLAG_HCARRY(cpu);
-    opc_testPFlag8(cpu, res);
-    RESET_FLAG_ADDSUB(cpu);
-    RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed OR 0x%02hhX\n", n);
@@ -2452,12 +2084,7 @@ static void opc_ORHL(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = cpu_read(cpu, cpu->HL);
     uint8_t res = cpu->A | data;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    RESET_FLAG_HCARRY(cpu);
-    opc_testPFlag8(cpu, res);
-    RESET_FLAG_ADDSUB(cpu);
-    RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed OR (HL) HL=0x%04X\n", cpu->HL);
@@ -2471,12 +2098,7 @@ static void opc_XORr(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = opc_readReg(cpu, src);
     uint8_t res = cpu->A ^ data;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    RESET_FLAG_HCARRY(cpu);
-    opc_testPFlag8(cpu, res);
-    RESET_FLAG_ADDSUB(cpu);
-    RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed XOR %s\n", opc_regName8(src));
@@ -2489,12 +2111,7 @@ static void opc_XORn(cpu_t *cpu, uint8_t opcode) {
     uint8_t n = opc_fetch8(cpu);
     uint8_t res = cpu->A ^ n;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    RESET_FLAG_HCARRY(cpu);
-    opc_testPFlag8(cpu, res);
-    RESET_FLAG_ADDSUB(cpu);
-    RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed XOR 0x%02hhX\n", n);
@@ -2507,12 +2124,7 @@ static void opc_XORHL(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = cpu_read(cpu, cpu->HL);
     uint8_t res = cpu->A ^ data;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    RESET_FLAG_HCARRY(cpu);
-    opc_testPFlag8(cpu, res);
-    RESET_FLAG_ADDSUB(cpu);
-    RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, 0);
 
     cpu->A = res;
     LOG_DEBUG("Executed XOR (HL) HL=0x%04X\n", cpu->HL);
@@ -2523,10 +2135,9 @@ static void opc_XORHL(cpu_t *cpu, uint8_t opcode) {
 // CP r instruction.
 static void opc_CPr(cpu_t *cpu, uint8_t opcode) {
     uint8_t src = (opcode & 0x07);
-    uint8_t data = cpu_read(cpu, src);
-    uint8_t res = cpu->A - data;
+    uint8_t data = opc_readReg(cpu, src);
 
-    opc_setFlagsSub8(cpu, cpu->A, data, 0, res);
+    opc_setFlagsSub8(cpu, cpu->A, data, 0);
 
     LOG_DEBUG("Executed CP %s\n", opc_regName8(src));
     return;
@@ -2536,9 +2147,8 @@ static void opc_CPr(cpu_t *cpu, uint8_t opcode) {
 // CP n instruction.
 static void opc_CPn(cpu_t *cpu, uint8_t opcode) {
     uint8_t n = opc_fetch8(cpu);
-    uint8_t res = cpu->A - n;
 
-    opc_setFlagsSub8(cpu, cpu->A, n, 0, res);
+    opc_setFlagsSub8(cpu, cpu->A, n, 0);
 
     LOG_DEBUG("Executed CP 0x%02X\n", n);
     return;
@@ -2548,9 +2158,8 @@ static void opc_CPn(cpu_t *cpu, uint8_t opcode) {
 // CP (HL) instruction.
 static void opc_CPHL(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = cpu_read(cpu, cpu->HL);
-    uint8_t res = cpu->A - data;
 
-    opc_setFlagsSub8(cpu, cpu->A, data, 0, res);
+    opc_setFlagsSub8(cpu, cpu->A, data, 0);
 
     LOG_DEBUG("Executed CP (HL) HL=0x%04X\n", cpu->HL);
     return;
@@ -2560,20 +2169,12 @@ static void opc_CPHL(cpu_t *cpu, uint8_t opcode) {
 // INC r instruction.
 static void opc_INCr(cpu_t *cpu, uint8_t opcode) {
     uint8_t src = ((opcode >> 3) & 0x07);
-    uint8_t data = opc_readReg(cpu, src);
-    uint8_t res = data + 1;
-
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    opc_testHFlag8(cpu, data, 1, 0, IS_ADD);
-    RESET_FLAG_ADDSUB(cpu);
+    uint8_t *reg = opc_reg8(cpu, src);
+    uint8_t data = *reg;
 
-    if (data == 0x7F)
-        SET_FLAG_PARITY(cpu);
-    else
-        RESET_FLAG_PARITY(cpu);
+    opc_setFlagsInc8(cpu, data);
 
-    opc_writeReg(cpu, src, res);
+    *reg = data + 1;
     LOG_DEBUG("Executed INC %s\n", opc_regName8(src));
     return;
 }
@@ -2584,15 +2185,7 @@ static void opc_INCHL(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = cpu_read(cpu, cpu->HL);
     uint8_t res = data + 1;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    opc_testHFlag8(cpu, data, 1, 0, IS_ADD);
-    RESET_FLAG_ADDSUB(cpu);
-
-    if (data == 0x7F)
-        SET_FLAG_PARITY(cpu);
-    else
-        RESET_FLAG_PARITY(cpu);
+    opc_setFlagsInc8(cpu, data);
 
     cpu_write(cpu, res, cpu->HL);
     LOG_DEBUG("Executed INC (HL) HL=0x%04X\n", cpu->HL);
@@ -2603,20 +2196,12 @@ static void opc_INCHL(cpu_t *cpu, uint8_t opcode) {
 // DEC r instruction.
 static void opc_DECr(cpu_t *cpu, uint8_t opcode) {
     uint8_t src = ((opcode >> 3) & 0x07);
-    uint8_t data = opc_readReg(cpu, src);
-    uint8_t res = data - 1;
-
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    opc_testHFlag8(cpu, data, 1, 0, IS_SUB);
-    SET_FLAG_ADDSUB(cpu);
+    uint8_t *reg = opc_reg8(cpu, src);
+    uint8_t data = *reg;
 
-    if (data == 0x80)
-        SET_FLAG_PARITY(cpu);
-    else
-        RESET_FLAG_PARITY(cpu);
+    opc_setFlagsDec8(cpu, data);
 
-    opc_writeReg(cpu, src, res);
+    *reg = data - 1;
     LOG_DEBUG("Executed DEC %s\n", opc_regName8(src));
     return;
 }
@@ -2627,15 +2212,7 @@ static void opc_DECHL(cpu_t *cpu, uint8_t opcode) {
     uint8_t data = cpu_read(cpu, cpu->HL);
     uint8_t res = data - 1;
 
-    opc_testSFlag8(cpu, res);
-    opc_testZFlag8(cpu, res);
-    opc_testHFlag8(cpu, data, 1, 0, IS_SUB);
-    SET_FLAG_ADDSUB(cpu);
-
-    if (data == 0x80)
-        SET_FLAG_PARITY(cpu);
-    else
-        RESET_FLAG_PARITY(cpu);
+    opc_setFlagsDec8(cpu, data);
 
     cpu_write(cpu, res, cpu->HL);
     LOG_DEBUG("Executed DEC (HL) HL=0x%04X\n", cpu->HL);
@@ -2646,7 +2223,7 @@ static void opc_DECHL(cpu_t *cpu, uint8_t opcode) {
 // TODO: DAA
 static void opc_DAA(cpu_t *cpu, uint8_t opcode) {
     LOG_FATAL("DAA instruction is not implemented yet.\n");
-    raise(SIGINT);
+    cpu_fault(cpu);
     return;
 }
 
@@ -2845,412 +2422,301 @@ static void opc_RRA(cpu_t *cpu, uint8_t opcode) {
 }
 
 
-static void opc_RLC(cpu_t *cpu, uint8_t opcode) {
-    opc_tbl[0xCB].TStates = 8;
-    uint8_t next_opc = opc_fetch8(cpu);
+// RLC r instruction.
+static void opc_RLCr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
+    uint8_t msb = (data & 0x80) >> 7;
+    uint8_t res = ((data << 1) | msb);
 
-    // RLCr instruction.
-    if ((next_opc >= 0 && next_opc <= 7) && next_opc != 6) {
-        uint8_t src = (next_opc & 0x07);
-        uint8_t data = opc_readReg(cpu, src);
-        uint8_t msb = (data & 0x80) >> 7;
-        uint8_t res = ((data << 1) | msb);
+    opc_setFlagsSZP8(cpu, res, msb);
 
-        if (msb)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    opc_writeReg(cpu, src, res);
+    LOG_DEBUG("Executed RLC %s\n", opc_regName8(src));
+    return;
+}
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
 
-        opc_writeReg(cpu, src, res);
-        LOG_DEBUG("Executed RLC %s\n", opc_regName8(src));
-    }
+// RLC (HL) instruction.
+static void opc_RLCHL(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, cpu->HL);
+    uint8_t msb = (data & 0x80) >> 7;
+    uint8_t res = ((data << 1) | msb);
 
-    // RLC (HL) instruction.
-    else if (next_opc == 0x06) {
-        opc_tbl[0xCB].TStates = 15;
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        uint8_t msb = (data & 0x80) >> 7;
-        uint8_t res = ((data << 1) | msb);
+    opc_setFlagsSZP8(cpu, res, msb);
 
-        if (msb)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed RLC (HL) HL=0x%04X\n", cpu->HL);
+    return;
+}
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
 
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed RLC (HL) HL=0x%04X\n", cpu->HL);
-    }
+// RRC r instruction.
+static void opc_RRCr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
+    uint8_t lsb = (data & 0x1);
 
-    // BIT b,r instruction.
-    else if ((next_opc & 0xC0) == 0x40) {
-        uint8_t bit = ((next_opc >> 3) & 0x07);
-        uint8_t src = (next_opc & 0x07);
-        uint8_t data = opc_readReg(cpu, src);
-        uint8_t res = ((data >> bit) & 0x1);
+    uint8_t res = ((data >> 1) | (lsb << 7));
 
-        opc_testZFlag8(cpu, res);
-        SET_FLAG_HCARRY(cpu);
-        RESET_FLAG_ADDSUB(cpu);
+    opc_setFlagsSZP8(cpu, res, lsb);
 
-        LOG_DEBUG("Executed BIT %d,%s\n", bit, opc_regName8(src));
-    }
+    opc_writeReg(cpu, src, res);
+    LOG_DEBUG("Executed RRC %s\n", opc_regName8(src));
+    return;
+}
 
-    // BIT b,(HL) instruction.
-    else if ((next_opc & 0xC7) == 0x46) {
-        opc_tbl[0xCB].TStates = 12;
-        uint8_t bit = ((next_opc >> 3) & 0x07);
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        uint8_t res = ((data >> bit) & 0x1);
 
-        opc_testZFlag8(cpu, res);
-        SET_FLAG_HCARRY(cpu);
-        RESET_FLAG_ADDSUB(cpu);
+// RRC (HL) instruction.
+static void opc_RRCHL(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, cpu->HL);
+    uint8_t lsb = (data & 0x1);
 
-        LOG_DEBUG("Executed BIT %d,(HL) HL=0x%04X\n", bit, cpu->HL);
-    }
+    uint8_t res = ((data >> 1) | (lsb << 7));
 
-    // SET b,r instruction.
-    else if ((next_opc & 0xC0) == 0xC0) {
-        uint8_t bit = ((next_opc >> 3) & 0x07);
-        uint8_t src = (next_opc & 0x07);
-        uint8_t data = opc_readReg(cpu, src);
-        uint8_t res = data | (1 << bit);
-        opc_writeReg(cpu, src, res);
-        LOG_DEBUG("Executed SET %d,%s\n", bit, opc_regName8(src));
-    }
+    opc_setFlagsSZP8(cpu, res, lsb);
 
-    // SET b,(HL) instruction.
-    else if ((next_opc & 0xC7) == 0xC6) {
-        opc_tbl[0xCB].TStates = 15;
-        uint8_t bit = ((next_opc >> 3) & 0x07);
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        uint8_t res = data | (1 << bit);
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed SET %d,(HL) HL=0x%04X\n", bit, cpu->HL);
-    }
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed RRC (HL) HL=0x%04X\n", cpu->HL);
+    return;
+}
 
-    // RES b,r instruction.
-    else if ((next_opc & 0xC0) == 0x80) {
-        uint8_t bit = ((next_opc >> 3) & 0x07);
-        uint8_t src = (next_opc & 0x07);
-        uint8_t data = opc_readReg(cpu, src);
-        uint8_t res = data & ~(1 << bit);
-        opc_writeReg(cpu, src, res);
-        LOG_DEBUG("Executed RES %d,%s\n", bit, opc_regName8(src));
-    }
 
-    // RES b,(HL) instruction.
-    else if ((next_opc & 0xC7) == 0x86) {
-        opc_tbl[0xCB].TStates = 15;
-        uint8_t bit = ((next_opc >> 3) & 0x07);
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        uint8_t res = data & ~(1 << bit);
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed RES %d,(HL) HL=0x%04X\n", bit, cpu->HL);
-    }
+// RL r instruction.
+static void opc_RLr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
+    uint8_t c = GET_FLAG_CARRY(cpu);
 
-    // RL r instruction.
-    else if ((next_opc & 0xF8) == 0x10) {
-        uint8_t src = (next_opc & 0x07);
-        uint8_t data = opc_readReg(cpu, src);
-        uint8_t c = GET_FLAG_CARRY(cpu);
+    uint8_t res = ((data << 1) | c);
 
-        // MSB in carry flag.
-        if (data & 0x80)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, (data >> 7));
 
-        uint8_t res = ((data << 1) | c);
+    opc_writeReg(cpu, src, res);
+    LOG_DEBUG("Executed RL %s\n", opc_regName8(src));
+    return;
+}
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
 
-        opc_writeReg(cpu, src, res);
-        LOG_DEBUG("Executed RL %s\n", opc_regName8(src));
-    }
+// RL (HL) instruction.
+static void opc_RLHL(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, cpu->HL);
+    uint8_t c = GET_FLAG_CARRY(cpu);
+
+    uint8_t res = ((data << 1) | c);
 
-    // RL (HL) instruction.
-    else if (next_opc == 0x16) {
-        opc_tbl[0xCB].TStates = 15;
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        uint8_t c = GET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, (data >> 7));
 
-        // MSB in carry flag.
-        if (data & 0x80)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed RL (HL) HL=0x%04X\n", cpu->HL);
+    return;
+}
 
-        uint8_t res = ((data << 1) | c);
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// RR r instruction.
+static void opc_RRr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
+    uint8_t c = GET_FLAG_CARRY(cpu);
 
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed RL (HL) HL=0x%04X\n", cpu->HL);
-    }
+    uint8_t res = ((data >> 1) | (c << 7));
 
-    // RRC r instruction.
-    else if ((next_opc & 0xF8) == 0x08) {
-        uint8_t src = (next_opc & 0x07);
-        uint8_t data = opc_readReg(cpu, src);
-        uint8_t lsb = (data & 0x1);
+    opc_setFlagsSZP8(cpu, res, (data & 0x1));
 
-        // LSB in carry flag.
-        if (lsb)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    opc_writeReg(cpu, src, res);
+    LOG_DEBUG("Executed RR %s\n", opc_regName8(src));
+    return;
+}
 
-        uint8_t res = ((data >> 1) | (lsb << 7));
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// RR (HL) instruction.
+static void opc_RRHL(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, cpu->HL);
+    uint8_t c = GET_FLAG_CARRY(cpu);
 
-        opc_writeReg(cpu, src, res);
-        LOG_DEBUG("Executed RRC %s\n", opc_regName8(src));
-    }
+    uint8_t res = ((data >> 1) | (c << 7));
 
-    // RRC (HL) instruction.
-    else if (next_opc == 0x0E) {
-        opc_tbl[0xCB].TStates = 15;
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        uint8_t lsb = (data & 0x1);
+    opc_setFlagsSZP8(cpu, res, (data & 0x1));
 
-        // LSB in carry flag.
-        if (lsb)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed RR (HL) HL=0x%04X\n", cpu->HL);
+    return;
+}
 
-        uint8_t res = ((data >> 1) | (lsb << 7));
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// SLA r instruction.
+static void opc_SLAr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
 
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed RRC (HL) HL=0x%04X\n", cpu->HL);
-    }
+    uint8_t res = (data << 1);
 
-    // RR r instruction.
-    else if ((next_opc & 0xF8) == 0x18) {
-        uint8_t src = (next_opc & 0x07);
-        uint8_t data = opc_readReg(cpu, src);
-        uint8_t c = GET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, (data >> 7));
 
-        // LSB in carry flag.
-        if (data & 0x1)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    opc_writeReg(cpu, src, res);
+    LOG_DEBUG("Executed SLA %s\n", opc_regName8(src));
+    return;
+}
 
-        uint8_t res = ((data >> 1) | (c << 7));
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// SLA (HL) instruction.
+static void opc_SLAHL(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, cpu->HL);
 
-        opc_writeReg(cpu, src, res);
-        LOG_DEBUG("Executed RR %s\n", opc_regName8(src));
-    }
+    uint8_t res = (data << 1);
 
-    // RR (HL) instruction.
-    else if (next_opc == 0x1E) {
-        opc_tbl[0xCB].TStates = 15;
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        uint8_t c = GET_FLAG_CARRY(cpu);
+    opc_setFlagsSZP8(cpu, res, (data >> 7));
 
-        // LSB in carry flag.
-        if (data & 0x1)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed SLA (HL) HL=0x%04X\n", cpu->HL);
+    return;
+}
 
-        uint8_t res = ((data >> 1) | (c << 7));
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// SRA r instruction.
+static void opc_SRAr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
+    uint8_t msb = (data & 0x80);
+    uint8_t lsb = (data & 0x1);
 
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed RR (HL) HL=0x%04X\n", cpu->HL);
-    }
+    uint8_t res = ((data >> 1) | msb);
 
-    // SLA r instruction.
-    else if ((next_opc & 0xF8) == 0x20) {
-        uint8_t src = (next_opc & 0x07);
-        uint8_t data = opc_readReg(cpu, src);
+    opc_setFlagsSZP8(cpu, res, lsb);
 
-        // MSB in carry bit
-        if (data & 0x80)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    opc_writeReg(cpu, src, res);
+    LOG_DEBUG("Executed SRA %s\n", opc_regName8(src));
+    return;
+}
 
-        uint8_t res = (data << 1);
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// SRA (HL) instruction.
+static void opc_SRAHL(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, cpu->HL);
+    uint8_t msb = (data & 0x80);
+    uint8_t lsb = (data & 0x1);
 
-        opc_writeReg(cpu, src, res);
-        LOG_DEBUG("Executed SLA %s\n", opc_regName8(src));
-    }
+    uint8_t res = ((data >> 1) | msb);
 
-    // SLA (HL) instruction.
-    else if (next_opc == 0x26) {
-        opc_tbl[0xCB].TStates = 15;
-        uint8_t data = cpu_read(cpu, cpu->HL);
+    opc_setFlagsSZP8(cpu, res, lsb);
 
-        // MSB in carry bit
-        if (data & 0x80)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed SRA (HL) HL=0x%04X\n", cpu->HL);
+    return;
+}
 
-        uint8_t res = (data << 1);
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// SRL r instruction.
+static void opc_SRLr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
 
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed SLA (HL) HL=0x%04X\n", cpu->HL);
-    }
+    uint8_t res = (data >> 1);
 
-    // SRA r instruction.
-    else if ((next_opc & 0xF8) == 0x28) {
-        uint8_t src = (next_opc & 0x07);
-        uint8_t data = opc_readReg(cpu, src);
-        uint8_t msb = (data & 0x80);
-        uint8_t lsb = (data & 0x1);
+    opc_setFlagsSZP8(cpu, res, (data & 0x1));
 
-        // LSB in carry flag.
-        if (lsb)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    opc_writeReg(cpu, src, res);
+    LOG_DEBUG("Executed SRL %s\n", opc_regName8(src));
+    return;
+}
 
-        uint8_t res = ((data >> 1) | msb);
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// SRL (HL) instruction.
+static void opc_SRLHL(cpu_t *cpu, uint8_t opcode) {
+    uint8_t data = cpu_read(cpu, cpu->HL);
+
+    uint8_t res = (data >> 1);
+
+    opc_setFlagsSZP8(cpu, res, (data & 0x1));
+
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed SRL (HL) HL=0x%04X\n", cpu->HL);
+    return;
+}
 
-        opc_writeReg(cpu, src, res);
-        LOG_DEBUG("Executed SRA %s\n", opc_regName8(src));
-    }
 
-    // SRA (HL) instruction.
-    else if (next_opc == 0x2E) {
-        opc_tbl[0xCB].TStates = 15;
-        uint8_t data = cpu_read(cpu, cpu->HL);
-        uint8_t msb = (data & 0x80);
-        uint8_t lsb = (data & 0x1);
+// BIT b,r instruction.
+static void opc_BITbr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t bit = ((opcode >> 3) & 0x07);
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
+    uint8_t res = ((data >> bit) & 0x1);
+
+    opc_testZFlag8(cpu, res);
+    SET_FLAG_HCARRY(cpu);
+    RESET_FLAG_ADDSUB(cpu);
 
-        // LSB in carry flag.
-        if (lsb)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+    LOG_DEBUG("Executed BIT %d,%s\n", bit, opc_regName8(src));
+    return;
+}
 
-        uint8_t res = ((data >> 1) | msb);
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// BIT b,(HL) instruction.
+static void opc_BITbHL(cpu_t *cpu, uint8_t opcode) {
+    uint8_t bit = ((opcode >> 3) & 0x07);
+    uint8_t data = cpu_read(cpu, cpu->HL);
+    uint8_t res = ((data >> bit) & 0x1);
 
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed SRA (HL) HL=0x%04X\n", cpu->HL);
-    }
+    opc_testZFlag8(cpu, res);
+    SET_FLAG_HCARRY(cpu);
+    RESET_FLAG_ADDSUB(cpu);
 
-    // SRL r instruction.
-    else if ((next_opc & 0xF8) == 0x38) {
-        uint8_t src = (next_opc & 0x07);
-        uint8_t data = opc_readReg(cpu, src);
+    LOG_DEBUG("Executed BIT %d,(HL) HL=0x%04X\n", bit, cpu->HL);
+    return;
+}
 
-        // LSB in carry flag.
-        if (data & 0x1)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
 
-        uint8_t res = (data >> 1);
+// SET b,r instruction.
+static void opc_SETbr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t bit = ((opcode >> 3) & 0x07);
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
+    uint8_t res = data | (1 << bit);
+    opc_writeReg(cpu, src, res);
+    LOG_DEBUG("Executed SET %d,%s\n", bit, opc_regName8(src));
+    return;
+}
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
 
-        opc_writeReg(cpu, src, res);
-        LOG_DEBUG("Executed SRL %s\n", opc_regName8(src));
-    }
+// SET b,(HL) instruction.
+static void opc_SETbHL(cpu_t *cpu, uint8_t opcode) {
+    uint8_t bit = ((opcode >> 3) & 0x07);
+    uint8_t data = cpu_read(cpu, cpu->HL);
+    uint8_t res = data | (1 << bit);
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed SET %d,(HL) HL=0x%04X\n", bit, cpu->HL);
+    return;
+}
 
-    // SRL (HL) instruction.
-    else if (next_opc == 0x3E) {
-        opc_tbl[0xCB].TStates = 15;
-        uint8_t data = cpu_read(cpu, cpu->HL);
 
-        // LSB in carry flag.
-        if (data & 0x1)
-            SET_FLAG_CARRY(cpu);
-        else
-            RESET_FLAG_CARRY(cpu);
+// RES b,r instruction.
+static void opc_RESbr(cpu_t *cpu, uint8_t opcode) {
+    uint8_t bit = ((opcode >> 3) & 0x07);
+    uint8_t src = (opcode & 0x07);
+    uint8_t data = opc_readReg(cpu, src);
+    uint8_t res = data & ~(1 << bit);
+    opc_writeReg(cpu, src, res);
+    LOG_DEBUG("Executed RES %d,%s\n", bit, opc_regName8(src));
+    return;
+}
 
-        uint8_t res = (data >> 1);
 
-        opc_testSFlag8(cpu, res);
-        opc_testZFlag8(cpu, res);
-        RESET_FLAG_HCARRY(cpu);
-        opc_testPFlag8(cpu, res);
-        RESET_FLAG_ADDSUB(cpu);
+// RES b,(HL) instruction.
+static void opc_RESbHL(cpu_t *cpu, uint8_t opcode) {
+    uint8_t bit = ((opcode >> 3) & 0x07);
+    uint8_t data = cpu_read(cpu, cpu->HL);
+    uint8_t res = data & ~(1 << bit);
+    cpu_write(cpu, res, cpu->HL);
+    LOG_DEBUG("Executed RES %d,(HL) HL=0x%04X\n", bit, cpu->HL);
+    return;
+}
 
-        cpu_write(cpu, res, cpu->HL);
-        LOG_DEBUG("Executed SRL (HL) HL=0x%04X\n", cpu->HL);
-    }
 
-    else {
-        LOG_FATAL("Invalid RLC instruction.\n");
-        raise(SIGINT);
-    }
+// Undefined instruction in the 0xCB instruction group.
+static void opc_invalidCB(cpu_t *cpu, uint8_t opcode) {
+    LOG_FATAL("Invalid operation in 0xCB instruction group.\n");
+    cpu_fault(cpu);
+    return;
 }
 
 
@@ -3311,7 +2777,7 @@ static void opc_JPccnn(cpu_t *cpu, uint8_t opcode) {
             break;
         default:
             LOG_FATAL("Invalid 'cc' in JP cc,nn instruction.\n");
-            raise(SIGINT);
+            cpu_fault(cpu);
     }
     return;
 }
@@ -3328,13 +2794,13 @@ static void opc_JRe(cpu_t *cpu, uint8_t opcode) {
 
 // JR C,e instruction.
 static void opc_JRCe(cpu_t *cpu, uint8_t opcode) {
-    opc_tbl[0x38].TStates = 12;  // Condition is met.
     int8_t e = (int8_t)opc_fetch8(cpu);
 
-    if (GET_FLAG_CARRY(cpu))
+    if (GET_FLAG_CARRY(cpu)) {
         cpu->PC += e;
-    else
-        opc_tbl[0x38].TStates = 7;  // Condition is not met.
+        cpu->cycles += 12; // Condition is met.
+    } else
+        cpu->cycles += 7;  // Condition is not met.
 
     LOG_DEBUG("Executed JR C,0x%02hhX\n", e);
     return;
@@ -3343,13 +2809,13 @@ static void opc_JRCe(cpu_t *cpu, uint8_t opcode) {
 
 // JR NC, e instruction.
 static void opc_JRNCe(cpu_t *cpu, uint8_t opcode) {
-    opc_tbl[0x30].TStates = 12;  // Condition is met.
     int8_t e = (int8_t)opc_fetch8(cpu);
 
-    if (!GET_FLAG_CARRY(cpu))
+    if (!GET_FLAG_CARRY(cpu)) {
         cpu->PC += e;
-    else
-        opc_tbl[0x30].TStates = 7;  // Condition is not met.
+        cpu->cycles += 12; // Condition is met.
+    } else
+        cpu->cycles += 7;  // Condition is not met.
 
     LOG_DEBUG("Executed JR NC,0x%02hhX\n", e);
     return;
@@ -3358,13 +2824,13 @@ static void opc_JRNCe(cpu_t *cpu, uint8_t opcode) {
 
 // JR Z,e instruction.
 static void opc_JRZe(cpu_t *cpu, uint8_t opcode) {
-    opc_tbl[0x28].TStates = 12;  // Condition is met.
     int8_t e = (int8_t)opc_fetch8(cpu);
 
-    if (GET_FLAG_ZERO(cpu))
+    if (GET_FLAG_ZERO(cpu)) {
         cpu->PC += e;
-    else
-        opc_tbl[0x28].TStates = 7;  // Condition is not met.
+        cpu->cycles += 12; // Condition is met.
+    } else
+        cpu->cycles += 7;  // Condition is not met.
 
     LOG_DEBUG("Executed JR Z,0x%02hhX\n", e);
     return;
@@ -3373,13 +2839,13 @@ static void opc_JRZe(cpu_t *cpu, uint8_t opcode) {
 
 // JR NZ,e instruction.
 static void opc_JRNZe(cpu_t *cpu, uint8_t opcode) {
-    opc_tbl[0x20].TStates = 12;  // Condition is met.
     int8_t e = (int8_t)opc_fetch8(cpu);
 
-    if (!GET_FLAG_ZERO(cpu))
+    if (!GET_FLAG_ZERO(cpu)) {
         cpu->PC += e;
-    else
-        opc_tbl[0x20].TStates = 7;  // Condition is not met.
+        cpu->cycles += 12; // Condition is met.
+    } else
+        cpu->cycles += 7;  // Condition is not met.
 
     LOG_DEBUG("Executed JR NZ,0x%02hhX\n", e);
     return;
@@ -3400,10 +2866,10 @@ static void opc_DJNZe(cpu_t *cpu, uint8_t opcode) {
     cpu->B--;
 
     if (cpu->B) {
-        opc_tbl[0x10].TStates = 13;
         cpu->PC += e;
+        cpu->cycles += 13;
     } else
-        opc_tbl[0x10].TStates = 8;
+        cpu->cycles += 8;
 
     LOG_DEBUG("Executed DJNZ 0x%02X\n", e);
     return;
@@ -3430,77 +2896,77 @@ static void opc_CALLccnn(cpu_t *cpu, uint8_t opcode) {
             if (!GET_FLAG_ZERO(cpu)) {
                 cpu_stackPush(cpu, cpu->PC);
                 cpu->PC = nn;
-                opc_tbl[0xC4].TStates = 17;
+                cpu->cycles += 17;
             } else
-                opc_tbl[0xC4].TStates = 10;
+                cpu->cycles += 10;
             LOG_DEBUG("Executed CALL NZ,0x%04X\n", nn);
             break;
         case 0x01: // Z zero.
             if (GET_FLAG_ZERO(cpu)) {
                 cpu_stackPush(cpu, cpu->PC);
                 cpu->PC = nn;
-                opc_tbl[0xCC].TStates = 17;
+                cpu->cycles += 17;
             } else
-                opc_tbl[0xCC].TStates = 10;
+                cpu->cycles += 10;
             LOG_DEBUG("Executed CALL Z,0x%04X\n", nn);
             break;
         case 0x02: // NC no carry.
             if (!GET_FLAG_CARRY(cpu)) {
                 cpu_stackPush(cpu, cpu->PC);
                 cpu->PC = nn;
-                opc_tbl[0xD4].TStates = 17;
+                cpu->cycles += 17;
             } else
-                opc_tbl[0xD4].TStates = 10;
+                cpu->cycles += 10;
             LOG_DEBUG("Executed CALL NC,0x%04X\n", nn);
             break;
         case 0x03: // C carry.
             if (GET_FLAG_CARRY(cpu)) {
                 cpu_stackPush(cpu, cpu->PC);
                 cpu->PC = nn;
-                opc_tbl[0xDC].TStates = 17;
+                cpu->cycles += 17;
             } else
-                opc_tbl[0xDC].TStates = 10;
+                cpu->cycles += 10;
             LOG_DEBUG("Executed CALL C,0x%04X\n", nn);
             break;
         case 0x04: // P/V parity odd (P/V reset).
             if (!GET_FLAG_PARITY(cpu)) {
                 cpu_stackPush(cpu, cpu->PC);
                 cpu->PC = nn;
-                opc_tbl[0xE4].TStates = 17;
+                cpu->cycles += 17;
             } else
-                opc_tbl[0xE4].TStates = 10;
+                cpu->cycles += 10;
             LOG_DEBUG("Executed CALL PO,0x%04X\n", nn);
             break;
         case 0x05: // P/V parity even (P/V set).
             if (GET_FLAG_PARITY(cpu)) {
                 cpu_stackPush(cpu, cpu->PC);
                 cpu->PC = nn;
-                opc_tbl[0xEC].TStates = 17;
+                cpu->cycles += 17;
             } else
-                opc_tbl[0xEC].TStates = 10;
+                cpu->cycles += 10;
             LOG_DEBUG("Executed CALL PE,0x%04X\n", nn);
             break;
         case 0x06: // S sign positive (S reset).
             if(!GET_FLAG_SIGN(cpu)) {
                 cpu_stackPush(cpu, cpu->PC);
                 cpu->PC = nn;
-                opc_tbl[0xF4].TStates = 17;
+                cpu->cycles += 17;
             } else
-                opc_tbl[0xF4].TStates = 10;
+                cpu->cycles += 10;
             LOG_DEBUG("Executed CALL P,0x%04X\n", nn);
             break;
         case 0x07: // S sign negative (S set).
             if (GET_FLAG_SIGN(cpu)) {
                 cpu_stackPush(cpu, cpu->PC);
                 cpu->PC = nn;
-                opc_tbl[0xFC].TStates = 17;
+                cpu->cycles += 17;
             } else
-                opc_tbl[0xFC].TStates = 10;
+                cpu->cycles += 10;
             LOG_DEBUG("Executed CALL M,0x%04X\n", nn);
             break;
         default:
             LOG_FATAL("Invalid condition in CALL cc,nn instruction.\n");
-            raise(SIGINT);
+            cpu_fault(cpu);
     }
 }
 
@@ -3521,71 +2987,71 @@ static void opc_RETcc(cpu_t *cpu, uint8_t opcode) {
         case 0x00: // NZ non-zero.
             if (!GET_FLAG_ZERO(cpu)) {
                 cpu->PC = cpu_stackPop(cpu);
-                opc_tbl[0xC0].TStates = 11;
+                cpu->cycles += 11;
             }
             else
-                opc_tbl[0xC0].TStates = 5;
+                cpu->cycles += 5;
             LOG_DEBUG("Executed RET NZ\n");
             break;
         case 0x01: // Z zero.
             if (GET_FLAG_ZERO(cpu)) {
                 cpu->PC = cpu_stackPop(cpu);
-                opc_tbl[0xC8].TStates = 11;
+                cpu->cycles += 11;
             } else
-                opc_tbl[0xC8].TStates = 5;
+                cpu->cycles += 5;
             LOG_DEBUG("Executed RET Z\n");
             break;
         case 0x02: // NC no carry.
             if (!GET_FLAG_CARRY(cpu)) {
                 cpu->PC = cpu_stackPop(cpu);
-                opc_tbl[0xD0].TStates = 11;
+                cpu->cycles += 11;
             } else
-                opc_tbl[0xD0].TStates = 5;
+                cpu->cycles += 5;
             LOG_DEBUG("Executed RET NC\n");
             break;
         case 0x03: // C carry.
             if (GET_FLAG_CARRY(cpu)) {
                 cpu->PC = cpu_stackPop(cpu);
-                opc_tbl[0xD8].TStates = 11;
+                cpu->cycles += 11;
             } else
-                opc_tbl[0xD8].TStates = 5;
+                cpu->cycles += 5;
             LOG_DEBUG("Executed RET C\n");
             break;
         case 0x04: // P/V parity odd (P/V reset).
             if (!GET_FLAG_PARITY(cpu)) {
                 cpu->PC = cpu_stackPop(cpu);
-                opc_tbl[0xE0].TStates = 11;
+                cpu->cycles += 11;
             } else
-                opc_tbl[0xE0].TStates = 5;
+                cpu->cycles += 5;
             LOG_DEBUG("Executed RET PO\n");
             break;
         case 0x05: // P/V parity even (P/V set).
             if (GET_FLAG_PARITY(cpu)) {
                 cpu->PC = cpu_stackPop(cpu);
-                opc_tbl[0xE8].TStates = 11;
+                cpu->cycles += 11;
             } else
-                opc_tbl[0xE8].TStates = 5;
+                cpu->cycles += 5;
             LOG_DEBUG("Executed RET PE\n");
             break;
         case 0x06: // S sign positive (S reset).
             if (!GET_FLAG_SIGN(cpu)) {
                 cpu->PC = cpu_stackPop(cpu);
-                opc_tbl[0xF0].TStates = 11;
+                cpu->cycles += 11;
             } else
-                opc_tbl[0xF0].TStates = 5;
+                cpu->cycles += 5;
             LOG_DEBUG("Executed RET P\n");
             break;
         case 0x07: // S sign negative (S set).
             if (GET_FLAG_SIGN(cpu)) {
                 cpu->PC = cpu_stackPop(cpu);
-                opc_tbl[0xF8].TStates = 11;
+                cpu->cycles += 11;
             } else
-                opc_tbl[0xF8].TStates = 5;
+                cpu->cycles += 5;
             LOG_DEBUG("Executed RET M\n");
             break;
         default:
             LOG_FATAL("Invalid condition in RET cc instruction.\n");
-            raise(SIGINT);
+            cpu_fault(cpu);
     }
 }
 
@@ -3630,7 +3096,7 @@ static void opc_RSTp(cpu_t *cpu, uint8_t opcode) {
             break;
         default:
             LOG_FATAL("Invalid t in RST p instruction.\n");
-            raise(SIGINT);
+            cpu_fault(cpu);
     }
 }
 
@@ -3638,7 +3104,7 @@ static void opc_RSTp(cpu_t *cpu, uint8_t opcode) {
 // IN A,(n) instruction.
 static void opc_INAn(cpu_t *cpu, uint8_t opcode) {
     uint8_t n = opc_fetch8(cpu);
-    cpu->A = cpu->portIO_in(cpu->board, n);
+    cpu->A = cpu_portIn(cpu, n);
     LOG_DEBUG("Executed IN A,(0x%02hhX)\n", n);
     return;
 }
@@ -3647,14 +3113,509 @@ static void opc_INAn(cpu_t *cpu, uint8_t opcode) {
 // OUT (n),A.
 static void opc_OUTnA(cpu_t *cpu, uint8_t opcode) {
     uint8_t n = opc_fetch8(cpu);
-    cpu->portIO_out(cpu->board, n, cpu->A);
+    cpu_portOut(cpu, n, cpu->A);
     LOG_DEBUG("Executed OUT (0x%02hhX),A\n", n);
     return;
 }
 
 
+// 0xCB prefix: rotate, shift and bit instructions.
+static void opc_CB(cpu_t *cpu, uint8_t opcode) {
+    uint8_t next_opc = opc_fetch8(cpu);
+    opc_tblCB[next_opc].execute(cpu, next_opc);
+    cpu->cycles += opc_tblCB[next_opc].TStates;
+    return;
+}
+
+
+// 0xED prefix: extended instructions.
+static void opc_ED(cpu_t *cpu, uint8_t opcode) {
+    uint8_t next_opc = opc_fetch8(cpu);
+    opc_tblED[next_opc].execute(cpu, next_opc);
+    cpu->cycles += opc_tblED[next_opc].TStates;
+    return;
+}
+
+
+// 0xDD prefix: IX instructions.
+static void opc_DD(cpu_t *cpu, uint8_t opcode) {
+    uint8_t next_opc = opc_fetch8(cpu);
+    opc_tblXY[next_opc].execute(cpu, &cpu->IX, next_opc);
+    cpu->cycles += opc_tblXY[next_opc].TStates;
+    return;
+}
+
+
+// 0xFD prefix: IY instructions.
+static void opc_FD(cpu_t *cpu, uint8_t opcode) {
+    uint8_t next_opc = opc_fetch8(cpu);
+    opc_tblXY[next_opc].execute(cpu, &cpu->IY, next_opc);
+    cpu->cycles += opc_tblXY[next_opc].TStates;
+    return;
+}
+
+
+#ifdef CPU_FUSION
+///////////////////////////////////////////////////////////
+// FUSED INSTRUCTION GROUPS
+///////////////////////////////////////////////////////////
+
+// Runs the first instruction of a fused group and counts the group.
+static inline void opc_fuseFirst(cpu_t *cpu, uint8_t id, uint8_t opcode) {
+    cpu->blocks->fusion_hits[id]++;
+    cpu->blocks->fusion_instr[id]++;
+    opc_tbl[opcode].execute(cpu, opcode);
+    cpu->cycles += opc_tbl[opcode].TStates;
+    return;
+}
+
+
+// Runs the next instruction of a fused group. If an interrupt is pending it
+// is skipped instead, so that the interrupt is taken at the same point as
+// without fusion, and the block cache resumes from the PC.
+// Returns true if the instruction was run.
+static inline bool opc_fuseNext(cpu_t *cpu, uint8_t id, uint8_t opcode) {
+    if (cpu_hasInterrupt(cpu))
+        return false;
+
+    cpu->blocks->fusion_instr[id]++;
+    cpu->PC++;
+    cpu->instr++;
+    opc_tbl[opcode].execute(cpu, opcode);
+    cpu->cycles += opc_tbl[opcode].TStates;
+    return true;
+}
+
+
+// LD A,(nn) ; CP n ; JR Z,e group.
+static void opc_fuseLDAnnCPnJRZe(cpu_t *cpu, uint8_t id) {
+    opc_fuseFirst(cpu, id, 0x3A);
+    if (opc_fuseNext(cpu, id, 0xFE))
+        opc_fuseNext(cpu, id, 0x28);
+    return;
+}
+
+
+// LD A,(HL) ; INC HL group.
+static void opc_fuseLDAHLINCHL(cpu_t *cpu, uint8_t id) {
+    opc_fuseFirst(cpu, id, 0x7E);
+    opc_fuseNext(cpu, id, 0x23);
+    return;
+}
+
+
+// INC HL ; LD A,(HL) group.
+static void opc_fuseINCHLLDAHL(cpu_t *cpu, uint8_t id) {
+    opc_fuseFirst(cpu, id, 0x23);
+    opc_fuseNext(cpu, id, 0x7E);
+    return;
+}
+
+
+// LD A,(HL) ; CP n group.
+static void opc_fuseLDAHLCPn(cpu_t *cpu, uint8_t id) {
+    opc_fuseFirst(cpu, id, 0x7E);
+    opc_fuseNext(cpu, id, 0xFE);
+    return;
+}
+
+
+// CP n ; JR NZ,e group.
+static void opc_fuseCPnJRNZe(cpu_t *cpu, uint8_t id) {
+    opc_fuseFirst(cpu, id, 0xFE);
+    opc_fuseNext(cpu, id, 0x20);
+    return;
+}
+
+
+// CP n ; JR Z,e group.
+static void opc_fuseCPnJRZe(cpu_t *cpu, uint8_t id) {
+    opc_fuseFirst(cpu, id, 0xFE);
+    opc_fuseNext(cpu, id, 0x28);
+    return;
+}
+
+
+// DEC B ; JR NZ,e group.
+static void opc_fuseDECBJRNZe(cpu_t *cpu, uint8_t id) {
+    opc_fuseFirst(cpu, id, 0x05);
+    opc_fuseNext(cpu, id, 0x20);
+    return;
+}
+
+
+// EX DE,HL ; LD A,(HL) group.
+static void opc_fuseEXDEHLLDAHL(cpu_t *cpu, uint8_t id) {
+    opc_fuseFirst(cpu, id, 0xEB);
+    opc_fuseNext(cpu, id, 0x7E);
+    return;
+}
+
+
+// Fused groups, matched on the opcodes of their instructions. Longer groups
+// come first so that they win over the pairs they contain.
+const opc_fusion_t opc_fusionTbl[OPC_FUSION_COUNT] = {
+    {"LD A,(nn) ; CP n ; JR Z,e", 3, {0x3A, 0xFE, 0x28}, opc_fuseLDAnnCPnJRZe},
+    {"LD A,(HL) ; INC HL", 2, {0x7E, 0x23}, opc_fuseLDAHLINCHL},
+    {"INC HL ; LD A,(HL)", 2, {0x23, 0x7E}, opc_fuseINCHLLDAHL},
+    {"LD A,(HL) ; CP n", 2, {0x7E, 0xFE}, opc_fuseLDAHLCPn},
+    {"CP n ; JR NZ,e", 2, {0xFE, 0x20}, opc_fuseCPnJRNZe},
+    {"CP n ; JR Z,e", 2, {0xFE, 0x28}, opc_fuseCPnJRZe},
+    {"DEC B ; JR NZ,e", 2, {0x05, 0x20}, opc_fuseDECBJRNZe},
+    {"EX DE,HL ; LD A,(HL)", 2, {0xEB, 0x7E}, opc_fuseEXDEHLLDAHL}
+};
+#endif
+
+///////////////////////////////////////////////////////////
+// DECODED INSTRUCTIONS
+///////////////////////////////////////////////////////////
+
+// The handlers below are run by the block cache and the JIT with the PC
+// already past the whole instruction, and take the operands decoded by
+// blk_decode instead of fetching them again.
+
+// Returns the index register selected by the prefix of a decoded instruction.
+static inline uint16_t *opc_decodedIdx(cpu_t *cpu, const blk_instr_t *instr) {
+    return (instr->prefix == 0xDD) ? &cpu->IX : &cpu->IY;
+}
+
+
+// Returns the (IX+d) or (IY+d) address of a decoded instruction.
+static inline uint16_t opc_decodedIdxAddr(cpu_t *cpu, const blk_instr_t *instr) {
+    return *opc_decodedIdx(cpu, instr) + (int8_t)(instr->operand & 0xFF);
+}
+
+
+// Tests the condition cc of JP cc, CALL cc and RET cc: NZ, Z, NC, C, PO,
+// PE, P and M.
+static inline bool opc_isCondition(cpu_t *cpu, uint8_t cc) {
+    static const uint8_t flag_bit[4] = {
+        FLAG_ZERO_BIT, FLAG_CARRY_BIT, FLAG_PARITY_BIT, FLAG_SIGN_BIT
+    };
+    return ((cpu_getF(cpu) >> flag_bit[cc >> 1]) & 0x1) == (cc & 0x1);
+}
+
+
+// Runs on A and n the 8-bit arithmetic or logical operation selected by
+// bits 3-5 of opcode, as ADD, ADC, SUB, SBC, AND, XOR, OR and CP do.
+static inline void opc_decodedALU(cpu_t *cpu, uint8_t opcode, uint8_t n) {
+    uint8_t c;
+
+    switch ((opcode >> 3) & 0x07) {
+        case 0x00: // ADD
+            opc_setFlagsAdd8(cpu, cpu->A, n, 0);
+            cpu->A += n;
+            break;
+        case 0x01: // ADC
+            c = GET_FLAG_CARRY(cpu);
+            opc_setFlagsAdd8(cpu, cpu->A, n, c);
+            cpu->A += n + c;
+            break;
+        case 0x02: // SUB
+            opc_setFlagsSub8(cpu, cpu->A, n, 0);
+            cpu->A -= n;
+            break;
+        case 0x03: // SBC
+            c = GET_FLAG_CARRY(cpu);
+            opc_setFlagsSub8(cpu, cpu->A, n, c);
+            cpu->A -= n + c;
+            break;
+        case 0x04: // AND
+            cpu->A &= n;
+            opc_setFlagsSZP8(cpu, cpu->A, FLAG_HCARRY);
+            break;
+        case 0x05: // XOR
+            cpu->A ^= n;
+            opc_setFlagsSZP8(cpu, cpu->A, 0);
+            break;
+        case 0x06: // OR
+            cpu->A |= n;
+            opc_setFlagsSZP8(cpu, cpu->A, 0);
+            break;
+        case 0x07: // CP
+            opc_setFlagsSub8(cpu, cpu->A, n, 0);
+            break;
+    }
+    return;
+}
+
+
+// LD r,n instruction, decoded.
+static void opc_decLDrn(cpu_t *cpu, const blk_instr_t *instr) {
+    opc_writeReg(cpu, (instr->opcode >> 3) & 0x07, instr->operand);
+    LOG_DEBUG("Executed LD %s,0x%02X\n",
+        opc_regName8((instr->opcode >> 3) & 0x07), instr->operand);
+    return;
+}
+
+
+// LD (HL),n instruction, decoded.
+static void opc_decLDHLn(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu_write(cpu, instr->operand, cpu->HL);
+    LOG_DEBUG("Executed LD (HL),0x%02X HL=0x%04X\n", instr->operand, cpu->HL);
+    return;
+}
+
+
+// LD dd,nn instruction, decoded.
+static void opc_decLDddnn(cpu_t *cpu, const blk_instr_t *instr) {
+    opc_writeReg16(cpu, (instr->opcode >> 4) & 0x03, instr->operand, REG16_DD);
+    LOG_DEBUG("Executed LD dd,0x%04X\n", instr->operand);
+    return;
+}
+
+
+// LD (nn),HL instruction, decoded.
+static void opc_decLDnnHL(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu_write(cpu, cpu->L, instr->operand);
+    cpu_write(cpu, cpu->H, instr->operand + 1);
+    LOG_DEBUG("Executed LD (0x%04X),HL\n", instr->operand);
+    return;
+}
+
+
+// LD HL,(nn) instruction, decoded.
+static void opc_decLDHLnn(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu->L = cpu_read(cpu, instr->operand);
+    cpu->H = cpu_read(cpu, instr->operand + 1);
+    LOG_DEBUG("Executed LD HL,(0x%04X)\n", instr->operand);
+    return;
+}
+
+
+// LD (nn),A instruction, decoded.
+static void opc_decLDnnA(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu_write(cpu, cpu->A, instr->operand);
+    LOG_DEBUG("Executed LD (0x%04X),A\n", instr->operand);
+    return;
+}
+
+
+// LD A,(nn) instruction, decoded.
+static void opc_decLDAnn(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu->A = cpu_read(cpu, instr->operand);
+    LOG_DEBUG("Executed LD A,(0x%04X)\n", instr->operand);
+    return;
+}
+
+
+// ADD/ADC/SUB/SBC/AND/XOR/OR/CP n instructions, decoded.
+static void opc_decALUn(cpu_t *cpu, const blk_instr_t *instr) {
+    opc_decodedALU(cpu, instr->opcode, instr->operand);
+    LOG_DEBUG("Executed ALU 0x%02X,0x%02X\n", instr->opcode, instr->operand);
+    return;
+}
+
+
+// JP nn instruction, decoded.
+static void opc_decJPnn(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu->PC = instr->operand;
+    LOG_DEBUG("Executed JP 0x%04X\n", instr->operand);
+    return;
+}
+
+
+// JP cc,nn instruction, decoded.
+static void opc_decJPccnn(cpu_t *cpu, const blk_instr_t *instr) {
+    if (opc_isCondition(cpu, (instr->opcode >> 3) & 0x07))
+        cpu->PC = instr->operand;
+    LOG_DEBUG("Executed JP cc,0x%04X\n", instr->operand);
+    return;
+}
+
+
+// JR e instruction, decoded.
+static void opc_decJRe(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu->PC += (int8_t)instr->operand;
+    LOG_DEBUG("Executed JR 0x%02hhX\n", (int8_t)instr->operand);
+    return;
+}
+
+
+// JR NZ/Z/NC/C,e instructions, decoded.
+static void opc_decJRcce(cpu_t *cpu, const blk_instr_t *instr) {
+    if (opc_isCondition(cpu, (instr->opcode >> 3) & 0x03)) {
+        cpu->PC += (int8_t)instr->operand;
+        cpu->cycles += 12; // Condition is met.
+    } else
+        cpu->cycles += 7;  // Condition is not met.
+
+    LOG_DEBUG("Executed JR cc,0x%02hhX\n", (int8_t)instr->operand);
+    return;
+}
+
+
+// DJNZ e instruction, decoded.
+static void opc_decDJNZe(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu->B--;
+
+    if (cpu->B) {
+        cpu->PC += (int8_t)instr->operand;
+        cpu->cycles += 13;
+    } else
+        cpu->cycles += 8;
+
+    LOG_DEBUG("Executed DJNZ 0x%02X\n", (int8_t)instr->operand);
+    return;
+}
+
+
+// CALL nn instruction, decoded.
+static void opc_decCALLnn(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu_stackPush(cpu, cpu->PC);
+    cpu->PC = instr->operand;
+    LOG_DEBUG("Executed CALL 0x%04X\n", instr->operand);
+    return;
+}
+
+
+// CALL cc,nn instruction, decoded.
+static void opc_decCALLccnn(cpu_t *cpu, const blk_instr_t *instr) {
+    if (opc_isCondition(cpu, (instr->opcode >> 3) & 0x07)) {
+        cpu_stackPush(cpu, cpu->PC);
+        cpu->PC = instr->operand;
+        cpu->cycles += 17;
+    } else
+        cpu->cycles += 10;
+
+    LOG_DEBUG("Executed CALL cc,0x%04X\n", instr->operand);
+    return;
+}
+
+
+// OUT (n),A instruction, decoded.
+static void opc_decOUTnA(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu_portOut(cpu, instr->operand, cpu->A);
+    LOG_DEBUG("Executed OUT (0x%02hhX),A\n", (uint8_t)instr->operand);
+    return;
+}
+
+
+// IN A,(n) instruction, decoded.
+static void opc_decINAn(cpu_t *cpu, const blk_instr_t *instr) {
+    cpu->A = cpu_portIn(cpu, instr->operand);
+    LOG_DEBUG("Executed IN A,(0x%02hhX)\n", (uint8_t)instr->operand);
+    return;
+}
+
+
+// LD IX,nn instruction, decoded.
+static void opc_decLDXYnn(cpu_t *cpu, const blk_instr_t *instr) {
+    *opc_decodedIdx(cpu, instr) = instr->operand;
+    LOG_DEBUG("Executed LD %s,0x%04X\n",
+        opc_idxName(cpu, opc_decodedIdx(cpu, instr)), instr->operand);
+    return;
+}
+
+
+// LD IX,(nn) instruction, decoded.
+static void opc_decLDXYMnn(cpu_t *cpu, const blk_instr_t *instr) {
+    uint16_t addr = instr->operand;
+    *opc_decodedIdx(cpu, instr) =
+        (cpu_read(cpu, addr) | (cpu_read(cpu, addr + 1) << 8));
+    LOG_DEBUG("Executed LD %s,(0x%04X)\n",
+        opc_idxName(cpu, opc_decodedIdx(cpu, instr)), addr);
+    return;
+}
+
+
+// LD (nn),IX instruction, decoded.
+static void opc_decLDMnnXY(cpu_t *cpu, const blk_instr_t *instr) {
+    uint16_t idx = *opc_decodedIdx(cpu, instr);
+    cpu_write(cpu, (idx & 0xFF), instr->operand);
+    cpu_write(cpu, ((idx >> 8) & 0xFF), instr->operand + 1);
+    LOG_DEBUG("Executed LD (0x%04X),%s\n", instr->operand,
+        opc_idxName(cpu, opc_decodedIdx(cpu, instr)));
+    return;
+}
+
+
+// LD r,(IX+d) instruction, decoded.
+static void opc_decLDrIdx(cpu_t *cpu, const blk_instr_t *instr) {
+    uint16_t addr = opc_decodedIdxAddr(cpu, instr);
+    opc_writeReg(cpu, (instr->opcode >> 3) & 0x07, cpu_read(cpu, addr));
+    LOG_DEBUG("Executed LD %s,(IX+d) addr=0x%04X\n",
+        opc_regName8((instr->opcode >> 3) & 0x07), addr);
+    return;
+}
+
+
+// LD (IX+d),r instruction, decoded.
+static void opc_decLDIdxr(cpu_t *cpu, const blk_instr_t *instr) {
+    uint16_t addr = opc_decodedIdxAddr(cpu, instr);
+    cpu_write(cpu, opc_readReg(cpu, instr->opcode & 0x07), addr);
+    LOG_DEBUG("Executed LD (IX+d),%s addr=0x%04X\n",
+        opc_regName8(instr->opcode & 0x07), addr);
+    return;
+}
+
+
+// LD (IX+d),n instruction, decoded. The operand holds d, then n.
+static void opc_decLDIdxn(cpu_t *cpu, const blk_instr_t *instr) {
+    uint16_t addr = opc_decodedIdxAddr(cpu, instr);
+    cpu_write(cpu, instr->operand >> 8, addr);
+    LOG_DEBUG("Executed LD (IX+d),0x%02X addr=0x%04X\n", instr->operand >> 8,
+        addr);
+    return;
+}
+
+
+// ADD/ADC/SUB/SBC/AND/XOR/OR/CP (IX+d) instructions, decoded.
+static void opc_decALUIdx(cpu_t *cpu, const blk_instr_t *instr) {
+    uint16_t addr = opc_decodedIdxAddr(cpu, instr);
+    opc_decodedALU(cpu, instr->opcode, cpu_read(cpu, addr));
+    LOG_DEBUG("Executed ALU 0x%02X,(IX+d) addr=0x%04X\n", instr->opcode, addr);
+    return;
+}
+
+
+// Decoded handlers of the unprefixed instructions with operands.
+const opc_decoded_t opc_decodedTbl[0x100] = {
+    [0x01] = opc_decLDddnn, [0x11] = opc_decLDddnn,
+    [0x21] = opc_decLDddnn, [0x31] = opc_decLDddnn,
+    [0x06] = opc_decLDrn, [0x0E] = opc_decLDrn, [0x16] = opc_decLDrn,
+    [0x1E] = opc_decLDrn, [0x26] = opc_decLDrn, [0x2E] = opc_decLDrn,
+    [0x3E] = opc_decLDrn, [0x36] = opc_decLDHLn,
+    [0x22] = opc_decLDnnHL, [0x2A] = opc_decLDHLnn,
+    [0x32] = opc_decLDnnA, [0x3A] = opc_decLDAnn,
+    [0xC6] = opc_decALUn, [0xCE] = opc_decALUn, [0xD6] = opc_decALUn,
+    [0xDE] = opc_decALUn, [0xE6] = opc_decALUn, [0xEE] = opc_decALUn,
+    [0xF6] = opc_decALUn, [0xFE] = opc_decALUn,
+    [0xC3] = opc_decJPnn,
+    [0xC2] = opc_decJPccnn, [0xCA] = opc_decJPccnn, [0xD2] = opc_decJPccnn,
+    [0xDA] = opc_decJPccnn, [0xE2] = opc_decJPccnn, [0xEA] = opc_decJPccnn,
+    [0xF2] = opc_decJPccnn, [0xFA] = opc_decJPccnn,
+    [0x18] = opc_decJRe,
+    [0x20] = opc_decJRcce, [0x28] = opc_decJRcce, [0x30] = opc_decJRcce,
+    [0x38] = opc_decJRcce,
+    [0x10] = opc_decDJNZe,
+    [0xCD] = opc_decCALLnn,
+    [0xC4] = opc_decCALLccnn, [0xCC] = opc_decCALLccnn,
+    [0xD4] = opc_decCALLccnn, [0xDC] = opc_decCALLccnn,
+    [0xE4] = opc_decCALLccnn, [0xEC] = opc_decCALLccnn,
+    [0xF4] = opc_decCALLccnn, [0xFC] = opc_decCALLccnn,
+    [0xD3] = opc_decOUTnA, [0xDB] = opc_decINAn
+};
+
+
+// Decoded handlers of the 0xDD and 0xFD prefixed instructions with operands.
+const opc_decoded_t opc_decodedTblXY[0x100] = {
+    [0x21] = opc_decLDXYnn, [0x22] = opc_decLDMnnXY, [0x2A] = opc_decLDXYMnn,
+    [0x36] = opc_decLDIdxn,
+    [0x46] = opc_decLDrIdx, [0x4E] = opc_decLDrIdx, [0x56] = opc_decLDrIdx,
+    [0x5E] = opc_decLDrIdx, [0x66] = opc_decLDrIdx, [0x6E] = opc_decLDrIdx,
+    [0x7E] = opc_decLDrIdx,
+    [0x70] = opc_decLDIdxr, [0x71] = opc_decLDIdxr, [0x72] = opc_decLDIdxr,
+    [0x73] = opc_decLDIdxr, [0x74] = opc_decLDIdxr, [0x75] = opc_decLDIdxr,
+    [0x77] = opc_decLDIdxr,
+    [0x86] = opc_decALUIdx, [0x8E] = opc_decALUIdx, [0x96] = opc_decALUIdx,
+    [0x9E] = opc_decALUIdx, [0xA6] = opc_decALUIdx, [0xAE] = opc_decALUIdx,
+    [0xB6] = opc_decALUIdx, [0xBE] = opc_decALUIdx
+};
+
+
 // Opcodes lookup table.
-opc_t opc_tbl[0x100] = {
+const opc_t opc_tbl[0x100] = {
     {opc_NOP, 4},
     {opc_LDddnn, 10},
     {opc_LDBCA, 7},
@@ -3671,7 +3632,7 @@ opc_t opc_tbl[0x100] = {
     {opc_DECr, 4},
     {opc_LDrn, 7},
     {opc_RRCA, 4},
-    {opc_DJNZe, 13}, // 0x10
+    {opc_DJNZe, 0}, // 0x10
     {opc_LDddnn, 10},
     {opc_LDDEA, 7},
     {opc_INCss, 6},
@@ -3687,7 +3648,7 @@ opc_t opc_tbl[0x100] = {
     {opc_DECr, 4},
     {opc_LDrn, 7},
     {opc_RRA, 4},
-    {opc_JRNZe, 12}, // 0x20
+    {opc_JRNZe, 0}, // 0x20
     {opc_LDddnn, 10},
     {opc_LDnnHL, 16},
     {opc_INCss, 6},
@@ -3695,7 +3656,7 @@ opc_t opc_tbl[0x100] = {
     {opc_DECr, 4},
     {opc_LDrn, 7},
     {opc_DAA, 4},
-    {opc_JRZe, 12},
+    {opc_JRZe, 0},
     {opc_ADDHLss, 11},
     {opc_LDHLnn, 16},
     {opc_DECss, 6},
@@ -3703,7 +3664,7 @@ opc_t opc_tbl[0x100] = {
     {opc_DECr, 4},
     {opc_LDrn, 7},
     {opc_CPL, 4},
-    {opc_JRNCe, 12}, // 0x30
+    {opc_JRNCe, 0}, // 0x30
     {opc_LDddnn, 10},
     {opc_LDnnA, 13},
     {opc_INCss, 6},
@@ -3711,7 +3672,7 @@ opc_t opc_tbl[0x100] = {
     {opc_DECHL, 11},
     {opc_LDHLn, 10},
     {opc_SCF, 4},
-    {opc_JRCe, 12},
+    {opc_JRCe, 0},
     {opc_ADDHLss, 11},
     {opc_LDAnn, 13},
     {opc_DECss, 6},
@@ -3847,68 +3808,1113 @@ opc_t opc_tbl[0x100] = {
     {opc_CPr, 4},
     {opc_CPHL, 7},
     {opc_CPr, 4},
-    {opc_RETcc, 5}, // 0xC0
+    {opc_RETcc, 0}, // 0xC0
     {opc_POPqq, 10},
     {opc_JPccnn, 10},
     {opc_JPnn, 10},
-    {opc_CALLccnn, 10},
+    {opc_CALLccnn, 0},
     {opc_PUSHqq, 11},
     {opc_ADDAn, 7},
     {opc_RSTp, 11},
-    {opc_RETcc, 5},
+    {opc_RETcc, 0},
     {opc_RET, 10},
     {opc_JPccnn, 10},
-    {opc_RLC, 8},
-    {opc_CALLccnn, 10},
+    {opc_CB, 0},
+    {opc_CALLccnn, 0},
     {opc_CALLnn, 17},
     {opc_ADCAn, 7},
     {opc_RSTp, 11},
-    {opc_RETcc, 5}, // 0xD0
+    {opc_RETcc, 0}, // 0xD0
     {opc_POPqq, 10},
     {opc_JPccnn, 10},
     {opc_OUTnA, 11},
-    {opc_CALLccnn, 10},
+    {opc_CALLccnn, 0},
     {opc_PUSHqq, 11},
     {opc_SUBAn, 7},
     {opc_RSTp, 11},
-    {opc_RETcc, 5},
+    {opc_RETcc, 0},
     {opc_EXX, 4},
     {opc_JPccnn, 10},
     {opc_INAn, 11},
-    {opc_CALLccnn, 10},
-    {opc_LDIX, 19},
+    {opc_CALLccnn, 0},
+    {opc_DD, 0},
     {opc_SBCAn, 7},
     {opc_RSTp, 11},
-    {opc_RETcc, 5}, // 0xE0
+    {opc_RETcc, 0}, // 0xE0
     {opc_POPqq, 10},
     {opc_JPccnn, 10},
     {opc_EXSPHL, 19},
-    {opc_CALLccnn, 10},
+    {opc_CALLccnn, 0},
     {opc_PUSHqq, 11},
     {opc_ANDn, 7},
     {opc_RSTp, 11},
-    {opc_RETcc, 5},
+    {opc_RETcc, 0},
     {opc_JPHL, 4},
     {opc_JPccnn, 10},
     {opc_EXDEHL, 4},
-    {opc_CALLccnn, 10},
-    {opc_LDRIddnn, 9},
+    {opc_CALLccnn, 0},
+    {opc_ED, 0},
     {opc_XORn, 7},
     {opc_RSTp, 11},
-    {opc_RETcc, 5}, // 0xF0
+    {opc_RETcc, 0}, // 0xF0
     {opc_POPqq, 10},
     {opc_JPccnn, 10},
     {opc_DI, 4},
-    {opc_CALLccnn, 10},
+    {opc_CALLccnn, 0},
     {opc_PUSHqq, 11},
     {opc_ORn, 7},
     {opc_RSTp, 11},
-    {opc_RETcc, 5},
+    {opc_RETcc, 0},
     {opc_LDSPHL, 6},
     {opc_JPccnn, 10},
     {opc_EI, 4},
-    {opc_CALLccnn, 10},
-    {opc_LDIY, 19},
+    {opc_CALLccnn, 0},
+    {opc_FD, 0},
     {opc_CPn, 7},
     {opc_RSTp, 11}
 };
+
+
+// 0xCB prefixed opcodes lookup table.
+const opc_t opc_tblCB[0x100] = {
+    {opc_RLCr, 8}, // 0x00
+    {opc_RLCr, 8},
+    {opc_RLCr, 8},
+    {opc_RLCr, 8},
+    {opc_RLCr, 8},
+    {opc_RLCr, 8},
+    {opc_RLCHL, 15},
+    {opc_RLCr, 8},
+    {opc_RRCr, 8},
+    {opc_RRCr, 8},
+    {opc_RRCr, 8},
+    {opc_RRCr, 8},
+    {opc_RRCr, 8},
+    {opc_RRCr, 8},
+    {opc_RRCHL, 15},
+    {opc_RRCr, 8},
+    {opc_RLr, 8}, // 0x10
+    {opc_RLr, 8},
+    {opc_RLr, 8},
+    {opc_RLr, 8},
+    {opc_RLr, 8},
+    {opc_RLr, 8},
+    {opc_RLHL, 15},
+    {opc_RLr, 8},
+    {opc_RRr, 8},
+    {opc_RRr, 8},
+    {opc_RRr, 8},
+    {opc_RRr, 8},
+    {opc_RRr, 8},
+    {opc_RRr, 8},
+    {opc_RRHL, 15},
+    {opc_RRr, 8},
+    {opc_SLAr, 8}, // 0x20
+    {opc_SLAr, 8},
+    {opc_SLAr, 8},
+    {opc_SLAr, 8},
+    {opc_SLAr, 8},
+    {opc_SLAr, 8},
+    {opc_SLAHL, 15},
+    {opc_SLAr, 8},
+    {opc_SRAr, 8},
+    {opc_SRAr, 8},
+    {opc_SRAr, 8},
+    {opc_SRAr, 8},
+    {opc_SRAr, 8},
+    {opc_SRAr, 8},
+    {opc_SRAHL, 15},
+    {opc_SRAr, 8},
+    {opc_invalidCB, 0}, // 0x30
+    {opc_invalidCB, 0},
+    {opc_invalidCB, 0},
+    {opc_invalidCB, 0},
+    {opc_invalidCB, 0},
+    {opc_invalidCB, 0},
+    {opc_invalidCB, 0},
+    {opc_invalidCB, 0},
+    {opc_SRLr, 8},
+    {opc_SRLr, 8},
+    {opc_SRLr, 8},
+    {opc_SRLr, 8},
+    {opc_SRLr, 8},
+    {opc_SRLr, 8},
+    {opc_SRLHL, 15},
+    {opc_SRLr, 8},
+    {opc_BITbr, 8}, // 0x40
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbHL, 12},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbHL, 12},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8}, // 0x50
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbHL, 12},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbHL, 12},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8}, // 0x60
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbHL, 12},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbHL, 12},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8}, // 0x70
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbHL, 12},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbr, 8},
+    {opc_BITbHL, 12},
+    {opc_BITbr, 8},
+    {opc_RESbr, 8}, // 0x80
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbHL, 15},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbHL, 15},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8}, // 0x90
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbHL, 15},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbHL, 15},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8}, // 0xA0
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbHL, 15},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbHL, 15},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8}, // 0xB0
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbHL, 15},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbr, 8},
+    {opc_RESbHL, 15},
+    {opc_RESbr, 8},
+    {opc_SETbr, 8}, // 0xC0
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbHL, 15},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbHL, 15},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8}, // 0xD0
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbHL, 15},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbHL, 15},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8}, // 0xE0
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbHL, 15},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbHL, 15},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8}, // 0xF0
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbHL, 15},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbr, 8},
+    {opc_SETbHL, 15},
+    {opc_SETbr, 8}
+};
+
+
+// 0xED prefixed opcodes lookup table.
+const opc_t opc_tblED[0x100] = {
+    {opc_invalidED, 0}, // 0x00
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0}, // 0x10
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0}, // 0x20
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0}, // 0x30
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_INrC, 12}, // 0x40
+    {opc_OUTCr, 12},
+    {opc_SBCHLss, 15},
+    {opc_LDMnndd, 20},
+    {opc_NEG, 8},
+    {opc_RETN, 14},
+    {opc_IM0, 8},
+    {opc_LDIA, 9},
+    {opc_INrC, 12},
+    {opc_OUTCr, 12},
+    {opc_ADCHLss, 15},
+    {opc_LDddMnn, 20},
+    {opc_invalidED, 0},
+    {opc_RETI, 14},
+    {opc_invalidED, 0},
+    {opc_LDRA, 9},
+    {opc_INrC, 12}, // 0x50
+    {opc_OUTCr, 12},
+    {opc_SBCHLss, 15},
+    {opc_LDMnndd, 20},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_IM1, 8},
+    {opc_LDAI, 9},
+    {opc_INrC, 12},
+    {opc_OUTCr, 12},
+    {opc_ADCHLss, 15},
+    {opc_LDddMnn, 20},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_IM2, 8},
+    {opc_LDAR, 9},
+    {opc_INrC, 12}, // 0x60
+    {opc_OUTCr, 12},
+    {opc_SBCHLss, 15},
+    {opc_LDMnndd, 20},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_RRD, 18},
+    {opc_INrC, 12},
+    {opc_OUTCr, 12},
+    {opc_ADCHLss, 15},
+    {opc_LDddMnn, 20},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_RLD, 18},
+    {opc_invalidED, 0}, // 0x70
+    {opc_invalidED, 0},
+    {opc_SBCHLss, 15},
+    {opc_LDMnndd, 20},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_INrC, 12},
+    {opc_OUTCr, 12},
+    {opc_ADCHLss, 15},
+    {opc_LDddMnn, 20},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0}, // 0x80
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0}, // 0x90
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_LDI, 16}, // 0xA0
+    {opc_CPI, 16},
+    {opc_INI, 16},
+    {opc_OUTI, 16},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_LDD, 16},
+    {opc_CPD, 16},
+    {opc_IND, 16},
+    {opc_OUTD, 16},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_LDIR, 0}, // 0xB0
+    {opc_CPIR, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_LDDR, 0},
+    {opc_CPDR, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0}, // 0xC0
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0}, // 0xD0
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0}, // 0xE0
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0}, // 0xF0
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0},
+    {opc_invalidED, 0}
+};
+
+
+// 0xDD and 0xFD prefixed opcodes lookup table.
+const opc_xy_t opc_tblXY[0x100] = {
+    {opc_invalidXY, 0}, // 0x00
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_ADDXYpp, 15},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0x10
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_ADDXYpp, 15},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0x20
+    {opc_LDXYnn, 14},
+    {opc_LDMnnXY, 20},
+    {opc_INCXY, 10},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_ADDXYpp, 15},
+    {opc_LDXYMnn, 20},
+    {opc_DECXY, 10},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0x30
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_INCIdx, 23},
+    {opc_DECIdx, 23},
+    {opc_LDIdxn, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_ADDXYpp, 15},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0x40
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_LDrIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_LDrIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0x50
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_LDrIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_LDrIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0x60
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_LDrIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_LDrIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_LDIdxr, 19}, // 0x70
+    {opc_LDIdxr, 19},
+    {opc_LDIdxr, 19},
+    {opc_LDIdxr, 19},
+    {opc_LDIdxr, 19},
+    {opc_LDIdxr, 19},
+    {opc_invalidXY, 0},
+    {opc_LDIdxr, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_LDrIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0x80
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_ADDAIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_ADCAIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0x90
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_SUBAIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_SBCAIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0xA0
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_ANDIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_XORIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0xB0
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_ORIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_CPIdx, 19},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0xC0
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_XYCB, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0xD0
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0xE0
+    {opc_POPXY, 14},
+    {opc_invalidXY, 0},
+    {opc_EXSPXY, 23},
+    {opc_invalidXY, 0},
+    {opc_PUSHXY, 15},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_JPXY, 8},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}, // 0xF0
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_LDSPXY, 10},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0},
+    {opc_invalidXY, 0}
+};
+
+
+// 0xDDCB and 0xFDCB prefixed opcodes lookup table, indexed by the 4th
+// instruction byte.
+const opc_xycb_t opc_tblXYCB[0x100] = {
+    {opc_invalidXYCB, 0}, // 0x00
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RLCIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RRCIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0x10
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RLIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RRIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0x20
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SLAIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SRAIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0x30
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SRLIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0x40
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_BITbIdx, 20},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_BITbIdx, 20},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0x50
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_BITbIdx, 20},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_BITbIdx, 20},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0x60
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_BITbIdx, 20},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_BITbIdx, 20},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0x70
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_BITbIdx, 20},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_BITbIdx, 20},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0x80
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RESbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RESbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0x90
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RESbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RESbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0xA0
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RESbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RESbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0xB0
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RESbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_RESbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0xC0
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SETbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SETbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0xD0
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SETbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SETbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0xE0
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SETbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SETbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0}, // 0xF0
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SETbIdx, 23},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_invalidXYCB, 0},
+    {opc_SETbIdx, 23},
+    {opc_invalidXYCB, 0}
+};
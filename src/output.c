@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <time.h>
+#ifndef Z80_HEADLESS
+#include <ncurses.h>
+#endif
+
+#include "output.h"
+#include "logger.h"
+
+
+// Returns the monotonic time in milliseconds.
+static uint64_t output_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+// Allocates an empty output buffer, written to stream or, if it is NULL,
+// to the curses screen.
+// Returns NULL in case of errors.
+output_t *output_create(FILE *stream) {
+#ifdef Z80_HEADLESS
+    if (stream == NULL) {
+        LOG_ERROR("The terminal is not compiled in.\n");
+        return NULL;
+    }
+#endif
+    output_t *output = (output_t *)calloc(1, sizeof(output_t));
+
+    if (output == NULL) {
+        LOG_ERROR("Cannot allocate the output buffer.\n");
+        return NULL;
+    }
+    output->stream = stream;
+    output->last_flush = output_now();
+    return output;
+}
+
+
+// Renders what is left in the buffer and frees output.
+void output_destroy(output_t *output) {
+    output_flush(output);
+    free(output);
+    return;
+}
+
+
+// Queues a byte sent by the guest, rendering the buffer first if it is
+// full.
+void output_put(output_t *output, uint8_t byte) {
+    if (output->size == OUTPUT_BUFFER_SIZE)
+        output_flush(output);
+    output->buff[output->size++] = byte;
+    return;
+}
+
+
+// Writes the buffer to the stream as text lines: carriage returns end
+// the lines, line feeds and form feeds are dropped.
+static void output_writeStream(output_t *output) {
+    char *buff = output->buff;
+    char *end = buff + output->size;
+
+    while (buff < end) {
+        char *run = buff;
+        while (buff < end && *buff != 0x0D && *buff != 0x0A && *buff != 0x0C)
+            buff++;
+        fwrite(run, 1, buff - run, output->stream);
+        if (buff < end && *buff++ == 0x0D)
+            fputc('\n', output->stream);
+    }
+    fflush(output->stream);
+    return;
+}
+
+
+#ifndef Z80_HEADLESS
+// Renders the buffer to the screen and refreshes it.
+static void output_writeScreen(output_t *output) {
+    char *buff = output->buff;
+    char *end = buff + output->size;
+
+    // Whatever comes before the last form feed is cleared anyway.
+    for (char *ff = end; ff > buff; ff--) {
+        if (ff[-1] == 0x0C) {
+            clear();
+            buff = ff;
+            break;
+        }
+    }
+
+    // Text runs are added at once. Carriage returns start a new line,
+    // line feeds and NUL bytes are dropped.
+    while (buff < end) {
+        char *run = buff;
+        while (buff < end && *buff != 0x0D && *buff != 0x0A && *buff != 0)
+            buff++;
+        if (buff > run)
+            addnstr(run, buff - run);
+        if (buff < end && *buff++ == 0x0D)
+            addch('\n');
+    }
+
+    refresh();
+    return;
+}
+#endif
+
+
+// Writes out the buffer, translated in one go.
+void output_flush(output_t *output) {
+    output->last_flush = output_now();
+    if (output->size == 0)
+        return;
+
+#ifndef Z80_HEADLESS
+    if (output->stream == NULL)
+        output_writeScreen(output);
+    else
+#endif
+        output_writeStream(output);
+    output->size = 0;
+    return;
+}
+
+
+// Renders the buffer if the guest is idle or a frame has gone by since
+// the last refresh.
+void output_update(output_t *output, bool is_idle) {
+    if (output->size == 0)
+        return;
+    if (is_idle || output_now() - output->last_flush >= OUTPUT_FRAME_MS)
+        output_flush(output);
+    return;
+}
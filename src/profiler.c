@@ -0,0 +1,337 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "profiler.h"
+#include "logger.h"
+
+
+// Allocates an empty profile, the root of the call tree is the reset
+// vector.
+// Returns NULL in case of errors.
+prof_t *prof_create(void) {
+    prof_t *prof = (prof_t *)calloc(1, sizeof(prof_t));
+
+    if (prof == NULL) {
+        LOG_ERROR("Cannot allocate the profiler.\n");
+        return NULL;
+    }
+
+    memset(prof->hash, -1, sizeof(prof->hash));
+    prof->nodes[0] = (prof_node_t){0, -1, 0};
+    prof->node_count = 1;
+    prof->stack[0] = (prof_frame_t){0, 0};
+    prof->depth = 0;
+    return prof;
+}
+
+
+// Releases the profile and its symbols.
+void prof_destroy(prof_t *prof) {
+    free(prof->syms);
+    free(prof);
+    return;
+}
+
+
+// Orders symbols by address.
+static int prof_cmpSymbol(const void *a, const void *b) {
+    return (int)((const prof_sym_t *)a)->addr -
+        (int)((const prof_sym_t *)b)->addr;
+}
+
+
+// Loads the symbol map at path, replacing the current symbols.
+// Returns 0 if no errors occur.
+int32_t prof_loadSymbols(prof_t *prof, const char *path) {
+    FILE *stream = fopen(path, "r");
+    if (stream == NULL) {
+        LOG_ERROR("Cannot open the symbol map %s.\n", path);
+        return 1;
+    }
+
+    prof_sym_t *syms = NULL;
+    int32_t count = 0;
+    int32_t size = 0;
+    char line[256];
+    int32_t line_num = 0;
+
+    while (fgets(line, sizeof(line), stream) != NULL) {
+        line_num++;
+
+        char *str = line + strspn(line, " \t");
+        if (*str == '#' || *str == ';' || *str == '\n' || *str == '\0')
+            continue;
+
+        uint32_t addr;
+        char name[PROF_MAX_NAME];
+        if (sscanf(str, "%x %31s", &addr, name) != 2 || addr > 0xFFFF) {
+            LOG_WARNING("Skipped invalid symbol at %s:%d.\n", path, line_num);
+            continue;
+        }
+
+        if (count == size) {
+            size = size ? 2 * size : 256;
+            prof_sym_t *tmp = (prof_sym_t *)realloc(syms,
+                size * sizeof(prof_sym_t));
+            if (tmp == NULL) {
+                LOG_ERROR("Cannot allocate the symbol map.\n");
+                free(syms);
+                fclose(stream);
+                return 1;
+            }
+            syms = tmp;
+        }
+        syms[count].addr = addr;
+        strcpy(syms[count].name, name);
+        count++;
+    }
+    fclose(stream);
+
+    qsort(syms, count, sizeof(prof_sym_t), prof_cmpSymbol);
+    free(prof->syms);
+    prof->syms = syms;
+    prof->sym_count = count;
+
+    LOG_INFO("Loaded %d symbols from %s.\n", count, path);
+    return 0;
+}
+
+
+// Returns the symbol holding addr, NULL if there is none.
+static const prof_sym_t *prof_findSymbol(const prof_t *prof, uint16_t addr) {
+    int32_t lo = 0;
+    int32_t hi = prof->sym_count - 1;
+    const prof_sym_t *found = NULL;
+
+    while (lo <= hi) {
+        int32_t mid = (lo + hi) / 2;
+        if (prof->syms[mid].addr <= addr) {
+            found = &prof->syms[mid];
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+    return found;
+}
+
+
+// Returns the node called at addr from the node parent, creating it if
+// needed. Returns parent if the call tree is full.
+static int32_t prof_child(prof_t *prof, int32_t parent, uint16_t addr) {
+    uint32_t h = ((uint32_t)parent * 0x9E3779B1u ^ addr) & (PROF_HASH_SIZE - 1);
+
+    while (prof->hash[h] != -1) {
+        const prof_node_t *node = &prof->nodes[prof->hash[h]];
+        if (node->parent == parent && node->addr == addr)
+            return prof->hash[h];
+        h = (h + 1) & (PROF_HASH_SIZE - 1);
+    }
+
+    if (prof->node_count == PROF_MAX_NODES)
+        return parent;
+
+    int32_t id = prof->node_count++;
+    prof->nodes[id] = (prof_node_t){addr, parent, 0};
+    prof->hash[h] = id;
+    return id;
+}
+
+
+// Enters the function at the current PC, whose return address has just
+// been pushed at SP.
+static void prof_enter(prof_t *prof, cpu_t *cpu) {
+    if (prof->depth == PROF_MAX_DEPTH - 1)
+        return;
+
+    int32_t node = prof_child(prof, prof->stack[prof->depth].node, cpu->PC);
+    prof->stack[++prof->depth] = (prof_frame_t){node, cpu->SP};
+    return;
+}
+
+
+// Accounts the instruction just run at pc. sp and cycles are SP and the
+// T-states counter before it ran.
+void prof_record(prof_t *prof, cpu_t *cpu, uint16_t pc, uint16_t sp,
+    uint32_t cycles) {
+    uint32_t spent = cpu->cycles - cycles;
+
+    prof->instr[pc]++;
+    prof->cycles[pc] += spent;
+    prof->nodes[prof->stack[prof->depth].node].cycles += spent;
+
+    // Leaves the frames whose return address has been popped.
+    while (prof->depth > 0 && cpu->SP > prof->stack[prof->depth].sp)
+        prof->depth--;
+
+    // CALL nn, CALL cc,nn and RST p, if they pushed the return address.
+    if (cpu->SP == (uint16_t)(sp - 2) && !cpu->halt) {
+        uint8_t opcode = cpu_read(cpu, pc);
+        if (opcode == 0xCD || (opcode & 0xC7) == 0xC4 ||
+            (opcode & 0xC7) == 0xC7)
+            prof_enter(prof, cpu);
+    }
+    return;
+}
+
+
+// Accounts count NOPs run at once by a halted cpu.
+void prof_skipHalt(prof_t *prof, cpu_t *cpu, uint32_t count) {
+    uint16_t pc = cpu->PC - 1;
+
+    prof->instr[pc] += count;
+    prof->cycles[pc] += 4 * (uint64_t)count;
+    prof->nodes[prof->stack[prof->depth].node].cycles += 4 * (uint64_t)count;
+    return;
+}
+
+
+// Enters the service routine of an interrupt that has just been accepted,
+// which took cycles T-states.
+void prof_interrupt(prof_t *prof, cpu_t *cpu, uint32_t cycles) {
+    prof_enter(prof, cpu);
+    prof->cycles[cpu->PC] += cycles;
+    prof->nodes[prof->stack[prof->depth].node].cycles += cycles;
+    return;
+}
+
+
+// Writes the name of addr, with the offset from its symbol if with_offset
+// is set.
+static void prof_printName(const prof_t *prof, FILE *stream, uint16_t addr,
+    bool with_offset) {
+    const prof_sym_t *sym = prof_findSymbol(prof, addr);
+
+    if (sym == NULL)
+        fprintf(stream, "0x%04X", addr);
+    else if (with_offset && sym->addr != addr)
+        fprintf(stream, "%s+0x%X", sym->name, addr - sym->addr);
+    else
+        fprintf(stream, "%s", sym->name);
+    return;
+}
+
+
+typedef struct prof_entry_t {
+    uint16_t addr;
+    uint64_t instr;
+    uint64_t cycles;
+} prof_entry_t;
+
+
+// Orders report entries by decreasing T-states, then by address.
+static int prof_cmpEntry(const void *a, const void *b) {
+    const prof_entry_t *ea = (const prof_entry_t *)a;
+    const prof_entry_t *eb = (const prof_entry_t *)b;
+
+    if (ea->cycles != eb->cycles)
+        return ea->cycles < eb->cycles ? 1 : -1;
+    return (int)ea->addr - (int)eb->addr;
+}
+
+
+// Writes entries sorted by T-states, with their share of total_cycles.
+static void prof_printEntries(const prof_t *prof, FILE *stream,
+    prof_entry_t *entries, int32_t count, uint64_t total_cycles,
+    bool with_offset) {
+    qsort(entries, count, sizeof(prof_entry_t), prof_cmpEntry);
+
+    fprintf(stream, "%14s %7s %14s  %-6s  %s\n", "T-states", "%",
+        "Instructions", "Addr", "Symbol");
+    for (int32_t i = 0; i < count; i++) {
+        fprintf(stream, "%14llu %7.3f %14llu  0x%04X  ",
+            (unsigned long long)entries[i].cycles,
+            total_cycles ? 100.0 * entries[i].cycles / total_cycles : 0.0,
+            (unsigned long long)entries[i].instr, entries[i].addr);
+        if (prof->sym_count > 0)
+            prof_printName(prof, stream, entries[i].addr, with_offset);
+        fprintf(stream, "\n");
+    }
+    return;
+}
+
+
+// Writes the per address counters sorted by T-states, preceded by the
+// totals of each symbol if a symbol map is loaded.
+void prof_writeReport(prof_t *prof, FILE *stream) {
+    prof_entry_t *entries = (prof_entry_t *)malloc(
+        0x10000 * sizeof(prof_entry_t));
+    if (entries == NULL) {
+        LOG_ERROR("Cannot allocate the profiler report.\n");
+        return;
+    }
+
+    uint64_t total_instr = 0;
+    uint64_t total_cycles = 0;
+    int32_t count = 0;
+
+    for (int32_t pc = 0; pc < 0x10000; pc++) {
+        if (prof->instr[pc] == 0 && prof->cycles[pc] == 0)
+            continue;
+        entries[count++] = (prof_entry_t){pc, prof->instr[pc],
+            prof->cycles[pc]};
+        total_instr += prof->instr[pc];
+        total_cycles += prof->cycles[pc];
+    }
+
+    fprintf(stream, "Profile: %llu instructions, %llu T-states.\n\n",
+        (unsigned long long)total_instr, (unsigned long long)total_cycles);
+
+    if (prof->sym_count > 0) {
+        // Entries are still in address order, so each symbol is one run.
+        prof_entry_t *funcs = (prof_entry_t *)malloc(
+            (count + 1) * sizeof(prof_entry_t));
+        if (funcs == NULL) {
+            LOG_ERROR("Cannot allocate the profiler report.\n");
+            free(entries);
+            return;
+        }
+
+        int32_t func_count = 0;
+        const prof_sym_t *last = NULL;
+        for (int32_t i = 0; i < count; i++) {
+            const prof_sym_t *sym = prof_findSymbol(prof, entries[i].addr);
+            uint16_t addr = sym != NULL ? sym->addr : 0;
+
+            if (func_count == 0 || sym != last) {
+                funcs[func_count++] = (prof_entry_t){addr, 0, 0};
+                last = sym;
+            }
+            funcs[func_count - 1].instr += entries[i].instr;
+            funcs[func_count - 1].cycles += entries[i].cycles;
+        }
+
+        fprintf(stream, "Symbols:\n");
+        prof_printEntries(prof, stream, funcs, func_count, total_cycles, false);
+        fprintf(stream, "\nAddresses:\n");
+        free(funcs);
+    }
+
+    prof_printEntries(prof, stream, entries, count, total_cycles, true);
+    free(entries);
+    return;
+}
+
+
+// Writes the T-states of every call path in the folded stack format read
+// by flame graph tools: "root;caller;callee T-states", one path per line.
+void prof_writeFolded(prof_t *prof, FILE *stream) {
+    int32_t path[PROF_MAX_DEPTH];
+
+    for (int32_t id = 0; id < prof->node_count; id++) {
+        if (prof->nodes[id].cycles == 0)
+            continue;
+
+        int32_t len = 0;
+        for (int32_t n = id; n != -1 && len < PROF_MAX_DEPTH;
+            n = prof->nodes[n].parent)
+            path[len++] = n;
+
+        for (int32_t i = len - 1; i >= 0; i--) {
+            prof_printName(prof, stream, prof->nodes[path[i]].addr, false);
+            fprintf(stream, i > 0 ? ";" : " ");
+        }
+        fprintf(stream, "%llu\n", (unsigned long long)prof->nodes[id].cycles);
+    }
+    return;
+}
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "rom.h"
+#include "hex2array.h"
+#include "logger.h"
+
+
+// Returns the length of the mapping holding size bytes.
+static size_t rom_mapSize(uint32_t size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+
+// Allocates a writable image of size bytes, with one reference held by
+// the caller. path may be NULL for images not backed by a file.
+// Returns NULL in case of errors.
+static rom_t *rom_alloc(const char *path, uint32_t size) {
+    rom_t *rom = (rom_t *)calloc(1, sizeof(rom_t));
+    if (rom == NULL) {
+        LOG_ERROR("Cannot allocate the ROM image.\n");
+        return NULL;
+    }
+
+    rom->path = (path != NULL) ? strdup(path) : NULL;
+    rom->size = size;
+    rom->refs = 1;
+    rom->data = mmap(NULL, rom_mapSize(size), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if ((path != NULL && rom->path == NULL) || rom->data == MAP_FAILED) {
+        LOG_ERROR("Cannot allocate the ROM image.\n");
+        if (rom->data != MAP_FAILED)
+            munmap(rom->data, rom_mapSize(size));
+        free(rom->path);
+        free(rom);
+        return NULL;
+    }
+    return rom;
+}
+
+
+// Frees an image that is not referenced anymore.
+static void rom_free(rom_t *rom) {
+    munmap(rom->data, rom_mapSize(rom->size));
+    free(rom->path);
+    free(rom);
+    return;
+}
+
+
+// Parses the hex file at path into a new read-only image of size bytes,
+// with one reference held by the caller.
+// Returns NULL in case of errors.
+rom_t *rom_load(const char *path, uint32_t size) {
+    rom_t *rom = rom_alloc(path, size);
+    if (rom == NULL)
+        return NULL;
+
+    if (hex2array(path, rom->data, size) ||
+        mprotect(rom->data, rom_mapSize(size), PROT_READ)) {
+        LOG_ERROR("Unable to load the ROM image (%s).\n", path);
+        rom_free(rom);
+        return NULL;
+    }
+
+    LOG_INFO("Loaded shared ROM image %s.\n", path);
+    return rom;
+}
+
+
+// Copies size bytes at data into a new read-only image, with one
+// reference held by the caller.
+// Returns NULL in case of errors.
+rom_t *rom_create(const uint8_t *data, uint32_t size) {
+    rom_t *rom = rom_alloc(NULL, size);
+    if (rom == NULL)
+        return NULL;
+
+    memcpy(rom->data, data, size);
+    if (mprotect(rom->data, rom_mapSize(size), PROT_READ)) {
+        LOG_ERROR("Cannot protect the memory image.\n");
+        rom_free(rom);
+        return NULL;
+    }
+    return rom;
+}
+
+
+// Adds a reference to rom.
+// Returns rom.
+rom_t *rom_acquire(rom_t *rom) {
+    __atomic_add_fetch(&rom->refs, 1, __ATOMIC_RELAXED);
+    return rom;
+}
+
+
+// Drops a reference to rom, the last one frees it.
+void rom_release(rom_t *rom) {
+    if (__atomic_sub_fetch(&rom->refs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    rom_free(rom);
+    return;
+}
+
+
+// Allocates an empty registry.
+// Returns NULL in case of errors.
+rom_registry_t *rom_createRegistry(void) {
+    rom_registry_t *registry = (rom_registry_t *)malloc(sizeof(rom_registry_t));
+
+    if (registry == NULL) {
+        LOG_ERROR("Cannot allocate the ROM registry.\n");
+        return NULL;
+    }
+
+    pthread_mutex_init(&registry->lock, NULL);
+    registry->images = NULL;
+    return registry;
+}
+
+
+// Drops the registry references, images still mapped by boards stay
+// alive until those are destroyed.
+void rom_destroyRegistry(rom_registry_t *registry) {
+    rom_t *next;
+
+    for (rom_t *rom = registry->images; rom != NULL; rom = next) {
+        next = rom->next;
+        rom_release(rom);
+    }
+    pthread_mutex_destroy(&registry->lock);
+    free(registry);
+    return;
+}
+
+
+// Returns the image of the hex file at path with a new reference held by
+// the caller, loading it on first use.
+// Returns NULL in case of errors.
+rom_t *rom_open(rom_registry_t *registry, const char *path, uint32_t size) {
+    rom_t *rom;
+
+    pthread_mutex_lock(&registry->lock);
+    for (rom = registry->images; rom != NULL; rom = rom->next) {
+        if (rom->size == size && strcmp(rom->path, path) == 0)
+            break;
+    }
+
+    if (rom == NULL) {
+        rom = rom_load(path, size);
+        if (rom != NULL) {
+            rom->next = registry->images;
+            registry->images = rom;
+        }
+    }
+
+    if (rom != NULL)
+        rom_acquire(rom);
+    pthread_mutex_unlock(&registry->lock);
+    return rom;
+}
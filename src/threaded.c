@@ -0,0 +1,822 @@
+#include "threaded.h"
+#include "opcodes.h"
+#include "logger.h"
+
+/*
+  Direct-threaded execution engine.
+
+  This is an alternative to the opc_tbl based cpu_emulate(). All the
+  unprefixed instructions are executed inside one function, dispatching
+  through GCC labels-as-values, with the cpu registers held in locals and
+  written back to cpu_t only when leaving the engine. Prefixed groups
+  (CB, DD, ED, FD) and DAA fall back to the opc_tbl handlers, which remain
+  the reference implementation the engine is checked against.
+
+  The engine leaves after any IO access and on HALT so that the board can
+  service the peripherals, and it never accepts interrupts itself: as soon
+  as one can be taken, the next instruction is run through cpu_emulate().
+*/
+
+// Flag masks.
+#define FS FLAG_SIGN
+#define FZ FLAG_ZERO
+#define FH FLAG_HCARRY
+#define FP FLAG_PARITY
+#define FN FLAG_ADDSUB
+#define FC FLAG_CARRY
+
+// Register pairs held in 8-bit locals.
+#define PAIR(hi, lo) ((uint16_t)(((hi) << 8) | (lo)))
+#define SETPAIR(hi, lo, val) \
+    do { uint16_t v_ = (val); hi = (v_ >> 8); lo = (v_ & 0xFF); } while (0)
+#define SWAPPAIR(hi, lo, field) \
+    do { tmp16 = (field); field = PAIR(hi, lo); SETPAIR(hi, lo, tmp16); } while (0)
+
+// Memory and stack access.
+#define RD8(addr)       thr_read(cpu, (addr))
+#define RD16(addr)      thr_read16(cpu, (addr))
+#define FETCH16()       (tmp16 = RD16(pc), pc += 2, tmp16)
+
+// Writes through cpu_write() can move host pages (copy on write), so they
+// drop the page cached for fetches.
+#define WR8(data, addr) \
+    do { if (thr_write(cpu, (data), (addr))) fetch_page = THR_NO_PAGE; } while (0)
+#define PUSH16(val) \
+    do { sp -= 2; if (thr_push16(cpu, (val), sp)) fetch_page = THR_NO_PAGE; } while (0)
+
+// Bytes at pc are read from the host page cached in fetch_host.
+#define THR_NO_PAGE     MEM_PAGE_COUNT
+#define FETCH8() \
+    ((pc >> MEM_PAGE_SHIFT) == fetch_page ? fetch_host[pc++ & MEM_PAGE_MASK] : \
+     thr_fetch(cpu, pc++, &fetch_page, &fetch_host))
+#define POP16()         (tmp16 = RD16(sp), sp += 2, tmp16)
+
+// 8-bit arithmetic and logic on the accumulator.
+#define ADD_A(val) (a = thr_add8(&f, a, (val), 0))
+#define ADC_A(val) (a = thr_add8(&f, a, (val), f & FC))
+#define SUB_A(val) (a = thr_sub8(&f, a, (val), 0))
+#define SBC_A(val) (a = thr_sub8(&f, a, (val), f & FC))
+#define AND_A(val) (a &= (val), f = (f & FLAG_UNDOC_MASK) | thr_szp(a) | FH)
+#define XOR_A(val) (a ^= (val), f = (f & FLAG_UNDOC_MASK) | thr_szp(a))
+#define OR_A(val)  (a |= (val), f = (f & FLAG_UNDOC_MASK) | thr_szp(a))
+#define CP_A(val)  (thr_sub8(&f, a, (val), 0))
+#define ADD_HL(val) SETPAIR(h, l, thr_add16(&f, PAIR(h, l), (val)))
+
+// Cpu state transfer between locals and cpu_t.
+#define SPILL() \
+    do { \
+        cpu->A = a; cpu->F = f; cpu->B = b; cpu->C = c; \
+        cpu->D = d; cpu->E = e; cpu->H = h; cpu->L = l; \
+        cpu->PC = pc; cpu->SP = sp; \
+        cpu->cycles = cycles; cpu->instr += spilled - left; \
+        spilled = left; \
+    } while (0)
+
+#define RELOAD() \
+    do { \
+        a = cpu->A; f = cpu_getF(cpu); b = cpu->B; c = cpu->C; \
+        d = cpu->D; e = cpu->E; h = cpu->H; l = cpu->L; \
+        pc = cpu->PC; sp = cpu->SP; cycles = cpu->cycles; \
+        fetch_page = THR_NO_PAGE; \
+    } while (0)
+
+#ifdef CPU_TRACE
+#define TRACE() \
+    cpu_traceRecord(cpu, pc, PAIR(a, f), PAIR(b, c), PAIR(d, e), PAIR(h, l), \
+        sp, cycles)
+#else
+#define TRACE() do { } while (0)
+#endif
+
+// Instruction completion and dispatch.
+#define DISPATCH() \
+    do { \
+        if (left == 0) \
+            goto done; \
+        TRACE(); \
+        op = FETCH8(); \
+        goto *dispatch[op]; \
+    } while (0)
+
+#define END(t)      do { cycles += (t); left--; DISPATCH(); } while (0)
+#define END_EXIT(t) do { cycles += (t); left--; goto done; } while (0)
+
+// Runs the instruction through the opc_tbl reference handler.
+#define FALLBACK_RUN() \
+    do { \
+        SPILL(); \
+        opc_tbl[op].execute(cpu, op); \
+        RELOAD(); \
+        cycles += opc_tbl[op].TStates; \
+    } while (0)
+
+#define FALLBACK()      do { FALLBACK_RUN(); END(0); } while (0)
+#define FALLBACK_EXIT() do { FALLBACK_RUN(); END_EXIT(0); } while (0)
+
+
+// Reads one byte, taking the page table fast path when possible.
+static inline uint8_t thr_read(cpu_t *cpu, const uint16_t addr) {
+    const mem_page_t *pg = &cpu->pages[addr >> MEM_PAGE_SHIFT];
+
+    if (!(pg->flags & (PAGE_UNUSED | PAGE_MMIO)))
+        return pg->host[addr & MEM_PAGE_MASK];
+
+    return cpu_read(cpu, addr);
+}
+
+
+// Reads the byte at pc and caches its page for the next fetches, unless
+// it is not directly mapped.
+static inline uint8_t thr_fetch(cpu_t *cpu, const uint16_t addr,
+    uint32_t *page, const uint8_t **host) {
+    const mem_page_t *pg = &cpu->pages[addr >> MEM_PAGE_SHIFT];
+
+    if (pg->flags & (PAGE_UNUSED | PAGE_MMIO)) {
+        *page = THR_NO_PAGE;
+        return cpu_read(cpu, addr);
+    }
+
+    *page = addr >> MEM_PAGE_SHIFT;
+    *host = pg->host;
+    return pg->host[addr & MEM_PAGE_MASK];
+}
+
+
+// Writes one byte, taking the page table fast path when possible.
+// Returns true if the write went through cpu_write().
+static inline bool thr_write(cpu_t *cpu, const uint8_t data, const uint16_t addr) {
+    const mem_page_t *pg = &cpu->pages[addr >> MEM_PAGE_SHIFT];
+
+    if (!pg->flags) {
+        pg->host[addr & MEM_PAGE_MASK] = data;
+        return false;
+    }
+
+    cpu_write(cpu, data, addr);
+    return true;
+}
+
+
+// Reads a word, with a single page lookup when both bytes are in the same
+// directly mapped page.
+static inline uint16_t thr_read16(cpu_t *cpu, const uint16_t addr) {
+    const mem_page_t *pg = &cpu->pages[addr >> MEM_PAGE_SHIFT];
+    const uint16_t offset = addr & MEM_PAGE_MASK;
+
+    if (offset != MEM_PAGE_MASK && !(pg->flags & (PAGE_UNUSED | PAGE_MMIO)))
+        return pg->host[offset] | (pg->host[offset + 1] << 8);
+
+    return thr_read(cpu, addr) | (thr_read(cpu, (uint16_t)(addr + 1)) << 8);
+}
+
+
+// Writes a word pushed at addr. Like cpu_stackPush(), the slow path writes
+// the high byte first.
+// Returns true if the write went through cpu_write().
+static inline bool thr_push16(cpu_t *cpu, const uint16_t data,
+    const uint16_t addr) {
+    const mem_page_t *pg = &cpu->pages[addr >> MEM_PAGE_SHIFT];
+    const uint16_t offset = addr & MEM_PAGE_MASK;
+
+    if (offset != MEM_PAGE_MASK && !pg->flags) {
+        pg->host[offset] = data & 0xFF;
+        pg->host[offset + 1] = data >> 8;
+        return false;
+    }
+
+    cpu_write(cpu, data >> 8, (uint16_t)(addr + 1));
+    cpu_write(cpu, data & 0xFF, addr);
+    return true;
+}
+
+
+// Returns S, Z and P flags for the given result.
+static inline uint8_t thr_szp(uint8_t val) {
+    return opc_szpTbl[val];
+}
+
+
+// 8-bit ADD and ADC.
+static inline uint8_t thr_add8(uint8_t *f, uint8_t op1, uint8_t op2, uint8_t c) {
+    *f = (*f & FLAG_UNDOC_MASK) | opc_szhvcAddTbl[FLAG_TBL_IDX(c, op1, op2)];
+    return op1 + op2 + c;
+}
+
+
+// 8-bit SUB, SBC and CP.
+static inline uint8_t thr_sub8(uint8_t *f, uint8_t op1, uint8_t op2, uint8_t c) {
+    *f = (*f & FLAG_UNDOC_MASK) | opc_szhvcSubTbl[FLAG_TBL_IDX(c, op1, op2)];
+    return op1 - op2 - c;
+}
+
+
+// INC r. Carry is not affected.
+static inline uint8_t thr_inc8(uint8_t *f, uint8_t val) {
+    *f = (*f & (FLAG_UNDOC_MASK | FC)) |
+        (opc_szhvcAddTbl[FLAG_TBL_IDX(0, val, 1)] & ~FC);
+    return val + 1;
+}
+
+
+// DEC r. Carry is not affected.
+static inline uint8_t thr_dec8(uint8_t *f, uint8_t val) {
+    *f = (*f & (FLAG_UNDOC_MASK | FC)) |
+        (opc_szhvcSubTbl[FLAG_TBL_IDX(0, val, 1)] & ~FC);
+    return val - 1;
+}
+
+
+// 16-bit ADD. S, Z and P/V are not affected.
+static inline uint16_t thr_add16(uint8_t *f, uint16_t op1, uint16_t op2) {
+    *f = (*f & ~(FH | FN | FC)) |
+        ((((op1 & 0xFFF) + (op2 & 0xFFF)) & 0x1000) ? FH : 0) |
+        (((uint32_t)op1 + op2 > 0xFFFF) ? FC : 0);
+    return op1 + op2;
+}
+
+
+// Executes up to instr_limit instructions. Execution stops earlier after
+// IO instructions, HALT or whenever a pending interrupt could be accepted.
+// Returns the number of executed instructions (at least one if the limit
+// is not zero).
+uint32_t thr_emulate(cpu_t *cpu, uint32_t instr_limit) {
+    static const void * const dispatch[0x100] = {
+        &&op_00, &&op_01, &&op_02, &&op_03, &&op_04, &&op_05, &&op_06, &&op_07,
+        &&op_08, &&op_09, &&op_0A, &&op_0B, &&op_0C, &&op_0D, &&op_0E, &&op_0F,
+        &&op_10, &&op_11, &&op_12, &&op_13, &&op_14, &&op_15, &&op_16, &&op_17,
+        &&op_18, &&op_19, &&op_1A, &&op_1B, &&op_1C, &&op_1D, &&op_1E, &&op_1F,
+        &&op_20, &&op_21, &&op_22, &&op_23, &&op_24, &&op_25, &&op_26, &&op_27,
+        &&op_28, &&op_29, &&op_2A, &&op_2B, &&op_2C, &&op_2D, &&op_2E, &&op_2F,
+        &&op_30, &&op_31, &&op_32, &&op_33, &&op_34, &&op_35, &&op_36, &&op_37,
+        &&op_38, &&op_39, &&op_3A, &&op_3B, &&op_3C, &&op_3D, &&op_3E, &&op_3F,
+        &&op_40, &&op_41, &&op_42, &&op_43, &&op_44, &&op_45, &&op_46, &&op_47,
+        &&op_48, &&op_49, &&op_4A, &&op_4B, &&op_4C, &&op_4D, &&op_4E, &&op_4F,
+        &&op_50, &&op_51, &&op_52, &&op_53, &&op_54, &&op_55, &&op_56, &&op_57,
+        &&op_58, &&op_59, &&op_5A, &&op_5B, &&op_5C, &&op_5D, &&op_5E, &&op_5F,
+        &&op_60, &&op_61, &&op_62, &&op_63, &&op_64, &&op_65, &&op_66, &&op_67,
+        &&op_68, &&op_69, &&op_6A, &&op_6B, &&op_6C, &&op_6D, &&op_6E, &&op_6F,
+        &&op_70, &&op_71, &&op_72, &&op_73, &&op_74, &&op_75, &&op_76, &&op_77,
+        &&op_78, &&op_79, &&op_7A, &&op_7B, &&op_7C, &&op_7D, &&op_7E, &&op_7F,
+        &&op_80, &&op_81, &&op_82, &&op_83, &&op_84, &&op_85, &&op_86, &&op_87,
+        &&op_88, &&op_89, &&op_8A, &&op_8B, &&op_8C, &&op_8D, &&op_8E, &&op_8F,
+        &&op_90, &&op_91, &&op_92, &&op_93, &&op_94, &&op_95, &&op_96, &&op_97,
+        &&op_98, &&op_99, &&op_9A, &&op_9B, &&op_9C, &&op_9D, &&op_9E, &&op_9F,
+        &&op_A0, &&op_A1, &&op_A2, &&op_A3, &&op_A4, &&op_A5, &&op_A6, &&op_A7,
+        &&op_A8, &&op_A9, &&op_AA, &&op_AB, &&op_AC, &&op_AD, &&op_AE, &&op_AF,
+        &&op_B0, &&op_B1, &&op_B2, &&op_B3, &&op_B4, &&op_B5, &&op_B6, &&op_B7,
+        &&op_B8, &&op_B9, &&op_BA, &&op_BB, &&op_BC, &&op_BD, &&op_BE, &&op_BF,
+        &&op_C0, &&op_C1, &&op_C2, &&op_C3, &&op_C4, &&op_C5, &&op_C6, &&op_C7,
+        &&op_C8, &&op_C9, &&op_CA, &&op_CB, &&op_CC, &&op_CD, &&op_CE, &&op_CF,
+        &&op_D0, &&op_D1, &&op_D2, &&op_D3, &&op_D4, &&op_D5, &&op_D6, &&op_D7,
+        &&op_D8, &&op_D9, &&op_DA, &&op_DB, &&op_DC, &&op_DD, &&op_DE, &&op_DF,
+        &&op_E0, &&op_E1, &&op_E2, &&op_E3, &&op_E4, &&op_E5, &&op_E6, &&op_E7,
+        &&op_E8, &&op_E9, &&op_EA, &&op_EB, &&op_EC, &&op_ED, &&op_EE, &&op_EF,
+        &&op_F0, &&op_F1, &&op_F2, &&op_F3, &&op_F4, &&op_F5, &&op_F6, &&op_F7,
+        &&op_F8, &&op_F9, &&op_FA, &&op_FB, &&op_FC, &&op_FD, &&op_FE, &&op_FF,
+    };
+
+    if (instr_limit == 0)
+        return 0;
+
+    // A halted cpu that cannot take an interrupt only runs NOPs.
+    if (cpu->halt && !cpu_hasInterrupt(cpu))
+        return cpu_skipHalt(cpu, instr_limit);
+
+    // Halt and interrupt acceptance are left to the reference engine.
+    if (cpu->halt || cpu_hasInterrupt(cpu)) {
+        cpu_emulate(cpu);
+        cpu_getF(cpu);
+        return 1;
+    }
+
+    uint8_t a, f, b, c, d, e, h, l;
+    uint16_t pc, sp;
+    uint32_t cycles;
+    uint32_t left = instr_limit; // Instructions still allowed.
+    uint32_t spilled = instr_limit;
+    uint8_t op, tmp8;
+    uint16_t tmp16;
+    uint32_t fetch_page;
+    const uint8_t *fetch_host = NULL;
+
+    RELOAD();
+    DISPATCH();
+
+    op_00: // NOP
+        END(4);
+    op_01: // LD BC,nn
+        SETPAIR(b, c, FETCH16()); END(10);
+    op_02: // LD (BC),A
+        WR8(a, PAIR(b, c)); END(7);
+    op_03: // INC BC
+        SETPAIR(b, c, PAIR(b, c) + 1); END(6);
+    op_04: // INC B
+        b = thr_inc8(&f, b); END(4);
+    op_05: // DEC B
+        b = thr_dec8(&f, b); END(4);
+    op_06: // LD B,n
+        b = FETCH8(); END(7);
+    op_07: // RLCA
+        tmp8 = a >> 7; a = (a << 1) | tmp8; f = (f & ~(FH | FN | FC)) | tmp8; END(4);
+    op_08: // EX AF,AF'
+        tmp16 = cpu->ArFr; cpu->ArFr = PAIR(a, f); SETPAIR(a, f, tmp16); END(4);
+    op_09: // ADD HL,BC
+        ADD_HL(PAIR(b, c)); END(11);
+    op_0A: // LD A,(BC)
+        a = RD8(PAIR(b, c)); END(7);
+    op_0B: // DEC BC
+        SETPAIR(b, c, PAIR(b, c) - 1); END(6);
+    op_0C: // INC C
+        c = thr_inc8(&f, c); END(4);
+    op_0D: // DEC C
+        c = thr_dec8(&f, c); END(4);
+    op_0E: // LD C,n
+        c = FETCH8(); END(7);
+    op_0F: // RRCA
+        tmp8 = a & 0x1; a = (a >> 1) | (tmp8 << 7); f = (f & ~(FH | FN | FC)) | tmp8; END(4);
+    op_10: // DJNZ e
+        tmp8 = FETCH8(); if (--b) { pc += (int8_t)tmp8; END(13); } END(8);
+    op_11: // LD DE,nn
+        SETPAIR(d, e, FETCH16()); END(10);
+    op_12: // LD (DE),A
+        WR8(a, PAIR(d, e)); END(7);
+    op_13: // INC DE
+        SETPAIR(d, e, PAIR(d, e) + 1); END(6);
+    op_14: // INC D
+        d = thr_inc8(&f, d); END(4);
+    op_15: // DEC D
+        d = thr_dec8(&f, d); END(4);
+    op_16: // LD D,n
+        d = FETCH8(); END(7);
+    op_17: // RLA
+        tmp8 = f & FC; f = (f & ~(FH | FN | FC)) | (a >> 7); a = (a << 1) | tmp8; END(4);
+    op_18: // JR e
+        tmp8 = FETCH8(); pc += (int8_t)tmp8; END(12);
+    op_19: // ADD HL,DE
+        ADD_HL(PAIR(d, e)); END(11);
+    op_1A: // LD A,(DE)
+        a = RD8(PAIR(d, e)); END(7);
+    op_1B: // DEC DE
+        SETPAIR(d, e, PAIR(d, e) - 1); END(6);
+    op_1C: // INC E
+        e = thr_inc8(&f, e); END(4);
+    op_1D: // DEC E
+        e = thr_dec8(&f, e); END(4);
+    op_1E: // LD E,n
+        e = FETCH8(); END(7);
+    op_1F: // RRA
+        tmp8 = f & FC; f = (f & ~(FH | FN | FC)) | (a & 0x1); a = (a >> 1) | (tmp8 << 7); END(4);
+    op_20: // JR NZ,e
+        tmp8 = FETCH8(); if (!(f & FZ)) { pc += (int8_t)tmp8; END(12); } END(7);
+    op_21: // LD HL,nn
+        SETPAIR(h, l, FETCH16()); END(10);
+    op_22: // LD (nn),HL
+        tmp16 = FETCH16(); WR8(l, tmp16); WR8(h, (uint16_t)(tmp16 + 1)); END(16);
+    op_23: // INC HL
+        SETPAIR(h, l, PAIR(h, l) + 1); END(6);
+    op_24: // INC H
+        h = thr_inc8(&f, h); END(4);
+    op_25: // DEC H
+        h = thr_dec8(&f, h); END(4);
+    op_26: // LD H,n
+        h = FETCH8(); END(7);
+    op_27: // DAA
+        FALLBACK();
+    op_28: // JR Z,e
+        tmp8 = FETCH8(); if (f & FZ) { pc += (int8_t)tmp8; END(12); } END(7);
+    op_29: // ADD HL,HL
+        ADD_HL(PAIR(h, l)); END(11);
+    op_2A: // LD HL,(nn)
+        tmp16 = FETCH16(); SETPAIR(h, l, RD16(tmp16)); END(16);
+    op_2B: // DEC HL
+        SETPAIR(h, l, PAIR(h, l) - 1); END(6);
+    op_2C: // INC L
+        l = thr_inc8(&f, l); END(4);
+    op_2D: // DEC L
+        l = thr_dec8(&f, l); END(4);
+    op_2E: // LD L,n
+        l = FETCH8(); END(7);
+    op_2F: // CPL
+        a = ~a; f |= (FH | FN); END(4);
+    op_30: // JR NC,e
+        tmp8 = FETCH8(); if (!(f & FC)) { pc += (int8_t)tmp8; END(12); } END(7);
+    op_31: // LD SP,nn
+        sp = FETCH16(); END(10);
+    op_32: // LD (nn),A
+        tmp16 = FETCH16(); WR8(a, tmp16); END(13);
+    op_33: // INC SP
+        sp++; END(6);
+    op_34: // INC (HL)
+        WR8(thr_inc8(&f, RD8(PAIR(h, l))), PAIR(h, l)); END(11);
+    op_35: // DEC (HL)
+        WR8(thr_dec8(&f, RD8(PAIR(h, l))), PAIR(h, l)); END(11);
+    op_36: // LD (HL),n
+        tmp8 = FETCH8(); WR8(tmp8, PAIR(h, l)); END(10);
+    op_37: // SCF
+        f = (f & ~(FH | FN)) | FC; END(4);
+    op_38: // JR C,e
+        tmp8 = FETCH8(); if (f & FC) { pc += (int8_t)tmp8; END(12); } END(7);
+    op_39: // ADD HL,SP
+        ADD_HL(sp); END(11);
+    op_3A: // LD A,(nn)
+        tmp16 = FETCH16(); a = RD8(tmp16); END(13);
+    op_3B: // DEC SP
+        sp--; END(6);
+    op_3C: // INC A
+        a = thr_inc8(&f, a); END(4);
+    op_3D: // DEC A
+        a = thr_dec8(&f, a); END(4);
+    op_3E: // LD A,n
+        a = FETCH8(); END(7);
+    op_3F: // CCF
+        f = (f & ~(FH | FN | FC)) | ((f & FC) ? FH : FC); END(4);
+    op_40: // LD B,B
+        b = b; END(4);
+    op_41: // LD B,C
+        b = c; END(4);
+    op_42: // LD B,D
+        b = d; END(4);
+    op_43: // LD B,E
+        b = e; END(4);
+    op_44: // LD B,H
+        b = h; END(4);
+    op_45: // LD B,L
+        b = l; END(4);
+    op_46: // LD B,(HL)
+        b = RD8(PAIR(h, l)); END(7);
+    op_47: // LD B,A
+        b = a; END(4);
+    op_48: // LD C,B
+        c = b; END(4);
+    op_49: // LD C,C
+        c = c; END(4);
+    op_4A: // LD C,D
+        c = d; END(4);
+    op_4B: // LD C,E
+        c = e; END(4);
+    op_4C: // LD C,H
+        c = h; END(4);
+    op_4D: // LD C,L
+        c = l; END(4);
+    op_4E: // LD C,(HL)
+        c = RD8(PAIR(h, l)); END(7);
+    op_4F: // LD C,A
+        c = a; END(4);
+    op_50: // LD D,B
+        d = b; END(4);
+    op_51: // LD D,C
+        d = c; END(4);
+    op_52: // LD D,D
+        d = d; END(4);
+    op_53: // LD D,E
+        d = e; END(4);
+    op_54: // LD D,H
+        d = h; END(4);
+    op_55: // LD D,L
+        d = l; END(4);
+    op_56: // LD D,(HL)
+        d = RD8(PAIR(h, l)); END(7);
+    op_57: // LD D,A
+        d = a; END(4);
+    op_58: // LD E,B
+        e = b; END(4);
+    op_59: // LD E,C
+        e = c; END(4);
+    op_5A: // LD E,D
+        e = d; END(4);
+    op_5B: // LD E,E
+        e = e; END(4);
+    op_5C: // LD E,H
+        e = h; END(4);
+    op_5D: // LD E,L
+        e = l; END(4);
+    op_5E: // LD E,(HL)
+        e = RD8(PAIR(h, l)); END(7);
+    op_5F: // LD E,A
+        e = a; END(4);
+    op_60: // LD H,B
+        h = b; END(4);
+    op_61: // LD H,C
+        h = c; END(4);
+    op_62: // LD H,D
+        h = d; END(4);
+    op_63: // LD H,E
+        h = e; END(4);
+    op_64: // LD H,H
+        h = h; END(4);
+    op_65: // LD H,L
+        h = l; END(4);
+    op_66: // LD H,(HL)
+        h = RD8(PAIR(h, l)); END(7);
+    op_67: // LD H,A
+        h = a; END(4);
+    op_68: // LD L,B
+        l = b; END(4);
+    op_69: // LD L,C
+        l = c; END(4);
+    op_6A: // LD L,D
+        l = d; END(4);
+    op_6B: // LD L,E
+        l = e; END(4);
+    op_6C: // LD L,H
+        l = h; END(4);
+    op_6D: // LD L,L
+        l = l; END(4);
+    op_6E: // LD L,(HL)
+        l = RD8(PAIR(h, l)); END(7);
+    op_6F: // LD L,A
+        l = a; END(4);
+    op_70: // LD (HL),B
+        WR8(b, PAIR(h, l)); END(7);
+    op_71: // LD (HL),C
+        WR8(c, PAIR(h, l)); END(7);
+    op_72: // LD (HL),D
+        WR8(d, PAIR(h, l)); END(7);
+    op_73: // LD (HL),E
+        WR8(e, PAIR(h, l)); END(7);
+    op_74: // LD (HL),H
+        WR8(h, PAIR(h, l)); END(7);
+    op_75: // LD (HL),L
+        WR8(l, PAIR(h, l)); END(7);
+    op_76: // HALT
+        cpu->halt = 1; cycles += 4; left--; goto done;
+    op_77: // LD (HL),A
+        WR8(a, PAIR(h, l)); END(7);
+    op_78: // LD A,B
+        a = b; END(4);
+    op_79: // LD A,C
+        a = c; END(4);
+    op_7A: // LD A,D
+        a = d; END(4);
+    op_7B: // LD A,E
+        a = e; END(4);
+    op_7C: // LD A,H
+        a = h; END(4);
+    op_7D: // LD A,L
+        a = l; END(4);
+    op_7E: // LD A,(HL)
+        a = RD8(PAIR(h, l)); END(7);
+    op_7F: // LD A,A
+        a = a; END(4);
+    op_80: // ADD A,B
+        ADD_A(b); END(4);
+    op_81: // ADD A,C
+        ADD_A(c); END(4);
+    op_82: // ADD A,D
+        ADD_A(d); END(4);
+    op_83: // ADD A,E
+        ADD_A(e); END(4);
+    op_84: // ADD A,H
+        ADD_A(h); END(4);
+    op_85: // ADD A,L
+        ADD_A(l); END(4);
+    op_86: // ADD A,(HL)
+        ADD_A(RD8(PAIR(h, l))); END(7);
+    op_87: // ADD A,A
+        ADD_A(a); END(4);
+    op_88: // ADC A,B
+        ADC_A(b); END(4);
+    op_89: // ADC A,C
+        ADC_A(c); END(4);
+    op_8A: // ADC A,D
+        ADC_A(d); END(4);
+    op_8B: // ADC A,E
+        ADC_A(e); END(4);
+    op_8C: // ADC A,H
+        ADC_A(h); END(4);
+    op_8D: // ADC A,L
+        ADC_A(l); END(4);
+    op_8E: // ADC A,(HL)
+        ADC_A(RD8(PAIR(h, l))); END(7);
+    op_8F: // ADC A,A
+        ADC_A(a); END(4);
+    op_90: // SUB B
+        SUB_A(b); END(4);
+    op_91: // SUB C
+        SUB_A(c); END(4);
+    op_92: // SUB D
+        SUB_A(d); END(4);
+    op_93: // SUB E
+        SUB_A(e); END(4);
+    op_94: // SUB H
+        SUB_A(h); END(4);
+    op_95: // SUB L
+        SUB_A(l); END(4);
+    op_96: // SUB (HL)
+        SUB_A(RD8(PAIR(h, l))); END(7);
+    op_97: // SUB A
+        SUB_A(a); END(4);
+    op_98: // SBC A,B
+        SBC_A(b); END(4);
+    op_99: // SBC A,C
+        SBC_A(c); END(4);
+    op_9A: // SBC A,D
+        SBC_A(d); END(4);
+    op_9B: // SBC A,E
+        SBC_A(e); END(4);
+    op_9C: // SBC A,H
+        SBC_A(h); END(4);
+    op_9D: // SBC A,L
+        SBC_A(l); END(4);
+    op_9E: // SBC A,(HL)
+        SBC_A(RD8(PAIR(h, l))); END(7);
+    op_9F: // SBC A,A
+        SBC_A(a); END(4);
+    op_A0: // AND B
+        AND_A(b); END(4);
+    op_A1: // AND C
+        AND_A(c); END(4);
+    op_A2: // AND D
+        AND_A(d); END(4);
+    op_A3: // AND E
+        AND_A(e); END(4);
+    op_A4: // AND H
+        AND_A(h); END(4);
+    op_A5: // AND L
+        AND_A(l); END(4);
+    op_A6: // AND (HL)
+        AND_A(RD8(PAIR(h, l))); END(7);
+    op_A7: // AND A
+        AND_A(a); END(4);
+    op_A8: // XOR B
+        XOR_A(b); END(4);
+    op_A9: // XOR C
+        XOR_A(c); END(4);
+    op_AA: // XOR D
+        XOR_A(d); END(4);
+    op_AB: // XOR E
+        XOR_A(e); END(4);
+    op_AC: // XOR H
+        XOR_A(h); END(4);
+    op_AD: // XOR L
+        XOR_A(l); END(4);
+    op_AE: // XOR (HL)
+        XOR_A(RD8(PAIR(h, l))); END(7);
+    op_AF: // XOR A
+        XOR_A(a); END(4);
+    op_B0: // OR B
+        OR_A(b); END(4);
+    op_B1: // OR C
+        OR_A(c); END(4);
+    op_B2: // OR D
+        OR_A(d); END(4);
+    op_B3: // OR E
+        OR_A(e); END(4);
+    op_B4: // OR H
+        OR_A(h); END(4);
+    op_B5: // OR L
+        OR_A(l); END(4);
+    op_B6: // OR (HL)
+        OR_A(RD8(PAIR(h, l))); END(7);
+    op_B7: // OR A
+        OR_A(a); END(4);
+    op_B8: // CP B
+        CP_A(b); END(4);
+    op_B9: // CP C
+        CP_A(c); END(4);
+    op_BA: // CP D
+        CP_A(d); END(4);
+    op_BB: // CP E
+        CP_A(e); END(4);
+    op_BC: // CP H
+        CP_A(h); END(4);
+    op_BD: // CP L
+        CP_A(l); END(4);
+    op_BE: // CP (HL)
+        CP_A(RD8(PAIR(h, l))); END(7);
+    op_BF: // CP A
+        CP_A(a); END(4);
+    op_C0: // RET NZ
+        if (!(f & FZ)) { pc = POP16(); END(11); } END(5);
+    op_C1: // POP BC
+        tmp16 = POP16(); SETPAIR(b, c, tmp16); END(10);
+    op_C2: // JP NZ,nn
+        tmp16 = FETCH16(); if (!(f & FZ)) pc = tmp16; END(10);
+    op_C3: // JP nn
+        pc = FETCH16(); END(10);
+    op_C4: // CALL NZ,nn
+        tmp16 = FETCH16(); if (!(f & FZ)) { PUSH16(pc); pc = tmp16; END(17); } END(10);
+    op_C5: // PUSH BC
+        PUSH16(PAIR(b, c)); END(11);
+    op_C6: // ADD A,n
+        ADD_A(FETCH8()); END(7);
+    op_C7: // RST 00h
+        PUSH16(pc); pc = 0x00; END(11);
+    op_C8: // RET Z
+        if (f & FZ) { pc = POP16(); END(11); } END(5);
+    op_C9: // RET
+        pc = POP16(); END(10);
+    op_CA: // JP Z,nn
+        tmp16 = FETCH16(); if (f & FZ) pc = tmp16; END(10);
+    op_CB: // CB prefix
+        FALLBACK();
+    op_CC: // CALL Z,nn
+        tmp16 = FETCH16(); if (f & FZ) { PUSH16(pc); pc = tmp16; END(17); } END(10);
+    op_CD: // CALL nn
+        tmp16 = FETCH16(); PUSH16(pc); pc = tmp16; END(17);
+    op_CE: // ADC A,n
+        ADC_A(FETCH8()); END(7);
+    op_CF: // RST 08h
+        PUSH16(pc); pc = 0x08; END(11);
+    op_D0: // RET NC
+        if (!(f & FC)) { pc = POP16(); END(11); } END(5);
+    op_D1: // POP DE
+        tmp16 = POP16(); SETPAIR(d, e, tmp16); END(10);
+    op_D2: // JP NC,nn
+        tmp16 = FETCH16(); if (!(f & FC)) pc = tmp16; END(10);
+    op_D3: // OUT (n),A
+        tmp8 = FETCH8(); SPILL(); cpu_portOut(cpu, tmp8, a); END_EXIT(11);
+    op_D4: // CALL NC,nn
+        tmp16 = FETCH16(); if (!(f & FC)) { PUSH16(pc); pc = tmp16; END(17); } END(10);
+    op_D5: // PUSH DE
+        PUSH16(PAIR(d, e)); END(11);
+    op_D6: // SUB n
+        SUB_A(FETCH8()); END(7);
+    op_D7: // RST 10h
+        PUSH16(pc); pc = 0x10; END(11);
+    op_D8: // RET C
+        if (f & FC) { pc = POP16(); END(11); } END(5);
+    op_D9: // EXX
+        SWAPPAIR(b, c, cpu->BrCr); SWAPPAIR(d, e, cpu->DrEr); SWAPPAIR(h, l, cpu->HrLr); END(4);
+    op_DA: // JP C,nn
+        tmp16 = FETCH16(); if (f & FC) pc = tmp16; END(10);
+    op_DB: // IN A,(n)
+        tmp8 = FETCH8(); SPILL(); a = cpu_portIn(cpu, tmp8); END_EXIT(11);
+    op_DC: // CALL C,nn
+        tmp16 = FETCH16(); if (f & FC) { PUSH16(pc); pc = tmp16; END(17); } END(10);
+    op_DD: // DD prefix
+        FALLBACK();
+    op_DE: // SBC A,n
+        SBC_A(FETCH8()); END(7);
+    op_DF: // RST 18h
+        PUSH16(pc); pc = 0x18; END(11);
+    op_E0: // RET PO
+        if (!(f & FP)) { pc = POP16(); END(11); } END(5);
+    op_E1: // POP HL
+        tmp16 = POP16(); SETPAIR(h, l, tmp16); END(10);
+    op_E2: // JP PO,nn
+        tmp16 = FETCH16(); if (!(f & FP)) pc = tmp16; END(10);
+    op_E3: // EX (SP),HL
+        tmp8 = RD8(sp); tmp16 = RD8((uint16_t)(sp + 1));
+        WR8(l, sp); WR8(h, (uint16_t)(sp + 1)); l = tmp8; h = tmp16; END(19);
+    op_E4: // CALL PO,nn
+        tmp16 = FETCH16(); if (!(f & FP)) { PUSH16(pc); pc = tmp16; END(17); } END(10);
+    op_E5: // PUSH HL
+        PUSH16(PAIR(h, l)); END(11);
+    op_E6: // AND n
+        AND_A(FETCH8()); END(7);
+    op_E7: // RST 20h
+        PUSH16(pc); pc = 0x20; END(11);
+    op_E8: // RET PE
+        if (f & FP) { pc = POP16(); END(11); } END(5);
+    op_E9: // JP (HL)
+        pc = PAIR(h, l); END(4);
+    op_EA: // JP PE,nn
+        tmp16 = FETCH16(); if (f & FP) pc = tmp16; END(10);
+    op_EB: // EX DE,HL
+        tmp8 = d; d = h; h = tmp8; tmp8 = e; e = l; l = tmp8; END(4);
+    op_EC: // CALL PE,nn
+        tmp16 = FETCH16(); if (f & FP) { PUSH16(pc); pc = tmp16; END(17); } END(10);
+    op_ED: // ED prefix
+        FALLBACK_EXIT();
+    op_EE: // XOR n
+        XOR_A(FETCH8()); END(7);
+    op_EF: // RST 28h
+        PUSH16(pc); pc = 0x28; END(11);
+    op_F0: // RET P
+        if (!(f & FS)) { pc = POP16(); END(11); } END(5);
+    op_F1: // POP AF
+        tmp16 = POP16(); SETPAIR(a, f, tmp16); END(10);
+    op_F2: // JP P,nn
+        tmp16 = FETCH16(); if (!(f & FS)) pc = tmp16; END(10);
+    op_F3: // DI
+        cpu->IFF1 = 0; cpu->IFF2 = 0; END(4);
+    op_F4: // CALL P,nn
+        tmp16 = FETCH16(); if (!(f & FS)) { PUSH16(pc); pc = tmp16; END(17); } END(10);
+    op_F5: // PUSH AF
+        PUSH16(PAIR(a, f)); END(11);
+    op_F6: // OR n
+        OR_A(FETCH8()); END(7);
+    op_F7: // RST 30h
+        PUSH16(pc); pc = 0x30; END(11);
+    op_F8: // RET M
+        if (f & FS) { pc = POP16(); END(11); } END(5);
+    op_F9: // LD SP,HL
+        sp = PAIR(h, l); END(6);
+    op_FA: // JP M,nn
+        tmp16 = FETCH16(); if (f & FS) pc = tmp16; END(10);
+    op_FB: // EI
+        cpu->IFF1 = 1; cpu->IFF2 = 1; if (cpu->is_pendingMI) END_EXIT(4); END(4);
+    op_FC: // CALL M,nn
+        tmp16 = FETCH16(); if (f & FS) { PUSH16(pc); pc = tmp16; END(17); } END(10);
+    op_FD: // FD prefix
+        FALLBACK();
+    op_FE: // CP n
+        CP_A(FETCH8()); END(7);
+    op_FF: // RST 38h
+        PUSH16(pc); pc = 0x38; END(11);
+
+done:
+    SPILL();
+    return instr_limit - left;
+}
@@ -0,0 +1,1059 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "wide.h"
+#include "opcodes.h"
+#include "logger.h"
+
+
+// Kernel running one instruction on the lanes set in mask. The operand
+// bytes are in wide->data and the memory operand in wide->mem. PC and
+// cycles have already been advanced as for an instruction with a fixed
+// duration.
+typedef void (*wide_kernel_t)(wide_t *wide, const uint8_t *mask,
+    uint8_t opcode);
+
+// Memory operand of an instruction, read before its kernel runs.
+typedef enum {
+    WIDE_MEM_NONE,
+    WIDE_MEM_HL,    // Byte at (HL).
+    WIDE_MEM_BC,    // Byte at (BC).
+    WIDE_MEM_DE,    // Byte at (DE).
+    WIDE_MEM_NN,    // Byte at (nn), nn being the operand bytes.
+    WIDE_MEM_NN16,  // Two bytes at (nn).
+    WIDE_MEM_SP     // Two bytes at (SP).
+} wide_mem_t;
+
+#define WIDE_LANES(i) for (uint32_t i = 0; i < WIDE_MAX_LANES; i++)
+
+
+// Creates an engine running the given cpus, at most WIDE_MAX_LANES.
+// Returns NULL in case of errors.
+wide_t *wide_create(cpu_t **cpus, uint32_t count) {
+    if (count == 0 || count > WIDE_MAX_LANES) {
+        LOG_ERROR("Invalid number of lanes (%u).\n", count);
+        return NULL;
+    }
+
+    wide_t *wide = (wide_t *)calloc(1, sizeof(wide_t));
+    if (wide == NULL) {
+        LOG_ERROR("Cannot allocate the lockstep engine.\n");
+        return NULL;
+    }
+
+    wide->count = count;
+    for (uint32_t i = 0; i < count; i++)
+        wide->cpus[i] = cpus[i];
+    return wide;
+}
+
+
+// Releases the engine. The cpus are left alone.
+void wide_destroy(wide_t *wide) {
+    free(wide);
+    return;
+}
+
+
+// Copies the registers of the cpu of lane i into the arrays.
+static void wide_load(wide_t *wide, uint32_t i) {
+    cpu_t *cpu = wide->cpus[i];
+
+    wide->reg[0][i] = cpu->B;
+    wide->reg[1][i] = cpu->C;
+    wide->reg[2][i] = cpu->D;
+    wide->reg[3][i] = cpu->E;
+    wide->reg[4][i] = cpu->H;
+    wide->reg[5][i] = cpu->L;
+    wide->reg[WIDE_F][i] = cpu_getF(cpu);
+    wide->reg[7][i] = cpu->A;
+    wide->PC[i] = cpu->PC;
+    wide->SP[i] = cpu->SP;
+    wide->cycles[i] = cpu->cycles;
+    wide->instr[i] = cpu->instr;
+    wide->halt[i] = cpu->halt;
+    wide->is_interrupted[i] = cpu_hasInterrupt(cpu);
+    return;
+}
+
+
+// Copies the registers of lane i back into its cpu.
+static void wide_store(wide_t *wide, uint32_t i) {
+    cpu_t *cpu = wide->cpus[i];
+
+    cpu->B = wide->reg[0][i];
+    cpu->C = wide->reg[1][i];
+    cpu->D = wide->reg[2][i];
+    cpu->E = wide->reg[3][i];
+    cpu->H = wide->reg[4][i];
+    cpu->L = wide->reg[5][i];
+    cpu->F = wide->reg[WIDE_F][i];
+    cpu->A = wide->reg[7][i];
+    cpu->PC = wide->PC[i];
+    cpu->SP = wide->SP[i];
+    cpu->cycles = wide->cycles[i];
+    cpu->instr = wide->instr[i];
+    return;
+}
+
+
+// Reads one byte, taking the page table fast path when possible.
+static inline uint8_t wide_read(cpu_t *cpu, const uint16_t addr) {
+    const mem_page_t *pg = &cpu->pages[addr >> MEM_PAGE_SHIFT];
+
+    if (!(pg->flags & (PAGE_UNUSED | PAGE_MMIO)))
+        return pg->host[addr & MEM_PAGE_MASK];
+    return cpu_read(cpu, addr);
+}
+
+
+// Writes one byte, straight to plain RAM pages. Anything else goes
+// through cpu_write().
+static inline void wide_write(cpu_t *cpu, const uint8_t data,
+    const uint16_t addr) {
+
+    mem_page_t *pg = &cpu->pages[addr >> MEM_PAGE_SHIFT];
+
+    if (!pg->flags)
+        pg->host[addr & MEM_PAGE_MASK] = data;
+    else
+        cpu_write(cpu, data, addr);
+    return;
+}
+
+
+///////////////////////////////////////////////////////////
+// KERNELS
+// Same semantics as the opc_tbl handlers, flags come from the same tables.
+///////////////////////////////////////////////////////////
+
+// NOP instruction.
+static void wide_NOP(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    return;
+}
+
+
+// LD r,r' instruction.
+static void wide_LDrr(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t *dst = wide->reg[(opcode >> 3) & 0x07];
+    const uint8_t *src = wide->reg[opcode & 0x07];
+
+    WIDE_LANES(i)
+        dst[i] = mask[i] ? src[i] : dst[i];
+    return;
+}
+
+
+// LD r,n and LD r,(HL) instructions.
+static void wide_LDrn(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t *dst = wide->reg[(opcode >> 3) & 0x07];
+    const uint8_t *src = (opcode & 0x40) ? wide->mem[0] : wide->data[0];
+
+    WIDE_LANES(i)
+        dst[i] = mask[i] ? src[i] : dst[i];
+    return;
+}
+
+
+// LD A,(BC), LD A,(DE) and LD A,(nn) instructions.
+static void wide_LDAm(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t *A = wide->reg[7];
+
+    WIDE_LANES(i)
+        A[i] = mask[i] ? wide->mem[0][i] : A[i];
+    return;
+}
+
+
+// LD dd,nn instruction.
+static void wide_LDddnn(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t pair = (opcode >> 4) & 0x03;
+
+    if (pair == 3) {
+        WIDE_LANES(i)
+            wide->SP[i] = mask[i] ?
+                (wide->data[0][i] | (wide->data[1][i] << 8)) : wide->SP[i];
+        return;
+    }
+
+    uint8_t *hi = wide->reg[2 * pair];
+    uint8_t *lo = wide->reg[2 * pair + 1];
+    WIDE_LANES(i) {
+        hi[i] = mask[i] ? wide->data[1][i] : hi[i];
+        lo[i] = mask[i] ? wide->data[0][i] : lo[i];
+    }
+    return;
+}
+
+
+// LD (HL),r and LD (HL),n instructions. Writes go through each cpu.
+static void wide_LDHLr(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    const uint8_t *src = (opcode & 0x40) ? wide->reg[opcode & 0x07] :
+        wide->data[0];
+
+    for (uint32_t i = 0; i < wide->count; i++) {
+        if (mask[i])
+            wide_write(wide->cpus[i], src[i],
+                (wide->reg[4][i] << 8) | wide->reg[5][i]);
+    }
+    return;
+}
+
+
+// INC r and DEC r instructions. C is kept.
+static void wide_INCDECr(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t *reg = wide->reg[(opcode >> 3) & 0x07];
+    uint8_t *F = wide->reg[WIDE_F];
+    const uint8_t *tbl = (opcode & 0x01) ? opc_szhvcSubTbl : opc_szhvcAddTbl;
+    int32_t step = (opcode & 0x01) ? -1 : 1;
+
+    WIDE_LANES(i) {
+        uint8_t flags = (F[i] & (FLAG_UNDOC_MASK | FLAG_CARRY)) |
+            (tbl[FLAG_TBL_IDX(0, reg[i], 1)] & ~FLAG_CARRY);
+        F[i] = mask[i] ? flags : F[i];
+        reg[i] = mask[i] ? (uint8_t)(reg[i] + step) : reg[i];
+    }
+    return;
+}
+
+
+// ADD, ADC, SUB, SBC, AND, XOR, OR and CP with a register, n or (HL).
+static void wide_ALU(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    const uint8_t *src = ((opcode & 0xC0) != 0x80) ? wide->data[0] :
+        ((opcode & 0x07) == 0x06) ? wide->mem[0] : wide->reg[opcode & 0x07];
+    uint8_t *A = wide->reg[7];
+    uint8_t *F = wide->reg[WIDE_F];
+
+    switch ((opcode >> 3) & 0x07) {
+        case 0: // ADD
+        case 1: // ADC
+            WIDE_LANES(i) {
+                uint8_t c = (opcode & 0x08) ? (F[i] & FLAG_CARRY) : 0;
+                uint8_t flags = (F[i] & FLAG_UNDOC_MASK) |
+                    opc_szhvcAddTbl[FLAG_TBL_IDX(c, A[i], src[i])];
+                uint8_t res = A[i] + src[i] + c;
+                F[i] = mask[i] ? flags : F[i];
+                A[i] = mask[i] ? res : A[i];
+            }
+            break;
+        case 2: // SUB
+        case 3: // SBC
+        case 7: // CP
+            WIDE_LANES(i) {
+                uint8_t c = ((opcode & 0x38) == 0x18) ?
+                    (F[i] & FLAG_CARRY) : 0;
+                uint8_t flags = (F[i] & FLAG_UNDOC_MASK) |
+                    opc_szhvcSubTbl[FLAG_TBL_IDX(c, A[i], src[i])];
+                uint8_t res = ((opcode & 0x38) == 0x38) ? A[i] :
+                    A[i] - src[i] - c;
+                F[i] = mask[i] ? flags : F[i];
+                A[i] = mask[i] ? res : A[i];
+            }
+            break;
+        case 4: // AND
+            WIDE_LANES(i) {
+                uint8_t res = A[i] & src[i];
+                uint8_t flags = (F[i] & FLAG_UNDOC_MASK) | opc_szpTbl[res] |
+                    FLAG_HCARRY;
+                F[i] = mask[i] ? flags : F[i];
+                A[i] = mask[i] ? res : A[i];
+            }
+            break;
+        case 5: // XOR
+            WIDE_LANES(i) {
+                uint8_t res = A[i] ^ src[i];
+                uint8_t flags = (F[i] & FLAG_UNDOC_MASK) | opc_szpTbl[res];
+                F[i] = mask[i] ? flags : F[i];
+                A[i] = mask[i] ? res : A[i];
+            }
+            break;
+        case 6: // OR
+            WIDE_LANES(i) {
+                uint8_t res = A[i] | src[i];
+                uint8_t flags = (F[i] & FLAG_UNDOC_MASK) | opc_szpTbl[res];
+                F[i] = mask[i] ? flags : F[i];
+                A[i] = mask[i] ? res : A[i];
+            }
+            break;
+    }
+    return;
+}
+
+
+// INC ss and DEC ss instructions.
+static void wide_INCDECss(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t pair = (opcode >> 4) & 0x03;
+    int32_t step = (opcode & 0x08) ? -1 : 1;
+
+    if (pair == 3) {
+        WIDE_LANES(i)
+            wide->SP[i] = mask[i] ? (uint16_t)(wide->SP[i] + step) :
+                wide->SP[i];
+        return;
+    }
+
+    uint8_t *hi = wide->reg[2 * pair];
+    uint8_t *lo = wide->reg[2 * pair + 1];
+    WIDE_LANES(i) {
+        uint16_t res = ((hi[i] << 8) | lo[i]) + step;
+        hi[i] = mask[i] ? (res >> 8) : hi[i];
+        lo[i] = mask[i] ? (res & 0xFF) : lo[i];
+    }
+    return;
+}
+
+
+// EX DE,HL instruction.
+static void wide_EXDEHL(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    WIDE_LANES(i) {
+        uint8_t d = wide->reg[2][i];
+        uint8_t e = wide->reg[3][i];
+        wide->reg[2][i] = mask[i] ? wide->reg[4][i] : d;
+        wide->reg[3][i] = mask[i] ? wide->reg[5][i] : e;
+        wide->reg[4][i] = mask[i] ? d : wide->reg[4][i];
+        wide->reg[5][i] = mask[i] ? e : wide->reg[5][i];
+    }
+    return;
+}
+
+
+// PUSH qq instruction. Writes go through each cpu.
+static void wide_PUSHqq(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t pair = (opcode >> 4) & 0x03;
+    const uint8_t *hi = wide->reg[(pair == 3) ? 7 : 2 * pair];
+    const uint8_t *lo = wide->reg[(pair == 3) ? WIDE_F : 2 * pair + 1];
+
+    WIDE_LANES(i)
+        wide->SP[i] -= mask[i] ? 2 : 0;
+    for (uint32_t i = 0; i < wide->count; i++) {
+        if (mask[i]) {
+            wide_write(wide->cpus[i], hi[i], wide->SP[i] + 1);
+            wide_write(wide->cpus[i], lo[i], wide->SP[i]);
+        }
+    }
+    return;
+}
+
+
+// POP qq instruction.
+static void wide_POPqq(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t pair = (opcode >> 4) & 0x03;
+    uint8_t *hi = wide->reg[(pair == 3) ? 7 : 2 * pair];
+    uint8_t *lo = wide->reg[(pair == 3) ? WIDE_F : 2 * pair + 1];
+
+    WIDE_LANES(i) {
+        hi[i] = mask[i] ? wide->mem[1][i] : hi[i];
+        lo[i] = mask[i] ? wide->mem[0][i] : lo[i];
+        wide->SP[i] += mask[i] ? 2 : 0;
+    }
+    return;
+}
+
+
+// Pushes PC on the lanes set in mask. Writes go through each cpu.
+static void wide_pushPC(wide_t *wide, const uint8_t *mask) {
+    WIDE_LANES(i)
+        wide->SP[i] -= mask[i] ? 2 : 0;
+    for (uint32_t i = 0; i < wide->count; i++) {
+        if (mask[i]) {
+            wide_write(wide->cpus[i], wide->PC[i] >> 8, wide->SP[i] + 1);
+            wide_write(wide->cpus[i], wide->PC[i] & 0xFF, wide->SP[i]);
+        }
+    }
+    return;
+}
+
+
+// CALL nn instruction.
+static void wide_CALLnn(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    wide_pushPC(wide, mask);
+    WIDE_LANES(i)
+        wide->PC[i] = mask[i] ?
+            (wide->data[0][i] | (wide->data[1][i] << 8)) : wide->PC[i];
+    return;
+}
+
+
+// RET instruction. Lanes may part here.
+static void wide_RET(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    WIDE_LANES(i) {
+        wide->PC[i] = mask[i] ?
+            (wide->mem[0][i] | (wide->mem[1][i] << 8)) : wide->PC[i];
+        wide->SP[i] += mask[i] ? 2 : 0;
+    }
+    return;
+}
+
+
+// Flag tested by the conditions of JP, CALL and RET, in cc order. Odd
+// conditions are met when the flag is set.
+static const uint8_t wide_ccFlag[8] = {
+    FLAG_ZERO, FLAG_ZERO, FLAG_CARRY, FLAG_CARRY,
+    FLAG_PARITY, FLAG_PARITY, FLAG_SIGN, FLAG_SIGN
+};
+
+
+// JR e, JR cc,e and DJNZ e instructions. Lanes may part here.
+static void wide_JR(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t *F = wide->reg[WIDE_F];
+    uint8_t *B = wide->reg[0];
+    // Cycles of the taken and not taken jumps, on top of opc_tbl.
+    uint32_t taken_cycles = 12;
+    uint32_t skip_cycles = 7;
+    uint8_t flag = wide_ccFlag[(opcode >> 3) & 0x03];
+    uint8_t is_set = (opcode & 0x08) ? flag : 0;
+
+    if (opcode == 0x18) {
+        taken_cycles = 0;
+        skip_cycles = 0;
+    }
+    else if (opcode == 0x10) {
+        taken_cycles = 13;
+        skip_cycles = 8;
+        WIDE_LANES(i)
+            B[i] = mask[i] ? (uint8_t)(B[i] - 1) : B[i];
+    }
+
+    WIDE_LANES(i) {
+        bool is_taken = (opcode == 0x18) ||
+            (opcode == 0x10 && B[i] != 0) ||
+            (opcode >= 0x20 && (F[i] & flag) == is_set);
+        uint16_t target = wide->PC[i] + (int8_t)wide->data[0][i];
+        wide->PC[i] = (mask[i] && is_taken) ? target : wide->PC[i];
+        wide->cycles[i] += mask[i] ?
+            (is_taken ? taken_cycles : skip_cycles) : 0;
+    }
+    return;
+}
+
+
+// JP nn and JP cc,nn instructions. Lanes may part here.
+static void wide_JP(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t *F = wide->reg[WIDE_F];
+    uint8_t flag = (opcode == 0xC3) ? 0 : wide_ccFlag[(opcode >> 3) & 0x07];
+    uint8_t is_set = (opcode & 0x08) ? flag : 0;
+
+    WIDE_LANES(i) {
+        bool is_taken = (F[i] & flag) == is_set;
+        uint16_t target = wide->data[0][i] | (wide->data[1][i] << 8);
+        wide->PC[i] = (mask[i] && is_taken) ? target : wide->PC[i];
+    }
+    return;
+}
+
+
+// RET cc and CALL cc,nn instructions. Lanes may part here.
+static void wide_RETCALLcc(wide_t *wide, const uint8_t *mask,
+    uint8_t opcode) {
+
+    uint8_t *F = wide->reg[WIDE_F];
+    uint8_t flag = wide_ccFlag[(opcode >> 3) & 0x07];
+    uint8_t is_set = (opcode & 0x08) ? flag : 0;
+    bool is_call = (opcode & 0x04);
+    // Cycles of the taken and not taken branches, opc_tbl has none.
+    uint32_t taken_cycles = is_call ? 17 : 11;
+    uint32_t skip_cycles = is_call ? 10 : 5;
+    uint8_t taken[WIDE_MAX_LANES];
+
+    WIDE_LANES(i) {
+        taken[i] = mask[i] & ((F[i] & flag) == is_set);
+        wide->cycles[i] += mask[i] ?
+            (taken[i] ? taken_cycles : skip_cycles) : 0;
+    }
+
+    if (is_call) {
+        wide_pushPC(wide, taken);
+        WIDE_LANES(i)
+            wide->PC[i] = taken[i] ?
+                (wide->data[0][i] | (wide->data[1][i] << 8)) : wide->PC[i];
+        return;
+    }
+
+    WIDE_LANES(i) {
+        wide->PC[i] = taken[i] ?
+            (wide->mem[0][i] | (wide->mem[1][i] << 8)) : wide->PC[i];
+        wide->SP[i] += taken[i] ? 2 : 0;
+    }
+    return;
+}
+
+
+// RST p instruction.
+static void wide_RST(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    wide_pushPC(wide, mask);
+    WIDE_LANES(i)
+        wide->PC[i] = mask[i] ? (opcode & 0x38) : wide->PC[i];
+    return;
+}
+
+
+// RLCA, RRCA, RLA and RRA instructions. S, Z and P/V are kept.
+static void wide_rotA(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t *A = wide->reg[7];
+    uint8_t *F = wide->reg[WIDE_F];
+
+    WIDE_LANES(i) {
+        uint8_t c = F[i] & FLAG_CARRY;
+        uint8_t res = 0;
+        uint8_t out = 0;
+        switch (opcode) {
+            case 0x07: // RLCA
+                out = A[i] >> 7;
+                res = (A[i] << 1) | out;
+                break;
+            case 0x0F: // RRCA
+                out = A[i] & 0x01;
+                res = (A[i] >> 1) | (out << 7);
+                break;
+            case 0x17: // RLA
+                out = A[i] >> 7;
+                res = (A[i] << 1) | c;
+                break;
+            default: // RRA
+                out = A[i] & 0x01;
+                res = (A[i] >> 1) | (c << 7);
+                break;
+        }
+        uint8_t flags = (F[i] & ~(FLAG_HCARRY | FLAG_ADDSUB | FLAG_CARRY)) |
+            out;
+        F[i] = mask[i] ? flags : F[i];
+        A[i] = mask[i] ? res : A[i];
+    }
+    return;
+}
+
+
+// CPL, SCF and CCF instructions.
+static void wide_CPLSCFCCF(wide_t *wide, const uint8_t *mask,
+    uint8_t opcode) {
+
+    uint8_t *A = wide->reg[7];
+    uint8_t *F = wide->reg[WIDE_F];
+
+    WIDE_LANES(i) {
+        uint8_t res = A[i];
+        uint8_t flags = F[i] & ~(FLAG_HCARRY | FLAG_ADDSUB | FLAG_CARRY);
+        switch (opcode) {
+            case 0x2F: // CPL: C is kept.
+                res = ~A[i];
+                flags |= FLAG_HCARRY | FLAG_ADDSUB | (F[i] & FLAG_CARRY);
+                break;
+            case 0x37: // SCF
+                flags |= FLAG_CARRY;
+                break;
+            default: // CCF: the previous carry goes to H.
+                flags |= (F[i] & FLAG_CARRY) ? FLAG_HCARRY : FLAG_CARRY;
+                break;
+        }
+        F[i] = mask[i] ? flags : F[i];
+        A[i] = mask[i] ? res : A[i];
+    }
+    return;
+}
+
+
+// ADD HL,ss instruction. S, Z and P/V are kept.
+static void wide_ADDHLss(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    uint8_t pair = (opcode >> 4) & 0x03;
+    uint8_t *H = wide->reg[4];
+    uint8_t *L = wide->reg[5];
+    uint8_t *F = wide->reg[WIDE_F];
+
+    WIDE_LANES(i) {
+        uint16_t hl = (H[i] << 8) | L[i];
+        uint16_t src = (pair == 3) ? wide->SP[i] :
+            (wide->reg[2 * pair][i] << 8) | wide->reg[2 * pair + 1][i];
+        uint32_t res = hl + src;
+        uint8_t flags = (F[i] & ~(FLAG_HCARRY | FLAG_ADDSUB | FLAG_CARRY)) |
+            ((((hl & 0xFFF) + (src & 0xFFF)) & 0x1000) ? FLAG_HCARRY : 0) |
+            (res >> 16);
+        F[i] = mask[i] ? flags : F[i];
+        H[i] = mask[i] ? (uint8_t)(res >> 8) : H[i];
+        L[i] = mask[i] ? (uint8_t)res : L[i];
+    }
+    return;
+}
+
+
+// LD HL,(nn) instruction.
+static void wide_LDHLnn(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    WIDE_LANES(i) {
+        wide->reg[4][i] = mask[i] ? wide->mem[1][i] : wide->reg[4][i];
+        wide->reg[5][i] = mask[i] ? wide->mem[0][i] : wide->reg[5][i];
+    }
+    return;
+}
+
+
+// LD (nn),HL and LD (nn),A instructions. Writes go through each cpu.
+static void wide_LDnnr(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    const uint8_t *src = (opcode == 0x22) ? wide->reg[5] : wide->reg[7];
+
+    for (uint32_t i = 0; i < wide->count; i++) {
+        if (!mask[i])
+            continue;
+        uint16_t addr = wide->data[0][i] | (wide->data[1][i] << 8);
+        wide_write(wide->cpus[i], src[i], addr);
+        if (opcode == 0x22)
+            wide_write(wide->cpus[i], wide->reg[4][i], addr + 1);
+    }
+    return;
+}
+
+
+// EX (SP),HL instruction. Writes go through each cpu.
+static void wide_EXSPHL(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    for (uint32_t i = 0; i < wide->count; i++) {
+        if (mask[i]) {
+            wide_write(wide->cpus[i], wide->reg[5][i], wide->SP[i]);
+            wide_write(wide->cpus[i], wide->reg[4][i], wide->SP[i] + 1);
+        }
+    }
+    WIDE_LANES(i) {
+        wide->reg[4][i] = mask[i] ? wide->mem[1][i] : wide->reg[4][i];
+        wide->reg[5][i] = mask[i] ? wide->mem[0][i] : wide->reg[5][i];
+    }
+    return;
+}
+
+
+// LD SP,HL instruction.
+static void wide_LDSPHL(wide_t *wide, const uint8_t *mask, uint8_t opcode) {
+    WIDE_LANES(i)
+        wide->SP[i] = mask[i] ?
+            ((wide->reg[4][i] << 8) | wide->reg[5][i]) : wide->SP[i];
+    return;
+}
+
+
+// Returns the kernel of opcode, NULL if it has to run lane by lane, and
+// sets the instruction length and its memory operand.
+static wide_kernel_t wide_decode(uint8_t opcode, uint32_t *len,
+    wide_mem_t *mem) {
+
+    bool is_hl = ((opcode & 0x07) == 0x06);
+    bool is_hlDst = ((opcode & 0x38) == 0x30);
+
+    *len = 1;
+    *mem = WIDE_MEM_NONE;
+    switch (opcode & 0xC0) {
+        case 0x40: // LD r,r', LD r,(HL), LD (HL),r, HALT excluded.
+            if (opcode == 0x76)
+                return NULL;
+            if (is_hlDst)
+                return wide_LDHLr;
+            if (is_hl) {
+                *mem = WIDE_MEM_HL;
+                return wide_LDrn;
+            }
+            return wide_LDrr;
+        case 0x80: // ALU A,r and ALU A,(HL).
+            *mem = is_hl ? WIDE_MEM_HL : WIDE_MEM_NONE;
+            return wide_ALU;
+    }
+
+    switch (opcode & 0xCF) {
+        case 0x01: // LD dd,nn.
+            *len = 3;
+            return wide_LDddnn;
+        case 0xC1: // POP qq.
+            *mem = WIDE_MEM_SP;
+            return wide_POPqq;
+        case 0xC5: // PUSH qq.
+            return wide_PUSHqq;
+        case 0x09: // ADD HL,ss.
+            return wide_ADDHLss;
+    }
+
+    switch (opcode & 0xC7) {
+        case 0x03: // INC ss, DEC ss.
+            return wide_INCDECss;
+        case 0x04: // INC r.
+        case 0x05: // DEC r.
+            return is_hlDst ? NULL : wide_INCDECr;
+        case 0x06: // LD r,n and LD (HL),n.
+            *len = 2;
+            return is_hlDst ? wide_LDHLr : wide_LDrn;
+        case 0xC6: // ALU A,n.
+            *len = 2;
+            return wide_ALU;
+        case 0xC2: // JP cc,nn.
+            *len = 3;
+            return wide_JP;
+        case 0xC0: // RET cc.
+            *mem = WIDE_MEM_SP;
+            return wide_RETCALLcc;
+        case 0xC4: // CALL cc,nn.
+            *len = 3;
+            return wide_RETCALLcc;
+        case 0xC7: // RST p.
+            return wide_RST;
+    }
+
+    switch (opcode) {
+        case 0x00: // NOP
+            return wide_NOP;
+        case 0x0A: // LD A,(BC)
+            *mem = WIDE_MEM_BC;
+            return wide_LDAm;
+        case 0x1A: // LD A,(DE)
+            *mem = WIDE_MEM_DE;
+            return wide_LDAm;
+        case 0x3A: // LD A,(nn)
+            *len = 3;
+            *mem = WIDE_MEM_NN;
+            return wide_LDAm;
+        case 0x10: // DJNZ e
+        case 0x18: // JR e
+        case 0x20: // JR NZ,e
+        case 0x28: // JR Z,e
+        case 0x30: // JR NC,e
+        case 0x38: // JR C,e
+            *len = 2;
+            return wide_JR;
+        case 0xC3: // JP nn
+            *len = 3;
+            return wide_JP;
+        case 0xC9: // RET
+            *mem = WIDE_MEM_SP;
+            return wide_RET;
+        case 0xCD: // CALL nn
+            *len = 3;
+            return wide_CALLnn;
+        case 0xEB: // EX DE,HL
+            return wide_EXDEHL;
+        case 0x07: // RLCA
+        case 0x0F: // RRCA
+        case 0x17: // RLA
+        case 0x1F: // RRA
+            return wide_rotA;
+        case 0x2F: // CPL
+        case 0x37: // SCF
+        case 0x3F: // CCF
+            return wide_CPLSCFCCF;
+        case 0x22: // LD (nn),HL
+        case 0x32: // LD (nn),A
+            *len = 3;
+            return wide_LDnnr;
+        case 0x2A: // LD HL,(nn)
+            *len = 3;
+            *mem = WIDE_MEM_NN16;
+            return wide_LDHLnn;
+        case 0xE3: // EX (SP),HL
+            *mem = WIDE_MEM_SP;
+            return wide_EXSPHL;
+        case 0xF9: // LD SP,HL
+            return wide_LDSPHL;
+    }
+    return NULL;
+}
+
+
+// Returns true if the instruction at pc is read from the same host memory
+// by both cpus, as for boards sharing a ROM image or forked from the same
+// one (see cpu_fork).
+static inline bool wide_isSameCode(cpu_t *cpu, cpu_t *lane, uint16_t pc) {
+    const mem_page_t *pg = &cpu->pages[pc >> MEM_PAGE_SHIFT];
+
+    return (pc & MEM_PAGE_MASK) <= MEM_PAGE_SIZE - 3 &&
+        !(pg->flags & (PAGE_UNUSED | PAGE_MMIO)) &&
+        lane->pages[pc >> MEM_PAGE_SHIFT].host == pg->host;
+}
+
+
+// Reads the memory operand of the lanes set in mask.
+static void wide_readMem(wide_t *wide, const uint8_t *mask, wide_mem_t mem) {
+    for (uint32_t i = 0; i < wide->count; i++) {
+        if (!mask[i])
+            continue;
+
+        cpu_t *cpu = wide->cpus[i];
+        uint16_t addr = 0;
+        switch (mem) {
+            case WIDE_MEM_HL:
+                addr = (wide->reg[4][i] << 8) | wide->reg[5][i];
+                break;
+            case WIDE_MEM_BC:
+                addr = (wide->reg[0][i] << 8) | wide->reg[1][i];
+                break;
+            case WIDE_MEM_DE:
+                addr = (wide->reg[2][i] << 8) | wide->reg[3][i];
+                break;
+            case WIDE_MEM_NN16:
+                wide->mem[1][i] = wide_read(cpu,
+                    (wide->data[0][i] | (wide->data[1][i] << 8)) + 1);
+                // Fall through.
+            case WIDE_MEM_NN:
+                addr = wide->data[0][i] | (wide->data[1][i] << 8);
+                break;
+            case WIDE_MEM_SP:
+                addr = wide->SP[i];
+                wide->mem[1][i] = wide_read(cpu, addr + 1);
+                break;
+            default:
+                break;
+        }
+        wide->mem[0][i] = wide_read(cpu, addr);
+    }
+    return;
+}
+
+
+#ifdef WIDE_SELFCHECK
+// Runs the instruction of lane i on a copy of its cpu with cpu_emulate().
+static void wide_checkBefore(wide_t *wide, uint32_t i, cpu_t *ref) {
+    wide_store(wide, i);
+    *ref = *wide->cpus[i];
+    ref->blocks = NULL;
+    ref->jit = NULL;
+    ref->prof = NULL;
+    cpu_emulate(ref);
+    cpu_getF(ref);
+    return;
+}
+
+
+// Compares lane i after a kernel with the copy run by wide_checkBefore.
+// Stops the cpu on the first mismatch.
+static void wide_checkAfter(wide_t *wide, uint32_t i, cpu_t *ref,
+    uint8_t opcode) {
+
+    cpu_t *cpu = wide->cpus[i];
+    wide_store(wide, i);
+
+    if (ref->AF != cpu->AF || ref->BC != cpu->BC || ref->DE != cpu->DE ||
+        ref->HL != cpu->HL || ref->PC != cpu->PC || ref->SP != cpu->SP ||
+        ref->cycles != cpu->cycles || ref->instr != cpu->instr) {
+        LOG_FATAL("Lockstep self-check failed for opcode 0x%02X, lane %u.\n"
+            "        PC   AF   BC   DE   HL   SP   CYCLES\n"
+            "wide    %04X %04X %04X %04X %04X %04X %u\n"
+            "interp  %04X %04X %04X %04X %04X %04X %u\n", opcode, i,
+            cpu->PC, cpu->AF, cpu->BC, cpu->DE, cpu->HL, cpu->SP,
+            cpu->cycles, ref->PC, ref->AF, ref->BC, ref->DE, ref->HL,
+            ref->SP, ref->cycles);
+        cpu_fault(cpu);
+    }
+    return;
+}
+#endif
+
+
+// Runs one instruction of lane i through cpu_emulate(), or skips the rest
+// of its budget if it is halted for good, as cpu_run() does.
+// Returns the reason for the lane to stop, CPU_RUN_BUDGET if none.
+static cpu_run_t wide_scalarStep(wide_t *wide, uint32_t i, uint32_t left) {
+    cpu_t *cpu = wide->cpus[i];
+    cpu_run_t status = CPU_RUN_BUDGET;
+
+    wide_store(wide, i);
+    if (cpu->halt && !cpu_hasInterrupt(cpu))
+        cpu_skipHalt(cpu, left / 4 + (left % 4 != 0));
+    else {
+        bool was_halted = cpu->halt;
+        bool was_pendingMI = cpu->is_pendingMI;
+        bool was_pendingNMI = cpu->is_pendingNMI;
+
+        cpu_emulate(cpu);
+
+        if (cpu->is_ioAccess)
+            status = CPU_RUN_IO;
+        else if ((was_pendingMI && !cpu->is_pendingMI) ||
+            (was_pendingNMI && !cpu->is_pendingNMI))
+            status = CPU_RUN_INTERRUPT;
+        else if (cpu->halt && !was_halted)
+            status = CPU_RUN_HALT;
+    }
+    wide_load(wide, i);
+    return status;
+}
+
+
+// Runs the instruction of lane lead on every lane at the same PC, with
+// a kernel if it has one. running holds the lanes with budget left. The
+// lanes that have to stop get their reason in status.
+// Returns true if any lane has to stop.
+static bool wide_step(wide_t *wide, uint32_t lead, const uint8_t *running,
+    const uint32_t *left, cpu_run_t *status) {
+
+    cpu_t *cpu = wide->cpus[lead];
+    uint16_t pc = wide->PC[lead];
+    uint8_t code[3];
+    for (uint32_t b = 0; b < 3; b++)
+        code[b] = wide_read(cpu, pc + b);
+
+    uint8_t opcode = code[0];
+    uint32_t len;
+    wide_mem_t mem;
+    wide_kernel_t kernel = wide_decode(opcode, &len, &mem);
+    uint8_t mask[WIDE_MAX_LANES] = {0};
+    uint32_t group = 0;
+    uint32_t live = 0;
+
+    // Lanes at the same PC and in the same halt state, before their code is
+    // compared.
+    uint8_t at_pc[WIDE_MAX_LANES];
+    uint8_t halt = wide->halt[lead];
+    WIDE_LANES(i) {
+        at_pc[i] = running[i] & (wide->PC[i] == pc) & (wide->halt[i] == halt);
+        live += running[i];
+        wide->data[0][i] = code[1];
+        wide->data[1][i] = code[2];
+    }
+
+    // Lanes share the instruction if it has the same bytes in their memory.
+    // Those in the same read-only memory as lane lead need no check.
+    uint32_t rom = wide->rom_lanes[pc >> MEM_PAGE_SHIFT];
+    if (!(rom >> lead & 1) || (pc & MEM_PAGE_MASK) > MEM_PAGE_SIZE - 3)
+        rom = 0;
+    for (uint32_t i = 0; i < wide->count; i++) {
+        if (!at_pc[i] || (rom >> i & 1))
+            continue;
+        cpu_t *lane = wide->cpus[i];
+        if (wide_isSameCode(cpu, lane, pc))
+            continue;
+        if (wide_read(lane, pc) != opcode) {
+            at_pc[i] = 0;
+            continue;
+        }
+        for (uint32_t b = 1; b < len; b++)
+            wide->data[b - 1][i] = wide_read(lane, pc + b);
+    }
+
+    // Halted and interrupted lanes only go with instructions run one by one.
+    uint8_t is_scalar = (kernel == NULL);
+    WIDE_LANES(i) {
+        mask[i] = at_pc[i] &
+            (is_scalar | !(wide->halt[i] | wide->is_interrupted[i]));
+        group += mask[i];
+    }
+
+    wide->diverged = (group * 2 < live) ? wide->diverged + 1 : 0;
+
+    // Interrupts, HALT and instructions with no kernel: the lanes at pc run
+    // one by one.
+    if (kernel == NULL || wide->halt[lead] || wide->is_interrupted[lead]) {
+        bool is_stopped = false;
+        mask[lead] = 1;
+        for (uint32_t i = 0; i < wide->count; i++) {
+            if (mask[i]) {
+                status[i] = wide_scalarStep(wide, i, left[i]);
+                is_stopped = is_stopped || status[i] != CPU_RUN_BUDGET;
+            }
+        }
+        return is_stopped;
+    }
+
+    if (mem != WIDE_MEM_NONE)
+        wide_readMem(wide, mask, mem);
+
+#ifdef WIDE_SELFCHECK
+    cpu_t *ref = (cpu_t *)malloc(WIDE_MAX_LANES * sizeof(cpu_t));
+    for (uint32_t i = 0; i < wide->count; i++) {
+        if (mask[i])
+            wide_checkBefore(wide, i, &ref[i]);
+    }
+#endif
+
+    uint32_t tstates = opc_tbl[opcode].TStates;
+    WIDE_LANES(i) {
+        wide->PC[i] += mask[i] ? len : 0;
+        wide->cycles[i] += mask[i] ? tstates : 0;
+        wide->instr[i] += mask[i];
+    }
+    kernel(wide, mask, opcode);
+
+#ifdef WIDE_SELFCHECK
+    for (uint32_t i = 0; i < wide->count; i++) {
+        if (mask[i])
+            wide_checkAfter(wide, i, &ref[i], opcode);
+    }
+    free(ref);
+#endif
+    return false;
+}
+
+
+// Runs the lanes with budget left one after the other through cpu_run(),
+// which stores in status the reason for each of them to stop.
+static void wide_runScalar(wide_t *wide, const uint8_t *running,
+    const uint32_t *left, cpu_run_t *status) {
+
+    for (uint32_t i = 0; i < wide->count; i++) {
+        if (!running[i])
+            continue;
+        wide_store(wide, i);
+        status[i] = cpu_run(wide->cpus[i], left[i]);
+        wide_load(wide, i);
+    }
+    return;
+}
+
+
+// Runs each lane i for budget[i] T-states, none for 0. All the lanes stop
+// as soon as one of them would end cpu_run() early: it accesses IO,
+// accepts an interrupt or halts. Faulted lanes do not run.
+// status[i] gets the reason for lane i to stop, the cpu_run() one. Lanes
+// stopped by another one are left with CPU_RUN_BUDGET and budget left.
+void wide_run(wide_t *wide, const uint32_t *budget, cpu_run_t *status) {
+    uint32_t start[WIDE_MAX_LANES];
+    bool is_stopped = false;
+
+    for (uint32_t i = 0; i < wide->count; i++) {
+        wide_load(wide, i);
+        wide->cpus[i]->is_ioAccess = false;
+        start[i] = wide->cycles[i];
+        status[i] = wide->cpus[i]->is_faulted ?
+            CPU_RUN_FAULT : CPU_RUN_BUDGET;
+    }
+    wide->diverged = 0;
+
+    for (uint32_t p = 0; p < MEM_PAGE_COUNT; p++) {
+        const mem_page_t *pg = &wide->cpus[0]->pages[p];
+        wide->rom_lanes[p] = 0;
+        if ((pg->flags & (PAGE_UNUSED | PAGE_MMIO | PAGE_READONLY)) !=
+            PAGE_READONLY)
+            continue;
+        for (uint32_t i = 0; i < wide->count; i++) {
+            const mem_page_t *lane = &wide->cpus[i]->pages[p];
+            if (lane->host == pg->host && (lane->flags &
+                (PAGE_UNUSED | PAGE_MMIO | PAGE_READONLY)) == PAGE_READONLY)
+                wide->rom_lanes[p] |= 1u << i;
+        }
+    }
+
+    while (!is_stopped) {
+        uint8_t running[WIDE_MAX_LANES] = {0};
+        uint32_t left[WIDE_MAX_LANES] = {0};
+        uint32_t lead_used = UINT32_MAX;
+        int32_t lead = -1;
+
+        // The lane furthest behind leads, so that lanes which parted at a
+        // branch can meet again.
+        for (uint32_t i = 0; i < wide->count; i++) {
+            uint32_t used = wide->cycles[i] - start[i];
+            running[i] = !wide->cpus[i]->is_faulted && used < budget[i];
+            left[i] = running[i] ? budget[i] - used : 0;
+            if (running[i] && used < lead_used) {
+                lead_used = used;
+                lead = i;
+            }
+        }
+
+        if (lead < 0)
+            break;
+
+        if (wide->diverged >= WIDE_DIVERGE_STEPS) {
+            wide_runScalar(wide, running, left, status);
+            break;
+        }
+        is_stopped = wide_step(wide, lead, running, left, status);
+    }
+
+    for (uint32_t i = 0; i < wide->count; i++) {
+        wide_store(wide, i);
+        if (wide->cpus[i]->is_faulted)
+            status[i] = CPU_RUN_FAULT;
+    }
+    return;
+}
@@ -0,0 +1,338 @@
+#include <stdlib.h>
+
+#include "z80.h"
+#include "board.h"
+#include "cpu.h"
+#include "rom.h"
+#include "wide.h"
+
+// T-states run by cpu_run() between two ACIA checks, as in board_emulate().
+#define Z80_SLICE_CYCLES 40000
+// Slices the cpu must end idle, with no ACIA activity, before z80_run()
+// gives up waiting for input (see BOARD_IDLE_SLICES).
+#define Z80_IDLE_SLICES 3
+
+// Circular byte queue between the host and the ACIA.
+typedef struct z80_fifo_t {
+    uint8_t data[Z80_BUFFER_SIZE];
+    uint32_t head;
+    uint32_t count;
+} z80_fifo_t;
+
+struct z80_t {
+    board_t board;
+    z80_fifo_t input;
+    z80_fifo_t output;
+    uint32_t idle_slices;
+    // Total T-states, cpu->cycles wraps around.
+    uint64_t cycles;
+};
+
+
+// Creates an empty ROM registry.
+// Returns NULL in case of errors.
+z80_roms_t *z80_createRoms(void) {
+    return rom_createRegistry();
+}
+
+
+// Releases the registry. Images still mapped by instances are freed with
+// the last of them.
+void z80_destroyRoms(z80_roms_t *roms) {
+    rom_destroyRegistry(roms);
+    return;
+}
+
+
+// Creates an instance with a blank ROM, to be filled by z80_loadRom().
+// Returns NULL in case of errors.
+z80_t *z80_create(void) {
+    z80_t *z80 = (z80_t *)calloc(1, sizeof(z80_t));
+
+    if (z80 == NULL)
+        return NULL;
+
+    if (board_init(&z80->board, NULL)) {
+        free(z80);
+        return NULL;
+    }
+    return z80;
+}
+
+
+// Creates an instance running the hex file at rom_file, shared through
+// roms with every other instance of the same file.
+// Returns NULL in case of errors.
+z80_t *z80_createShared(z80_roms_t *roms, const char *rom_file) {
+    z80_t *z80 = (z80_t *)calloc(1, sizeof(z80_t));
+    if (z80 == NULL)
+        return NULL;
+
+    rom_t *rom = rom_open(roms, rom_file, BOARD_ROM_SIZE);
+    if (rom == NULL) {
+        free(z80);
+        return NULL;
+    }
+
+    // The board holds its own reference.
+    int32_t err = board_initShared(&z80->board, rom);
+    rom_release(rom);
+    if (err) {
+        free(z80);
+        return NULL;
+    }
+    return z80;
+}
+
+
+// Creates an instance in the same state as z80, queues included. RAM is
+// shared until either of them writes to it, and their ROM is shared for
+// good: neither can load another one afterwards.
+// Returns NULL in case of errors.
+z80_t *z80_fork(z80_t *z80) {
+    z80_t *copy = (z80_t *)malloc(sizeof(z80_t));
+    if (copy == NULL)
+        return NULL;
+
+    *copy = *z80;
+    if (board_fork(&copy->board, &z80->board)) {
+        free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+
+// Loads the hex file at rom_file and restarts the guest from it. Queued
+// input and output are dropped. Fails on instances with a shared ROM.
+// Returns 0 if no errors occur.
+int32_t z80_loadRom(z80_t *z80, const char *rom_file) {
+    if (board_loadRom(&z80->board, rom_file))
+        return 1;
+
+    bool is_turbo = z80->board.acia->is_turbo;
+    mc6850_init(z80->board.acia);
+    z80->board.acia->is_turbo = is_turbo;
+    z80->input.count = 0;
+    z80->output.count = 0;
+    z80->idle_slices = 0;
+    return 0;
+}
+
+
+// Moves bytes between the queues and the ACIA, as board_emulate() does
+// with the terminal.
+// Returns true if any byte was moved.
+static bool z80_serviceAcia(z80_t *z80) {
+    mc6850_t *acia = z80->board.acia;
+    uint32_t now = z80->board.cpu->cycles;
+    bool is_active = false;
+
+    mc6850_update(acia, now);
+
+    // With a full output queue the character stays in the shift register,
+    // then in TDR, and the guest waits for TX_EMPTY.
+    while (z80->output.count < Z80_BUFFER_SIZE && mc6850_isSent(acia, now)) {
+        uint32_t tail = (z80->output.head + z80->output.count) %
+            Z80_BUFFER_SIZE;
+        z80->output.data[tail] = mc6850_transmit(acia, now);
+        z80->output.count++;
+        is_active = true;
+    }
+
+    if (z80->input.count > 0 && mc6850_canReceive(acia)) {
+        mc6850_receive(acia, z80->input.data[z80->input.head], now);
+        z80->input.head = (z80->input.head + 1) % Z80_BUFFER_SIZE;
+        z80->input.count--;
+        is_active = true;
+    }
+
+    board_updateIrq(&z80->board);
+    return is_active;
+}
+
+
+// Services the ACIA after the cpu ran a slice, and tells whether the run
+// is over. The reason is then stored in status.
+// Returns true if the run has to stop.
+static bool z80_endSlice(z80_t *z80, z80_run_t *status) {
+    cpu_t *cpu = z80->board.cpu;
+
+    if (cpu->is_faulted) {
+        *status = Z80_RUN_FAULT;
+        return true;
+    }
+
+    bool is_active = z80_serviceAcia(z80);
+    if (mc6850_isSent(z80->board.acia, cpu->cycles)) {
+        *status = Z80_RUN_OUTPUT;
+        return true;
+    }
+
+    bool is_idle = !mc6850_isBusy(z80->board.acia, cpu->cycles) &&
+        !cpu_hasInterrupt(cpu) && (cpu->halt || cpu_isIdle(cpu));
+    z80->idle_slices = (is_idle && !is_active) ? z80->idle_slices + 1 : 0;
+    if (z80->idle_slices >= Z80_IDLE_SLICES && z80->input.count == 0) {
+        *status = Z80_RUN_IDLE;
+        return true;
+    }
+    return false;
+}
+
+
+// Runs the guest for up to cycles T-states. It stops earlier once it is
+// idle with no queued input, when the output queue is full or on a fault.
+// Returns the reason for stopping.
+z80_run_t z80_run(z80_t *z80, uint32_t cycles) {
+    cpu_t *cpu = z80->board.cpu;
+    uint32_t start = cpu->cycles;
+    z80_run_t status = Z80_RUN_BUDGET;
+
+    while (cpu->cycles - start < cycles) {
+        uint32_t left = cycles - (cpu->cycles - start);
+        cpu_run(cpu, board_sliceCycles(&z80->board,
+            left < Z80_SLICE_CYCLES ? left : Z80_SLICE_CYCLES));
+
+        if (z80_endSlice(z80, &status))
+            break;
+    }
+
+    z80->cycles += cpu->cycles - start;
+    return status;
+}
+
+
+// Runs up to WIDE_MAX_LANES instances as z80_run() does, in lockstep.
+// A slice of an instance only ends when cpu_run() would have returned:
+// lanes stopped early by another one resume with what is left of it.
+// Returns 0 if no errors occur.
+static int32_t z80_runGroup(z80_t **z80, uint32_t count, uint32_t cycles,
+    z80_run_t *status) {
+
+    cpu_t *cpus[WIDE_MAX_LANES];
+    uint32_t start[WIDE_MAX_LANES];
+    uint32_t slice_start[WIDE_MAX_LANES];
+    uint32_t slice[WIDE_MAX_LANES];
+    uint32_t budget[WIDE_MAX_LANES];
+    cpu_run_t lane_status[WIDE_MAX_LANES];
+    bool is_over[WIDE_MAX_LANES];
+
+    for (uint32_t i = 0; i < count; i++) {
+        cpus[i] = z80[i]->board.cpu;
+        start[i] = cpus[i]->cycles;
+        slice[i] = 0;
+        is_over[i] = false;
+        status[i] = Z80_RUN_BUDGET;
+    }
+
+    wide_t *wide = wide_create(cpus, count);
+    if (wide == NULL)
+        return 1;
+
+    for (;;) {
+        bool is_done = true;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t used = cpus[i]->cycles - start[i];
+            if (used >= cycles)
+                is_over[i] = true;
+            if (is_over[i]) {
+                budget[i] = 0;
+                continue;
+            }
+            // Starts a new slice.
+            if (slice[i] == 0) {
+                uint32_t left = cycles - used;
+                slice[i] = board_sliceCycles(&z80[i]->board,
+                    (left < Z80_SLICE_CYCLES) ? left : Z80_SLICE_CYCLES);
+                slice_start[i] = cpus[i]->cycles;
+            }
+            budget[i] = slice[i] - (cpus[i]->cycles - slice_start[i]);
+            is_done = false;
+        }
+        if (is_done)
+            break;
+
+        wide_run(wide, budget, lane_status);
+
+        for (uint32_t i = 0; i < count; i++) {
+            if (is_over[i] || (lane_status[i] == CPU_RUN_BUDGET &&
+                cpus[i]->cycles - slice_start[i] < slice[i]))
+                continue;
+            slice[i] = 0;
+            is_over[i] = z80_endSlice(z80[i], &status[i]);
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+        z80[i]->cycles += cpus[i]->cycles - start[i];
+    wide_destroy(wide);
+    return 0;
+}
+
+
+// Runs count instances for up to cycles T-states each, like z80_run(),
+// storing the reason for each of them to stop in status. Groups of up to
+// WIDE_MAX_LANES instances run in lockstep: while their guests run the
+// same code, one instruction is decoded for all of them.
+// Returns 0 if no errors occur.
+int32_t z80_runLockstep(z80_t **z80, uint32_t count, uint32_t cycles,
+    z80_run_t *status) {
+
+    for (uint32_t i = 0; i < count; i += WIDE_MAX_LANES) {
+        uint32_t n = (count - i < WIDE_MAX_LANES) ? count - i : WIDE_MAX_LANES;
+        if (z80_runGroup(&z80[i], n, cycles, &status[i]))
+            return 1;
+    }
+    return 0;
+}
+
+
+// Sets the ACIA of the instance in turbo mode, where characters take no
+// time on the serial lines, or back to timed characters (see mc6850.h).
+void z80_setTurbo(z80_t *z80, bool is_turbo) {
+    z80->board.acia->is_turbo = is_turbo;
+    return;
+}
+
+
+// Queues up to size bytes of input for the guest.
+// Returns the number of bytes queued.
+uint32_t z80_write(z80_t *z80, const uint8_t *data, uint32_t size) {
+    uint32_t n = 0;
+
+    while (n < size && z80->input.count < Z80_BUFFER_SIZE) {
+        uint32_t tail = (z80->input.head + z80->input.count) % Z80_BUFFER_SIZE;
+        z80->input.data[tail] = data[n++];
+        z80->input.count++;
+    }
+    z80->idle_slices = 0;
+    return n;
+}
+
+
+// Takes up to size bytes of guest output.
+// Returns the number of bytes copied to data.
+uint32_t z80_read(z80_t *z80, uint8_t *data, uint32_t size) {
+    uint32_t n = 0;
+
+    while (n < size && z80->output.count > 0) {
+        data[n++] = z80->output.data[z80->output.head];
+        z80->output.head = (z80->output.head + 1) % Z80_BUFFER_SIZE;
+        z80->output.count--;
+    }
+    return n;
+}
+
+
+// Returns the T-states run since the instance was created.
+uint64_t z80_cycles(const z80_t *z80) {
+    return z80->cycles;
+}
+
+
+// Releases the instance.
+void z80_destroy(z80_t *z80) {
+    board_destroy(&z80->board);
+    free(z80);
+    return;
+}